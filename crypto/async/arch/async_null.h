@@ -23,7 +23,7 @@ typedef struct async_fibre_st {
 
 
 # define async_fibre_swapcontext(o,n,r)         0
-# define async_fibre_makecontext(c)             0
+# define async_fibre_makecontext(c, sz)         0
 # define async_fibre_free(f)
 # define async_fibre_init_dispatcher(f)
 
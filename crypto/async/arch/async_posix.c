@@ -14,8 +14,17 @@
 
 # include <stddef.h>
 # include <unistd.h>
+# include <sys/mman.h>
 
-#define STACKSIZE       32768
+# if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#  define MAP_ANON MAP_ANONYMOUS
+# endif
+# ifndef MAP_STACK
+#  define MAP_STACK 0
+# endif
+# ifndef PAGE_SIZE
+#  define PAGE_SIZE    4096
+# endif
 
 int ASYNC_is_capable(void)
 {
@@ -32,13 +41,73 @@ void async_local_cleanup(void)
 {
 }
 
-int async_fibre_makecontext(async_fibre *fibre)
+static size_t async_page_size(void)
 {
+    size_t pgsize = PAGE_SIZE;
+
+#if defined(_SC_PAGE_SIZE) || defined (_SC_PAGESIZE)
+    {
+# if defined(_SC_PAGE_SIZE)
+        long tmppgsize = sysconf(_SC_PAGE_SIZE);
+# else
+        long tmppgsize = sysconf(_SC_PAGESIZE);
+# endif
+        if (tmppgsize > 0)
+            pgsize = (size_t)tmppgsize;
+    }
+#endif
+    return pgsize;
+}
+
+/*
+ * Stacks are mapped with an inaccessible guard page below them, so that a job
+ * that runs off the end of its stack faults rather than silently corrupting
+ * whatever happens to be allocated next to it.
+ */
+static void *async_stack_alloc(size_t size)
+{
+#ifdef MAP_ANON
+    size_t pgsize = async_page_size();
+    unsigned char *map;
+
+    map = mmap(NULL, size + pgsize, PROT_READ | PROT_WRITE,
+               MAP_ANON | MAP_PRIVATE | MAP_STACK, -1, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+    if (mprotect(map, pgsize, PROT_NONE) < 0) {
+        munmap(map, size + pgsize);
+        return NULL;
+    }
+    return map + pgsize;
+#else
+    return OPENSSL_malloc(size);
+#endif
+}
+
+static void async_stack_free(void *stack, size_t size)
+{
+#ifdef MAP_ANON
+    size_t pgsize = async_page_size();
+
+    munmap((unsigned char *)stack - pgsize, size + pgsize);
+#else
+    OPENSSL_free(stack);
+#endif
+}
+
+int async_fibre_makecontext(async_fibre *fibre, size_t stack_size)
+{
+    size_t pgsize = async_page_size();
+
+    if (stack_size == 0)
+        stack_size = ASYNC_DEFAULT_STACK_SIZE;
+    stack_size = (stack_size + pgsize - 1) / pgsize * pgsize;
+
     fibre->env_init = 0;
     if (getcontext(&fibre->fibre) == 0) {
-        fibre->fibre.uc_stack.ss_sp = OPENSSL_malloc(STACKSIZE);
+        fibre->fibre.uc_stack.ss_sp = async_stack_alloc(stack_size);
         if (fibre->fibre.uc_stack.ss_sp != NULL) {
-            fibre->fibre.uc_stack.ss_size = STACKSIZE;
+            fibre->fibre.uc_stack.ss_size = stack_size;
             fibre->fibre.uc_link = NULL;
             makecontext(&fibre->fibre, async_start_func, 0);
             return 1;
@@ -51,7 +120,9 @@ int async_fibre_makecontext(async_fibre *fibre)
 
 void async_fibre_free(async_fibre *fibre)
 {
-    OPENSSL_free(fibre->fibre.uc_stack.ss_sp);
+    if (fibre->fibre.uc_stack.ss_sp != NULL)
+        async_stack_free(fibre->fibre.uc_stack.ss_sp,
+                         fibre->fibre.uc_stack.ss_size);
     fibre->fibre.uc_stack.ss_sp = NULL;
 }
 
@@ -124,7 +124,7 @@ static ASYNC_JOB *async_get_pool_job(void) {
 
         job = async_job_new();
         if (job != NULL) {
-            if (! async_fibre_makecontext(&job->fibrectx)) {
+            if (! async_fibre_makecontext(&job->fibrectx, pool->stack_size)) {
                 async_job_free(job);
                 return NULL;
             }
@@ -316,12 +316,17 @@ void async_deinit(void)
 }
 
 int ASYNC_init_thread(size_t max_size, size_t init_size)
+{
+    return ASYNC_init_thread_ex(max_size, init_size, 0);
+}
+
+int ASYNC_init_thread_ex(size_t max_size, size_t init_size, size_t stack_size)
 {
     async_pool *pool;
     size_t curr_size = 0;
 
     if (init_size > max_size) {
-        ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD, ASYNC_R_INVALID_POOL_SIZE);
+        ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD_EX, ASYNC_R_INVALID_POOL_SIZE);
         return 0;
     }
 
@@ -333,24 +338,26 @@ int ASYNC_init_thread(size_t max_size, size_t init_size)
 
     pool = OPENSSL_zalloc(sizeof(*pool));
     if (pool == NULL) {
-        ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD, ERR_R_MALLOC_FAILURE);
+        ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD_EX, ERR_R_MALLOC_FAILURE);
         return 0;
     }
 
     pool->jobs = sk_ASYNC_JOB_new_reserve(NULL, init_size);
     if (pool->jobs == NULL) {
-        ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD, ERR_R_MALLOC_FAILURE);
+        ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD_EX, ERR_R_MALLOC_FAILURE);
         OPENSSL_free(pool);
         return 0;
     }
 
     pool->max_size = max_size;
+    pool->stack_size = stack_size;
 
     /* Pre-create jobs as required */
     while (init_size--) {
         ASYNC_JOB *job;
         job = async_job_new();
-        if (job == NULL || !async_fibre_makecontext(&job->fibrectx)) {
+        if (job == NULL
+                || !async_fibre_makecontext(&job->fibrectx, stack_size)) {
             /*
              * Not actually fatal because we already created the pool, just
              * skip creation of any more jobs
@@ -364,7 +371,7 @@ int ASYNC_init_thread(size_t max_size, size_t init_size)
     }
     pool->curr_size = curr_size;
     if (!CRYPTO_THREAD_set_local(&poolkey, pool)) {
-        ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD, ASYNC_R_FAILED_TO_SET_POOL);
+        ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD_EX, ASYNC_R_FAILED_TO_SET_POOL);
         goto err;
     }
 
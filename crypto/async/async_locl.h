@@ -62,14 +62,30 @@ struct async_wait_ctx_st {
     ASYNC_callback_fn callback;
     void *callback_arg;
     int status;
+    ASYNC_WAIT_QUEUE *queue;
+    void *queue_arg;
+};
+
+struct async_wait_queue_st {
+    void **done;                /* Ring of completed jobs not yet drained */
+    size_t size;
+    size_t head;
+    size_t num;
+    ASYNC_callback_fn notify;
+    void *notify_arg;
+    CRYPTO_RWLOCK *lock;
 };
 
 DEFINE_STACK_OF(ASYNC_JOB)
 
+/* Used for fibre stacks when ASYNC_init_thread_ex() is not given a size */
+#define ASYNC_DEFAULT_STACK_SIZE    32768
+
 struct async_pool_st {
     STACK_OF(ASYNC_JOB) *jobs;
     size_t curr_size;
     size_t max_size;
+    size_t stack_size;
 };
 
 void async_local_cleanup(void);
@@ -191,6 +191,8 @@ int ASYNC_WAIT_CTX_set_callback(ASYNC_WAIT_CTX *ctx,
 
       ctx->callback = callback;
       ctx->callback_arg = callback_arg;
+      ctx->queue = NULL;
+      ctx->queue_arg = NULL;
       return 1;
 }
 
@@ -217,6 +219,167 @@ int ASYNC_WAIT_CTX_get_status(ASYNC_WAIT_CTX *ctx)
       return ctx->status;
 }
 
+ASYNC_WAIT_QUEUE *ASYNC_WAIT_QUEUE_new(void)
+{
+    ASYNC_WAIT_QUEUE *queue = OPENSSL_zalloc(sizeof(*queue));
+
+    if (queue == NULL) {
+        ERR_raise(ERR_LIB_ASYNC, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    queue->lock = CRYPTO_THREAD_lock_new();
+    if (queue->lock == NULL) {
+        ERR_raise(ERR_LIB_ASYNC, ERR_R_MALLOC_FAILURE);
+        OPENSSL_free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+void ASYNC_WAIT_QUEUE_free(ASYNC_WAIT_QUEUE *queue)
+{
+    if (queue == NULL)
+        return;
+
+    OPENSSL_free(queue->done);
+    CRYPTO_THREAD_lock_free(queue->lock);
+    OPENSSL_free(queue);
+}
+
+int ASYNC_WAIT_QUEUE_set_notify(ASYNC_WAIT_QUEUE *queue,
+                                ASYNC_callback_fn notify, void *notify_arg)
+{
+    if (queue == NULL)
+        return 0;
+
+    queue->notify = notify;
+    queue->notify_arg = notify_arg;
+    return 1;
+}
+
+/* Make room for at least |min| entries, keeping the waiting ones in order */
+static int async_wait_queue_grow(ASYNC_WAIT_QUEUE *queue, size_t min)
+{
+    size_t size = queue->size == 0 ? 16 : queue->size * 2;
+    size_t i;
+    void **done;
+
+    while (size < min)
+        size *= 2;
+    if ((done = OPENSSL_malloc(size * sizeof(*done))) == NULL) {
+        ERR_raise(ERR_LIB_ASYNC, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    for (i = 0; i < queue->num; i++)
+        done[i] = queue->done[(queue->head + i) % queue->size];
+    OPENSSL_free(queue->done);
+    queue->done = done;
+    queue->size = size;
+    queue->head = 0;
+    return 1;
+}
+
+/*
+ * Add the completed |ctxs|, which are all attached to |queue|, under one lock.
+ * The application is only notified when the queue was empty: it has not been
+ * woken yet for anything that is waiting to be drained.
+ */
+static int async_wait_queue_push(ASYNC_WAIT_QUEUE *queue,
+                                 ASYNC_WAIT_CTX **ctxs, size_t num)
+{
+    size_t i;
+    int notify;
+
+    if (!CRYPTO_THREAD_write_lock(queue->lock))
+        return 0;
+    if (queue->num + num > queue->size
+            && !async_wait_queue_grow(queue, queue->num + num)) {
+        CRYPTO_THREAD_unlock(queue->lock);
+        return 0;
+    }
+    notify = queue->num == 0;
+    for (i = 0; i < num; i++) {
+        queue->done[(queue->head + queue->num) % queue->size] =
+            ctxs[i]->queue_arg;
+        queue->num++;
+    }
+    CRYPTO_THREAD_unlock(queue->lock);
+
+    if (notify && queue->notify != NULL)
+        queue->notify(queue->notify_arg);
+    return 1;
+}
+
+size_t ASYNC_WAIT_QUEUE_drain(ASYNC_WAIT_QUEUE *queue, void **done,
+                              size_t max)
+{
+    size_t i, num;
+
+    if (!CRYPTO_THREAD_write_lock(queue->lock))
+        return 0;
+    num = queue->num < max ? queue->num : max;
+    for (i = 0; i < num; i++) {
+        done[i] = queue->done[queue->head];
+        queue->head = (queue->head + 1) % queue->size;
+    }
+    queue->num -= num;
+    CRYPTO_THREAD_unlock(queue->lock);
+    return num;
+}
+
+/*
+ * The callback of an ASYNC_WAIT_CTX that is attached to a queue, so that async
+ * aware code that calls the callback of each job itself also feeds the queue.
+ */
+static int async_wait_queue_cb(void *arg)
+{
+    ASYNC_WAIT_CTX *ctx = arg;
+
+    return ASYNC_WAIT_CTX_complete(&ctx, 1);
+}
+
+int ASYNC_WAIT_CTX_set_queue(ASYNC_WAIT_CTX *ctx, ASYNC_WAIT_QUEUE *queue,
+                             void *done_arg)
+{
+    if (ctx == NULL)
+        return 0;
+
+    if (queue != NULL) {
+        ctx->callback = async_wait_queue_cb;
+        ctx->callback_arg = ctx;
+    } else if (ctx->callback == async_wait_queue_cb) {
+        ctx->callback = NULL;
+        ctx->callback_arg = NULL;
+    }
+    ctx->queue = queue;
+    ctx->queue_arg = done_arg;
+    return 1;
+}
+
+int ASYNC_WAIT_CTX_complete(ASYNC_WAIT_CTX **ctxs, size_t numctxs)
+{
+    size_t i, j;
+    int ret = 1;
+
+    for (i = 0; i < numctxs; i = j) {
+        ASYNC_WAIT_QUEUE *queue = ctxs[i]->queue;
+
+        if (queue == NULL) {
+            if (ctxs[i]->callback == NULL
+                    || !ctxs[i]->callback(ctxs[i]->callback_arg))
+                ret = 0;
+            j = i + 1;
+            continue;
+        }
+        /* Hand each run of jobs that share a queue over in one go */
+        for (j = i + 1; j < numctxs && ctxs[j]->queue == queue; j++)
+            continue;
+        if (!async_wait_queue_push(queue, ctxs + i, j - i))
+            ret = 0;
+    }
+    return ret;
+}
+
 void async_wait_ctx_reset_counts(ASYNC_WAIT_CTX *ctx)
 {
     struct fd_lookup_st *curr, *prev = NULL;
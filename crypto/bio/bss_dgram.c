@@ -7,12 +7,21 @@
  * https://www.openssl.org/source/license.html
  */
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE            /* make sure recvmmsg is declared */
+#endif
+
 #include <stdio.h>
 #include <errno.h>
 
 #include "bio_lcl.h"
 #ifndef OPENSSL_NO_DGRAM
 
+# if defined(OPENSSL_SYS_LINUX) && defined(MSG_WAITFORONE)
+#  include <netinet/udp.h>
+#  define DGRAM_BATCH
+# endif
+
 # ifndef OPENSSL_NO_SCTP
 #  include <netinet/sctp.h>
 #  include <fcntl.h>
@@ -63,6 +72,15 @@ static void dgram_sctp_handle_auth_free_key_event(BIO *b, union sctp_notificatio
 
 static int BIO_dgram_should_retry(int s);
 
+# ifdef DGRAM_BATCH
+static int dgram_read_batch(BIO *b, char *out, int outl);
+static int dgram_write_batch(BIO *b, const char *in, int inl);
+static int dgram_flush_batch(BIO *b);
+static int dgram_set_recv_batch(BIO *b, size_t num);
+static int dgram_set_send_batch(BIO *b, size_t num);
+static void dgram_free_batches(BIO *b);
+# endif
+
 static void get_current_time(struct timeval *t);
 
 static const BIO_METHOD methods_dgramp = {
@@ -101,6 +119,58 @@ static const BIO_METHOD methods_dgramp_sctp = {
 };
 # endif
 
+# ifdef DGRAM_BATCH
+/* The most datagrams moved by one recvmmsg() or sendmmsg() call */
+#  define DGRAM_BATCH_MAX         64
+/* Room for the largest UDP payload, and so for a GRO aggregate too */
+#  define DGRAM_RECV_BUF_SIZE     65536
+/* Room per datagram in the send queue, sized for MTU sized datagrams */
+#  define DGRAM_SEND_BUF_SIZE     2048
+/* The kernel limits for a single UDP_SEGMENT send */
+#  define DGRAM_GSO_MAX_SEGS      64
+#  define DGRAM_GSO_MAX_BYTES     65000
+
+typedef union {
+    struct cmsghdr align;
+    unsigned char buf[CMSG_SPACE(sizeof(int))];
+} dgram_cmsg_buf;
+
+/*
+ * Datagrams received by one recvmmsg() call and not yet read.  A message
+ * received with UDP_GRO may hold several datagrams of |seg| bytes each, the
+ * last one possibly shorter, which are returned by separate reads.
+ */
+typedef struct bio_dgram_recv_batch_st {
+    size_t num;
+    size_t filled;
+    size_t cur;
+    size_t off;
+    unsigned char *buf;
+    struct mmsghdr *msgs;
+    struct iovec *iov;
+    BIO_ADDR *peer;
+    dgram_cmsg_buf *cmsg;
+    size_t *seg;
+} bio_dgram_recv_batch;
+
+/*
+ * Datagrams written but not yet sent.  They are stored back to back in |buf|
+ * and are sent by one sendmmsg() call when the queue is full or flushed.
+ */
+typedef struct bio_dgram_send_batch_st {
+    size_t num;
+    size_t queued;
+    size_t sent;
+    size_t buflen;
+    unsigned char *buf;
+    size_t *len;
+    BIO_ADDR *peer;
+    struct mmsghdr *msgs;
+    struct iovec *iov;
+    dgram_cmsg_buf *cmsg;
+} bio_dgram_send_batch;
+# endif
+
 typedef struct bio_dgram_data_st {
     BIO_ADDR peer;
     unsigned int connected;
@@ -109,6 +179,12 @@ typedef struct bio_dgram_data_st {
     struct timeval next_timeout;
     struct timeval socket_timeout;
     unsigned int peekmode;
+# ifdef DGRAM_BATCH
+    bio_dgram_recv_batch *rbatch;
+    bio_dgram_send_batch *wbatch;
+    unsigned int gro;
+    unsigned int gso;
+# endif
 } bio_dgram_data;
 
 # ifndef OPENSSL_NO_SCTP
@@ -171,6 +247,9 @@ static int dgram_free(BIO *a)
     if (!dgram_clear(a))
         return 0;
 
+# ifdef DGRAM_BATCH
+    dgram_free_batches(a);
+# endif
     data = (bio_dgram_data *)a->ptr;
     OPENSSL_free(data);
 
@@ -305,6 +384,11 @@ static int dgram_read(BIO *b, char *out, int outl)
     BIO_ADDR peer;
     socklen_t len = sizeof(peer);
 
+# ifdef DGRAM_BATCH
+    if (data->rbatch != NULL && out != NULL)
+        return dgram_read_batch(b, out, outl);
+# endif
+
     if (out != NULL) {
         clear_socket_error();
         memset(&peer, 0, sizeof(peer));
@@ -334,6 +418,16 @@ static int dgram_write(BIO *b, const char *in, int inl)
 {
     int ret;
     bio_dgram_data *data = (bio_dgram_data *)b->ptr;
+
+# ifdef DGRAM_BATCH
+    if (data->wbatch != NULL && inl >= 0
+            && (size_t)inl <= data->wbatch->buflen)
+        return dgram_write_batch(b, in, inl);
+    /* Keep datagrams in order when one is too big to be queued */
+    if (data->wbatch != NULL && dgram_flush_batch(b) <= 0)
+        return -1;
+# endif
+
     clear_socket_error();
 
     if (data->connected)
@@ -423,6 +517,15 @@ static long dgram_ctrl(BIO *b, int cmd, long num, void *ptr)
         b->num = *((int *)ptr);
         b->shutdown = (int)num;
         b->init = 1;
+# ifdef DGRAM_BATCH
+        /* Set the new socket up the same way, dropping anything queued */
+        if (data->rbatch != NULL)
+            dgram_set_recv_batch(b, data->rbatch->num);
+        if (data->wbatch != NULL) {
+            data->wbatch->queued = data->wbatch->sent = 0;
+            dgram_set_send_batch(b, data->wbatch->num);
+        }
+# endif
         break;
     case BIO_C_GET_FD:
         if (b->init) {
@@ -440,12 +543,44 @@ static long dgram_ctrl(BIO *b, int cmd, long num, void *ptr)
         b->shutdown = (int)num;
         break;
     case BIO_CTRL_PENDING:
+        ret = 0;
+# ifdef DGRAM_BATCH
+        /* The size of the next datagram that can be read without a syscall */
+        if (data->rbatch != NULL
+                && data->rbatch->cur < data->rbatch->filled) {
+            bio_dgram_recv_batch *rb = data->rbatch;
+            size_t left = rb->msgs[rb->cur].msg_len - rb->off;
+
+            ret = (long)(left < rb->seg[rb->cur] ? left : rb->seg[rb->cur]);
+        }
+# endif
+        break;
     case BIO_CTRL_WPENDING:
         ret = 0;
         break;
     case BIO_CTRL_DUP:
+        ret = 1;
+        break;
     case BIO_CTRL_FLUSH:
         ret = 1;
+# ifdef DGRAM_BATCH
+        if (data->wbatch != NULL)
+            ret = dgram_flush_batch(b);
+# endif
+        break;
+    case BIO_CTRL_DGRAM_SET_RECV_BATCH:
+# ifdef DGRAM_BATCH
+        ret = dgram_set_recv_batch(b, num > 0 ? (size_t)num : 0);
+# else
+        ret = 0;
+# endif
+        break;
+    case BIO_CTRL_DGRAM_SET_SEND_BATCH:
+# ifdef DGRAM_BATCH
+        ret = dgram_set_send_batch(b, num > 0 ? (size_t)num : 0);
+# else
+        ret = 0;
+# endif
         break;
     case BIO_CTRL_DGRAM_CONNECT:
         BIO_ADDR_make(&data->peer, BIO_ADDR_sockaddr((BIO_ADDR *)ptr));
@@ -808,6 +943,348 @@ static int dgram_puts(BIO *bp, const char *str)
     return ret;
 }
 
+# ifdef DGRAM_BATCH
+static void dgram_free_recv_batch(bio_dgram_recv_batch *rb)
+{
+    if (rb == NULL)
+        return;
+    OPENSSL_free(rb->buf);
+    OPENSSL_free(rb->msgs);
+    OPENSSL_free(rb->iov);
+    OPENSSL_free(rb->peer);
+    OPENSSL_free(rb->cmsg);
+    OPENSSL_free(rb->seg);
+    OPENSSL_free(rb);
+}
+
+static void dgram_free_send_batch(bio_dgram_send_batch *wb)
+{
+    if (wb == NULL)
+        return;
+    OPENSSL_free(wb->buf);
+    OPENSSL_free(wb->len);
+    OPENSSL_free(wb->peer);
+    OPENSSL_free(wb->msgs);
+    OPENSSL_free(wb->iov);
+    OPENSSL_free(wb->cmsg);
+    OPENSSL_free(wb);
+}
+
+static void dgram_free_batches(BIO *b)
+{
+    bio_dgram_data *data = (bio_dgram_data *)b->ptr;
+
+    dgram_free_recv_batch(data->rbatch);
+    data->rbatch = NULL;
+    dgram_free_send_batch(data->wbatch);
+    data->wbatch = NULL;
+}
+
+/*
+ * Receive |num| datagrams per recvmmsg() call, or go back to one recvfrom()
+ * per datagram if |num| is 0.  Datagrams that have been received but not read
+ * yet are discarded.  GRO is used when the kernel supports it.
+ */
+static int dgram_set_recv_batch(BIO *b, size_t num)
+{
+    bio_dgram_data *data = (bio_dgram_data *)b->ptr;
+    bio_dgram_recv_batch *rb = NULL;
+    int val;
+
+    if (num > DGRAM_BATCH_MAX)
+        num = DGRAM_BATCH_MAX;
+    if (num > 0) {
+        if ((rb = OPENSSL_zalloc(sizeof(*rb))) == NULL
+                || (rb->buf = OPENSSL_malloc(num * DGRAM_RECV_BUF_SIZE)) == NULL
+                || (rb->msgs = OPENSSL_zalloc(num * sizeof(*rb->msgs))) == NULL
+                || (rb->iov = OPENSSL_zalloc(num * sizeof(*rb->iov))) == NULL
+                || (rb->peer = OPENSSL_zalloc(num * sizeof(*rb->peer))) == NULL
+                || (rb->cmsg = OPENSSL_zalloc(num * sizeof(*rb->cmsg))) == NULL
+                || (rb->seg = OPENSSL_zalloc(num * sizeof(*rb->seg))) == NULL) {
+            dgram_free_recv_batch(rb);
+            ERR_raise(ERR_LIB_BIO, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        rb->num = num;
+    }
+
+    /*
+     * A socket that receives GRO aggregates must only be read by code that
+     * splits them up again, so switch GRO off along with batching.
+     */
+    val = num > 0;
+    data->gro = 0;
+#  if defined(SOL_UDP) && defined(UDP_GRO)
+    if (b->init && (val || data->rbatch != NULL)
+            && setsockopt(b->num, SOL_UDP, UDP_GRO, &val, sizeof(val)) == 0)
+        data->gro = val;
+#  endif
+
+    dgram_free_recv_batch(data->rbatch);
+    data->rbatch = rb;
+    return 1;
+}
+
+/*
+ * Queue up to |num| written datagrams and send them with one sendmmsg() call,
+ * or go back to one send per write if |num| is 0.  Queued datagrams are sent
+ * first.  Runs of equally sized datagrams to the same peer are sent as a
+ * single UDP_SEGMENT message when the kernel supports it.
+ */
+static int dgram_set_send_batch(BIO *b, size_t num)
+{
+    bio_dgram_data *data = (bio_dgram_data *)b->ptr;
+    bio_dgram_send_batch *wb = NULL;
+#  if defined(SOL_UDP) && defined(UDP_SEGMENT)
+    int val = 0;
+#  endif
+
+    if (data->wbatch != NULL && dgram_flush_batch(b) <= 0)
+        return 0;
+
+    if (num > DGRAM_BATCH_MAX)
+        num = DGRAM_BATCH_MAX;
+    if (num > 0) {
+        if ((wb = OPENSSL_zalloc(sizeof(*wb))) == NULL
+                || (wb->buf = OPENSSL_malloc(num * DGRAM_SEND_BUF_SIZE)) == NULL
+                || (wb->len = OPENSSL_zalloc(num * sizeof(*wb->len))) == NULL
+                || (wb->peer = OPENSSL_zalloc(num * sizeof(*wb->peer))) == NULL
+                || (wb->msgs = OPENSSL_zalloc(num * sizeof(*wb->msgs))) == NULL
+                || (wb->cmsg = OPENSSL_zalloc(num * sizeof(*wb->cmsg))) == NULL
+                || (wb->iov = OPENSSL_zalloc(num * sizeof(*wb->iov))) == NULL) {
+            dgram_free_send_batch(wb);
+            ERR_raise(ERR_LIB_BIO, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        wb->num = num;
+        wb->buflen = num * DGRAM_SEND_BUF_SIZE;
+    }
+
+    /* Setting a segment size of 0 on the socket tells us GSO is available */
+    data->gso = 0;
+#  if defined(SOL_UDP) && defined(UDP_SEGMENT)
+    if (wb != NULL && b->init
+            && setsockopt(b->num, SOL_UDP, UDP_SEGMENT, &val, sizeof(val)) == 0)
+        data->gso = 1;
+#  endif
+
+    dgram_free_send_batch(data->wbatch);
+    data->wbatch = wb;
+    return 1;
+}
+
+static int dgram_read_batch(BIO *b, char *out, int outl)
+{
+    bio_dgram_data *data = (bio_dgram_data *)b->ptr;
+    bio_dgram_recv_batch *rb = data->rbatch;
+    size_t i, len;
+    int ret;
+
+    if (rb->cur >= rb->filled) {
+        for (i = 0; i < rb->num; i++) {
+            struct msghdr *hdr = &rb->msgs[i].msg_hdr;
+
+            rb->iov[i].iov_base = rb->buf + i * DGRAM_RECV_BUF_SIZE;
+            rb->iov[i].iov_len = DGRAM_RECV_BUF_SIZE;
+            memset(&rb->peer[i], 0, sizeof(rb->peer[i]));
+            hdr->msg_name = &rb->peer[i];
+            hdr->msg_namelen = sizeof(rb->peer[i]);
+            hdr->msg_iov = &rb->iov[i];
+            hdr->msg_iovlen = 1;
+            hdr->msg_control = rb->cmsg[i].buf;
+            hdr->msg_controllen = sizeof(rb->cmsg[i].buf);
+            hdr->msg_flags = 0;
+        }
+
+        clear_socket_error();
+        dgram_adjust_rcv_timeout(b);
+        /* Block for the first datagram at most, then take what is there */
+        ret = recvmmsg(b->num, rb->msgs, rb->num, MSG_WAITFORONE, NULL);
+        BIO_clear_retry_flags(b);
+        if (ret < 0) {
+            if (BIO_dgram_should_retry(ret)) {
+                BIO_set_retry_read(b);
+                data->_errno = get_last_socket_error();
+            }
+            dgram_reset_rcv_timeout(b);
+            return ret;
+        }
+        dgram_reset_rcv_timeout(b);
+        if (ret == 0)
+            return 0;
+
+        for (i = 0; i < (size_t)ret; i++) {
+            struct msghdr *hdr = &rb->msgs[i].msg_hdr;
+            struct cmsghdr *cmsg;
+
+            rb->seg[i] = rb->msgs[i].msg_len;
+#  if defined(SOL_UDP) && defined(UDP_GRO)
+            for (cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL;
+                 cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+                int seg;
+
+                if (cmsg->cmsg_level != SOL_UDP || cmsg->cmsg_type != UDP_GRO)
+                    continue;
+                memcpy(&seg, CMSG_DATA(cmsg), sizeof(seg));
+                if (seg > 0)
+                    rb->seg[i] = seg;
+            }
+#  else
+            (void)hdr;
+            (void)cmsg;
+#  endif
+        }
+        rb->filled = ret;
+        rb->cur = 0;
+        rb->off = 0;
+    }
+
+    BIO_clear_retry_flags(b);
+    len = rb->msgs[rb->cur].msg_len - rb->off;
+    if (len > rb->seg[rb->cur])
+        len = rb->seg[rb->cur];
+    ret = (size_t)outl < len ? outl : (int)len;
+    memcpy(out, rb->buf + rb->cur * DGRAM_RECV_BUF_SIZE + rb->off, ret);
+
+    if (!data->connected)
+        BIO_ctrl(b, BIO_CTRL_DGRAM_SET_PEER, 0, &rb->peer[rb->cur]);
+
+    /* Like recvfrom(), a read consumes the datagram even if it is truncated */
+    if (!data->peekmode) {
+        rb->off += len;
+        if (rb->off >= rb->msgs[rb->cur].msg_len) {
+            rb->cur++;
+            rb->off = 0;
+        }
+    }
+    return ret;
+}
+
+static int dgram_write_batch(BIO *b, const char *in, int inl)
+{
+    bio_dgram_data *data = (bio_dgram_data *)b->ptr;
+    bio_dgram_send_batch *wb = data->wbatch;
+    size_t used = 0, i;
+
+    for (i = 0; i < wb->queued; i++)
+        used += wb->len[i];
+    if (wb->queued == wb->num || used + inl > wb->buflen) {
+        /* The retry flags are left set if the socket would block */
+        if (dgram_flush_batch(b) <= 0)
+            return -1;
+        used = 0;
+    }
+
+    BIO_clear_retry_flags(b);
+    memcpy(wb->buf + used, in, inl);
+    wb->len[wb->queued] = inl;
+    if (!data->connected)
+        wb->peer[wb->queued] = data->peer;
+    wb->queued++;
+    return inl;
+}
+
+static int dgram_same_peer(const BIO_ADDR *a, const BIO_ADDR *b)
+{
+    socklen_t len = BIO_ADDR_sockaddr_size(a);
+
+    return len == BIO_ADDR_sockaddr_size(b)
+        && memcmp(BIO_ADDR_sockaddr(a), BIO_ADDR_sockaddr(b), len) == 0;
+}
+
+/*
+ * Send the queued datagrams.  Returns 1 once they have all been sent or
+ * dropped, and <= 0 if the socket would block, with the retry flags set and
+ * the rest of the queue kept, or if a datagram could not be sent.
+ */
+static int dgram_flush_batch(BIO *b)
+{
+    bio_dgram_data *data = (bio_dgram_data *)b->ptr;
+    bio_dgram_send_batch *wb = data->wbatch;
+    size_t off = 0, i, j, nmsgs, segs[DGRAM_BATCH_MAX];
+    int ret, ok = 1;
+
+    BIO_clear_retry_flags(b);
+    for (i = 0; i < wb->sent; i++)
+        off += wb->len[i];
+
+    while (wb->sent < wb->queued) {
+        /* Gather the datagrams that are left into as few messages as we can */
+        nmsgs = 0;
+        for (i = wb->sent; i < wb->queued; i = j) {
+            struct msghdr *hdr = &wb->msgs[nmsgs].msg_hdr;
+            size_t total = wb->len[i];
+
+            for (j = i + 1; data->gso && j < wb->queued
+                     && j - i < DGRAM_GSO_MAX_SEGS
+                     && wb->len[j - 1] == wb->len[i]
+                     && wb->len[j] <= wb->len[i] && wb->len[j] > 0
+                     && total + wb->len[j] <= DGRAM_GSO_MAX_BYTES
+                     && (data->connected
+                         || dgram_same_peer(&wb->peer[i], &wb->peer[j]));
+                 j++)
+                total += wb->len[j];
+
+            memset(hdr, 0, sizeof(*hdr));
+            wb->iov[nmsgs].iov_base = wb->buf + off;
+            wb->iov[nmsgs].iov_len = total;
+            hdr->msg_iov = &wb->iov[nmsgs];
+            hdr->msg_iovlen = 1;
+            if (!data->connected) {
+                hdr->msg_name = &wb->peer[i];
+                hdr->msg_namelen = BIO_ADDR_sockaddr_size(&wb->peer[i]);
+            }
+#  if defined(SOL_UDP) && defined(UDP_SEGMENT)
+            if (j - i > 1) {
+                struct cmsghdr *cmsg;
+                uint16_t seg = (uint16_t)wb->len[i];
+
+                hdr->msg_control = wb->cmsg[nmsgs].buf;
+                hdr->msg_controllen = CMSG_SPACE(sizeof(seg));
+                cmsg = CMSG_FIRSTHDR(hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(seg));
+                memcpy(CMSG_DATA(cmsg), &seg, sizeof(seg));
+            }
+#  endif
+            segs[nmsgs++] = j - i;
+            off += total;
+        }
+
+        clear_socket_error();
+        ret = sendmmsg(b->num, wb->msgs, nmsgs, 0);
+        if (ret < 0) {
+            if (BIO_dgram_should_retry(ret)) {
+                BIO_set_retry_write(b);
+                data->_errno = get_last_socket_error();
+                return -1;
+            }
+            data->_errno = get_last_socket_error();
+            if (segs[0] > 1
+                    && (data->_errno == EIO || data->_errno == EINVAL)) {
+                /* The kernel or the device can't segment: stop asking it to */
+                data->gso = 0;
+            } else {
+                /* Drop the datagrams that could not be sent, like send() */
+                wb->sent += segs[0];
+                ok = -1;
+            }
+            ret = 0;
+        }
+        for (i = 0; i < (size_t)ret; i++)
+            wb->sent += segs[i];
+
+        off = 0;
+        for (i = 0; i < wb->sent; i++)
+            off += wb->len[i];
+    }
+
+    wb->queued = wb->sent = 0;
+    return ok;
+}
+# endif
+
 # ifndef OPENSSL_NO_SCTP
 const BIO_METHOD *BIO_s_datagram_sctp(void)
 {
@@ -0,0 +1,358 @@
+#! /usr/bin/env perl
+# Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+#
+# Almost Montgomery Multiplication (AMM) of two independent 1024-bit
+# operand pairs at once, for the two CRT halves of an RSA-2048 private
+# key operation.
+#
+# Operands are kept in radix 2^52, 20 digits each, so that every digit
+# fits one lane of the 52-bit integer multiply-add instructions of
+# AVX512IFMA.  One number occupies five 256-bit registers and the two
+# multiplications are interleaved digit by digit to hide the latency of
+# the reduction step.  Only 256-bit registers are used, to stay clear of
+# the frequency penalty of the 512-bit ones.
+#
+# With R = 2^1040 and 4*m < R, amm52x20_x2 computes a*b/R mod m with the
+# result less than 2*m whenever a and b are, see [1].
+#
+# [1] S. Gueron, "Efficient software implementations of modular
+#     exponentiation", Journal of Cryptographic Engineering 2:31-43 (2012).
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$avx512ifma = ($1>=2.26);
+}
+
+if (!$avx512ifma && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	    `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)/) {
+	$avx512ifma = ($1>=2.12);
+}
+
+if (!$avx512ifma && $win64 && ($flavour =~ /masm/ || $ENV{ASM} =~ /ml64/) &&
+	    `ml64 2>&1` =~ /Version ([0-9]+)\./) {
+	$avx512ifma = ($1>=14);
+}
+
+if (!$avx512ifma && `$ENV{CC} -v 2>&1`
+		=~ /((?:^clang|LLVM) version|.*based on LLVM) ([0-9]+)\.([0-9]+)/) {
+	$avx512ifma = ($2>=7);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT = *OUT;
+
+if ($avx512ifma) {{{
+$code.=<<___;
+.text
+
+.extern	OPENSSL_ia32cap_P
+.globl	rsaz_avx512ifma_eligible
+.type	rsaz_avx512ifma_eligible,\@abi-omnipotent
+.align	32
+rsaz_avx512ifma_eligible:
+	mov	OPENSSL_ia32cap_P+8(%rip),%ecx
+	xor	%eax,%eax
+	and	\$`1<<31|1<<21|1<<16`,%ecx	# AVX512VL, AVX512IFMA, AVX512F
+	mov	\$1,%edx
+	cmp	\$`1<<31|1<<21|1<<16`,%ecx
+	cmove	%edx,%eax
+	ret
+.size	rsaz_avx512ifma_eligible,.-rsaz_avx512ifma_eligible
+___
+
+{ # void rsaz_amm52x20_x2_256(
+my $rp="%rdi";	# BN_ULONG out[2][20],
+my $ap="%rsi";	# const BN_ULONG a[2][20],
+my $bp="%rdx";	# const BN_ULONG b[2][20],
+my $np="%rcx";	# const BN_ULONG m[2][20],
+my $k0="%r8";	# const BN_ULONG k0[2][4]);
+
+my $i="%r9d";
+
+# Only the volatile registers of both ABIs are used: 16-31 and 0-5.
+my @ACC=(["%ymm16","%ymm17","%ymm18","%ymm19","%ymm20"],
+	 ["%ymm21","%ymm22","%ymm23","%ymm24","%ymm25"]);
+my @B=("%ymm26","%ymm27");	# broadcast digit of b
+my @Y=("%ymm28","%ymm29");	# broadcast reduction multiplier
+my @H0=("%ymm30","%ymm31");	# high halves landing in the lowest digits
+my @AK0=("%ymm0","%ymm1");	# a[0] * k0 mod 2^52
+my @T=("%ymm2","%ymm3");	# carry out of the lowest digit
+
+$code.=<<___;
+.globl	rsaz_amm52x20_x2_256
+.type	rsaz_amm52x20_x2_256,\@function,5
+.align	32
+rsaz_amm52x20_x2_256:
+.cfi_startproc
+	mov		\$0x1,%eax
+	kmovw		%eax,%k1
+	mov		\$0x7,%eax
+	kmovw		%eax,%k2
+	mov		\$0xe,%eax
+	kmovw		%eax,%k3
+___
+for my $j (0..1) {
+    $code.=<<___;
+	vpbroadcastq	`160*$j`($ap),$T[$j]
+	vpxorq		$AK0[$j],$AK0[$j],$AK0[$j]
+	vpmadd52luq	`32*$j`($k0),$T[$j],$AK0[$j]
+___
+    for my $a (@{$ACC[$j]}) {
+	$code.="	vpxorq		$a,$a,$a\n";
+    }
+}
+$code.=<<___;
+	mov		\$20,$i
+
+.align	32
+.Loop_amm52x20_x2:
+___
+# The reduction multiplier of this step is
+#
+#	y = (acc[0] + a[0] * b[i]) * k0 = acc[0] * k0 + b[i] * (a[0] * k0)
+#
+# modulo 2^52.  The second term does not depend on acc, which leaves a
+# single multiply-add and a broadcast between the end of one step and
+# the reduction of the next.  The high 12 bits of y are ignored by the
+# multiply-add instructions that use it.
+for my $j (0..1) {
+    $code.=<<___;
+	vpbroadcastq	`160*$j`($bp),$B[$j]
+	vpxorq		$Y[$j],$Y[$j],$Y[$j]
+	vpmadd52luq	$AK0[$j],$B[$j],$Y[$j]
+	vpmadd52luq	`32*$j`($k0),$ACC[$j][0],$Y[$j]
+___
+}
+for my $j (0..1) {
+    (my $x=$Y[$j]) =~ s/ymm/xmm/;
+    $code.="	vpbroadcastq	$x,$Y[$j]\n";
+}
+# acc += a * b[i]; the high halves of the lowest four digits go aside
+for my $t (0..4) {
+    for my $j (0..1) {
+	$code.="	vpmadd52luq	".(32*$t+160*$j)."($ap),$B[$j],$ACC[$j][$t]\n";
+    }
+}
+for my $j (0..1) {
+    $code.=<<___;
+	vpxorq		$H0[$j],$H0[$j],$H0[$j]
+	vpmadd52huq	`160*$j`($ap),$B[$j],$H0[$j]
+___
+}
+# acc += m * y, which clears the low 52 bits of acc[0]
+for my $t (0..4) {
+    for my $j (0..1) {
+	$code.="	vpmadd52luq	".(32*$t+160*$j)."($np),$Y[$j],$ACC[$j][$t]\n";
+    }
+}
+for my $j (0..1) {
+    $code.="	vpmadd52huq	".(160*$j)."($np),$Y[$j],$H0[$j]\n";
+}
+# acc >>= 52: drop the lowest digit and move its carry into the next one
+for my $j (0..1) {
+    $code.="	vpsrlq		\$52,$ACC[$j][0],$T[$j]\n";
+    for my $t (0..3) {
+	$code.="	valignq		\$1,$ACC[$j][$t],$ACC[$j][$t+1],$ACC[$j][$t]\n";
+    }
+    $code.="	valignq		\$1,$ACC[$j][4],$ACC[$j][4],$ACC[$j][4]\{%k2\}\{z\}\n";
+    $code.="	vpaddq		$T[$j],$ACC[$j][0],$ACC[$j][0]\{%k1\}\n";
+    $code.="	vpaddq		$H0[$j],$ACC[$j][0],$ACC[$j][0]\n";
+}
+# the high halves of both products land one digit up, i.e. in place now
+for my $t (1..4) {
+    for my $j (0..1) {
+	$code.=<<___;
+	vpmadd52huq	`32*$t+160*$j`($ap),$B[$j],$ACC[$j][$t]
+	vpmadd52huq	`32*$t+160*$j`($np),$Y[$j],$ACC[$j][$t]
+___
+    }
+}
+$code.=<<___;
+	lea		8($bp),$bp
+	dec		$i
+	jnz		.Loop_amm52x20_x2
+
+___
+
+# Normalise to 52-bit digits.  The digits are less than 2^59 each and
+# the result is less than 2*m, so nothing carries out of the top one.
+# One parallel step leaves every digit below 2^52 + 2^7, with at most
+# a single carry out.  That carry moves on through runs of digits equal
+# to 2^52 - 1, which is done with bit masks of the digits that overflow
+# (G) and of those that are all ones (E): the digits that receive a
+# carry are ((G << 1) + E) ^ E.
+my @C=(["%ymm26","%ymm28","%ymm30","%ymm0","%ymm2"],
+       ["%ymm27","%ymm29","%ymm31","%ymm1","%ymm3"]);
+my ($g,$e,$tmp)=("%rax","%r10","%r11");
+
+for my $t (0..4) {
+    for my $j (0..1) {
+	$code.=<<___;
+	vpsrlq		\$52,$ACC[$j][$t],$C[$j][$t]
+	vpandq		.Lmask52x4(%rip),$ACC[$j][$t],$ACC[$j][$t]
+___
+    }
+}
+for my $j (0..1) {
+    for my $t (reverse 1..4) {
+	$code.="	valignq		\$3,$C[$j][$t-1],$C[$j][$t],$C[$j][$t]\n";
+    }
+    $code.="	valignq		\$3,$C[$j][0],$C[$j][0],$C[$j][0]\{%k3\}\{z\}\n";
+    for my $t (0..4) {
+	$code.="	vpaddq		$C[$j][$t],$ACC[$j][$t],$ACC[$j][$t]\n";
+    }
+}
+for my $j (0..1) {
+    $code.="	xor		$g,$g\n	xor		$e,$e\n";
+    for my $t (reverse 0..4) {
+	$code.=<<___;
+	vpcmpuq		\$6,.Lmask52x4(%rip),$ACC[$j][$t],%k4
+	vpcmpuq		\$0,.Lmask52x4(%rip),$ACC[$j][$t],%k5
+	shl		\$4,$g
+	shl		\$4,$e
+	kmovw		%k4,%r9d
+	kmovw		%k5,%r11d
+	or		%r9,$g
+	or		%r11,$e
+___
+    }
+    $code.=<<___;
+	add		$g,$g
+	add		$e,$g
+	xor		$e,$g
+___
+    for my $t (0..4) {
+	$code.=<<___;
+	kmovw		%eax,%k4
+	shr		\$4,$g
+	vpaddq		.Lone52x4(%rip),$ACC[$j][$t],$ACC[$j][$t]\{%k4\}
+	vpandq		.Lmask52x4(%rip),$ACC[$j][$t],$ACC[$j][$t]
+___
+    }
+}
+for my $j (0..1) {
+    for my $t (0..4) {
+	$code.="	vmovdqu64	$ACC[$j][$t],".(32*$t+160*$j)."($rp)\n";
+    }
+}
+$code.=<<___;
+	vzeroupper
+	ret
+.cfi_endproc
+.size	rsaz_amm52x20_x2_256,.-rsaz_amm52x20_x2_256
+
+.align	32
+.Lmask52x4:
+	.quad	0xfffffffffffff,0xfffffffffffff,0xfffffffffffff,0xfffffffffffff
+.Lone52x4:
+	.quad	1,1,1,1
+___
+}
+
+{ # void rsaz_extract_multiplier_2x20_win5(
+my $out="%rdi";	# BN_ULONG out[2][20],
+my $tbl="%rsi";	# const BN_ULONG table[32][2][20],
+my $idx0="%rdx";# int idx0,
+my $idx1="%rcx";# int idx1);
+
+my @R=(["%ymm16","%ymm17","%ymm18","%ymm19","%ymm20"],
+       ["%ymm21","%ymm22","%ymm23","%ymm24","%ymm25"]);
+my ($CNT,$IDX0,$IDX1,$ONE)=("%ymm26","%ymm27","%ymm28","%ymm29");
+
+# Every entry of the table is read, the wanted one is picked with masks,
+# so the memory access pattern does not depend on the indices.
+$code.=<<___;
+.globl	rsaz_extract_multiplier_2x20_win5
+.type	rsaz_extract_multiplier_2x20_win5,\@function,4
+.align	32
+rsaz_extract_multiplier_2x20_win5:
+.cfi_startproc
+	mov		%edx,%edx
+	mov		%ecx,%ecx
+	vpbroadcastq	$idx0,$IDX0
+	vpbroadcastq	$idx1,$IDX1
+	mov		\$1,%eax
+	vpbroadcastq	%rax,$ONE
+	vpxorq		$CNT,$CNT,$CNT
+___
+for my $j (0..1) {
+    for my $r (@{$R[$j]}) {
+	$code.="	vpxorq		$r,$r,$r\n";
+    }
+}
+$code.=<<___;
+	mov		\$32,%eax
+
+.align	32
+.Loop_extract_2x20:
+	vpcmpeqq	$IDX0,$CNT,%k2
+	vpcmpeqq	$IDX1,$CNT,%k3
+___
+for my $t (0..4) {
+    $code.="	vpblendmq	".(32*$t)."($tbl),$R[0][$t],$R[0][$t]\{%k2\}\n";
+    $code.="	vpblendmq	".(32*$t+160)."($tbl),$R[1][$t],$R[1][$t]\{%k3\}\n";
+}
+$code.=<<___;
+	vpaddq		$ONE,$CNT,$CNT
+	lea		320($tbl),$tbl
+	dec		%eax
+	jnz		.Loop_extract_2x20
+
+___
+for my $j (0..1) {
+    for my $t (0..4) {
+	$code.="	vmovdqu64	$R[$j][$t],".(32*$t+160*$j)."($out)\n";
+    }
+}
+$code.=<<___;
+	vzeroupper
+	ret
+.cfi_endproc
+.size	rsaz_extract_multiplier_2x20_win5,.-rsaz_extract_multiplier_2x20_win5
+___
+}
+
+foreach (split("\n",$code)) {
+	s/\`([^\`]*)\`/eval($1)/ge;
+	print $_,"\n";
+}
+
+}}} else {{{
+print <<___;	# assembler is too old
+.text
+
+.globl	rsaz_avx512ifma_eligible
+.type	rsaz_avx512ifma_eligible,\@abi-omnipotent
+rsaz_avx512ifma_eligible:
+	xor	%eax,%eax
+	ret
+.size	rsaz_avx512ifma_eligible,.-rsaz_avx512ifma_eligible
+
+.globl	rsaz_amm52x20_x2_256
+.globl	rsaz_extract_multiplier_2x20_win5
+.type	rsaz_amm52x20_x2_256,\@abi-omnipotent
+rsaz_amm52x20_x2_256:
+rsaz_extract_multiplier_2x20_win5:
+	.byte	0x0f,0x0b	# ud2
+	ret
+.size	rsaz_amm52x20_x2_256,.-rsaz_amm52x20_x2_256
+___
+}}}
+
+close STDOUT;
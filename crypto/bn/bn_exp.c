@@ -1126,6 +1126,76 @@ int BN_mod_exp_mont_consttime(BIGNUM *rr, const BIGNUM *a, const BIGNUM *p,
     return ret;
 }
 
+/*
+ * Computes rr1 = a1^p1 mod m1 and rr2 = a2^p2 mod m2 in constant time, as
+ * two calls to BN_mod_exp_mont_consttime() would.  For 1024-bit moduli,
+ * such as the prime factors of an RSA-2048 key, on CPUs with AVX512IFMA
+ * the two exponentiations run together in vector lanes, see
+ * crypto/bn/rsaz_exp_x2.c.
+ */
+int BN_mod_exp_mont_consttime_x2(BIGNUM *rr1, const BIGNUM *a1,
+                                 const BIGNUM *p1, const BIGNUM *m1,
+                                 BN_MONT_CTX *in_mont1,
+                                 BIGNUM *rr2, const BIGNUM *a2,
+                                 const BIGNUM *p2, const BIGNUM *m2,
+                                 BN_MONT_CTX *in_mont2,
+                                 BN_CTX *ctx)
+{
+#ifdef RSAZ_ENABLED
+    if (rsaz_avx512ifma_eligible()
+        && BN_is_odd(m1) && BN_num_bits(m1) == 1024
+        && BN_is_odd(m2) && BN_num_bits(m2) == 1024
+        && !a1->neg && BN_ucmp(a1, m1) < 0
+        && !a2->neg && BN_ucmp(a2, m2) < 0
+        && p1->top <= 16 && p2->top <= 16) {
+        BN_MONT_CTX *mont1 = in_mont1, *mont2 = in_mont2;
+        BN_ULONG words[6][16];
+        int ret = 0;
+
+        if (mont1 == NULL) {
+            if ((mont1 = BN_MONT_CTX_new()) == NULL
+                || !BN_MONT_CTX_set(mont1, m1, ctx))
+                goto err;
+        }
+        if (mont2 == NULL) {
+            if ((mont2 = BN_MONT_CTX_new()) == NULL
+                || !BN_MONT_CTX_set(mont2, m2, ctx))
+                goto err;
+        }
+
+        /* Copy the inputs first, the results may alias them */
+        if (!bn_copy_words(words[0], a1, 16)
+            || !bn_copy_words(words[1], p1, 16)
+            || !bn_copy_words(words[2], a2, 16)
+            || !bn_copy_words(words[3], p2, 16)
+            || !bn_copy_words(words[4], &mont1->RR, 16)
+            || !bn_copy_words(words[5], &mont2->RR, 16)
+            || bn_wexpand(rr1, 16) == NULL
+            || bn_wexpand(rr2, 16) == NULL)
+            goto err;
+
+        ret = RSAZ_mod_exp_avx512_x2(rr1->d, words[0], words[1], m1->d,
+                                     words[4], mont1->n0[0],
+                                     rr2->d, words[2], words[3], m2->d,
+                                     words[5], mont2->n0[0], 1024);
+        rr1->top = rr2->top = 16;
+        rr1->neg = rr2->neg = 0;
+        bn_correct_top(rr1);
+        bn_correct_top(rr2);
+ err:
+        OPENSSL_cleanse(words, sizeof(words));
+        if (in_mont1 == NULL)
+            BN_MONT_CTX_free(mont1);
+        if (in_mont2 == NULL)
+            BN_MONT_CTX_free(mont2);
+        return ret;
+    }
+#endif
+
+    return BN_mod_exp_mont_consttime(rr1, a1, p1, m1, ctx, in_mont1)
+        && BN_mod_exp_mont_consttime(rr2, a2, p2, m2, ctx, in_mont2);
+}
+
 int BN_mod_exp_mont_word(BIGNUM *rr, BN_ULONG a, const BIGNUM *p,
                          const BIGNUM *m, BN_CTX *ctx, BN_MONT_CTX *in_mont)
 {
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <openssl/opensslconf.h>
+#include <openssl/crypto.h>
+#include "rsaz_exp.h"
+
+#ifndef RSAZ_ENABLED
+NON_EMPTY_TRANSLATION_UNIT
+#else
+# include <string.h>
+# include "bn_lcl.h"
+
+/*
+ * See crypto/bn/asm/rsaz-avx512.pl for further details.
+ *
+ * Numbers are held in radix 2^52, 20 digits each, and always in pairs:
+ * digits 0-19 belong to the first exponentiation, 20-39 to the second.
+ * k0 is given once per lane of a 256-bit register.
+ */
+void rsaz_amm52x20_x2_256(BN_ULONG *out, const BN_ULONG *a,
+                          const BN_ULONG *b, const BN_ULONG *m,
+                          const BN_ULONG k0[2][4]);
+void rsaz_extract_multiplier_2x20_win5(BN_ULONG *out, const BN_ULONG *table,
+                                       int idx0, int idx1);
+
+# define DIGIT_SIZE     52
+# define DIGIT_MASK     ((BN_ULONG)0xFFFFFFFFFFFFF)
+# define DIGITS         20
+# define WORDS          16
+# define WINDOW         5
+
+# if defined(__GNUC__)
+#  define ALIGN64        __attribute__((aligned(64)))
+# elif defined(_MSC_VER)
+#  define ALIGN64        __declspec(align(64))
+# elif defined(__SUNPRO_C)
+#  define ALIGN64
+#  pragma align 64(one,two64)
+# else
+/* not fatal, might hurt performance a little */
+#  define ALIGN64
+# endif
+
+ALIGN64 static const BN_ULONG one[2 * DIGITS] = {
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/* 2^64, the factor between 2^(2*1024) and 2^(2*1040) after two AMMs */
+ALIGN64 static const BN_ULONG two64[2 * DIGITS] = {
+    0, 1 << 12, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 1 << 12, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/* Convert a 1024-bit number from 64-bit words to 52-bit digits */
+static void to_words52(BN_ULONG out[DIGITS], const BN_ULONG in[WORDS])
+{
+    int i;
+
+    for (i = 0; i < DIGITS; i++) {
+        int w = DIGIT_SIZE * i / 64, sh = DIGIT_SIZE * i % 64;
+        BN_ULONG d = in[w] >> sh;
+
+        if (sh > 64 - DIGIT_SIZE && w + 1 < WORDS)
+            d |= in[w + 1] << (64 - sh);
+        out[i] = d & DIGIT_MASK;
+    }
+}
+
+/* The reverse, for a number known to be less than 2^1024 */
+static void from_words52(BN_ULONG out[WORDS], const BN_ULONG in[DIGITS])
+{
+    int i;
+
+    memset(out, 0, WORDS * sizeof(*out));
+    for (i = 0; i < DIGITS; i++) {
+        int w = DIGIT_SIZE * i / 64, sh = DIGIT_SIZE * i % 64;
+
+        out[w] |= in[i] << sh;
+        if (sh > 64 - DIGIT_SIZE && w + 1 < WORDS)
+            out[w + 1] |= in[i] >> (64 - sh);
+    }
+}
+
+/* The |WINDOW| bits of |exp| starting at bit |bit|, which is public */
+static int get_window(const BN_ULONG exp[WORDS], int bit)
+{
+    int w = bit / 64, sh = bit % 64;
+    BN_ULONG v = exp[w] >> sh;
+
+    if (sh > 64 - WINDOW && w + 1 < WORDS)
+        v |= exp[w + 1] << (64 - sh);
+    return (int)(v & ((1 << WINDOW) - 1));
+}
+
+/* r = r mod m for r <= m, in constant time */
+static void reduce_once(BN_ULONG r[WORDS], const BN_ULONG m[WORDS])
+{
+    BN_ULONG t[WORDS], mask;
+    int i;
+
+    mask = 0 - bn_sub_words(t, r, m, WORDS);
+    for (i = 0; i < WORDS; i++)
+        r[i] = (r[i] & mask) | (t[i] & ~mask);
+    OPENSSL_cleanse(t, sizeof(t));
+}
+
+/*
+ * Computes res1 = base1^exp1 mod m1 and res2 = base2^exp2 mod m2 at the
+ * same time, in constant time.  The moduli must be odd and exactly
+ * |factor_size| bits long, the bases less than their moduli and the
+ * exponents no longer than |factor_size| bits.  RR1 and RR2 are
+ * 2^(2 * factor_size) mod m1 and m2, and k0_1 and k0_2 are -1/m1 and
+ * -1/m2 mod 2^64, as found in a BN_MONT_CTX.  All numbers are given as
+ * |factor_size| / 64 words.
+ *
+ * Returns 1 on success and 0 if |factor_size| is not supported.
+ */
+int RSAZ_mod_exp_avx512_x2(BN_ULONG *res1, const BN_ULONG *base1,
+                           const BN_ULONG *exp1, const BN_ULONG *m1,
+                           const BN_ULONG *RR1, BN_ULONG k0_1,
+                           BN_ULONG *res2, const BN_ULONG *base2,
+                           const BN_ULONG *exp2, const BN_ULONG *m2,
+                           const BN_ULONG *RR2, BN_ULONG k0_2,
+                           int factor_size)
+{
+    /* 5 numbers, k0 and the table of 32 powers, 11.5KB */
+    unsigned char storage[(6 + (1 << WINDOW)) * 2 * DIGITS * 8 + 64];
+    BN_ULONG *p_str = (BN_ULONG *)(storage + (64 - ((size_t)storage % 64)));
+    BN_ULONG *m = p_str;
+    BN_ULONG *base = m + 2 * DIGITS;
+    BN_ULONG *rr = base + 2 * DIGITS;
+    BN_ULONG *res = rr + 2 * DIGITS;
+    BN_ULONG *tmp = res + 2 * DIGITS;
+    BN_ULONG *k0_str = tmp + 2 * DIGITS;
+    const BN_ULONG (*k0)[4] = (const BN_ULONG (*)[4])k0_str;
+    BN_ULONG *table = tmp + 4 * DIGITS;
+    int i, bit;
+
+    if (factor_size != WORDS * 64)
+        return 0;
+
+    to_words52(m, m1);
+    to_words52(m + DIGITS, m2);
+    to_words52(base, base1);
+    to_words52(base + DIGITS, base2);
+    to_words52(rr, RR1);
+    to_words52(rr + DIGITS, RR2);
+    for (i = 0; i < 4; i++) {
+        k0_str[i] = k0_1 & DIGIT_MASK;
+        k0_str[4 + i] = k0_2 & DIGIT_MASK;
+    }
+
+    /*
+     * With R = 2^1040, turn 2^2048 mod m into R^2 mod m:
+     * 2^2048 * 2^2048 / R = 2^3056, then 2^3056 * 2^64 / R = 2^2080.
+     */
+    rsaz_amm52x20_x2_256(rr, rr, rr, m, k0);
+    rsaz_amm52x20_x2_256(rr, rr, two64, m, k0);
+
+    /* table[i] = base^i * R mod m */
+    rsaz_amm52x20_x2_256(table, rr, one, m, k0);
+    rsaz_amm52x20_x2_256(table + 2 * DIGITS, base, rr, m, k0);
+    for (i = 2; i < 1 << WINDOW; i++)
+        rsaz_amm52x20_x2_256(table + i * 2 * DIGITS,
+                             table + (i - 1) * 2 * DIGITS,
+                             table + 2 * DIGITS, m, k0);
+
+    /* Fixed window exponentiation, starting with the partial top window */
+    bit = factor_size - factor_size % WINDOW;
+    rsaz_extract_multiplier_2x20_win5(res, table, get_window(exp1, bit),
+                                      get_window(exp2, bit));
+    for (bit -= WINDOW; bit >= 0; bit -= WINDOW) {
+        for (i = 0; i < WINDOW; i++)
+            rsaz_amm52x20_x2_256(res, res, res, m, k0);
+        rsaz_extract_multiplier_2x20_win5(tmp, table, get_window(exp1, bit),
+                                          get_window(exp2, bit));
+        rsaz_amm52x20_x2_256(res, res, tmp, m, k0);
+    }
+
+    /* Leave the Montgomery domain, which leaves res no greater than m */
+    rsaz_amm52x20_x2_256(res, res, one, m, k0);
+
+    from_words52(res1, res);
+    from_words52(res2, res + DIGITS);
+    reduce_once(res1, m1);
+    reduce_once(res2, m2);
+
+    OPENSSL_cleanse(storage, sizeof(storage));
+    return 1;
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include "internal/cryptlib_int.h"
 #include "internal/thread_once.h"
 #include "internal/property.h"
+#include "internal/tsan_assist.h"
 
 struct openssl_ctx_onfree_list_st {
     openssl_ctx_onfree_fn *fn;
@@ -36,6 +37,16 @@ struct openssl_ctx_st {
     int run_once_done[OPENSSL_CTX_MAX_RUN_ONCE];
     int run_once_ret[OPENSSL_CTX_MAX_RUN_ONCE];
     struct openssl_ctx_onfree_list_st *onfreelist;
+
+    /* Changes whenever previously fetched methods may have gone stale */
+    TSAN_QUALIFIER int method_generation;
+
+    /*
+     * Each thread's cache of fetched methods.  This is kept here rather than
+     * in the ex_data, so that it can be reached without taking any lock.
+     */
+    CRYPTO_THREAD_LOCAL fetch_cache;
+    int fetch_cache_done;
 };
 
 #ifndef FIPS_MODE
@@ -58,6 +69,10 @@ static int context_init(OPENSSL_CTX *ctx)
     if (ctx->oncelock == NULL)
         goto err;
 
+    if (!CRYPTO_THREAD_init_local(&ctx->fetch_cache, NULL))
+        goto err;
+    ctx->fetch_cache_done = 1;
+
     for (i = 0; i < OPENSSL_CTX_MAX_INDEXES; i++) {
         ctx->index_locks[i] = CRYPTO_THREAD_lock_new();
         ctx->dyn_indexes[i] = -1;
@@ -84,6 +99,8 @@ static int context_init(OPENSSL_CTX *ctx)
  err:
     if (exdata_done)
         crypto_cleanup_all_ex_data_int(ctx);
+    if (ctx->fetch_cache_done)
+        CRYPTO_THREAD_cleanup_local(&ctx->fetch_cache);
     CRYPTO_THREAD_lock_free(ctx->oncelock);
     CRYPTO_THREAD_lock_free(ctx->lock);
     ctx->lock = NULL;
@@ -112,6 +129,8 @@ static int context_deinit(OPENSSL_CTX *ctx)
     for (i = 0; i < OPENSSL_CTX_MAX_INDEXES; i++)
         CRYPTO_THREAD_lock_free(ctx->index_locks[i]);
 
+    if (ctx->fetch_cache_done)
+        CRYPTO_THREAD_cleanup_local(&ctx->fetch_cache);
     CRYPTO_THREAD_lock_free(ctx->oncelock);
     CRYPTO_THREAD_lock_free(ctx->lock);
     ctx->lock = NULL;
@@ -295,6 +314,45 @@ int openssl_ctx_run_once(OPENSSL_CTX *ctx, unsigned int idx,
     return ret;
 }
 
+int openssl_ctx_get_method_generation(OPENSSL_CTX *ctx)
+{
+    ctx = openssl_ctx_get_concrete(ctx);
+    if (ctx == NULL)
+        return 0;
+    return tsan_load(&ctx->method_generation);
+}
+
+/*
+ * Called when providers come and go, or when the method store changes in a
+ * way that means a repeated fetch could return a different method.  Anyone
+ * holding on to fetched methods on the library's behalf should drop them.
+ */
+void openssl_ctx_new_method_generation(OPENSSL_CTX *ctx)
+{
+    ctx = openssl_ctx_get_concrete(ctx);
+    if (ctx == NULL)
+        return;
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    tsan_counter(&ctx->method_generation);
+    CRYPTO_THREAD_unlock(ctx->lock);
+}
+
+void *openssl_ctx_get_fetch_cache(OPENSSL_CTX *ctx)
+{
+    ctx = openssl_ctx_get_concrete(ctx);
+    if (ctx == NULL)
+        return NULL;
+    return CRYPTO_THREAD_get_local(&ctx->fetch_cache);
+}
+
+int openssl_ctx_set_fetch_cache(OPENSSL_CTX *ctx, void *cache)
+{
+    ctx = openssl_ctx_get_concrete(ctx);
+    if (ctx == NULL)
+        return 0;
+    return CRYPTO_THREAD_set_local(&ctx->fetch_cache, cache);
+}
+
 int openssl_ctx_onfree(OPENSSL_CTX *ctx, openssl_ctx_onfree_fn onfreefn)
 {
     struct openssl_ctx_onfree_list_st *newonfree
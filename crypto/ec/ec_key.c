@@ -12,6 +12,7 @@
 #include <string.h>
 #include "ec_lcl.h"
 #include "internal/refcount.h"
+#include "internal/tsan_assist.h"
 #include <openssl/err.h>
 #include <openssl/engine.h>
 
@@ -78,6 +79,7 @@ void EC_KEY_free(EC_KEY *r)
 #ifndef FIPS_MODE
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_EC_KEY, r, &r->ex_data);
 #endif
+    ec_key_pub_pre_comp_free(r);
     CRYPTO_THREAD_lock_free(r->lock);
     EC_GROUP_free(r->group);
     EC_POINT_free(r->pub_key);
@@ -107,6 +109,8 @@ EC_KEY *EC_KEY_copy(EC_KEY *dest, const EC_KEY *src)
     /* copy the parameters */
     if (src->group != NULL) {
         const EC_METHOD *meth = EC_GROUP_method_of(src->group);
+        /* the table for the old public key is of no use any more */
+        ec_key_pub_pre_comp_free(dest);
         /* clear the old group */
         EC_GROUP_free(dest->group);
         dest->group = EC_GROUP_new_ex(src->libctx, meth);
@@ -145,6 +149,7 @@ EC_KEY *EC_KEY_copy(EC_KEY *dest, const EC_KEY *src)
     dest->conv_form = src->conv_form;
     dest->version = src->version;
     dest->flags = src->flags;
+    dest->pub_pre_comp_threshold = src->pub_pre_comp_threshold;
 #ifndef FIPS_MODE
     if (!CRYPTO_dup_ex_data(CRYPTO_EX_INDEX_EC_KEY,
                             &dest->ex_data, &src->ex_data))
@@ -203,6 +208,7 @@ int EC_KEY_generate_key(EC_KEY *eckey)
         ECerr(EC_F_EC_KEY_GENERATE_KEY, ERR_R_PASSED_NULL_PARAMETER);
         return 0;
     }
+    ec_key_pub_pre_comp_free(eckey);
     if (eckey->meth->keygen != NULL)
         return eckey->meth->keygen(eckey);
     ECerr(EC_F_EC_KEY_GENERATE_KEY, EC_R_OPERATION_NOT_SUPPORTED);
@@ -524,6 +530,7 @@ int EC_KEY_set_group(EC_KEY *key, const EC_GROUP *group)
 {
     if (key->meth->set_group != NULL && key->meth->set_group(key, group) == 0)
         return 0;
+    ec_key_pub_pre_comp_free(key);
     EC_GROUP_free(key->group);
     key->group = EC_GROUP_dup(group);
     return (key->group == NULL) ? 0 : 1;
@@ -559,6 +566,7 @@ int EC_KEY_set_public_key(EC_KEY *key, const EC_POINT *pub_key)
     if (key->meth->set_public != NULL
         && key->meth->set_public(key, pub_key) == 0)
         return 0;
+    ec_key_pub_pre_comp_free(key);
     EC_POINT_free(key->pub_key);
     key->pub_key = EC_POINT_dup(pub_key, key->group);
     return (key->pub_key == NULL) ? 0 : 1;
@@ -599,6 +607,111 @@ int EC_KEY_precompute_mult(EC_KEY *key, BN_CTX *ctx)
     return EC_GROUP_precompute_mult(key->group, ctx);
 }
 
+int EC_KEY_set_precompute_pub(EC_KEY *key, int uses)
+{
+    if (uses < 0) {
+        ECerr(EC_F_EC_KEY_SET_PRECOMPUTE_PUB, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    key->pub_pre_comp_threshold = uses;
+    if (uses == 0)
+        ec_key_pub_pre_comp_free(key);
+    return 1;
+}
+
+int EC_KEY_get_precompute_pub(const EC_KEY *key)
+{
+    return key->pub_pre_comp_threshold;
+}
+
+/*
+ * Throw away the table for the public key and start counting again.  The
+ * caller must make sure that no other thread is using |eckey|.
+ */
+void ec_key_pub_pre_comp_free(EC_KEY *eckey)
+{
+    if (eckey->pub_pre_comp != NULL)
+        eckey->group->meth->point_pre_comp_free(eckey->pub_pre_comp);
+    eckey->pub_pre_comp = NULL;
+    eckey->pub_pre_comp_uses = 0;
+}
+
+/*
+ * Return the table for the public key, building it if this is the use that
+ * reaches the threshold.  Only the thread that reaches it builds the table,
+ * all others carry on without one until it has been published.  Uses stop
+ * being counted once the threshold is reached, unless the build fails.
+ */
+static const void *ec_key_pub_pre_comp(EC_KEY *eckey, BN_CTX *ctx)
+{
+    void *pre_comp;
+    int uses;
+
+#ifdef tsan_ld_acq
+    pre_comp = tsan_ld_acq((void *TSAN_QUALIFIER *)&eckey->pub_pre_comp);
+#else
+    CRYPTO_THREAD_read_lock(eckey->lock);
+    pre_comp = eckey->pub_pre_comp;
+    CRYPTO_THREAD_unlock(eckey->lock);
+#endif
+    if (pre_comp != NULL)
+        return pre_comp;
+
+    if (!CRYPTO_atomic_add(&eckey->pub_pre_comp_uses, 1, &uses, eckey->lock))
+        return NULL;
+    if (uses != eckey->pub_pre_comp_threshold) {
+        /* Don't count past the threshold while the table is being built */
+        if (uses > eckey->pub_pre_comp_threshold)
+            CRYPTO_atomic_add(&eckey->pub_pre_comp_uses, -1, &uses,
+                              eckey->lock);
+        return NULL;
+    }
+
+    /* Failing to build the table is not an error, it is just not used */
+#ifndef FIPS_MODE
+    ERR_set_mark();
+#endif
+    pre_comp = eckey->group->meth->precompute_point(eckey->group,
+                                                    eckey->pub_key, ctx);
+#ifndef FIPS_MODE
+    ERR_pop_to_mark();
+#endif
+    if (pre_comp == NULL) {
+        /* Start counting again, so that the build is retried later */
+        CRYPTO_atomic_add(&eckey->pub_pre_comp_uses,
+                          -eckey->pub_pre_comp_threshold, &uses, eckey->lock);
+        return NULL;
+    }
+
+#ifdef tsan_st_rel
+    tsan_st_rel((void *TSAN_QUALIFIER *)&eckey->pub_pre_comp, pre_comp);
+#else
+    CRYPTO_THREAD_write_lock(eckey->lock);
+    eckey->pub_pre_comp = pre_comp;
+    CRYPTO_THREAD_unlock(eckey->lock);
+#endif
+    return pre_comp;
+}
+
+/*
+ * r = g_scalar * generator + p_scalar * pub_key, using the table for the
+ * public key when there is one.
+ */
+int ec_key_pub_mul(EC_KEY *eckey, EC_POINT *r, const BIGNUM *g_scalar,
+                   const BIGNUM *p_scalar, BN_CTX *ctx)
+{
+    const EC_GROUP *group = eckey->group;
+    const void *pre_comp;
+
+    if (eckey->pub_pre_comp_threshold > 0
+        && group->meth->mul_point_pre_comp != NULL
+        && p_scalar != NULL
+        && (pre_comp = ec_key_pub_pre_comp(eckey, ctx)) != NULL)
+        return group->meth->mul_point_pre_comp(group, r, g_scalar, pre_comp,
+                                               p_scalar, ctx);
+    return EC_POINT_mul(group, r, g_scalar, eckey->pub_key, p_scalar, ctx);
+}
+
 int EC_KEY_get_flags(const EC_KEY *key)
 {
     return key->flags;
@@ -627,6 +740,7 @@ int EC_KEY_oct2key(EC_KEY *key, const unsigned char *buf, size_t len,
 {
     if (key == NULL || key->group == NULL)
         return 0;
+    ec_key_pub_pre_comp_free(key);
     if (key->pub_key == NULL)
         key->pub_key = EC_POINT_new(key->group);
     if (key->pub_key == NULL)
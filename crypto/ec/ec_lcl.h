@@ -200,6 +200,14 @@ struct ec_method_st {
     int (*ladder_post)(const EC_GROUP *group,
                        EC_POINT *r, EC_POINT *s,
                        EC_POINT *p, BN_CTX *ctx);
+    /* fixed-base precomputation for points other than the generator */
+    void *(*precompute_point)(const EC_GROUP *group, const EC_POINT *point,
+                              BN_CTX *ctx);
+    void (*point_pre_comp_free)(void *pre_comp);
+    /* r = g_scalar * generator + p_scalar * (point of pre_comp) */
+    int (*mul_point_pre_comp)(const EC_GROUP *group, EC_POINT *r,
+                              const BIGNUM *g_scalar, const void *pre_comp,
+                              const BIGNUM *p_scalar, BN_CTX *ctx);
 };
 
 /*
@@ -301,6 +309,13 @@ struct ec_key_st {
 #endif
     CRYPTO_RWLOCK *lock;
     OPENSSL_CTX *libctx;
+    /*
+     * Precomputed multiples of pub_key, built by the group method once the
+     * key has been used pub_pre_comp_threshold times for verification.
+     */
+    int pub_pre_comp_threshold;
+    int pub_pre_comp_uses;
+    void *pub_pre_comp;
 };
 
 struct ec_point_st {
@@ -609,6 +624,9 @@ int ec_key_simple_oct2priv(EC_KEY *eckey, const unsigned char *buf, size_t len);
 int ec_key_simple_generate_key(EC_KEY *eckey);
 int ec_key_simple_generate_public_key(EC_KEY *eckey);
 int ec_key_simple_check_key(const EC_KEY *eckey);
+void ec_key_pub_pre_comp_free(EC_KEY *eckey);
+int ec_key_pub_mul(EC_KEY *eckey, EC_POINT *r, const BIGNUM *g_scalar,
+                   const BIGNUM *p_scalar, BN_CTX *ctx);
 
 int ec_curve_nid_from_params(const EC_GROUP *group, BN_CTX *ctx);
 
@@ -675,6 +693,12 @@ ECDSA_SIG *ecdsa_simple_sign_sig(const unsigned char *dgst, int dgst_len,
                                  EC_KEY *eckey);
 int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
                             const ECDSA_SIG *sig, EC_KEY *eckey);
+int ecdsa_simple_verify_batch(const EC_GROUP *group, const size_t idx[],
+                              size_t num, const unsigned char *const dgst[],
+                              const size_t dgst_len[],
+                              const unsigned char *const sig[],
+                              const size_t sig_len[], EC_KEY *const eckey[],
+                              int results[]);
 
 int ED25519_sign(uint8_t *out_sig, const uint8_t *message, size_t message_len,
                  const uint8_t public_key[32], const uint8_t private_key[32]);
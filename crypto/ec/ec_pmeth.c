@@ -148,6 +148,34 @@ static int pkey_ec_verify(EVP_PKEY_CTX *ctx,
     return ret;
 }
 
+static int pkey_ec_verify_batch(EVP_PKEY_CTX *const ctx[], size_t num,
+                                const unsigned char *const sig[],
+                                const size_t siglen[],
+                                const unsigned char *const tbs[],
+                                const size_t tbslen[], int results[])
+{
+    EC_KEY **keys;
+    size_t i;
+    int ret;
+
+    if ((keys = OPENSSL_malloc(num * sizeof(*keys))) == NULL) {
+        /* Every result must be set, so verify one at a time instead */
+        ret = 1;
+        for (i = 0; i < num; i++)
+            if ((results[i] = pkey_ec_verify(ctx[i], sig[i], siglen[i], tbs[i],
+                                             tbslen[i])) != 1)
+                ret = 0;
+        return ret;
+    }
+    for (i = 0; i < num; i++)
+        keys[i] = ctx[i]->pkey->pkey.ec;
+
+    ret = ECDSA_verify_batch(num, tbs, tbslen, sig, siglen, keys, results);
+
+    OPENSSL_free(keys);
+    return ret;
+}
+
 #ifndef OPENSSL_NO_EC
 static int pkey_ec_derive(EVP_PKEY_CTX *ctx, unsigned char *key, size_t *keylen)
 {
@@ -473,5 +501,13 @@ const EVP_PKEY_METHOD ec_pkey_meth = {
     0,
 #endif
     pkey_ec_ctrl,
-    pkey_ec_ctrl_str
+    pkey_ec_ctrl_str,
+
+    0, 0,
+
+    0, 0, 0,
+
+    0,
+
+    pkey_ec_verify_batch
 };
@@ -8,6 +8,7 @@
  */
 
 #include <string.h>
+#include <limits.h>
 #include <openssl/err.h>
 #include <openssl/obj_mac.h>
 #include <openssl/rand.h>
@@ -324,35 +325,66 @@ ECDSA_SIG *ecdsa_simple_sign_sig(const unsigned char *dgst, int dgst_len,
  *      0: incorrect signature
  *     -1: error
  */
-int ossl_ecdsa_verify(int type, const unsigned char *dgst, int dgst_len,
-                      const unsigned char *sigbuf, int sig_len, EC_KEY *eckey)
+static ECDSA_SIG *ecdsa_sig_decode(const unsigned char *sigbuf, int sig_len)
 {
     ECDSA_SIG *s;
     const unsigned char *p = sigbuf;
     unsigned char *der = NULL;
     int derlen = -1;
-    int ret = -1;
 
     s = ECDSA_SIG_new();
     if (s == NULL)
-        return ret;
+        return NULL;
     if (d2i_ECDSA_SIG(&s, &p, sig_len) == NULL)
         goto err;
     /* Ensure signature uses DER and doesn't have trailing garbage */
     derlen = i2d_ECDSA_SIG(s, &der);
     if (derlen != sig_len || memcmp(sigbuf, der, derlen) != 0)
         goto err;
-    ret = ECDSA_do_verify(dgst, dgst_len, s, eckey);
+    OPENSSL_clear_free(der, derlen);
+    return s;
  err:
     OPENSSL_clear_free(der, derlen);
     ECDSA_SIG_free(s);
+    return NULL;
+}
+
+int ossl_ecdsa_verify(int type, const unsigned char *dgst, int dgst_len,
+                      const unsigned char *sigbuf, int sig_len, EC_KEY *eckey)
+{
+    ECDSA_SIG *s;
+    int ret;
+
+    if ((s = ecdsa_sig_decode(sigbuf, sig_len)) == NULL)
+        return -1;
+    ret = ECDSA_do_verify(dgst, dgst_len, s, eckey);
+    ECDSA_SIG_free(s);
     return ret;
 }
 
+/* Convert a digest to an integer as many bits long as |order| at most */
+static int ecdsa_digest_to_bn(BIGNUM *m, const unsigned char *dgst,
+                              int dgst_len, const BIGNUM *order)
+{
+    int i = BN_num_bits(order);
+
+    /*
+     * Need to truncate digest if it is too long: first truncate whole bytes.
+     */
+    if (8 * dgst_len > i)
+        dgst_len = (i + 7) / 8;
+    if (!BN_bin2bn(dgst, dgst_len, m))
+        return 0;
+    /* If still too long truncate remaining bits with a shift */
+    if ((8 * dgst_len > i) && !BN_rshift(m, m, 8 - (i & 0x7)))
+        return 0;
+    return 1;
+}
+
 int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
                             const ECDSA_SIG *sig, EC_KEY *eckey)
 {
-    int ret = -1, i;
+    int ret = -1;
     BN_CTX *ctx;
     const BIGNUM *order;
     BIGNUM *u1, *u2, *m, *X;
@@ -406,18 +438,7 @@ int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
         goto err;
     }
     /* digest -> m */
-    i = BN_num_bits(order);
-    /*
-     * Need to truncate digest if it is too long: first truncate whole bytes.
-     */
-    if (8 * dgst_len > i)
-        dgst_len = (i + 7) / 8;
-    if (!BN_bin2bn(dgst, dgst_len, m)) {
-        ECerr(EC_F_ECDSA_SIMPLE_VERIFY_SIG, ERR_R_BN_LIB);
-        goto err;
-    }
-    /* If still too long truncate remaining bits with a shift */
-    if ((8 * dgst_len > i) && !BN_rshift(m, m, 8 - (i & 0x7))) {
+    if (!ecdsa_digest_to_bn(m, dgst, dgst_len, order)) {
         ECerr(EC_F_ECDSA_SIMPLE_VERIFY_SIG, ERR_R_BN_LIB);
         goto err;
     }
@@ -436,7 +457,7 @@ int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
         ECerr(EC_F_ECDSA_SIMPLE_VERIFY_SIG, ERR_R_MALLOC_FAILURE);
         goto err;
     }
-    if (!EC_POINT_mul(group, point, u1, pub_key, u2, ctx)) {
+    if (!ec_key_pub_mul(eckey, point, u1, u2, ctx)) {
         ECerr(EC_F_ECDSA_SIMPLE_VERIFY_SIG, ERR_R_EC_LIB);
         goto err;
     }
@@ -458,3 +479,162 @@ int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
     EC_POINT_free(point);
     return ret;
 }
+
+/*
+ * Verify the |num| signatures given by |idx|, all made with keys on |group|.
+ * The inverses of all s values are found with a single inversion modulo the
+ * order, and all points u1 * G + u2 * pub_key are made affine with a single
+ * field inversion, using Montgomery's trick for both.  results[idx[i]] is set
+ * to what ossl_ecdsa_verify() would have returned for each signature.  If the
+ * batch fails part way, the signatures without a result yet are verified one
+ * at a time.  Returns 1 if the whole batch went through, 0 otherwise.
+ */
+int ecdsa_simple_verify_batch(const EC_GROUP *group, const size_t idx[],
+                              size_t num, const unsigned char *const dgst[],
+                              const size_t dgst_len[],
+                              const unsigned char *const sig[],
+                              const size_t sig_len[], EC_KEY *const eckey[],
+                              int results[])
+{
+    BN_CTX *ctx;
+    const BIGNUM *order;
+    BIGNUM *inv, *m, *u1, *u2, *X;
+    /* The signatures that are well formed, and where they came from */
+    ECDSA_SIG **sigs = NULL;
+    size_t *from = NULL;
+    BIGNUM **w = NULL;
+    EC_POINT **points = NULL;
+    size_t i, n = 0;
+    int ok = 0;
+
+    for (i = 0; i < num; i++)
+        results[idx[i]] = -1;
+
+    if ((ctx = BN_CTX_new_ex(group->libctx)) == NULL) {
+        ECerr(EC_F_ECDSA_SIMPLE_VERIFY_BATCH, ERR_R_MALLOC_FAILURE);
+        goto fallback;
+    }
+    BN_CTX_start(ctx);
+    inv = BN_CTX_get(ctx);
+    m = BN_CTX_get(ctx);
+    u1 = BN_CTX_get(ctx);
+    u2 = BN_CTX_get(ctx);
+    X = BN_CTX_get(ctx);
+    sigs = OPENSSL_zalloc(num * sizeof(*sigs));
+    from = OPENSSL_malloc(num * sizeof(*from));
+    w = OPENSSL_zalloc(num * sizeof(*w));
+    points = OPENSSL_zalloc(num * sizeof(*points));
+    if (X == NULL || sigs == NULL || from == NULL || w == NULL
+        || points == NULL) {
+        ECerr(EC_F_ECDSA_SIMPLE_VERIFY_BATCH, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    if ((order = EC_GROUP_get0_order(group)) == NULL) {
+        ECerr(EC_F_ECDSA_SIMPLE_VERIFY_BATCH, ERR_R_EC_LIB);
+        goto err;
+    }
+
+    /*
+     * Decode the signatures and set w[i] to the product of the s values of
+     * the first i + 1 well formed ones.
+     */
+    for (i = 0; i < num; i++) {
+        size_t k = idx[i];
+        ECDSA_SIG *s;
+
+        if (sig_len[k] > INT_MAX || dgst_len[k] > INT_MAX
+            || EC_KEY_get0_public_key(eckey[k]) == NULL
+            || !EC_KEY_can_sign(eckey[k])
+            || (s = ecdsa_sig_decode(sig[k], (int)sig_len[k])) == NULL)
+            continue;
+        if (BN_is_zero(s->r) || BN_is_negative(s->r)
+            || BN_ucmp(s->r, order) >= 0 || BN_is_zero(s->s)
+            || BN_is_negative(s->s) || BN_ucmp(s->s, order) >= 0) {
+            results[k] = 0;
+            ECDSA_SIG_free(s);
+            continue;
+        }
+        sigs[n] = s;
+        from[n] = k;
+        w[n] = BN_new();
+        n++;
+        if (w[n - 1] == NULL
+            || (n > 1 ? !BN_mod_mul(w[n - 1], w[n - 2], s->s, order, ctx)
+                      : !BN_copy(w[n - 1], s->s)))
+            goto err;
+    }
+    if (n == 0) {
+        ok = 1;
+        goto err;
+    }
+
+    /* Unwind the products from the back, leaving w[i] = 1 / s */
+    if (!ec_group_do_inverse_ord(group, inv, w[n - 1], ctx))
+        goto err;
+    for (i = n; --i > 0; ) {
+        if (!BN_mod_mul(w[i], inv, w[i - 1], order, ctx)
+            || !BN_mod_mul(inv, inv, sigs[i]->s, order, ctx))
+            goto err;
+    }
+    if (!BN_copy(w[0], inv))
+        goto err;
+
+    for (i = 0; i < n; i++) {
+        /* u1 = m * w mod order, u2 = r * w mod order */
+        if (!ecdsa_digest_to_bn(m, dgst[from[i]], (int)dgst_len[from[i]],
+                                order)
+            || !BN_mod_mul(u1, m, w[i], order, ctx)
+            || !BN_mod_mul(u2, sigs[i]->r, w[i], order, ctx)
+            || (points[i] = EC_POINT_new(group)) == NULL
+            || !ec_key_pub_mul(eckey[from[i]], points[i], u1, u2, ctx)) {
+            ECerr(EC_F_ECDSA_SIMPLE_VERIFY_BATCH, ERR_R_EC_LIB);
+            goto err;
+        }
+    }
+
+    if (!EC_POINTs_make_affine(group, n, points, ctx)) {
+        ECerr(EC_F_ECDSA_SIMPLE_VERIFY_BATCH, ERR_R_EC_LIB);
+        goto err;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (EC_POINT_is_at_infinity(group, points[i])) {
+            results[from[i]] = 0;
+            continue;
+        }
+        if (!EC_POINT_get_affine_coordinates(group, points[i], X, NULL, ctx)
+            || !BN_nnmod(u1, X, order, ctx)) {
+            ECerr(EC_F_ECDSA_SIMPLE_VERIFY_BATCH, ERR_R_EC_LIB);
+            goto err;
+        }
+        /*  if the signature is correct u1 is equal to sig->r */
+        results[from[i]] = (BN_ucmp(u1, sigs[i]->r) == 0);
+    }
+    ok = 1;
+
+ err:
+    for (i = 0; i < n; i++) {
+        ECDSA_SIG_free(sigs[i]);
+        BN_free(w[i]);
+        EC_POINT_free(points[i]);
+    }
+    OPENSSL_free(sigs);
+    OPENSSL_free(from);
+    OPENSSL_free(w);
+    OPENSSL_free(points);
+    BN_CTX_end(ctx);
+    BN_CTX_free(ctx);
+    if (ok)
+        return 1;
+
+ fallback:
+    for (i = 0; i < num; i++) {
+        size_t k = idx[i];
+
+        if (results[k] == -1 && sig_len[k] <= INT_MAX
+                && dgst_len[k] <= INT_MAX)
+            results[k] = ECDSA_verify(0, dgst[k], (int)dgst_len[k], sig[k],
+                                      (int)sig_len[k], eckey[k]);
+    }
+    return 0;
+}
@@ -41,3 +41,70 @@ int ECDSA_verify(int type, const unsigned char *dgst, int dgst_len,
     ECerr(EC_F_ECDSA_VERIFY, EC_R_OPERATION_NOT_SUPPORTED);
     return 0;
 }
+
+static int ecdsa_can_batch(const EC_KEY *eckey)
+{
+    return eckey->meth->verify == ossl_ecdsa_verify
+        && eckey->meth->verify_sig == ossl_ecdsa_verify_sig
+        && eckey->group != NULL
+        && eckey->group->meth->ecdsa_verify_sig == ecdsa_simple_verify_sig;
+}
+
+/* Points on |a| can be used with |b| */
+static int ecdsa_batch_group_match(const EC_GROUP *a, const EC_GROUP *b)
+{
+    return a == b
+        || (a->meth == b->meth && a->curve_name != NID_undef
+            && a->curve_name == b->curve_name);
+}
+
+/*-
+ * Sets results[i] for each signature as ECDSA_verify() would return it, and
+ * returns 1 if all signatures are correct, 0 otherwise
+ */
+int ECDSA_verify_batch(size_t num, const unsigned char *const dgst[],
+                       const size_t dgst_len[],
+                       const unsigned char *const sig[],
+                       const size_t sig_len[], EC_KEY *const eckey[],
+                       int results[])
+{
+    unsigned char *done = NULL;
+    size_t *idx = NULL;
+    size_t i, j, n;
+    int ret = 1;
+
+    if (num > 1) {
+        done = OPENSSL_zalloc(num);
+        idx = OPENSSL_malloc(num * sizeof(*idx));
+    }
+
+    for (i = 0; i < num; i++) {
+        const EC_GROUP *group = eckey[i]->group;
+
+        if (done != NULL && done[i])
+            continue;
+        if (done == NULL || idx == NULL || !ecdsa_can_batch(eckey[i])) {
+            results[i] = ECDSA_verify(0, dgst[i], (int)dgst_len[i], sig[i],
+                                      (int)sig_len[i], eckey[i]);
+            continue;
+        }
+
+        /* Verify this and all later signatures on the same curve together */
+        for (j = i, n = 0; j < num; j++) {
+            if (!done[j] && ecdsa_can_batch(eckey[j])
+                && ecdsa_batch_group_match(group, eckey[j]->group)) {
+                idx[n++] = j;
+                done[j] = 1;
+            }
+        }
+        ecdsa_simple_verify_batch(group, idx, n, dgst, dgst_len, sig, sig_len,
+                                  eckey, results);
+    }
+
+    for (i = 0; i < num; i++)
+        if (results[i] != 1)
+            ret = 0;
+    OPENSSL_free(done);
+    OPENSSL_free(idx);
+    return ret;
+}
@@ -1113,6 +1113,176 @@ __owur static int ecp_nistz256_set_from_affine(EC_POINT *out, const EC_GROUP *gr
     return ret;
 }
 
+/*
+ * Look for a table of precomputed multiples of |generator|: either one built
+ * by EC_GROUP_precompute_mult() or, for the default generator, the static
+ * one. |*table| is set to NULL if there is neither.
+ */
+__owur static int ecp_nistz256_generator_table(const EC_GROUP *group,
+                                               const EC_POINT *generator,
+                                               const PRECOMP256_ROW **table,
+                                               BN_CTX *ctx)
+{
+    const NISTZ256_PRE_COMP *pre_comp = group->pre_comp.nistz256;
+    P256_POINT_AFFINE p;
+
+    *table = NULL;
+    if (pre_comp) {
+        /*
+         * If there is a precomputed table for the generator, check that
+         * it was generated with the same generator.
+         */
+        EC_POINT *pre_comp_generator = EC_POINT_new(group);
+        if (pre_comp_generator == NULL)
+            return 0;
+
+        ecp_nistz256_gather_w7(&p, pre_comp->precomp[0], 1);
+        if (!ecp_nistz256_set_from_affine(pre_comp_generator,
+                                          group, &p, ctx)) {
+            EC_POINT_free(pre_comp_generator);
+            return 0;
+        }
+
+        if (0 == EC_POINT_cmp(group, generator, pre_comp_generator, ctx))
+            *table = (const PRECOMP256_ROW *)pre_comp->precomp;
+
+        EC_POINT_free(pre_comp_generator);
+    }
+
+    if (*table == NULL && ecp_nistz256_is_affine_G(generator)) {
+        /*
+         * If there is no precomputed data, but the generator is the
+         * default, a hardcoded table of precomputed data is used. This
+         * is because applications, such as Apache, do not use
+         * EC_KEY_precompute_mult.
+         */
+        *table = ecp_nistz256_precomputed;
+    }
+    return 1;
+}
+
+/* r = scalar*P, where |preComputedTable| holds the multiples of P */
+__owur static int ecp_nistz256_table_mul(const EC_GROUP *group,
+                                         P256_POINT *r,
+                                         const PRECOMP256_ROW *preComputedTable,
+                                         const BIGNUM *scalar, BN_CTX *ctx)
+{
+    int i, ret = 0;
+    unsigned char p_str[33] = { 0 };
+    unsigned int idx = 0;
+    const unsigned int window_size = 7;
+    const unsigned int mask = (1 << (window_size + 1)) - 1;
+    unsigned int wvalue;
+    ALIGN32 union {
+        P256_POINT p;
+        P256_POINT_AFFINE a;
+    } t, p;
+    BIGNUM *tmp_scalar;
+
+    BN_CTX_start(ctx);
+
+    if ((BN_num_bits(scalar) > 256)
+        || BN_is_negative(scalar)) {
+        if ((tmp_scalar = BN_CTX_get(ctx)) == NULL)
+            goto err;
+
+        if (!BN_nnmod(tmp_scalar, scalar, group->order, ctx)) {
+            ECerr(EC_F_ECP_NISTZ256_TABLE_MUL, ERR_R_BN_LIB);
+            goto err;
+        }
+        scalar = tmp_scalar;
+    }
+
+    for (i = 0; i < bn_get_top(scalar) * BN_BYTES; i += BN_BYTES) {
+        BN_ULONG d = bn_get_words(scalar)[i / BN_BYTES];
+
+        p_str[i + 0] = (unsigned char)d;
+        p_str[i + 1] = (unsigned char)(d >> 8);
+        p_str[i + 2] = (unsigned char)(d >> 16);
+        p_str[i + 3] = (unsigned char)(d >>= 24);
+        if (BN_BYTES == 8) {
+            d >>= 8;
+            p_str[i + 4] = (unsigned char)d;
+            p_str[i + 5] = (unsigned char)(d >> 8);
+            p_str[i + 6] = (unsigned char)(d >> 16);
+            p_str[i + 7] = (unsigned char)(d >> 24);
+        }
+    }
+
+    for (; i < 33; i++)
+        p_str[i] = 0;
+
+#if defined(ECP_NISTZ256_AVX2)
+    if (ecp_nistz_avx2_eligible()) {
+        ecp_nistz256_avx2_mul_g(&p.p, p_str, preComputedTable);
+    } else
+#endif
+    {
+        BN_ULONG infty;
+
+        /* First window */
+        wvalue = (p_str[0] << 1) & mask;
+        idx += window_size;
+
+        wvalue = _booth_recode_w7(wvalue);
+
+        ecp_nistz256_gather_w7(&p.a, preComputedTable[0],
+                               wvalue >> 1);
+
+        ecp_nistz256_neg(p.p.Z, p.p.Y);
+        copy_conditional(p.p.Y, p.p.Z, wvalue & 1);
+
+        /*
+         * Since affine infinity is encoded as (0,0) and
+         * Jacobian ias (,,0), we need to harmonize them
+         * by assigning "one" or zero to Z.
+         */
+        infty = (p.p.X[0] | p.p.X[1] | p.p.X[2] | p.p.X[3] |
+                 p.p.Y[0] | p.p.Y[1] | p.p.Y[2] | p.p.Y[3]);
+        if (P256_LIMBS == 8)
+            infty |= (p.p.X[4] | p.p.X[5] | p.p.X[6] | p.p.X[7] |
+                      p.p.Y[4] | p.p.Y[5] | p.p.Y[6] | p.p.Y[7]);
+
+        infty = 0 - is_zero(infty);
+        infty = ~infty;
+
+        p.p.Z[0] = ONE[0] & infty;
+        p.p.Z[1] = ONE[1] & infty;
+        p.p.Z[2] = ONE[2] & infty;
+        p.p.Z[3] = ONE[3] & infty;
+        if (P256_LIMBS == 8) {
+            p.p.Z[4] = ONE[4] & infty;
+            p.p.Z[5] = ONE[5] & infty;
+            p.p.Z[6] = ONE[6] & infty;
+            p.p.Z[7] = ONE[7] & infty;
+        }
+
+        for (i = 1; i < 37; i++) {
+            unsigned int off = (idx - 1) / 8;
+            wvalue = p_str[off] | p_str[off + 1] << 8;
+            wvalue = (wvalue >> ((idx - 1) % 8)) & mask;
+            idx += window_size;
+
+            wvalue = _booth_recode_w7(wvalue);
+
+            ecp_nistz256_gather_w7(&t.a,
+                                   preComputedTable[i], wvalue >> 1);
+
+            ecp_nistz256_neg(t.p.Z, t.a.Y);
+            copy_conditional(t.a.Y, t.p.Z, wvalue & 1);
+
+            ecp_nistz256_point_add_affine(&p.p, &p.p, &t.a);
+        }
+    }
+
+    memcpy(r, &p.p, sizeof(p.p));
+    ret = 1;
+
+ err:
+    BN_CTX_end(ctx);
+    return ret;
+}
+
 /* r = scalar*G + sum(scalars[i]*points[i]) */
 __owur static int ecp_nistz256_points_mul(const EC_GROUP *group,
                                           EC_POINT *r,
@@ -1121,22 +1291,15 @@ __owur static int ecp_nistz256_points_mul(const EC_GROUP *group,
                                           const EC_POINT *points[],
                                           const BIGNUM *scalars[], BN_CTX *ctx)
 {
-    int i = 0, ret = 0, no_precomp_for_generator = 0, p_is_infinity = 0;
-    unsigned char p_str[33] = { 0 };
+    int ret = 0, no_precomp_for_generator = 0, p_is_infinity = 0;
     const PRECOMP256_ROW *preComputedTable = NULL;
-    const NISTZ256_PRE_COMP *pre_comp = NULL;
     const EC_POINT *generator = NULL;
     const BIGNUM **new_scalars = NULL;
     const EC_POINT **new_points = NULL;
-    unsigned int idx = 0;
-    const unsigned int window_size = 7;
-    const unsigned int mask = (1 << (window_size + 1)) - 1;
-    unsigned int wvalue;
     ALIGN32 union {
         P256_POINT p;
         P256_POINT_AFFINE a;
     } t, p;
-    BIGNUM *tmp_scalar;
 
     if ((num + 1) == 0 || (num + 1) > OPENSSL_MALLOC_MAX_NELEMS(void *)) {
         ECerr(EC_F_ECP_NISTZ256_POINTS_MUL, ERR_R_MALLOC_FAILURE);
@@ -1153,134 +1316,14 @@ __owur static int ecp_nistz256_points_mul(const EC_GROUP *group,
         }
 
         /* look if we can use precomputed multiples of generator */
-        pre_comp = group->pre_comp.nistz256;
-
-        if (pre_comp) {
-            /*
-             * If there is a precomputed table for the generator, check that
-             * it was generated with the same generator.
-             */
-            EC_POINT *pre_comp_generator = EC_POINT_new(group);
-            if (pre_comp_generator == NULL)
-                goto err;
-
-            ecp_nistz256_gather_w7(&p.a, pre_comp->precomp[0], 1);
-            if (!ecp_nistz256_set_from_affine(pre_comp_generator,
-                                              group, &p.a, ctx)) {
-                EC_POINT_free(pre_comp_generator);
-                goto err;
-            }
-
-            if (0 == EC_POINT_cmp(group, generator, pre_comp_generator, ctx))
-                preComputedTable = (const PRECOMP256_ROW *)pre_comp->precomp;
-
-            EC_POINT_free(pre_comp_generator);
-        }
-
-        if (preComputedTable == NULL && ecp_nistz256_is_affine_G(generator)) {
-            /*
-             * If there is no precomputed data, but the generator is the
-             * default, a hardcoded table of precomputed data is used. This
-             * is because applications, such as Apache, do not use
-             * EC_KEY_precompute_mult.
-             */
-            preComputedTable = ecp_nistz256_precomputed;
-        }
+        if (!ecp_nistz256_generator_table(group, generator, &preComputedTable,
+                                          ctx))
+            goto err;
 
         if (preComputedTable) {
-            if ((BN_num_bits(scalar) > 256)
-                || BN_is_negative(scalar)) {
-                if ((tmp_scalar = BN_CTX_get(ctx)) == NULL)
-                    goto err;
-
-                if (!BN_nnmod(tmp_scalar, scalar, group->order, ctx)) {
-                    ECerr(EC_F_ECP_NISTZ256_POINTS_MUL, ERR_R_BN_LIB);
-                    goto err;
-                }
-                scalar = tmp_scalar;
-            }
-
-            for (i = 0; i < bn_get_top(scalar) * BN_BYTES; i += BN_BYTES) {
-                BN_ULONG d = bn_get_words(scalar)[i / BN_BYTES];
-
-                p_str[i + 0] = (unsigned char)d;
-                p_str[i + 1] = (unsigned char)(d >> 8);
-                p_str[i + 2] = (unsigned char)(d >> 16);
-                p_str[i + 3] = (unsigned char)(d >>= 24);
-                if (BN_BYTES == 8) {
-                    d >>= 8;
-                    p_str[i + 4] = (unsigned char)d;
-                    p_str[i + 5] = (unsigned char)(d >> 8);
-                    p_str[i + 6] = (unsigned char)(d >> 16);
-                    p_str[i + 7] = (unsigned char)(d >> 24);
-                }
-            }
-
-            for (; i < 33; i++)
-                p_str[i] = 0;
-
-#if defined(ECP_NISTZ256_AVX2)
-            if (ecp_nistz_avx2_eligible()) {
-                ecp_nistz256_avx2_mul_g(&p.p, p_str, preComputedTable);
-            } else
-#endif
-            {
-                BN_ULONG infty;
-
-                /* First window */
-                wvalue = (p_str[0] << 1) & mask;
-                idx += window_size;
-
-                wvalue = _booth_recode_w7(wvalue);
-
-                ecp_nistz256_gather_w7(&p.a, preComputedTable[0],
-                                       wvalue >> 1);
-
-                ecp_nistz256_neg(p.p.Z, p.p.Y);
-                copy_conditional(p.p.Y, p.p.Z, wvalue & 1);
-
-                /*
-                 * Since affine infinity is encoded as (0,0) and
-                 * Jacobian ias (,,0), we need to harmonize them
-                 * by assigning "one" or zero to Z.
-                 */
-                infty = (p.p.X[0] | p.p.X[1] | p.p.X[2] | p.p.X[3] |
-                         p.p.Y[0] | p.p.Y[1] | p.p.Y[2] | p.p.Y[3]);
-                if (P256_LIMBS == 8)
-                    infty |= (p.p.X[4] | p.p.X[5] | p.p.X[6] | p.p.X[7] |
-                              p.p.Y[4] | p.p.Y[5] | p.p.Y[6] | p.p.Y[7]);
-
-                infty = 0 - is_zero(infty);
-                infty = ~infty;
-
-                p.p.Z[0] = ONE[0] & infty;
-                p.p.Z[1] = ONE[1] & infty;
-                p.p.Z[2] = ONE[2] & infty;
-                p.p.Z[3] = ONE[3] & infty;
-                if (P256_LIMBS == 8) {
-                    p.p.Z[4] = ONE[4] & infty;
-                    p.p.Z[5] = ONE[5] & infty;
-                    p.p.Z[6] = ONE[6] & infty;
-                    p.p.Z[7] = ONE[7] & infty;
-                }
-
-                for (i = 1; i < 37; i++) {
-                    unsigned int off = (idx - 1) / 8;
-                    wvalue = p_str[off] | p_str[off + 1] << 8;
-                    wvalue = (wvalue >> ((idx - 1) % 8)) & mask;
-                    idx += window_size;
-
-                    wvalue = _booth_recode_w7(wvalue);
-
-                    ecp_nistz256_gather_w7(&t.a,
-                                           preComputedTable[i], wvalue >> 1);
-
-                    ecp_nistz256_neg(t.p.Z, t.a.Y);
-                    copy_conditional(t.a.Y, t.p.Z, wvalue & 1);
-
-                    ecp_nistz256_point_add_affine(&p.p, &p.p, &t.a);
-                }
-            }
+            if (!ecp_nistz256_table_mul(group, &p.p, preComputedTable, scalar,
+                                        ctx))
+                goto err;
         } else {
             p_is_infinity = 1;
             no_precomp_for_generator = 1;
@@ -1344,6 +1387,164 @@ err:
     return ret;
 }
 
+/*
+ * Build the same kind of table that ecp_nistz256_mult_precompute() builds for
+ * the generator, but for an arbitrary |point| such as a public key. The
+ * multiples are computed in Jacobian coordinates and then converted to
+ * affine form all at once, so that a single field inversion is needed.
+ */
+static void *ecp_nistz256_precompute_point(const EC_GROUP *group,
+                                           const EC_POINT *point,
+                                           BN_CTX *ctx)
+{
+    const size_t n = 37 * 64;
+    NISTZ256_PRE_COMP *pre_comp = NULL;
+    PRECOMP256_ROW *preComputedTable;
+    unsigned char *precomp_storage = NULL;
+    void *jac_storage = NULL;
+    P256_POINT *jac, *row;
+    BN_ULONG (*prod)[P256_LIMBS] = NULL;
+    BN_ULONG inv[P256_LIMBS], z_inv[P256_LIMBS], z_inv2[P256_LIMBS];
+    P256_POINT_AFFINE temp;
+    size_t i;
+    int j, k;
+
+    if (EC_POINT_is_at_infinity(group, point)) {
+        ECerr(EC_F_ECP_NISTZ256_PRECOMPUTE_POINT, EC_R_POINT_AT_INFINITY);
+        return NULL;
+    }
+
+    if ((pre_comp = ecp_nistz256_pre_comp_new(group)) == NULL)
+        return NULL;
+
+    if ((precomp_storage =
+         OPENSSL_malloc(37 * 64 * sizeof(P256_POINT_AFFINE) + 64)) == NULL
+        || (jac_storage = OPENSSL_malloc(n * sizeof(P256_POINT) + 64)) == NULL
+        || (prod = OPENSSL_malloc(n * sizeof(*prod))) == NULL) {
+        ECerr(EC_F_ECP_NISTZ256_PRECOMPUTE_POINT, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    preComputedTable = (void *)ALIGNPTR(precomp_storage, 64);
+    jac = (void *)ALIGNPTR(jac_storage, 64);
+
+    /*
+     * Row j holds 1 to 64 times 2^(7*j) * point. None of these is the point
+     * at infinity because the order of the group is a large prime.
+     */
+    if (!ecp_nistz256_bignum_to_field_elem(jac[0].X, point->X)
+        || !ecp_nistz256_bignum_to_field_elem(jac[0].Y, point->Y)
+        || !ecp_nistz256_bignum_to_field_elem(jac[0].Z, point->Z)) {
+        ECerr(EC_F_ECP_NISTZ256_PRECOMPUTE_POINT,
+              EC_R_COORDINATES_OUT_OF_RANGE);
+        goto err;
+    }
+    for (j = 0; j < 37; j++) {
+        row = jac + j * 64;
+        if (j > 0) {
+            ecp_nistz256_point_double(&row[0], &row[-64]);
+            for (k = 1; k < 7; k++)
+                ecp_nistz256_point_double(&row[0], &row[0]);
+        }
+        ecp_nistz256_point_double(&row[1], &row[0]);
+        for (k = 2; k < 64; k++)
+            ecp_nistz256_point_add(&row[k], &row[k - 1], &row[0]);
+    }
+
+    /* Invert all Z coordinates at once */
+    memcpy(prod[0], jac[0].Z, sizeof(prod[0]));
+    for (i = 1; i < n; i++)
+        ecp_nistz256_mul_mont(prod[i], prod[i - 1], jac[i].Z);
+    ecp_nistz256_mod_inverse(inv, prod[n - 1]);
+
+    for (i = n; i-- > 0; ) {
+        if (i > 0) {
+            ecp_nistz256_mul_mont(z_inv, inv, prod[i - 1]);
+            ecp_nistz256_mul_mont(inv, inv, jac[i].Z);
+        } else {
+            memcpy(z_inv, inv, sizeof(z_inv));
+        }
+        ecp_nistz256_sqr_mont(z_inv2, z_inv);
+        ecp_nistz256_mul_mont(temp.X, jac[i].X, z_inv2);
+        ecp_nistz256_mul_mont(z_inv2, z_inv2, z_inv);
+        ecp_nistz256_mul_mont(temp.Y, jac[i].Y, z_inv2);
+        ecp_nistz256_scatter_w7(preComputedTable[i / 64], &temp,
+                                (int)(i % 64));
+    }
+
+    pre_comp->w = 7;
+    pre_comp->precomp = preComputedTable;
+    pre_comp->precomp_storage = precomp_storage;
+    precomp_storage = NULL;
+
+    OPENSSL_free(jac_storage);
+    OPENSSL_free(prod);
+    return pre_comp;
+
+ err:
+    EC_nistz256_pre_comp_free(pre_comp);
+    OPENSSL_free(precomp_storage);
+    OPENSSL_free(jac_storage);
+    OPENSSL_free(prod);
+    return NULL;
+}
+
+static void ecp_nistz256_point_pre_comp_free(void *pre_comp)
+{
+    EC_nistz256_pre_comp_free(pre_comp);
+}
+
+/*
+ * r = g_scalar*G + p_scalar*P, where |pre_comp| was built for P by
+ * ecp_nistz256_precompute_point()
+ */
+__owur static int ecp_nistz256_mul_point_pre_comp(const EC_GROUP *group,
+                                                  EC_POINT *r,
+                                                  const BIGNUM *g_scalar,
+                                                  const void *pre_comp,
+                                                  const BIGNUM *p_scalar,
+                                                  BN_CTX *ctx)
+{
+    const NISTZ256_PRE_COMP *pre = pre_comp;
+    const PRECOMP256_ROW *preComputedTable = NULL;
+    const EC_POINT *generator;
+    ALIGN32 P256_POINT p, t;
+
+    if (!ecp_nistz256_table_mul(group, &p,
+                                (const PRECOMP256_ROW *)pre->precomp,
+                                p_scalar, ctx))
+        return 0;
+
+    if (g_scalar != NULL) {
+        generator = EC_GROUP_get0_generator(group);
+        if (generator == NULL) {
+            ECerr(EC_F_ECP_NISTZ256_MUL_POINT_PRE_COMP,
+                  EC_R_UNDEFINED_GENERATOR);
+            return 0;
+        }
+        if (!ecp_nistz256_generator_table(group, generator, &preComputedTable,
+                                          ctx))
+            return 0;
+        if (preComputedTable != NULL) {
+            if (!ecp_nistz256_table_mul(group, &t, preComputedTable, g_scalar,
+                                        ctx))
+                return 0;
+        } else if (!ecp_nistz256_windowed_mul(group, &t, &g_scalar,
+                                              &generator, 1, ctx)) {
+            return 0;
+        }
+        ecp_nistz256_point_add(&p, &p, &t);
+    }
+
+    /* Not constant-time, but we're only operating on the public output. */
+    if (!bn_set_words(r->X, p.X, P256_LIMBS) ||
+        !bn_set_words(r->Y, p.Y, P256_LIMBS) ||
+        !bn_set_words(r->Z, p.Z, P256_LIMBS))
+        return 0;
+    r->Z_is_one = is_one(r->Z) & 1;
+    return 1;
+}
+
 __owur static int ecp_nistz256_get_affine(const EC_GROUP *group,
                                           const EC_POINT *point,
                                           BIGNUM *x, BIGNUM *y, BN_CTX *ctx)
@@ -1696,7 +1897,10 @@ const EC_METHOD *EC_GFp_nistz256_method(void)
         0,                                          /* blind_coordinates */
         0,                                          /* ladder_pre */
         0,                                          /* ladder_step */
-        0                                           /* ladder_post */
+        0,                                          /* ladder_post */
+        ecp_nistz256_precompute_point,
+        ecp_nistz256_point_pre_comp_free,
+        ecp_nistz256_mul_point_pre_comp
     };
 
     return &ret;
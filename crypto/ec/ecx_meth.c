@@ -798,6 +798,25 @@ static int pkey_ecd_digestverify25519(EVP_MD_CTX *ctx, const unsigned char *sig,
     return ED25519_verify(tbs, tbslen, sig, edkey->pubkey);
 }
 
+/*
+ * Ed25519 signs the message itself, so EVP_PKEY_verify() takes the whole
+ * message as |tbs|.  This lets Ed25519 signatures take part in
+ * EVP_PKEY_verify_batch(), which verifies them one at a time.
+ */
+static int pkey_ecd_verify25519(EVP_PKEY_CTX *ctx, const unsigned char *sig,
+                                size_t siglen, const unsigned char *tbs,
+                                size_t tbslen)
+{
+    if (ctx->pkey == NULL) {
+        ECerr(EC_F_PKEY_ECD_VERIFY25519, EC_R_KEYS_NOT_SET);
+        return -1;
+    }
+    if (siglen != ED25519_SIGSIZE)
+        return 0;
+
+    return ED25519_verify(tbs, tbslen, sig, ctx->pkey->pkey.ecx->pubkey);
+}
+
 static int pkey_ecd_digestverify448(EVP_MD_CTX *ctx, const unsigned char *sig,
                                     size_t siglen, const unsigned char *tbs,
                                     size_t tbslen)
@@ -834,7 +853,9 @@ const EVP_PKEY_METHOD ed25519_pkey_meth = {
     EVP_PKEY_ED25519, EVP_PKEY_FLAG_SIGCTX_CUSTOM,
     0, 0, 0, 0, 0, 0,
     pkey_ecx_keygen,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0,
+    pkey_ecd_verify25519,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
     pkey_ecd_ctrl,
     0,
     pkey_ecd_digestsign25519,
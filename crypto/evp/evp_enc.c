@@ -172,6 +172,14 @@ int EVP_CipherInit_ex(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher,
         case NID_aes_256_ccm:
         case NID_aes_192_ccm:
         case NID_aes_128_ccm:
+        case NID_aes_256_xts:
+        case NID_aes_128_xts:
+        case NID_aes_256_ocb:
+        case NID_aes_192_ocb:
+        case NID_aes_128_ocb:
+        case NID_aes_256_siv:
+        case NID_aes_192_siv:
+        case NID_aes_128_siv:
         case NID_aria_256_ccm:
         case NID_aria_192_ccm:
         case NID_aria_128_ccm:
@@ -229,6 +237,7 @@ int EVP_CipherInit_ex(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher,
         case NID_des_ede_cfb64:
         case NID_desx_cbc:
         case NID_id_smime_alg_CMS3DESwrap:
+        case NID_chacha20_poly1305:
             break;
         default:
             goto legacy;
@@ -1043,6 +1052,10 @@ int EVP_CIPHER_CTX_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg, void *ptr)
     case EVP_CTRL_SET_KEY_LENGTH:
         params[0] = OSSL_PARAM_construct_size_t(OSSL_CIPHER_PARAM_KEYLEN, &sz);
         break;
+    case EVP_CTRL_SET_SPEED:     /* Used by SIV */
+        params[0] = OSSL_PARAM_construct_uint(OSSL_CIPHER_PARAM_SPEED,
+                                              (unsigned int *)&arg);
+        break;
     case EVP_CTRL_RAND_KEY:      /* Used by DES */
         set_params = 0;
         params[0] =
@@ -1050,7 +1063,27 @@ int EVP_CIPHER_CTX_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg, void *ptr)
                                               ptr, sz);
         break;
 
-    case EVP_CTRL_SET_PIPELINE_OUTPUT_BUFS: /* Used by DASYNC */
+    case EVP_CTRL_SET_PIPELINE_OUTPUT_BUFS:
+        if (arg < 0)
+            return 0;
+        params[0] =
+            OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_PIPELINE_OUTPUT_BUFS,
+                                              ptr, sz * sizeof(unsigned char *));
+        break;
+    case EVP_CTRL_SET_PIPELINE_INPUT_BUFS:
+        if (arg < 0)
+            return 0;
+        params[0] =
+            OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_PIPELINE_INPUT_BUFS,
+                                              ptr, sz * sizeof(unsigned char *));
+        break;
+    case EVP_CTRL_SET_PIPELINE_INPUT_LENS:
+        if (arg < 0)
+            return 0;
+        params[0] =
+            OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_PIPELINE_INPUT_LENS,
+                                              ptr, sz * sizeof(size_t));
+        break;
     case EVP_CTRL_INIT: /* TODO(3.0) Purely legacy, no provider counterpart */
     default:
         return EVP_CTRL_RET_UNSUPPORTED;
@@ -8,10 +8,12 @@
  */
 
 #include <stddef.h>
+#include <string.h>
 #include <openssl/ossl_typ.h>
 #include <openssl/evp.h>
 #include <openssl/core.h>
 #include "internal/cryptlib.h"
+#include "internal/cryptlib_int.h"
 #include "internal/thread_once.h"
 #include "internal/property.h"
 #include "internal/core.h"
@@ -35,6 +37,264 @@ static const OPENSSL_CTX_METHOD default_method_store_method = {
     default_method_store_free,
 };
 
+/*
+ * A small per-thread cache of fetched methods, consulted before the name map
+ * and the method store.  Entries hold a reference to their method, and so to
+ * its provider.  They are all dropped on the thread's next fetch once the
+ * library context's method generation has changed, or when the thread stops.
+ * Every cache is also listed in its library context, so that unloading a
+ * provider can empty the caches of threads that aren't fetching anything.
+ */
+#define EVP_FETCH_CACHE_SIZE    16
+
+typedef struct {
+    int operation_id;
+    char *name;
+    char *properties;           /* NULL for a NULL query */
+    void *method;
+    void (*free_method)(void *);
+} EVP_FETCH_CACHE_ENTRY;
+
+typedef struct evp_fetch_cache_st EVP_FETCH_CACHE;
+struct evp_fetch_cache_st {
+    /*
+     * Held by the owning thread while it uses the cache.  Other threads only
+     * take it to empty the cache, so it is hardly ever contended.
+     */
+    CRYPTO_RWLOCK *lock;
+    int generation;
+    size_t next;
+    EVP_FETCH_CACHE_ENTRY entries[EVP_FETCH_CACHE_SIZE];
+    EVP_FETCH_CACHE *prev_cache, *next_cache;
+};
+
+typedef struct {
+    CRYPTO_RWLOCK *lock;
+    EVP_FETCH_CACHE *caches;
+} EVP_FETCH_CACHE_LIST;
+
+static void evp_fetch_cache_entry_clear(EVP_FETCH_CACHE_ENTRY *e)
+{
+    if (e->method != NULL)
+        e->free_method(e->method);
+    OPENSSL_free(e->name);
+    memset(e, 0, sizeof(*e));
+}
+
+static void evp_fetch_cache_flush(EVP_FETCH_CACHE *cache)
+{
+    size_t i;
+
+    for (i = 0; i < EVP_FETCH_CACHE_SIZE; i++)
+        evp_fetch_cache_entry_clear(&cache->entries[i]);
+    cache->next = 0;
+}
+
+static void evp_fetch_cache_free(EVP_FETCH_CACHE *cache)
+{
+    evp_fetch_cache_flush(cache);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+static void *evp_fetch_cache_list_new(OPENSSL_CTX *ctx)
+{
+    EVP_FETCH_CACHE_LIST *list = OPENSSL_zalloc(sizeof(*list));
+
+    if (list == NULL)
+        return NULL;
+    if ((list->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        OPENSSL_free(list);
+        return NULL;
+    }
+    return list;
+}
+
+/* Frees the caches of the threads that haven't stopped yet */
+static void evp_fetch_cache_list_free(void *vlist)
+{
+    EVP_FETCH_CACHE_LIST *list = vlist;
+    EVP_FETCH_CACHE *cache, *next;
+
+    for (cache = list->caches; cache != NULL; cache = next) {
+        next = cache->next_cache;
+        evp_fetch_cache_free(cache);
+    }
+    CRYPTO_THREAD_lock_free(list->lock);
+    OPENSSL_free(list);
+}
+
+static const OPENSSL_CTX_METHOD evp_fetch_cache_list_method = {
+    evp_fetch_cache_list_new,
+    evp_fetch_cache_list_free,
+};
+
+static EVP_FETCH_CACHE_LIST *evp_fetch_cache_list(OPENSSL_CTX *libctx)
+{
+    return openssl_ctx_get_data(libctx, OPENSSL_CTX_FETCH_CACHE_LIST_INDEX,
+                                &evp_fetch_cache_list_method);
+}
+
+static void evp_fetch_cache_thread_stop(void *arg)
+{
+    EVP_FETCH_CACHE *cache = openssl_ctx_get_fetch_cache(arg);
+    EVP_FETCH_CACHE_LIST *list;
+
+    if (cache == NULL)
+        return;
+    openssl_ctx_set_fetch_cache(arg, NULL);
+    if ((list = evp_fetch_cache_list(arg)) != NULL) {
+        CRYPTO_THREAD_write_lock(list->lock);
+        if (cache->prev_cache != NULL)
+            cache->prev_cache->next_cache = cache->next_cache;
+        else
+            list->caches = cache->next_cache;
+        if (cache->next_cache != NULL)
+            cache->next_cache->prev_cache = cache->prev_cache;
+        CRYPTO_THREAD_unlock(list->lock);
+    }
+    evp_fetch_cache_free(cache);
+}
+
+/*
+ * Get this thread's cache for |libctx| with its lock held, emptied if
+ * anything happened since it was last used that could change the outcome of
+ * a fetch.  Apart from creating the cache, this takes no lock that other
+ * threads use while fetching.
+ */
+static EVP_FETCH_CACHE *evp_fetch_cache_get(OPENSSL_CTX *libctx, int create)
+{
+    EVP_FETCH_CACHE *cache = openssl_ctx_get_fetch_cache(libctx);
+    EVP_FETCH_CACHE_LIST *list;
+    int generation = openssl_ctx_get_method_generation(libctx);
+
+    if (cache == NULL) {
+        if (!create)
+            return NULL;
+        libctx = openssl_ctx_get_concrete(libctx);
+        if ((list = evp_fetch_cache_list(libctx)) == NULL
+            || !ossl_init_thread_start(NULL, libctx,
+                                       evp_fetch_cache_thread_stop)
+            || (cache = OPENSSL_zalloc(sizeof(*cache))) == NULL)
+            return NULL;
+        if ((cache->lock = CRYPTO_THREAD_lock_new()) == NULL
+            || !openssl_ctx_set_fetch_cache(libctx, cache)) {
+            CRYPTO_THREAD_lock_free(cache->lock);
+            OPENSSL_free(cache);
+            return NULL;
+        }
+        cache->generation = generation;
+        CRYPTO_THREAD_write_lock(list->lock);
+        cache->next_cache = list->caches;
+        if (list->caches != NULL)
+            list->caches->prev_cache = cache;
+        list->caches = cache;
+        CRYPTO_THREAD_unlock(list->lock);
+        CRYPTO_THREAD_write_lock(cache->lock);
+    } else {
+        CRYPTO_THREAD_write_lock(cache->lock);
+        if (cache->generation != generation) {
+            evp_fetch_cache_flush(cache);
+            cache->generation = generation;
+        }
+    }
+    return cache;
+}
+
+/*
+ * Empty every thread's cache for |libctx|, so that the references they hold
+ * on providers are dropped now rather than on each thread's next fetch.
+ */
+void evp_fetch_cache_flush_all(OPENSSL_CTX *libctx)
+{
+    EVP_FETCH_CACHE_LIST *list = evp_fetch_cache_list(libctx);
+    EVP_FETCH_CACHE *cache;
+
+    if (list == NULL)
+        return;
+    CRYPTO_THREAD_write_lock(list->lock);
+    for (cache = list->caches; cache != NULL; cache = cache->next_cache) {
+        CRYPTO_THREAD_write_lock(cache->lock);
+        evp_fetch_cache_flush(cache);
+        CRYPTO_THREAD_unlock(cache->lock);
+    }
+    CRYPTO_THREAD_unlock(list->lock);
+}
+
+static int evp_fetch_cache_match(const EVP_FETCH_CACHE_ENTRY *e,
+                                 int operation_id, const char *name,
+                                 const char *properties)
+{
+    if (e->method == NULL || e->operation_id != operation_id
+        || strcmp(e->name, name) != 0)
+        return 0;
+    if (e->properties == NULL || properties == NULL)
+        return e->properties == properties;
+    return strcmp(e->properties, properties) == 0;
+}
+
+static void *evp_fetch_cache_lookup(OPENSSL_CTX *libctx, int operation_id,
+                                    const char *name, const char *properties,
+                                    int (*up_ref_method)(void *))
+{
+    EVP_FETCH_CACHE *cache = evp_fetch_cache_get(libctx, 0);
+    void *method = NULL;
+    size_t i;
+
+    if (cache == NULL)
+        return NULL;
+    for (i = 0; i < EVP_FETCH_CACHE_SIZE; i++) {
+        EVP_FETCH_CACHE_ENTRY *e = &cache->entries[i];
+
+        if (evp_fetch_cache_match(e, operation_id, name, properties)) {
+            if (up_ref_method(e->method))
+                method = e->method;
+            break;
+        }
+    }
+    CRYPTO_THREAD_unlock(cache->lock);
+    return method;
+}
+
+static void evp_fetch_cache_insert(OPENSSL_CTX *libctx, int generation,
+                                   int operation_id, const char *name,
+                                   const char *properties, void *method,
+                                   int (*up_ref_method)(void *),
+                                   void (*free_method)(void *))
+{
+    EVP_FETCH_CACHE *cache = evp_fetch_cache_get(libctx, 1);
+    EVP_FETCH_CACHE_ENTRY *e;
+    size_t namelen, proplen;
+
+    if (cache == NULL)
+        return;
+    /* Don't cache a method that may already be stale */
+    if (cache->generation != generation)
+        goto end;
+
+    e = &cache->entries[cache->next];
+    evp_fetch_cache_entry_clear(e);
+    namelen = strlen(name) + 1;
+    proplen = properties != NULL ? strlen(properties) + 1 : 0;
+    if ((e->name = OPENSSL_malloc(namelen + proplen)) == NULL)
+        goto end;
+    memcpy(e->name, name, namelen);
+    if (properties != NULL) {
+        e->properties = e->name + namelen;
+        memcpy(e->properties, properties, proplen);
+    }
+    if (!up_ref_method(method)) {
+        evp_fetch_cache_entry_clear(e);
+        goto end;
+    }
+    e->operation_id = operation_id;
+    e->method = method;
+    e->free_method = free_method;
+    cache->next = (cache->next + 1) % EVP_FETCH_CACHE_SIZE;
+ end:
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
 /* Data to be passed through ossl_method_construct() */
 struct method_data_st {
     OPENSSL_CTX *libctx;
@@ -164,12 +424,22 @@ void *evp_generic_fetch(OPENSSL_CTX *libctx, int operation_id,
                         int (*up_ref_method)(void *),
                         void (*free_method)(void *))
 {
-    OSSL_METHOD_STORE *store = get_default_method_store(libctx);
-    OSSL_NAMEMAP *namemap = ossl_namemap_stored(libctx);
+    OSSL_METHOD_STORE *store;
+    OSSL_NAMEMAP *namemap;
     int nameid = 0;
     uint32_t methid = 0;
     void *method = NULL;
+    int generation;
+
+    if (name == NULL)
+        return NULL;
+    if ((method = evp_fetch_cache_lookup(libctx, operation_id, name,
+                                         properties, up_ref_method)) != NULL)
+        return method;
 
+    generation = openssl_ctx_get_method_generation(libctx);
+    store = get_default_method_store(libctx);
+    namemap = ossl_namemap_stored(libctx);
     if (store == NULL || namemap == NULL)
         return NULL;
 
@@ -227,6 +497,10 @@ void *evp_generic_fetch(OPENSSL_CTX *libctx, int operation_id,
         up_ref_method(method);
     }
 
+    if (method != NULL)
+        evp_fetch_cache_insert(libctx, generation, operation_id, name,
+                               properties, method, up_ref_method,
+                               free_method);
     return method;
 }
 
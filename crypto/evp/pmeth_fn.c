@@ -82,6 +82,85 @@ int EVP_PKEY_verify(EVP_PKEY_CTX *ctx,
     return ctx->pmeth->verify(ctx, sig, siglen, tbs, tbslen);
 }
 
+static int evp_pkey_can_verify(const EVP_PKEY_CTX *ctx)
+{
+    return ctx != NULL && ctx->pmeth != NULL && ctx->pmeth->verify != NULL
+        && ctx->operation == EVP_PKEY_OP_VERIFY;
+}
+
+int EVP_PKEY_verify_batch(size_t num, EVP_PKEY_CTX *const ctx[],
+                          const unsigned char *const sig[],
+                          const size_t siglen[],
+                          const unsigned char *const tbs[],
+                          const size_t tbslen[], int results[])
+{
+    /* The members of one batch, gathered from the arguments */
+    EVP_PKEY_CTX **bctx = NULL;
+    const unsigned char **bsig = NULL, **btbs = NULL;
+    size_t *bsiglen = NULL, *btbslen = NULL, *from = NULL;
+    int *bresults = NULL;
+    unsigned char *done = NULL;
+    size_t i, j, n;
+    int ret = 1;
+
+    if (num > 1
+        && ((bctx = OPENSSL_malloc(num * sizeof(*bctx))) == NULL
+            || (bsig = OPENSSL_malloc(num * sizeof(*bsig))) == NULL
+            || (btbs = OPENSSL_malloc(num * sizeof(*btbs))) == NULL
+            || (bsiglen = OPENSSL_malloc(num * sizeof(*bsiglen))) == NULL
+            || (btbslen = OPENSSL_malloc(num * sizeof(*btbslen))) == NULL
+            || (from = OPENSSL_malloc(num * sizeof(*from))) == NULL
+            || (bresults = OPENSSL_malloc(num * sizeof(*bresults))) == NULL
+            || (done = OPENSSL_zalloc(num)) == NULL)) {
+        OPENSSL_free(done);
+        done = NULL;
+    }
+
+    for (i = 0; i < num; i++) {
+        const EVP_PKEY_METHOD *pmeth;
+
+        if (done != NULL && done[i])
+            continue;
+        if (done == NULL || !evp_pkey_can_verify(ctx[i])
+            || ctx[i]->pmeth->verify_batch == NULL) {
+            results[i] = EVP_PKEY_verify(ctx[i], sig[i], siglen[i], tbs[i],
+                                         tbslen[i]);
+            continue;
+        }
+
+        /* Verify this and all later signatures with the same method together */
+        pmeth = ctx[i]->pmeth;
+        for (j = i, n = 0; j < num; j++) {
+            if (done[j] || !evp_pkey_can_verify(ctx[j])
+                || ctx[j]->pmeth != pmeth)
+                continue;
+            bctx[n] = ctx[j];
+            bsig[n] = sig[j];
+            bsiglen[n] = siglen[j];
+            btbs[n] = tbs[j];
+            btbslen[n] = tbslen[j];
+            from[n++] = j;
+            done[j] = 1;
+        }
+        pmeth->verify_batch(bctx, n, bsig, bsiglen, btbs, btbslen, bresults);
+        for (j = 0; j < n; j++)
+            results[from[j]] = bresults[j];
+    }
+
+    for (i = 0; i < num; i++)
+        if (results[i] != 1)
+            ret = 0;
+    OPENSSL_free(bctx);
+    OPENSSL_free(bsig);
+    OPENSSL_free(btbs);
+    OPENSSL_free(bsiglen);
+    OPENSSL_free(btbslen);
+    OPENSSL_free(from);
+    OPENSSL_free(bresults);
+    OPENSSL_free(done);
+    return ret;
+}
+
 int EVP_PKEY_verify_recover_init(EVP_PKEY_CTX *ctx)
 {
     int ret;
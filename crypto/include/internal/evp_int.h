@@ -93,6 +93,17 @@ struct evp_pkey_method_st {
     int (*param_check) (EVP_PKEY *pkey);
 
     int (*digest_custom) (EVP_PKEY_CTX *ctx, EVP_MD_CTX *mctx);
+
+    /*
+     * Verify |num| signatures at once, each with its own |ctx|, all of which
+     * use this method.  Not copied by EVP_PKEY_meth_copy(), so that a method
+     * with a replaced |verify| never takes this path.
+     */
+    int (*verify_batch) (EVP_PKEY_CTX *const ctx[], size_t num,
+                         const unsigned char *const sig[],
+                         const size_t siglen[],
+                         const unsigned char *const tbs[],
+                         const size_t tbslen[], int results[]);
 } /* EVP_PKEY_METHOD */ ;
 
 DEFINE_STACK_OF_CONST(EVP_PKEY_METHOD)
@@ -588,6 +599,8 @@ int evp_keymgmt_exportkey(const EVP_KEYMGMT *keymgmt,
 const OSSL_PARAM *evp_keymgmt_importkey_types(const EVP_KEYMGMT *keymgmt);
 const OSSL_PARAM *evp_keymgmt_exportkey_types(const EVP_KEYMGMT *keymgmt);
 
+void evp_fetch_cache_flush_all(OPENSSL_CTX *libctx);
+
 /* Pulling defines out of C source files */
 
 #define EVP_RC4_KEY_SIZE 16
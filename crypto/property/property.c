@@ -24,6 +24,28 @@
 /* The number of elements in the query cache before we initiate a flush */
 #define IMPL_CACHE_FLUSH_THRESHOLD  500
 
+/* The number of hash chains in the query cache, must be a power of two */
+#define IMPL_CACHE_BUCKETS          256
+
+/* The number of query cache reader counters, must be a power of two */
+#define IMPL_CACHE_READER_SHARDS    32
+
+/*
+ * The query cache is read without taking the store lock when the compiler
+ * gives us atomic loads and stores.  Otherwise readers take the read lock.
+ */
+#if defined(__GNUC__) && defined(__ATOMIC_SEQ_CST) \
+    && defined(__GCC_ATOMIC_INT_LOCK_FREE) && __GCC_ATOMIC_INT_LOCK_FREE == 2 \
+    && defined(__GCC_ATOMIC_POINTER_LOCK_FREE) \
+    && __GCC_ATOMIC_POINTER_LOCK_FREE == 2
+# define IMPL_CACHE_LOCKLESS
+# define impl_cache_load(p)         __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define impl_cache_publish(p, v)   __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+# define impl_cache_load(p)         (*(p))
+# define impl_cache_publish(p, v)   (*(p) = (v))
+#endif
+
 typedef struct {
     const OSSL_PROVIDER *provider;
     OSSL_PROPERTY_LIST *properties;
@@ -33,37 +55,81 @@ typedef struct {
 
 DEFINE_STACK_OF(IMPLEMENTATION)
 
-typedef struct {
-    const char *query;
+/*
+ * A query cache entry.  Entries are never modified once they have been
+ * published in a hash chain, apart from their next pointer when a following
+ * entry is unlinked.  Unlinked entries are kept on a retirement list until
+ * no reader can still be looking at them.
+ */
+typedef struct query_st QUERY;
+struct query_st {
+    QUERY *next;
+    QUERY *retired;
+    unsigned long hash;
+    int nid;
     void *method;
-    char body[1];
-} QUERY;
-
-DEFINE_LHASH_OF(QUERY);
+    char query[1];
+};
 
 typedef struct {
     int nid;
+    unsigned int gen;
     STACK_OF(IMPLEMENTATION) *impls;
-    LHASH_OF(QUERY) *cache;
 } ALGORITHM;
 
+/*
+ * What a store has learnt about an interned property query: the parsed query
+ * merged with the global properties and, for each algorithm, the best
+ * implementation as of the algorithm's generation.
+ */
+typedef struct {
+    void *method;
+    unsigned int gen;
+} QUERY_BEST;
+
+DEFINE_SPARSE_ARRAY_OF(QUERY_BEST);
+
+typedef struct {
+    OSSL_PROPERTY_LIST *pq;
+    size_t strings;
+    int optional;
+    SPARSE_ARRAY_OF(QUERY_BEST) *best;
+} QUERY_MEMO;
+
+DEFINE_SPARSE_ARRAY_OF(QUERY_MEMO);
+
+#ifdef IMPL_CACHE_LOCKLESS
+/*
+ * Counts of readers currently in the query cache, one per epoch parity.
+ * Readers are spread over several of these so that they don't all bounce
+ * the same cache line between processors.
+ */
+typedef struct {
+    unsigned int active[2];
+    unsigned char pad[64 - 2 * sizeof(unsigned int)];
+} IMPL_CACHE_READERS;
+#endif
+
 struct ossl_method_store_st {
     OPENSSL_CTX *ctx;
     size_t nelem;
     SPARSE_ARRAY_OF(ALGORITHM) *algs;
     OSSL_PROPERTY_LIST *global_properties;
     int need_flush;
-    unsigned int nbits;
-    unsigned char rand_bits[(IMPL_CACHE_FLUSH_THRESHOLD + 7) / 8];
     CRYPTO_RWLOCK *lock;
+    unsigned int gen;
+    SPARSE_ARRAY_OF(QUERY_MEMO) *memos;
+    size_t nmemos;
+    QUERY *cache[IMPL_CACHE_BUCKETS];
+#ifdef IMPL_CACHE_LOCKLESS
+    unsigned int epoch;
+    QUERY *retired_prev;
+    QUERY *retired_cur;
+    size_t nretired;
+    IMPL_CACHE_READERS readers[IMPL_CACHE_READER_SHARDS];
+#endif
 };
 
-typedef struct {
-    LHASH_OF(QUERY) *cache;
-    size_t nelem;
-    uint32_t seed;
-} IMPL_CACHE_FLUSH;
-
 DEFINE_SPARSE_ARRAY_OF(ALGORITHM);
 
 static void ossl_method_cache_flush(OSSL_METHOD_STORE *store, int nid);
@@ -84,14 +150,11 @@ int ossl_property_unlock(OSSL_METHOD_STORE *p)
     return p != 0 ? CRYPTO_THREAD_unlock(p->lock) : 0;
 }
 
-static unsigned long query_hash(const QUERY *a)
+static unsigned long query_hash(int nid, const char *query)
 {
-    return OPENSSL_LH_strhash(a->query);
-}
+    unsigned long h = OPENSSL_LH_strhash(query) + 0x9E3779B1UL * nid;
 
-static int query_cmp(const QUERY *a, const QUERY *b)
-{
-    return strcmp(a->query, b->query);
+    return h ^ (h >> 16);
 }
 
 static void impl_free(IMPLEMENTATION *impl)
@@ -103,21 +166,177 @@ static void impl_free(IMPLEMENTATION *impl)
     }
 }
 
-static void impl_cache_free(QUERY *elem)
+static size_t impl_cache_free(QUERY *elem, int retired)
 {
-    OPENSSL_free(elem);
+    QUERY *next;
+    size_t n = 0;
+
+    for (; elem != NULL; elem = next, n++) {
+        next = retired ? elem->retired : elem->next;
+        OPENSSL_free(elem);
+    }
+    return n;
+}
+
+static void query_memo_free(ossl_uintmax_t idx, QUERY_MEMO *memo)
+{
+    if (memo != NULL) {
+        ossl_property_free(memo->pq);
+        ossl_sa_QUERY_BEST_free_leaves(memo->best);
+        OPENSSL_free(memo);
+    }
+}
+
+static void query_memo_flush(OSSL_METHOD_STORE *store)
+{
+    ossl_sa_QUERY_MEMO_doall(store->memos, &query_memo_free);
+    ossl_sa_QUERY_MEMO_free(store->memos);
+    store->memos = ossl_sa_QUERY_MEMO_new();
+    store->nmemos = 0;
 }
 
 static void alg_cleanup(ossl_uintmax_t idx, ALGORITHM *a)
 {
     if (a != NULL) {
         sk_IMPLEMENTATION_pop_free(a->impls, &impl_free);
-        lh_QUERY_doall(a->cache, &impl_cache_free);
-        lh_QUERY_free(a->cache);
         OPENSSL_free(a);
     }
 }
 
+#ifdef IMPL_CACHE_LOCKLESS
+/*
+ * Pick the reader counter for the calling thread.  Thread stacks don't
+ * overlap, so the address of a local variable is a cheap and portable thread
+ * discriminator.  Collisions only cost a little sharing, never correctness.
+ */
+static IMPL_CACHE_READERS *impl_cache_readers(OSSL_METHOD_STORE *store)
+{
+    int marker;
+    uint32_t h = (uint32_t)((size_t)&marker >> 12) * 0x9E3779B1U;
+
+    return store->readers + (h >> 24) % IMPL_CACHE_READER_SHARDS;
+}
+
+/*
+ * Announce a reader in the current epoch.  Once this returns, nothing
+ * that the reader can reach in the cache will be freed until it calls
+ * impl_cache_read_leave().
+ */
+static unsigned int *impl_cache_read_enter(OSSL_METHOD_STORE *store)
+{
+    IMPL_CACHE_READERS *r = impl_cache_readers(store);
+    unsigned int epoch, *active;
+
+    for (;;) {
+        epoch = __atomic_load_n(&store->epoch, __ATOMIC_SEQ_CST);
+        active = r->active + (epoch & 1);
+        __atomic_add_fetch(active, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&store->epoch, __ATOMIC_SEQ_CST) == epoch)
+            return active;
+        /* The epoch moved on underneath us, register again */
+        __atomic_sub_fetch(active, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void impl_cache_read_leave(OSSL_METHOD_STORE *store,
+                                  unsigned int *active)
+{
+    __atomic_sub_fetch(active, 1, __ATOMIC_RELEASE);
+}
+
+static int impl_cache_readers_gone(OSSL_METHOD_STORE *store,
+                                   unsigned int parity)
+{
+    size_t i;
+
+    for (i = 0; i < IMPL_CACHE_READER_SHARDS; i++)
+        if (__atomic_load_n(store->readers[i].active + parity,
+                            __ATOMIC_SEQ_CST) != 0)
+            return 0;
+    return 1;
+}
+
+/*
+ * Free the entries that were retired in the previous epoch and move on to
+ * the next one.  This is only safe once every reader that registered in the
+ * epoch before the previous one has gone, since those are the only readers
+ * that could still hold such an entry.  Normally this is opportunistic, but
+ * once too many entries are awaiting reclamation it spins until the readers
+ * have left.  Readers never wait on anything, so that is bounded.
+ *
+ * This must be called with the write lock held.
+ */
+static void impl_cache_reclaim(OSSL_METHOD_STORE *store)
+{
+    int wait = store->nretired >= IMPL_CACHE_FLUSH_THRESHOLD;
+    unsigned int epoch;
+
+    while (store->retired_prev != NULL || store->retired_cur != NULL) {
+        epoch = store->epoch;
+        if (!impl_cache_readers_gone(store, (epoch + 1) & 1)) {
+            if (!wait)
+                return;
+            continue;
+        }
+        store->nretired -= impl_cache_free(store->retired_prev, 1);
+        store->retired_prev = store->retired_cur;
+        store->retired_cur = NULL;
+        __atomic_store_n(&store->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+        if (!wait)
+            return;
+    }
+}
+#else
+static unsigned int *impl_cache_read_enter(OSSL_METHOD_STORE *store)
+{
+    ossl_property_read_lock(store);
+    return NULL;
+}
+
+static void impl_cache_read_leave(OSSL_METHOD_STORE *store,
+                                  unsigned int *active)
+{
+    ossl_property_unlock(store);
+}
+
+static void impl_cache_reclaim(OSSL_METHOD_STORE *store)
+{
+}
+#endif
+
+/*
+ * Remove the entry at |*link| from its hash chain.  Readers that are
+ * currently on the entry can still follow its next pointer, so it is only
+ * freed straight away when there are no lockless readers.
+ */
+static void impl_cache_unlink(OSSL_METHOD_STORE *store, QUERY **link)
+{
+    QUERY *q = *link;
+
+    impl_cache_publish(link, q->next);
+#ifdef IMPL_CACHE_LOCKLESS
+    q->retired = store->retired_cur;
+    store->retired_cur = q;
+    store->nretired++;
+#else
+    OPENSSL_free(q);
+#endif
+    store->nelem--;
+}
+
+static QUERY **impl_cache_find(OSSL_METHOD_STORE *store, int nid,
+                               const char *prop_query, unsigned long hash)
+{
+    QUERY **link = store->cache + (hash & (IMPL_CACHE_BUCKETS - 1));
+    QUERY *q;
+
+    for (; (q = impl_cache_load(link)) != NULL; link = &q->next)
+        if (q->hash == hash && q->nid == nid
+                && strcmp(q->query, prop_query) == 0)
+            return link;
+    return NULL;
+}
+
 /*
  * The OPENSSL_CTX param here allows access to underlying property data needed
  * for computation
@@ -133,8 +352,10 @@ OSSL_METHOD_STORE *ossl_method_store_new(OPENSSL_CTX *ctx)
             OPENSSL_free(res);
             return NULL;
         }
-        if ((res->lock = CRYPTO_THREAD_lock_new()) == NULL) {
-            OPENSSL_free(res->algs);
+        if ((res->memos = ossl_sa_QUERY_MEMO_new()) == NULL
+            || (res->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            ossl_sa_QUERY_MEMO_free(res->memos);
+            ossl_sa_ALGORITHM_free(res->algs);
             OPENSSL_free(res);
             return NULL;
         }
@@ -144,9 +365,19 @@ OSSL_METHOD_STORE *ossl_method_store_new(OPENSSL_CTX *ctx)
 
 void ossl_method_store_free(OSSL_METHOD_STORE *store)
 {
+    size_t i;
+
     if (store != NULL) {
         ossl_sa_ALGORITHM_doall(store->algs, &alg_cleanup);
         ossl_sa_ALGORITHM_free(store->algs);
+        ossl_sa_QUERY_MEMO_doall(store->memos, &query_memo_free);
+        ossl_sa_QUERY_MEMO_free(store->memos);
+        for (i = 0; i < IMPL_CACHE_BUCKETS; i++)
+            impl_cache_free(store->cache[i], 0);
+#ifdef IMPL_CACHE_LOCKLESS
+        impl_cache_free(store->retired_prev, 1);
+        impl_cache_free(store->retired_cur, 1);
+#endif
         ossl_property_free(store->global_properties);
         CRYPTO_THREAD_lock_free(store->lock);
         OPENSSL_free(store);
@@ -208,8 +439,7 @@ int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
     alg = ossl_method_store_retrieve(store, nid);
     if (alg == NULL) {
         if ((alg = OPENSSL_zalloc(sizeof(*alg))) == NULL
-                || (alg->impls = sk_IMPLEMENTATION_new_null()) == NULL
-                || (alg->cache = lh_QUERY_new(&query_hash, &query_cmp)) == NULL)
+                || (alg->impls = sk_IMPLEMENTATION_new_null()) == NULL)
             goto err;
         alg->nid = nid;
         if (!ossl_method_store_insert(store, alg))
@@ -225,8 +455,10 @@ int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
             break;
     }
     if (i == sk_IMPLEMENTATION_num(alg->impls)
-        && sk_IMPLEMENTATION_push(alg->impls, impl))
+        && sk_IMPLEMENTATION_push(alg->impls, impl)) {
+        alg->gen = ++store->gen;
         ret = 1;
+    }
     ossl_property_unlock(store);
     if (ret == 0)
         impl_free(impl);
@@ -266,7 +498,9 @@ int ossl_method_store_remove(OSSL_METHOD_STORE *store, int nid,
 
         if (impl->method == method) {
             sk_IMPLEMENTATION_delete(alg->impls, i);
+            alg->gen = ++store->gen;
             ossl_property_unlock(store);
+            openssl_ctx_new_method_generation(store->ctx);
             impl_free(impl);
             return 1;
         }
@@ -275,25 +509,94 @@ int ossl_method_store_remove(OSSL_METHOD_STORE *store, int nid,
     return 0;
 }
 
-int ossl_method_store_fetch(OSSL_METHOD_STORE *store, int nid,
-                            const char *prop_query, void **method)
+/*
+ * Look up or create what the store knows about |query|.  The query is only
+ * parsed and merged with the global properties when it is first seen by this
+ * store, after the global properties change or when new property strings
+ * make the earlier parse out of date.
+ *
+ * This must be called with the write lock held.
+ */
+static QUERY_MEMO *query_memo_get(OSSL_METHOD_STORE *store,
+                                  const OSSL_PROPERTY_QUERY *query)
+{
+    QUERY_MEMO *memo = ossl_sa_QUERY_MEMO_get(store->memos, query->id);
+    size_t strings = ossl_property_string_generation(store->ctx);
+    OSSL_PROPERTY_LIST *p2;
+
+    if (memo != NULL) {
+        if (memo->strings == strings)
+            return memo;
+        ossl_sa_QUERY_MEMO_set(store->memos, query->id, NULL);
+        query_memo_free(0, memo);
+        store->nmemos--;
+    }
+    if (store->nmemos >= IMPL_CACHE_FLUSH_THRESHOLD)
+        query_memo_flush(store);
+    if (store->memos == NULL
+        || (memo = OPENSSL_zalloc(sizeof(*memo))) == NULL)
+        return NULL;
+    memo->strings = strings;
+    if ((memo->best = ossl_sa_QUERY_BEST_new()) == NULL
+        || (memo->pq = ossl_parse_query(store->ctx, query->query)) == NULL)
+        goto err;
+    if (store->global_properties != NULL) {
+        p2 = ossl_property_merge(memo->pq, store->global_properties);
+        if (p2 == NULL)
+            goto err;
+        ossl_property_free(memo->pq);
+        memo->pq = p2;
+    }
+    memo->optional = ossl_property_has_optional(memo->pq);
+    if (!ossl_sa_QUERY_MEMO_set(store->memos, query->id, memo))
+        goto err;
+    store->nmemos++;
+    return memo;
+
+err:
+    query_memo_free(0, memo);
+    return NULL;
+}
+
+static void *query_best_impl(const ALGORITHM *alg, const QUERY_MEMO *memo)
 {
-    ALGORITHM *alg;
     IMPLEMENTATION *impl;
-    OSSL_PROPERTY_LIST *pq = NULL, *p2;
-    int ret = 0;
-    int j, best = -1, score, optional;
+    void *method = NULL;
+    int j, best = -1, score;
+
+    for (j = 0; j < sk_IMPLEMENTATION_num(alg->impls); j++) {
+        impl = sk_IMPLEMENTATION_value(alg->impls, j);
+        score = ossl_property_match_count(memo->pq, impl->properties);
+        if (score > best) {
+            method = impl->method;
+            if (!memo->optional)
+                break;
+            best = score;
+        }
+    }
+    return method;
+}
+
+int ossl_method_store_fetch_query(OSSL_METHOD_STORE *store, int nid,
+                                  const OSSL_PROPERTY_QUERY *query,
+                                  void **method)
+{
+    ALGORITHM *alg;
+    QUERY_MEMO *memo;
+    QUERY_BEST *best;
+    void *m = NULL;
 
 #ifndef FIPS_MODE
     OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CONFIG, NULL);
 #endif
 
-    if (nid <= 0 || method == NULL || store == NULL)
+    if (nid <= 0 || method == NULL || store == NULL || query == NULL)
         return 0;
 
     /*
-     * This only needs to be a read lock, because queries never create property
-     * names or value and thus don't modify any of the property string layer.
+     * In the common case the best implementation for this query has already
+     * been chosen and nothing about the algorithm has changed since, so only
+     * a read lock is required.
      */
     ossl_property_read_lock(store);
     alg = ossl_method_store_retrieve(store, nid);
@@ -301,6 +604,71 @@ int ossl_method_store_fetch(OSSL_METHOD_STORE *store, int nid,
         ossl_property_unlock(store);
         return 0;
     }
+    if ((memo = ossl_sa_QUERY_MEMO_get(store->memos, query->id)) != NULL
+        && memo->strings == ossl_property_string_generation(store->ctx)
+        && (best = ossl_sa_QUERY_BEST_get(memo->best, nid)) != NULL
+        && best->gen == alg->gen) {
+        m = best->method;
+        ossl_property_unlock(store);
+        goto fin;
+    }
+    ossl_property_unlock(store);
+
+    ossl_property_write_lock(store);
+    if ((alg = ossl_method_store_retrieve(store, nid)) == NULL
+        || (memo = query_memo_get(store, query)) == NULL)
+        goto unlock;
+    m = query_best_impl(alg, memo);
+    if ((best = ossl_sa_QUERY_BEST_get(memo->best, nid)) == NULL
+        && (best = OPENSSL_malloc(sizeof(*best))) != NULL
+        && !ossl_sa_QUERY_BEST_set(memo->best, nid, best)) {
+        OPENSSL_free(best);
+        best = NULL;
+    }
+    if (best != NULL) {
+        best->method = m;
+        best->gen = alg->gen;
+    }
+unlock:
+    ossl_property_unlock(store);
+fin:
+    if (m == NULL)
+        return 0;
+    *method = m;
+    return 1;
+}
+
+int ossl_method_store_fetch(OSSL_METHOD_STORE *store, int nid,
+                            const char *prop_query, void **method)
+{
+    ALGORITHM *alg;
+    IMPLEMENTATION *impl;
+    const OSSL_PROPERTY_QUERY *query;
+    QUERY_MEMO memo;
+    OSSL_PROPERTY_LIST *p2;
+    void *m;
+    int ret = 0;
+
+    if (nid <= 0 || method == NULL || store == NULL)
+        return 0;
+
+    if (prop_query != NULL
+        && (query = ossl_property_query_get(store->ctx, prop_query)) != NULL)
+        return ossl_method_store_fetch_query(store, nid, query, method);
+
+#ifndef FIPS_MODE
+    OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CONFIG, NULL);
+#endif
+
+    /*
+     * This only needs to be a read lock, because queries never create property
+     * names or value and thus don't modify any of the property string layer.
+     */
+    memo.pq = NULL;
+    ossl_property_read_lock(store);
+    alg = ossl_method_store_retrieve(store, nid);
+    if (alg == NULL)
+        goto fin;
 
     if (prop_query == NULL) {
         if ((impl = sk_IMPLEMENTATION_value(alg->impls, 0)) != NULL) {
@@ -309,31 +677,25 @@ int ossl_method_store_fetch(OSSL_METHOD_STORE *store, int nid,
         }
         goto fin;
     }
-    pq = ossl_parse_query(store->ctx, prop_query);
-    if (pq == NULL)
+
+    /* Too many distinct queries have been interned, resolve this one as is */
+    if ((memo.pq = ossl_parse_query(store->ctx, prop_query)) == NULL)
         goto fin;
     if (store->global_properties != NULL) {
-        p2 = ossl_property_merge(pq, store->global_properties);
+        p2 = ossl_property_merge(memo.pq, store->global_properties);
         if (p2 == NULL)
             goto fin;
-        ossl_property_free(pq);
-        pq = p2;
+        ossl_property_free(memo.pq);
+        memo.pq = p2;
     }
-    optional = ossl_property_has_optional(pq);
-    for (j = 0; j < sk_IMPLEMENTATION_num(alg->impls); j++) {
-        impl = sk_IMPLEMENTATION_value(alg->impls, j);
-        score = ossl_property_match_count(pq, impl->properties);
-        if (score > best) {
-            *method = impl->method;
-            ret = 1;
-            if (!optional)
-                goto fin;
-            best = score;
-        }
+    memo.optional = ossl_property_has_optional(memo.pq);
+    if ((m = query_best_impl(alg, &memo)) != NULL) {
+        *method = m;
+        ret = 1;
     }
 fin:
     ossl_property_unlock(store);
-    ossl_property_free(pq);
+    ossl_property_free(memo.pq);
     return ret;
 }
 
@@ -346,41 +708,43 @@ int ossl_method_store_set_global_properties(OSSL_METHOD_STORE *store,
 
     ossl_property_write_lock(store);
     ossl_method_cache_flush_all(store);
+    query_memo_flush(store);
+    ossl_property_free(store->global_properties);
+    store->global_properties = NULL;
     if (prop_query == NULL) {
-        ossl_property_free(store->global_properties);
-        store->global_properties = NULL;
-        ossl_property_unlock(store);
-        return 1;
+        ret = 1;
+    } else {
+        store->global_properties = ossl_parse_query(store->ctx, prop_query);
+        ret = store->global_properties != NULL;
     }
-    store->global_properties = ossl_parse_query(store->ctx, prop_query);
-    ret = store->global_properties != NULL;
     ossl_property_unlock(store);
+    openssl_ctx_new_method_generation(store->ctx);
     return ret;
 }
 
-static void impl_cache_flush_alg(ossl_uintmax_t idx, ALGORITHM *alg)
-{
-    lh_QUERY_doall(alg->cache, &impl_cache_free);
-    lh_QUERY_flush(alg->cache);
-}
-
 static void ossl_method_cache_flush(OSSL_METHOD_STORE *store, int nid)
 {
-    ALGORITHM *alg = ossl_method_store_retrieve(store, nid);
-
-    if (alg != NULL) {
-        store->nelem -= lh_QUERY_num_items(alg->cache);
-        impl_cache_flush_alg(0, alg);
-    }
+    QUERY **link, *q;
+    size_t i;
+
+    for (i = 0; i < IMPL_CACHE_BUCKETS; i++)
+        for (link = store->cache + i; (q = *link) != NULL; )
+            if (q->nid == nid)
+                impl_cache_unlink(store, link);
+            else
+                link = &q->next;
+    impl_cache_reclaim(store);
 }
 
 static void ossl_method_cache_flush_all(OSSL_METHOD_STORE *store)
 {
-    ossl_sa_ALGORITHM_doall(store->algs, &impl_cache_flush_alg);
-    store->nelem = 0;
-}
+    size_t i;
 
-IMPLEMENT_LHASH_DOALL_ARG(QUERY, IMPL_CACHE_FLUSH);
+    for (i = 0; i < IMPL_CACHE_BUCKETS; i++)
+        while (store->cache[i] != NULL)
+            impl_cache_unlink(store, store->cache + i);
+    impl_cache_reclaim(store);
+}
 
 /*
  * Flush an element from the query cache (perhaps).
@@ -398,83 +762,64 @@ IMPLEMENT_LHASH_DOALL_ARG(QUERY, IMPL_CACHE_FLUSH);
  * preferable to a more refined approach that imposes a performance
  * impact.
  */
-static void impl_cache_flush_cache(QUERY *c, IMPL_CACHE_FLUSH *state)
-{
-    uint32_t n;
-
-    /*
-     * Implement the 32 bit xorshift as suggested by George Marsaglia in:
-     *      https://doi.org/10.18637/jss.v008.i14
-     *
-     * This is a very fast PRNG so there is no need to extract bits one at a
-     * time and use the entire value each time.
-     */
-    n = state->seed;
-    n ^= n << 13;
-    n ^= n >> 17;
-    n ^= n << 5;
-    state->seed = n;
-
-    if ((n & 1) != 0)
-        OPENSSL_free(lh_QUERY_delete(state->cache, c));
-    else
-        state->nelem++;
-}
-
-static void impl_cache_flush_one_alg(ossl_uintmax_t idx, ALGORITHM *alg,
-                                     void *v)
-{
-    IMPL_CACHE_FLUSH *state = (IMPL_CACHE_FLUSH *)v;
-
-    state->cache = alg->cache;
-    lh_QUERY_doall_IMPL_CACHE_FLUSH(state->cache, &impl_cache_flush_cache,
-                                    state);
-}
-
 static void ossl_method_cache_flush_some(OSSL_METHOD_STORE *store)
 {
-    IMPL_CACHE_FLUSH state;
+    QUERY **link, *q;
+    uint32_t n;
+    size_t i;
 
-    state.nelem = 0;
-    if ((state.seed = OPENSSL_rdtsc()) == 0)
-        state.seed = 1;
+    if ((n = OPENSSL_rdtsc()) == 0)
+        n = 1;
     store->need_flush = 0;
-    ossl_sa_ALGORITHM_doall_arg(store->algs, &impl_cache_flush_one_alg, &state);
-    store->nelem = state.nelem;
+    for (i = 0; i < IMPL_CACHE_BUCKETS; i++)
+        for (link = store->cache + i; (q = *link) != NULL; ) {
+            /*
+             * Implement the 32 bit xorshift as suggested by George Marsaglia
+             * in:
+             *      https://doi.org/10.18637/jss.v008.i14
+             *
+             * This is a very fast PRNG so there is no need to extract bits
+             * one at a time and use the entire value each time.
+             */
+            n ^= n << 13;
+            n ^= n >> 17;
+            n ^= n << 5;
+            if ((n & 1) != 0)
+                impl_cache_unlink(store, link);
+            else
+                link = &q->next;
+        }
 }
 
+/*
+ * Cache hits take no lock when the lockless cache is available, which keeps
+ * implicit fetches from contending with each other.
+ */
 int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, int nid,
                                 const char *prop_query, void **method)
 {
-    ALGORITHM *alg;
-    QUERY elem, *r;
+    QUERY **link;
+    unsigned int *active;
 
     if (nid <= 0 || store == NULL)
         return 0;
-
-    ossl_property_read_lock(store);
-    alg = ossl_method_store_retrieve(store, nid);
-    if (alg == NULL) {
-        ossl_property_unlock(store);
-        return 0;
-    }
-
-    elem.query = prop_query != NULL ? prop_query : "";
-    r = lh_QUERY_retrieve(alg->cache, &elem);
-    if (r == NULL) {
-        ossl_property_unlock(store);
-        return 0;
-    }
-    *method = r->method;
-    ossl_property_unlock(store);
-    return 1;
+    if (prop_query == NULL)
+        prop_query = "";
+
+    active = impl_cache_read_enter(store);
+    link = impl_cache_find(store, nid, prop_query,
+                           query_hash(nid, prop_query));
+    if (link != NULL)
+        *method = impl_cache_load(link)->method;
+    impl_cache_read_leave(store, active);
+    return link != NULL;
 }
 
 int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, int nid,
                                 const char *prop_query, void *method)
 {
-    QUERY elem, *old, *p = NULL;
-    ALGORITHM *alg;
+    QUERY **link, *p;
+    unsigned long hash;
     size_t len;
 
     if (nid <= 0 || store == NULL)
@@ -482,40 +827,35 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, int nid,
     if (prop_query == NULL)
         return 1;
 
+    hash = query_hash(nid, prop_query);
     ossl_property_write_lock(store);
     if (store->need_flush)
         ossl_method_cache_flush_some(store);
-    alg = ossl_method_store_retrieve(store, nid);
-    if (alg == NULL) {
-        ossl_property_unlock(store);
-        return 0;
-    }
-
-    if (method == NULL) {
-        elem.query = prop_query;
-        if (lh_QUERY_delete(alg->cache, &elem) != NULL)
-            store->nelem--;
-        ossl_property_unlock(store);
-        return 1;
-    }
-    p = OPENSSL_malloc(sizeof(*p) + (len = strlen(prop_query)));
-    if (p != NULL) {
-        p->query = p->body;
+    if (ossl_method_store_retrieve(store, nid) == NULL)
+        goto err;
+
+    if ((link = impl_cache_find(store, nid, prop_query, hash)) != NULL)
+        impl_cache_unlink(store, link);
+    if (method != NULL) {
+        len = strlen(prop_query);
+        if ((p = OPENSSL_malloc(sizeof(*p) + len)) == NULL)
+            goto err;
+        p->hash = hash;
+        p->nid = nid;
         p->method = method;
-        memcpy((char *)p->query, prop_query, len + 1);
-        if ((old = lh_QUERY_insert(alg->cache, p)) != NULL) {
-            OPENSSL_free(old);
-            ossl_property_unlock(store);
-            return 1;
-        }
-        if (!lh_QUERY_error(alg->cache)) {
-            if (++store->nelem >= IMPL_CACHE_FLUSH_THRESHOLD)
-                store->need_flush = 1;
-            ossl_property_unlock(store);
-            return 1;
-        }
+        p->retired = NULL;
+        memcpy(p->query, prop_query, len + 1);
+        link = store->cache + (hash & (IMPL_CACHE_BUCKETS - 1));
+        p->next = *link;
+        impl_cache_publish(link, p);
+        if (++store->nelem >= IMPL_CACHE_FLUSH_THRESHOLD)
+            store->need_flush = 1;
     }
+    impl_cache_reclaim(store);
+    ossl_property_unlock(store);
+    return 1;
+
+err:
     ossl_property_unlock(store);
-    OPENSSL_free(p);
     return 0;
 }
@@ -19,6 +19,7 @@ OSSL_PROPERTY_IDX ossl_property_name(OPENSSL_CTX *ctx, const char *s,
                                      int create);
 OSSL_PROPERTY_IDX ossl_property_value(OPENSSL_CTX *ctx, const char *s,
                                       int create);
+size_t ossl_property_string_generation(OPENSSL_CTX *ctx);
 
 /* Property list functions */
 void ossl_property_free(OSSL_PROPERTY_LIST *p);
@@ -39,6 +40,19 @@ OSSL_PROPERTY_LIST *ossl_prop_defn_get(OPENSSL_CTX *ctx, const char *prop);
 int ossl_prop_defn_set(OPENSSL_CTX *ctx, const char *prop,
                        OSSL_PROPERTY_LIST *pl);
 
+/* Compiled property queries, interned per library context */
+/*
+ * The most distinct queries that are interned by a library context.  Queries
+ * beyond this are parsed afresh on every fetch.
+ */
+#define PROPERTY_QUERY_MAX  1000
+
+struct ossl_property_query_st {
+    size_t id;
+    const char *query;
+    char body[1];
+};
+
 /* Property cache lock / unlock */
 int ossl_property_write_lock(OSSL_METHOD_STORE *);
 int ossl_property_read_lock(OSSL_METHOD_STORE *);
@@ -554,6 +554,9 @@ OSSL_PROPERTY_LIST *ossl_property_merge(const OSSL_PROPERTY_LIST *a,
         memcpy(r->properties + n, copy, sizeof(r->properties[0]));
     }
     r->n = n;
+    r->has_optional = 0;
+    for (i = 0; i < n; i++)
+        r->has_optional |= r->properties[i].optional;
     if (n != t)
         r = OPENSSL_realloc(r, sizeof(*r) + (n - 1) * sizeof(r->properties[0]));
     return r;
@@ -39,6 +39,7 @@ typedef struct {
     PROP_TABLE *prop_values;
     OSSL_PROPERTY_IDX prop_name_idx;
     OSSL_PROPERTY_IDX prop_value_idx;
+    CRYPTO_RWLOCK *lock;
 } PROPERTY_STRING_DATA;
 
 static unsigned long property_hash(const PROPERTY_STRING *a)
@@ -77,6 +78,7 @@ static void property_string_data_free(void *vpropdata)
     property_table_free(&propdata->prop_names);
     property_table_free(&propdata->prop_values);
     propdata->prop_name_idx = propdata->prop_value_idx = 0;
+    CRYPTO_THREAD_lock_free(propdata->lock);
 
     OPENSSL_free(propdata);
 }
@@ -87,6 +89,10 @@ static void *property_string_data_new(OPENSSL_CTX *ctx) {
     if (propdata == NULL)
         return NULL;
 
+    propdata->lock = CRYPTO_THREAD_lock_new();
+    if (propdata->lock == NULL)
+        goto err;
+
     propdata->prop_names = lh_PROPERTY_STRING_new(&property_hash,
                                                   &property_cmp);
     if (propdata->prop_names == NULL)
@@ -127,24 +133,38 @@ static PROPERTY_STRING *new_property_string(const char *s,
     return ps;
 }
 
-static OSSL_PROPERTY_IDX ossl_property_string(PROP_TABLE *t,
+/*
+ * Look |s| up in |t|.  Most strings are already known, so the table is first
+ * searched under the read lock and only locked for writing when |s| has to
+ * be added.
+ */
+static OSSL_PROPERTY_IDX ossl_property_string(PROPERTY_STRING_DATA *propdata,
+                                              PROP_TABLE *t,
                                               OSSL_PROPERTY_IDX *pidx,
                                               const char *s)
 {
     PROPERTY_STRING p, *ps, *ps_new;
+    OSSL_PROPERTY_IDX idx = 0;
 
     p.s = s;
+    CRYPTO_THREAD_read_lock(propdata->lock);
     ps = lh_PROPERTY_STRING_retrieve(t, &p);
-    if (ps == NULL && pidx != NULL)
-        if ((ps_new = new_property_string(s, pidx)) != NULL) {
+    if (ps == NULL && pidx != NULL) {
+        CRYPTO_THREAD_unlock(propdata->lock);
+        CRYPTO_THREAD_write_lock(propdata->lock);
+        ps = lh_PROPERTY_STRING_retrieve(t, &p);
+        if (ps == NULL && (ps_new = new_property_string(s, pidx)) != NULL) {
             lh_PROPERTY_STRING_insert(t, ps_new);
-            if (lh_PROPERTY_STRING_error(t)) {
+            if (lh_PROPERTY_STRING_error(t))
                 property_free(ps_new);
-                return 0;
-            }
-            ps = ps_new;
+            else
+                ps = ps_new;
         }
-    return ps != NULL ? ps->idx : 0;
+    }
+    if (ps != NULL)
+        idx = ps->idx;
+    CRYPTO_THREAD_unlock(propdata->lock);
+    return idx;
 }
 
 OSSL_PROPERTY_IDX ossl_property_name(OPENSSL_CTX *ctx, const char *s,
@@ -156,7 +176,7 @@ OSSL_PROPERTY_IDX ossl_property_name(OPENSSL_CTX *ctx, const char *s,
 
     if (propdata == NULL)
         return 0;
-    return ossl_property_string(propdata->prop_names,
+    return ossl_property_string(propdata, propdata->prop_names,
                                 create ? &propdata->prop_name_idx : NULL,
                                 s);
 }
@@ -170,7 +190,27 @@ OSSL_PROPERTY_IDX ossl_property_value(OPENSSL_CTX *ctx, const char *s,
 
     if (propdata == NULL)
         return 0;
-    return ossl_property_string(propdata->prop_values,
+    return ossl_property_string(propdata, propdata->prop_values,
                                 create ? &propdata->prop_value_idx : NULL,
                                 s);
 }
+
+/*
+ * Return a count that changes whenever a new property name or value is
+ * created.  Parsed queries refer to names and values by index, so a query
+ * parsed before one of its strings existed has to be parsed again.
+ */
+size_t ossl_property_string_generation(OPENSSL_CTX *ctx)
+{
+    PROPERTY_STRING_DATA *propdata
+        = openssl_ctx_get_data(ctx, OPENSSL_CTX_PROPERTY_STRING_INDEX,
+                               &property_string_data_method);
+    size_t gen;
+
+    if (propdata == NULL)
+        return 0;
+    CRYPTO_THREAD_read_lock(propdata->lock);
+    gen = (size_t)propdata->prop_name_idx + propdata->prop_value_idx;
+    CRYPTO_THREAD_unlock(propdata->lock);
+    return gen;
+}
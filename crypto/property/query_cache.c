@@ -0,0 +1,139 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/lhash.h>
+#include "internal/property.h"
+#include "property_lcl.h"
+
+/*
+ * Implement a table of interned property queries.
+ *
+ * Each distinct query string is given a handle that lives as long as the
+ * library context.  The handle carries a small identifier that method stores
+ * use to key what they have learnt about the query: its parsed form merged
+ * with the global properties and the best implementation for each algorithm.
+ *
+ * Handles can't be freed while the library context is alive, because they
+ * are used without holding any lock.  Instead, the table stops growing once
+ * it holds PROPERTY_QUERY_MAX queries, so that a caller that makes up new
+ * query strings can't use unbounded memory.  ossl_property_query_get()
+ * returns NULL for any further queries, which are then resolved without a
+ * handle.
+ */
+
+DEFINE_LHASH_OF(OSSL_PROPERTY_QUERY);
+
+typedef struct {
+    LHASH_OF(OSSL_PROPERTY_QUERY) *queries;
+    size_t next_id;
+    CRYPTO_RWLOCK *lock;
+} PROPERTY_QUERY_TABLE;
+
+static unsigned long property_query_hash(const OSSL_PROPERTY_QUERY *a)
+{
+    return OPENSSL_LH_strhash(a->query);
+}
+
+static int property_query_cmp(const OSSL_PROPERTY_QUERY *a,
+                              const OSSL_PROPERTY_QUERY *b)
+{
+    return strcmp(a->query, b->query);
+}
+
+static void property_query_free(OSSL_PROPERTY_QUERY *q)
+{
+    OPENSSL_free(q);
+}
+
+static void property_queries_free(void *vtable)
+{
+    PROPERTY_QUERY_TABLE *table = vtable;
+
+    if (table != NULL) {
+        lh_OSSL_PROPERTY_QUERY_doall(table->queries, &property_query_free);
+        lh_OSSL_PROPERTY_QUERY_free(table->queries);
+        CRYPTO_THREAD_lock_free(table->lock);
+        OPENSSL_free(table);
+    }
+}
+
+static void *property_queries_new(OPENSSL_CTX *ctx)
+{
+    PROPERTY_QUERY_TABLE *table = OPENSSL_zalloc(sizeof(*table));
+
+    if (table == NULL)
+        return NULL;
+    if ((table->queries = lh_OSSL_PROPERTY_QUERY_new(&property_query_hash,
+                                                     &property_query_cmp))
+            == NULL
+        || (table->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        property_queries_free(table);
+        return NULL;
+    }
+    return table;
+}
+
+static const OPENSSL_CTX_METHOD property_queries_method = {
+    property_queries_new,
+    property_queries_free,
+};
+
+const OSSL_PROPERTY_QUERY *ossl_property_query_get(OPENSSL_CTX *ctx,
+                                                   const char *prop_query)
+{
+    PROPERTY_QUERY_TABLE *table;
+    OSSL_PROPERTY_QUERY elem, *r, *p;
+    size_t len;
+    int full;
+
+    if (prop_query == NULL)
+        return NULL;
+    table = openssl_ctx_get_data(ctx, OPENSSL_CTX_PROPERTY_QUERY_INDEX,
+                                 &property_queries_method);
+    if (table == NULL)
+        return NULL;
+
+    elem.query = prop_query;
+    if (!CRYPTO_THREAD_read_lock(table->lock))
+        return NULL;
+    r = lh_OSSL_PROPERTY_QUERY_retrieve(table->queries, &elem);
+    full = lh_OSSL_PROPERTY_QUERY_num_items(table->queries)
+           >= PROPERTY_QUERY_MAX;
+    CRYPTO_THREAD_unlock(table->lock);
+    if (r != NULL || full)
+        return r;
+
+    len = strlen(prop_query);
+    if ((p = OPENSSL_malloc(sizeof(*p) + len)) == NULL)
+        return NULL;
+    p->query = p->body;
+    memcpy(p->body, prop_query, len + 1);
+
+    if (!CRYPTO_THREAD_write_lock(table->lock)) {
+        OPENSSL_free(p);
+        return NULL;
+    }
+    /* Someone else might have got here first */
+    r = lh_OSSL_PROPERTY_QUERY_retrieve(table->queries, &elem);
+    if (r == NULL
+        && lh_OSSL_PROPERTY_QUERY_num_items(table->queries)
+           < PROPERTY_QUERY_MAX) {
+        p->id = ++table->next_id;
+        lh_OSSL_PROPERTY_QUERY_insert(table->queries, p);
+        if (!lh_OSSL_PROPERTY_QUERY_error(table->queries)) {
+            r = p;
+            p = NULL;
+        }
+    }
+    CRYPTO_THREAD_unlock(table->lock);
+    OPENSSL_free(p);
+    return r;
+}
@@ -10,7 +10,9 @@
 #include <openssl/err.h>
 #include <openssl/cryptoerr.h>
 #include <openssl/provider.h>
+#include "internal/cryptlib.h"
 #include "internal/provider.h"
+#include "internal/evp_int.h"
 
 OSSL_PROVIDER *OSSL_PROVIDER_load(OPENSSL_CTX *libctx, const char *name)
 {
@@ -31,6 +33,19 @@ OSSL_PROVIDER *OSSL_PROVIDER_load(OPENSSL_CTX *libctx, const char *name)
 
 int OSSL_PROVIDER_unload(OSSL_PROVIDER *prov)
 {
+    /*
+     * Methods that were fetched from this provider may be cached on behalf
+     * of the application, each holding a reference to the provider that
+     * stops it from being deactivated.  Have them all dropped, whatever the
+     * reference count is now: the per-thread fetch caches right away, other
+     * holders when they next see the new method generation.
+     */
+    if (prov != NULL) {
+        OPENSSL_CTX *libctx = ossl_provider_library_context(prov);
+
+        openssl_ctx_new_method_generation(libctx);
+        evp_fetch_cache_flush_all(libctx);
+    }
     ossl_provider_free(prov);
     return 1;
 }
@@ -312,6 +312,7 @@ void ossl_provider_free(OSSL_PROVIDER *prov)
 # endif
 #endif
             prov->flag_initialized = 0;
+            openssl_ctx_new_method_generation(prov->libctx);
         }
 
         /*
@@ -535,6 +536,7 @@ static int provider_activate(OSSL_PROVIDER *prov)
 
     /* With this flag set, this provider has become fully "loaded". */
     prov->flag_initialized = 1;
+    openssl_ctx_new_method_generation(prov->libctx);
 
     return 1;
 }
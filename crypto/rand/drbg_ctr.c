@@ -18,6 +18,10 @@
 /*
  * Implementation of NIST SP 800-90A CTR DRBG.
  */
+
+/* The largest number of output bytes encrypted with one cipher call */
+#define CTR_GENERATE_CHUNK      (1 << 16)
+
 static void inc_128(RAND_DRBG_CTR *ctr)
 {
     int i;
@@ -323,26 +327,38 @@ __owur static int drbg_ctr_generate(RAND_DRBG *drbg,
         adinlen = 0;
     }
 
-    for ( ; ; ) {
+    /*
+     * Lay out the counter blocks for the whole blocks of output in |out|
+     * and encrypt them in place, so that the cipher gets to process many
+     * blocks in one call, which is much faster than one block at a time.
+     */
+    while (outlen >= AES_BLOCK_SIZE) {
+        size_t i, len = outlen - outlen % AES_BLOCK_SIZE;
+        int outl;
+
+        if (len > CTR_GENERATE_CHUNK)
+            len = CTR_GENERATE_CHUNK;
+        for (i = 0; i < len; i += AES_BLOCK_SIZE) {
+            inc_128(ctr);
+            memcpy(out + i, ctr->V, AES_BLOCK_SIZE);
+        }
+        if (!EVP_CipherUpdate(ctr->ctx, out, &outl, out, (int)len)
+            || outl != (int)len)
+            return 0;
+        out += len;
+        outlen -= len;
+    }
+
+    if (outlen > 0) {
         int outl = AES_BLOCK_SIZE;
 
         inc_128(ctr);
-        if (outlen < 16) {
-            /* Use K as temp space as it will be updated */
-            if (!EVP_CipherUpdate(ctr->ctx, ctr->K, &outl, ctr->V,
-                                  AES_BLOCK_SIZE)
-                || outl != AES_BLOCK_SIZE)
-                return 0;
-            memcpy(out, ctr->K, outlen);
-            break;
-        }
-        if (!EVP_CipherUpdate(ctr->ctx, out, &outl, ctr->V, AES_BLOCK_SIZE)
+        /* Use K as temp space as it will be updated */
+        if (!EVP_CipherUpdate(ctr->ctx, ctr->K, &outl, ctr->V,
+                              AES_BLOCK_SIZE)
             || outl != AES_BLOCK_SIZE)
             return 0;
-        out += 16;
-        outlen -= 16;
-        if (outlen == 0)
-            break;
+        memcpy(out, ctr->K, outlen);
     }
 
     if (!ctr_update(drbg, adin, adinlen, NULL, 0, NULL, 0))
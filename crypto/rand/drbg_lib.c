@@ -102,6 +102,12 @@ static unsigned int slave_reseed_interval  = SLAVE_RESEED_INTERVAL;
 static time_t master_reseed_time_interval = MASTER_RESEED_TIME_INTERVAL;
 static time_t slave_reseed_time_interval  = SLAVE_RESEED_TIME_INTERVAL;
 
+static size_t public_buffer_size  = 0;
+static size_t private_buffer_size = 0;
+
+/* Hands out the seed shards of the <master> DRBG in turn */
+static TSAN_QUALIFIER unsigned int next_seed_shard;
+
 /* A logical OR of all used DRBG flag bits (currently there is only one) */
 static const unsigned int rand_drbg_used_flags =
     RAND_DRBG_FLAG_CTR_NO_DF | RAND_DRBG_FLAG_HMAC | RAND_DRBG_TYPE_FLAGS;
@@ -491,6 +497,30 @@ RAND_DRBG *RAND_DRBG_secure_new(int type, unsigned int flags, RAND_DRBG *parent)
 {
     return RAND_DRBG_secure_new_ex(NULL, type, flags, parent);
 }
+
+/*
+ * Wipe the output left in the buffer of |drbg|, if any.
+ */
+static void drbg_buffer_drain(RAND_DRBG *drbg)
+{
+    if (drbg->buffer_avail == 0)
+        return;
+    OPENSSL_cleanse(drbg->buffer + drbg->buffer_size - drbg->buffer_avail,
+                    drbg->buffer_avail);
+    drbg->buffer_avail = 0;
+}
+
+static void drbg_buffer_free(RAND_DRBG *drbg)
+{
+    if (drbg->secure)
+        OPENSSL_secure_clear_free(drbg->buffer, drbg->buffer_size);
+    else
+        OPENSSL_clear_free(drbg->buffer, drbg->buffer_size);
+    drbg->buffer = NULL;
+    drbg->buffer_size = 0;
+    drbg->buffer_avail = 0;
+}
+
 /*
  * Uninstantiate |drbg| and free all memory.
  */
@@ -499,8 +529,16 @@ void RAND_DRBG_free(RAND_DRBG *drbg)
     if (drbg == NULL)
         return;
 
+    if (drbg->seed_shards != NULL) {
+        int i;
+
+        for (i = 0; i < DRBG_SEED_SHARDS; i++)
+            RAND_DRBG_free(drbg->seed_shards[i]);
+        OPENSSL_free(drbg->seed_shards);
+    }
     if (drbg->meth != NULL)
         drbg->meth->uninstantiate(drbg);
+    drbg_buffer_free(drbg);
     rand_pool_free(drbg->adin_pool);
     CRYPTO_THREAD_lock_free(drbg->lock);
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_DRBG, drbg, &drbg->ex_data);
@@ -528,6 +566,8 @@ int RAND_DRBG_instantiate(RAND_DRBG *drbg,
     size_t min_entropylen = drbg->min_entropylen;
     size_t max_entropylen = drbg->max_entropylen;
 
+    drbg_buffer_drain(drbg);
+
     if (perslen > drbg->max_perslen) {
         RANDerr(RAND_F_RAND_DRBG_INSTANTIATE,
                 RAND_R_PERSONALISATION_STRING_TOO_LONG);
@@ -617,6 +657,8 @@ int RAND_DRBG_instantiate(RAND_DRBG *drbg,
 int RAND_DRBG_uninstantiate(RAND_DRBG *drbg)
 {
     int index = -1, type, flags;
+
+    drbg_buffer_drain(drbg);
     if (drbg->meth == NULL) {
         drbg->state = DRBG_ERROR;
         RANDerr(RAND_F_RAND_DRBG_UNINSTANTIATE,
@@ -630,6 +672,18 @@ int RAND_DRBG_uninstantiate(RAND_DRBG *drbg)
      */
     drbg->meth->uninstantiate(drbg);
 
+    /*
+     * Make the seed shards reseed before they hand out more entropy, which
+     * instantiates |drbg| again.
+     */
+    if (drbg->seed_shards != NULL) {
+        unsigned int reseed_counter = tsan_load(&drbg->reseed_prop_counter);
+
+        if (reseed_counter > 0 && ++reseed_counter == 0)
+            reseed_counter = 1;
+        tsan_store(&drbg->reseed_prop_counter, reseed_counter);
+    }
+
     /* The reset uses the default values for type and flags */
     if (drbg->flags & RAND_DRBG_FLAG_MASTER)
         index = RAND_DRBG_TYPE_MASTER;
@@ -662,6 +716,9 @@ int RAND_DRBG_reseed(RAND_DRBG *drbg,
     unsigned char *entropy = NULL;
     size_t entropylen = 0;
 
+    /* Output generated before the reseed must not be handed out after it */
+    drbg_buffer_drain(drbg);
+
     if (drbg->state == DRBG_ERROR) {
         RANDerr(RAND_F_RAND_DRBG_RESEED, RAND_R_IN_ERROR_STATE);
         return 0;
@@ -738,6 +795,8 @@ int rand_drbg_restart(RAND_DRBG *drbg,
     const unsigned char *adin = NULL;
     size_t adinlen = 0;
 
+    drbg_buffer_drain(drbg);
+
     if (drbg->seed_pool != NULL) {
         RANDerr(RAND_F_RAND_DRBG_RESTART, ERR_R_INTERNAL_ERROR);
         drbg->state = DRBG_ERROR;
@@ -898,14 +957,11 @@ int RAND_DRBG_generate(RAND_DRBG *drbg, unsigned char *out, size_t outlen,
 }
 
 /*
- * Generates |outlen| random bytes and stores them in |out|. It will
- * using the given |drbg| to generate the bytes.
- *
- * Requires that drbg->lock is already locked for write, if non-null.
- *
- * Returns 1 on success 0 on failure.
+ * Generates |outlen| random bytes into |out|, in as many generate
+ * requests as needed, with fresh additional data.
  */
-int RAND_DRBG_bytes(RAND_DRBG *drbg, unsigned char *out, size_t outlen)
+static int drbg_bytes_unbuffered(RAND_DRBG *drbg,
+                                 unsigned char *out, size_t outlen)
 {
     unsigned char *additional = NULL;
     size_t additional_len;
@@ -940,6 +996,108 @@ int RAND_DRBG_bytes(RAND_DRBG *drbg, unsigned char *out, size_t outlen)
     return ret;
 }
 
+/*
+ * Returns 1 if the next generate request of |drbg| would reseed it for
+ * any reason other than its reseed interval, 0 otherwise.  Output it has
+ * buffered must not be used then.
+ */
+static int drbg_buffer_stale(RAND_DRBG *drbg)
+{
+    if (drbg->state != DRBG_READY || drbg->fork_count != rand_fork_count)
+        return 1;
+    if (drbg->reseed_time_interval > 0) {
+        time_t now = time(NULL);
+
+        if (now < drbg->reseed_time
+            || now - drbg->reseed_time >= drbg->reseed_time_interval)
+            return 1;
+    }
+    if (drbg->parent != NULL) {
+        unsigned int reseed_counter = tsan_load(&drbg->reseed_prop_counter);
+
+        if (reseed_counter > 0
+                && tsan_load(&drbg->parent->reseed_prop_counter)
+                   != reseed_counter)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Generates |outlen| random bytes and stores them in |out|. It will
+ * using the given |drbg| to generate the bytes.
+ *
+ * If |drbg| has an output buffer and the request fits into it, the bytes
+ * are taken from the buffer, which is refilled with a single generate
+ * request when it runs out.  The bytes handed out are wiped from the
+ * buffer.
+ *
+ * Requires that drbg->lock is already locked for write, if non-null.
+ *
+ * Returns 1 on success 0 on failure.
+ */
+int RAND_DRBG_bytes(RAND_DRBG *drbg, unsigned char *out, size_t outlen)
+{
+    unsigned char *p;
+    size_t n;
+
+    if (drbg->buffer == NULL || outlen > drbg->buffer_size)
+        return drbg_bytes_unbuffered(drbg, out, outlen);
+
+    if (drbg->buffer_avail > 0 && drbg_buffer_stale(drbg))
+        drbg_buffer_drain(drbg);
+
+    while (outlen > 0) {
+        if (drbg->buffer_avail == 0) {
+            if (!drbg_bytes_unbuffered(drbg, drbg->buffer, drbg->buffer_size))
+                return 0;
+            drbg->buffer_avail = drbg->buffer_size;
+        }
+        n = outlen < drbg->buffer_avail ? outlen : drbg->buffer_avail;
+        p = drbg->buffer + drbg->buffer_size - drbg->buffer_avail;
+        memcpy(out, p, n);
+        OPENSSL_cleanse(p, n);
+        drbg->buffer_avail -= n;
+        out += n;
+        outlen -= n;
+    }
+    return 1;
+}
+
+/*
+ * Set the size of the output buffer of |drbg| to |size| bytes, which
+ * must not exceed the maximum request size of |drbg|.  A |size| of 0
+ * removes the buffer.  Any buffered output is discarded.
+ *
+ * Returns 1 on success, 0 on failure.
+ */
+int RAND_DRBG_set_buffer_size(RAND_DRBG *drbg, size_t size)
+{
+    unsigned char *buffer = NULL;
+
+    if (size > MAX_BUFFER_SIZE || size > drbg->max_request)
+        return 0;
+
+    if (size > 0) {
+        buffer = drbg->secure ? OPENSSL_secure_malloc(size)
+                              : OPENSSL_malloc(size);
+        if (buffer == NULL) {
+            RANDerr(RAND_F_RAND_DRBG_SET_BUFFER_SIZE, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+    }
+
+    drbg_buffer_free(drbg);
+    drbg->buffer = buffer;
+    drbg->buffer_size = size;
+    return 1;
+}
+
+size_t RAND_DRBG_get_buffer_size(const RAND_DRBG *drbg)
+{
+    return drbg->buffer_size;
+}
+
 /*
  * Set the RAND_DRBG callbacks for obtaining entropy and nonce.
  *
@@ -1032,6 +1190,25 @@ int RAND_DRBG_set_reseed_defaults(
     return 1;
 }
 
+/*
+ * Set the default output buffer sizes of the per-thread <public> and
+ * <private> DRBG instances created from now on.
+ *
+ * Returns 1 on success, 0 on failure.
+ */
+int RAND_DRBG_set_buffer_defaults(size_t _public_buffer_size,
+                                  size_t _private_buffer_size)
+{
+    if (_public_buffer_size > MAX_BUFFER_SIZE
+        || _private_buffer_size > MAX_BUFFER_SIZE)
+        return 0;
+
+    public_buffer_size = _public_buffer_size;
+    private_buffer_size = _private_buffer_size;
+
+    return 1;
+}
+
 /*
  * Locks the given drbg. Locking a drbg which does not have locking
  * enabled is considered a successful no-op.
@@ -1113,6 +1290,42 @@ void *RAND_DRBG_get_ex_data(const RAND_DRBG *drbg, int idx)
  * global DRBG.  They lock.
  */
 
+/*
+ * Gives the <master> DRBG |master| its seed shards, see struct rand_drbg_st.
+ * The shards are instantiated when they are first used.
+ *
+ * Returns 1 on success, 0 on failure.
+ */
+static int drbg_setup_seed_shards(RAND_DRBG *master)
+{
+    RAND_DRBG **shards;
+    int i;
+
+    shards = OPENSSL_zalloc(DRBG_SEED_SHARDS * sizeof(*shards));
+    if (shards == NULL)
+        return 0;
+
+    for (i = 0; i < DRBG_SEED_SHARDS; i++) {
+        shards[i] = RAND_DRBG_secure_new_ex(master->libctx, master->type,
+                                            master->flags
+                                            & ~RAND_DRBG_TYPE_FLAGS,
+                                            master);
+        if (shards[i] == NULL || rand_drbg_enable_locking(shards[i]) == 0)
+            goto err;
+        /* enable seed propagation */
+        tsan_store(&shards[i]->reseed_prop_counter, 1);
+    }
+
+    master->seed_shards = shards;
+    return 1;
+
+ err:
+    for (i = 0; i < DRBG_SEED_SHARDS; i++)
+        RAND_DRBG_free(shards[i]);
+    OPENSSL_free(shards);
+    return 0;
+}
+
 /*
  * Allocates a new global DRBG on the secure heap (if enabled) and
  * initializes it with default settings.
@@ -1122,6 +1335,7 @@ void *RAND_DRBG_get_ex_data(const RAND_DRBG *drbg, int idx)
 static RAND_DRBG *drbg_setup(OPENSSL_CTX *ctx, RAND_DRBG *parent, int drbg_type)
 {
     RAND_DRBG *drbg;
+    size_t buffer_size = 0;
 
     drbg = RAND_DRBG_secure_new_ex(ctx, rand_drbg_type[drbg_type],
                                    rand_drbg_flags[drbg_type], parent);
@@ -1132,6 +1346,22 @@ static RAND_DRBG *drbg_setup(OPENSSL_CTX *ctx, RAND_DRBG *parent, int drbg_type)
     if (parent == NULL && rand_drbg_enable_locking(drbg) == 0)
         goto err;
 
+    if (drbg_type == RAND_DRBG_TYPE_PUBLIC)
+        buffer_size = public_buffer_size;
+    else if (drbg_type == RAND_DRBG_TYPE_PRIVATE)
+        buffer_size = private_buffer_size;
+    if (buffer_size > 0 && !RAND_DRBG_set_buffer_size(drbg, buffer_size))
+        goto err;
+
+    /*
+     * Without seed shards, the <public> and <private> DRBGs simply reseed
+     * from the <master> itself.
+     */
+    if (parent == NULL)
+        (void)drbg_setup_seed_shards(drbg);
+    else
+        drbg->seed_shard = tsan_counter(&next_seed_shard);
+
     /* enable seed propagation */
     tsan_store(&drbg->reseed_prop_counter, 1);
 
@@ -34,6 +34,12 @@
 # define MASTER_RESEED_TIME_INTERVAL             (60*60)   /* 1 hour */
 # define SLAVE_RESEED_TIME_INTERVAL              (7*60)    /* 7 minutes */
 
+/* Maximum size of the output buffer of a DRBG, see RAND_DRBG_bytes() */
+# define MAX_BUFFER_SIZE                         (1 << 16)
+
+/* Number of seed shards of the <master> DRBG, see struct rand_drbg_st */
+# define DRBG_SEED_SHARDS                        8
+
 /*
  * The number of bytes that constitutes an atomic lump of entropy with respect
  * to the FIPS 140-2 section 4.9.2 Conditional Tests.  The size is somewhat
@@ -305,6 +311,32 @@ struct rand_drbg_st {
     TSAN_QUALIFIER unsigned int reseed_prop_counter;
     unsigned int reseed_next_counter;
 
+    /*
+     * Output generated ahead of time by RAND_DRBG_bytes(), which serves
+     * small requests from it instead of running a generate request for
+     * each one.  The unused output is the last |buffer_avail| bytes of
+     * the |buffer_size| byte |buffer|, everything before it has been
+     * handed out and wiped.  It is discarded whenever the DRBG reseeds or
+     * would have to reseed before its next generate request.
+     */
+    unsigned char *buffer;
+    size_t buffer_size;
+    size_t buffer_avail;
+
+    /*
+     * The <master> DRBG has DRBG_SEED_SHARDS children of its own, its seed
+     * shards, which are locked separately.  The <public> and <private>
+     * DRBGs are spread over them and take their entropy from their shard
+     * instead of the <master>, so that threads reseeding at the same time
+     * do not all queue on the lock of the <master>.  The shards follow the
+     * reseeds of the <master> like any other child, so the chain from the
+     * <master> to the per-thread DRBGs is kept intact.
+     *
+     * |seed_shard| selects the shard of the parent a DRBG reseeds from.
+     */
+    RAND_DRBG **seed_shards;
+    unsigned int seed_shard;
+
     size_t seedlen;
     DRBG_STATUS state;
 
@@ -155,6 +155,16 @@ size_t rand_drbg_get_entropy(RAND_DRBG *drbg,
     if (drbg->parent != NULL) {
         size_t bytes_needed = rand_pool_bytes_needed(pool, 1 /*entropy_factor*/);
         unsigned char *buffer = rand_pool_add_begin(pool, bytes_needed);
+        RAND_DRBG *source = drbg->parent;
+
+        /*
+         * The <public> and <private> DRBGs take their entropy from a seed
+         * shard of the <master>, if it has them.
+         */
+        if (source->seed_shards != NULL
+                && (drbg->flags
+                    & (RAND_DRBG_FLAG_PUBLIC | RAND_DRBG_FLAG_PRIVATE)) != 0)
+            source = source->seed_shards[drbg->seed_shard % DRBG_SEED_SHARDS];
 
         if (buffer != NULL) {
             size_t bytes = 0;
@@ -164,16 +174,20 @@ size_t rand_drbg_get_entropy(RAND_DRBG *drbg,
              * Our lock is already held, but we need to lock our parent before
              * generating bits from it. (Note: taking the lock will be a no-op
              * if locking if drbg->parent->lock == NULL.)
+             *
+             * A seed shard reseeds from the parent first if the parent has
+             * reseeded since the shard last did, so its reseed counter is
+             * the one to record.
              */
-            rand_drbg_lock(drbg->parent);
-            if (RAND_DRBG_generate(drbg->parent,
+            rand_drbg_lock(source);
+            if (RAND_DRBG_generate(source,
                                    buffer, bytes_needed,
                                    prediction_resistance,
                                    NULL, 0) != 0)
                 bytes = bytes_needed;
             drbg->reseed_next_counter
-                = tsan_load(&drbg->parent->reseed_prop_counter);
-            rand_drbg_unlock(drbg->parent);
+                = tsan_load(&source->reseed_prop_counter);
+            rand_drbg_unlock(source);
 
             rand_pool_add_end(pool, bytes, 8 * bytes);
             entropy_available = rand_pool_entropy_available(pool);
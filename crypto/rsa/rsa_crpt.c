@@ -11,6 +11,7 @@
 #include <openssl/crypto.h>
 #include "internal/cryptlib.h"
 #include "internal/bn_int.h"
+#include "internal/tsan_assist.h"
 #include <openssl/rand.h>
 #include "rsa_locl.h"
 
@@ -55,22 +56,23 @@ int RSA_flags(const RSA *r)
 
 void RSA_blinding_off(RSA *rsa)
 {
-    BN_BLINDING_free(rsa->blinding);
-    rsa->blinding = NULL;
+    rsa_free_blindings(rsa);
     rsa->flags &= ~RSA_FLAG_BLINDING;
     rsa->flags |= RSA_FLAG_NO_BLINDING;
 }
 
 int RSA_blinding_on(RSA *rsa, BN_CTX *ctx)
 {
-    int ret = 0;
+    BN_BLINDING *b;
+    int ret = 0, local;
 
-    if (rsa->blinding != NULL)
+    if (rsa->blindings != NULL)
         RSA_blinding_off(rsa);
 
-    rsa->blinding = RSA_setup_blinding(rsa, ctx);
-    if (rsa->blinding == NULL)
+    if ((b = rsa_get_thread_blinding(rsa, ctx, &local)) == NULL)
         goto err;
+    if (!local)
+        BN_BLINDING_free(b);
 
     rsa->flags |= RSA_FLAG_BLINDING;
     rsa->flags &= ~RSA_FLAG_NO_BLINDING;
@@ -167,3 +169,91 @@ BN_BLINDING *RSA_setup_blinding(RSA *rsa, BN_CTX *in_ctx)
 
     return ret;
 }
+
+static BN_BLINDING *rsa_find_thread_blinding(const RSA_BLINDING *rb)
+{
+    for (; rb != NULL; rb = rb->next)
+        if (BN_BLINDING_is_current_thread(rb->blinding))
+            return rb->blinding;
+    return NULL;
+}
+
+/*
+ * Get the calling thread's blinding for |rsa|, setting one up on first use.
+ * Every thread has a blinding of its own, so private key operations on a key
+ * shared between threads need no locking around BN_BLINDING_convert() and
+ * BN_BLINDING_invert().  A thread that has exited leaves its blinding behind
+ * for the next thread that is given the same thread ID.
+ *
+ * Thread IDs are not always reused, so the number of blindings kept with the
+ * key is capped, which also bounds the walk to find one.  Once the cap is
+ * reached, other threads get a new blinding for every operation.  *|local| is
+ * set to 0 in that case, and the caller has to free the blinding when done.
+ */
+#define RSA_MAX_THREAD_BLINDINGS    64
+
+BN_BLINDING *rsa_get_thread_blinding(RSA *rsa, BN_CTX *ctx, int *local)
+{
+    RSA_BLINDING *rb;
+    BN_BLINDING *ret;
+
+    *local = 1;
+
+#ifdef tsan_ld_acq
+    ret = rsa_find_thread_blinding(
+              tsan_ld_acq((RSA_BLINDING *TSAN_QUALIFIER *)&rsa->blindings));
+#else
+    CRYPTO_THREAD_read_lock(rsa->lock);
+    ret = rsa_find_thread_blinding(rsa->blindings);
+    CRYPTO_THREAD_unlock(rsa->lock);
+#endif
+    if (ret != NULL)
+        return ret;
+
+    /* Only this thread can add a blinding for itself, no need to look again */
+    if ((rb = OPENSSL_malloc(sizeof(*rb))) == NULL) {
+        RSAerr(RSA_F_RSA_GET_THREAD_BLINDING, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    if ((ret = RSA_setup_blinding(rsa, ctx)) == NULL) {
+        OPENSSL_free(rb);
+        return NULL;
+    }
+
+    CRYPTO_THREAD_write_lock(rsa->lock);
+    if (rsa->nblindings < RSA_MAX_THREAD_BLINDINGS) {
+        rb->blinding = ret;
+        rb->next = rsa->blindings;
+#ifdef tsan_st_rel
+        tsan_st_rel((RSA_BLINDING *TSAN_QUALIFIER *)&rsa->blindings, rb);
+#else
+        rsa->blindings = rb;
+#endif
+        rsa->nblindings++;
+        rb = NULL;
+    }
+    CRYPTO_THREAD_unlock(rsa->lock);
+
+    if (rb != NULL) {
+        OPENSSL_free(rb);
+        *local = 0;
+    }
+    return ret;
+}
+
+/*
+ * Free the blindings of all threads.  The caller must make sure that no other
+ * thread is using |rsa|.
+ */
+void rsa_free_blindings(RSA *rsa)
+{
+    RSA_BLINDING *rb, *next;
+
+    for (rb = rsa->blindings; rb != NULL; rb = next) {
+        next = rb->next;
+        BN_BLINDING_free(rb->blinding);
+        OPENSSL_free(rb);
+    }
+    rsa->blindings = NULL;
+    rsa->nblindings = 0;
+}
@@ -135,8 +135,7 @@ void RSA_free(RSA *r)
     BN_clear_free(r->iqmp);
     RSA_PSS_PARAMS_free(r->pss);
     sk_RSA_PRIME_INFO_pop_free(r->prime_infos, rsa_multip_info_free);
-    BN_BLINDING_free(r->blinding);
-    BN_BLINDING_free(r->mt_blinding);
+    rsa_free_blindings(r);
     OPENSSL_free(r->bignum_data);
     OPENSSL_free(r);
 }
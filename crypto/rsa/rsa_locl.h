@@ -28,6 +28,13 @@ typedef struct rsa_prime_info_st {
 DECLARE_ASN1_ITEM(RSA_PRIME_INFO)
 DEFINE_STACK_OF(RSA_PRIME_INFO)
 
+/* One thread's blinding for private key operations with a key */
+typedef struct rsa_blinding_st RSA_BLINDING;
+struct rsa_blinding_st {
+    BN_BLINDING *blinding;
+    RSA_BLINDING *next;
+};
+
 struct rsa_st {
     /*
      * The first parameter is used to pickup errors where this is passed
@@ -63,8 +70,14 @@ struct rsa_st {
      * NULL
      */
     char *bignum_data;
-    BN_BLINDING *blinding;
-    BN_BLINDING *mt_blinding;
+    /*
+     * A blinding for each thread that has used this key, at most
+     * RSA_MAX_THREAD_BLINDINGS of them.  Entries are only ever added at the
+     * head, under |lock|, so a thread can look up its own without taking
+     * the lock.
+     */
+    RSA_BLINDING *blindings;
+    int nblindings;
     CRYPTO_RWLOCK *lock;
 };
 
@@ -128,6 +141,9 @@ RSA_PSS_PARAMS *rsa_pss_params_create(const EVP_MD *sigmd,
 int rsa_pss_get_param(const RSA_PSS_PARAMS *pss, const EVP_MD **pmd,
                       const EVP_MD **pmgf1md, int *psaltlen);
 /* internal function to clear and free multi-prime parameters */
+BN_BLINDING *rsa_get_thread_blinding(RSA *rsa, BN_CTX *ctx, int *local);
+void rsa_free_blindings(RSA *rsa);
+
 void rsa_multip_info_free_ex(RSA_PRIME_INFO *pinfo);
 void rsa_multip_info_free(RSA_PRIME_INFO *pinfo);
 RSA_PRIME_INFO *rsa_multip_info_new(void);
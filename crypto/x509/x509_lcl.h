@@ -38,6 +38,8 @@ struct X509_VERIFY_PARAM_st {
 /* No error callback if depth < 0 */
 int x509_check_cert_time(X509_STORE_CTX *ctx, X509 *x, int depth);
 
+int x509_store_read_lock(X509_STORE *s);
+
 /* a sequence of these are used */
 struct x509_attributes_st {
     ASN1_OBJECT *object;
@@ -134,6 +136,11 @@ struct x509_store_st {
     CRYPTO_EX_DATA ex_data;
     CRYPTO_REF_COUNT references;
     CRYPTO_RWLOCK *lock;
+    /* Bumped under |lock| whenever the store changes */
+    uint64_t generation;
+    /* Under the write lock of X509_STORE_lock(), the number of objects */
+    int locked_num;
+    int write_locked;
 };
 
 typedef struct lookup_dir_hashes_st BY_DIR_HASH;
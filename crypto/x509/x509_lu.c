@@ -41,16 +41,78 @@ void X509_LOOKUP_free(X509_LOOKUP *ctx)
     OPENSSL_free(ctx);
 }
 
+/*
+ * Lock |s| for changes.  The objects are sorted first, so that
+ * X509_STORE_unlock() can tell whether any were added, replaced or removed
+ * while the lock was held: all of these either unsort the stack or change
+ * its size.
+ */
 int X509_STORE_lock(X509_STORE *s)
 {
-    return CRYPTO_THREAD_write_lock(s->lock);
+    if (!CRYPTO_THREAD_write_lock(s->lock))
+        return 0;
+    sk_X509_OBJECT_sort(s->objs);
+    s->locked_num = sk_X509_OBJECT_num(s->objs);
+    s->write_locked = 1;
+    return 1;
 }
 
 int X509_STORE_unlock(X509_STORE *s)
 {
+    if (s->write_locked) {
+        s->write_locked = 0;
+        if (!sk_X509_OBJECT_is_sorted(s->objs)
+                || sk_X509_OBJECT_num(s->objs) != s->locked_num)
+            s->generation++;
+    }
     return CRYPTO_THREAD_unlock(s->lock);
 }
 
+/*
+ * Note a change to |s| that was made without its lock, after the change, so
+ * that anyone who sees the new generation also sees the change.
+ */
+static void x509_store_modified(X509_STORE *s)
+{
+    if (CRYPTO_THREAD_write_lock(s->lock)) {
+        s->generation++;
+        CRYPTO_THREAD_unlock(s->lock);
+    }
+}
+
+uint64_t X509_STORE_get_generation(X509_STORE *s)
+{
+    uint64_t generation;
+
+    if (!CRYPTO_THREAD_read_lock(s->lock))
+        return 0;
+    generation = s->generation;
+    CRYPTO_THREAD_unlock(s->lock);
+    return generation;
+}
+
+/*
+ * Lock |s| for lookups only.  Lookups binary search the object stack, which
+ * has to be sorted first if objects were added since the last lookup.  That
+ * is done under the write lock, so that the lookups themselves can share the
+ * read lock with each other.  Unlock with X509_STORE_unlock().
+ */
+int x509_store_read_lock(X509_STORE *s)
+{
+    for (;;) {
+        if (!CRYPTO_THREAD_read_lock(s->lock))
+            return 0;
+        if (sk_X509_OBJECT_is_sorted(s->objs))
+            return 1;
+        CRYPTO_THREAD_unlock(s->lock);
+
+        if (!CRYPTO_THREAD_write_lock(s->lock))
+            return 0;
+        sk_X509_OBJECT_sort(s->objs);
+        CRYPTO_THREAD_unlock(s->lock);
+    }
+}
+
 int X509_LOOKUP_init(X509_LOOKUP *ctx)
 {
     if (ctx->method == NULL)
@@ -263,8 +325,10 @@ X509_LOOKUP *X509_STORE_add_lookup(X509_STORE *v, X509_LOOKUP_METHOD *m)
     }
 
     lu->store_ctx = v;
-    if (sk_X509_LOOKUP_push(v->get_cert_methods, lu))
+    if (sk_X509_LOOKUP_push(v->get_cert_methods, lu)) {
+        x509_store_modified(v);
         return lu;
+    }
     /* malloc failed */
     X509err(X509_F_X509_STORE_ADD_LOOKUP, ERR_R_MALLOC_FAILURE);
     X509_LOOKUP_free(lu);
@@ -301,7 +365,8 @@ int X509_STORE_CTX_get_by_subject(X509_STORE_CTX *vs, X509_LOOKUP_TYPE type,
     stmp.data.ptr = NULL;
 
 
-    X509_STORE_lock(store);
+    if (!x509_store_read_lock(store))
+        return 0;
     tmp = X509_OBJECT_retrieve_by_subject(store->objs, type, name);
     X509_STORE_unlock(store);
 
@@ -540,10 +605,9 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
     X509_OBJECT *obj;
     X509_STORE *store = ctx->store;
 
-    if (store == NULL)
+    if (store == NULL || !x509_store_read_lock(store))
         return NULL;
 
-    X509_STORE_lock(store);
     idx = x509_object_idx_cnt(store->objs, X509_LU_X509, nm, &cnt);
     if (idx < 0) {
         /*
@@ -561,7 +625,8 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
             return NULL;
         }
         X509_OBJECT_free(xobj);
-        X509_STORE_lock(store);
+        if (!x509_store_read_lock(store))
+            return NULL;
         idx = x509_object_idx_cnt(store->objs, X509_LU_X509, nm, &cnt);
         if (idx < 0) {
             X509_STORE_unlock(store);
@@ -570,6 +635,10 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
     }
 
     sk = sk_X509_new_null();
+    if (sk == NULL) {
+        X509_STORE_unlock(store);
+        return NULL;
+    }
     for (i = 0; i < cnt; i++, idx++) {
         obj = sk_X509_OBJECT_value(store->objs, idx);
         x = obj->data.x509;
@@ -607,7 +676,10 @@ STACK_OF(X509_CRL) *X509_STORE_CTX_get1_crls(X509_STORE_CTX *ctx, X509_NAME *nm)
         return NULL;
     }
     X509_OBJECT_free(xobj);
-    X509_STORE_lock(store);
+    if (!x509_store_read_lock(store)) {
+        sk_X509_CRL_free(sk);
+        return NULL;
+    }
     idx = x509_object_idx_cnt(store->objs, X509_LU_CRL, nm, &cnt);
     if (idx < 0) {
         X509_STORE_unlock(store);
@@ -709,7 +781,8 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
 
     /* Else find index of first cert accepted by 'check_issued' */
     ret = 0;
-    X509_STORE_lock(store);
+    if (!x509_store_read_lock(store))
+        return -1;
     idx = X509_OBJECT_idx_by_subject(store->objs, X509_LU_X509, xn);
     if (idx != -1) {            /* should be true as we've had at least one
                                  * match */
@@ -746,28 +819,45 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
 
 int X509_STORE_set_flags(X509_STORE *ctx, unsigned long flags)
 {
-    return X509_VERIFY_PARAM_set_flags(ctx->param, flags);
+    int ret = X509_VERIFY_PARAM_set_flags(ctx->param, flags);
+
+    if (ret)
+        x509_store_modified(ctx);
+    return ret;
 }
 
 int X509_STORE_set_depth(X509_STORE *ctx, int depth)
 {
     X509_VERIFY_PARAM_set_depth(ctx->param, depth);
+    x509_store_modified(ctx);
     return 1;
 }
 
 int X509_STORE_set_purpose(X509_STORE *ctx, int purpose)
 {
-    return X509_VERIFY_PARAM_set_purpose(ctx->param, purpose);
+    int ret = X509_VERIFY_PARAM_set_purpose(ctx->param, purpose);
+
+    if (ret)
+        x509_store_modified(ctx);
+    return ret;
 }
 
 int X509_STORE_set_trust(X509_STORE *ctx, int trust)
 {
-    return X509_VERIFY_PARAM_set_trust(ctx->param, trust);
+    int ret = X509_VERIFY_PARAM_set_trust(ctx->param, trust);
+
+    if (ret)
+        x509_store_modified(ctx);
+    return ret;
 }
 
 int X509_STORE_set1_param(X509_STORE *ctx, X509_VERIFY_PARAM *param)
 {
-    return X509_VERIFY_PARAM_set1(ctx->param, param);
+    int ret = X509_VERIFY_PARAM_set1(ctx->param, param);
+
+    if (ret)
+        x509_store_modified(ctx);
+    return ret;
 }
 
 X509_VERIFY_PARAM *X509_STORE_get0_param(X509_STORE *ctx)
@@ -778,6 +868,7 @@ X509_VERIFY_PARAM *X509_STORE_get0_param(X509_STORE *ctx)
 void X509_STORE_set_verify(X509_STORE *ctx, X509_STORE_CTX_verify_fn verify)
 {
     ctx->verify = verify;
+    x509_store_modified(ctx);
 }
 
 X509_STORE_CTX_verify_fn X509_STORE_get_verify(X509_STORE *ctx)
@@ -800,6 +891,7 @@ void X509_STORE_set_get_issuer(X509_STORE *ctx,
                                X509_STORE_CTX_get_issuer_fn get_issuer)
 {
     ctx->get_issuer = get_issuer;
+    x509_store_modified(ctx);
 }
 
 X509_STORE_CTX_get_issuer_fn X509_STORE_get_get_issuer(X509_STORE *ctx)
@@ -811,6 +903,7 @@ void X509_STORE_set_check_issued(X509_STORE *ctx,
                                  X509_STORE_CTX_check_issued_fn check_issued)
 {
     ctx->check_issued = check_issued;
+    x509_store_modified(ctx);
 }
 
 X509_STORE_CTX_check_issued_fn X509_STORE_get_check_issued(X509_STORE *ctx)
@@ -877,6 +970,7 @@ void X509_STORE_set_lookup_certs(X509_STORE *ctx,
                                  X509_STORE_CTX_lookup_certs_fn lookup_certs)
 {
     ctx->lookup_certs = lookup_certs;
+    x509_store_modified(ctx);
 }
 
 X509_STORE_CTX_lookup_certs_fn X509_STORE_get_lookup_certs(X509_STORE *ctx)
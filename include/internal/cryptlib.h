@@ -153,7 +153,9 @@ typedef struct ossl_ex_data_global_st {
 # define OPENSSL_CTX_RAND_CRNGT_INDEX               7
 # define OPENSSL_CTX_THREAD_EVENT_HANDLER_INDEX     8
 # define OPENSSL_CTX_FIPS_PROV_INDEX                9
-# define OPENSSL_CTX_MAX_INDEXES                   10
+# define OPENSSL_CTX_PROPERTY_QUERY_INDEX          10
+# define OPENSSL_CTX_FETCH_CACHE_LIST_INDEX        11
+# define OPENSSL_CTX_MAX_INDEXES                   12
 
 typedef struct openssl_ctx_method {
     void *(*new_func)(OPENSSL_CTX *ctx);
@@ -174,6 +176,10 @@ typedef void (openssl_ctx_onfree_fn)(OPENSSL_CTX *ctx);
 int openssl_ctx_run_once(OPENSSL_CTX *ctx, unsigned int idx,
                          openssl_ctx_run_once_fn run_once_fn);
 int openssl_ctx_onfree(OPENSSL_CTX *ctx, openssl_ctx_onfree_fn onfreefn);
+int openssl_ctx_get_method_generation(OPENSSL_CTX *ctx);
+void openssl_ctx_new_method_generation(OPENSSL_CTX *ctx);
+void *openssl_ctx_get_fetch_cache(OPENSSL_CTX *ctx);
+int openssl_ctx_set_fetch_cache(OPENSSL_CTX *ctx, void *cache);
 
 OPENSSL_CTX *crypto_ex_data_get_openssl_ctx(const CRYPTO_EX_DATA *ad);
 int crypto_new_ex_data_ex(OPENSSL_CTX *ctx, int class_index, void *obj,
@@ -1,5 +1,5 @@
 /*
- * Copyright 2018 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2018-2019 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -49,6 +49,13 @@ struct tls12_crypto_info_aes_gcm_128 {
     unsigned char rec_seq[TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE];
 };
 
+struct tls_crypto_info_all {
+    union {
+        struct tls12_crypto_info_aes_gcm_128 gcm128;
+    } u;
+    size_t tls_crypto_info_len;
+};
+
 /* Dummy functions here */
 static ossl_inline int ktls_enable(int fd)
 {
@@ -56,8 +63,8 @@ static ossl_inline int ktls_enable(int fd)
 }
 
 static ossl_inline int ktls_start(int fd,
-                                  struct tls12_crypto_info_aes_gcm_128
-                                  *crypto_info, size_t len, int is_tx)
+                                  struct tls_crypto_info_all *crypto_info,
+                                  int is_tx)
 {
     return 0;
 }
@@ -100,6 +107,32 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off, size_t s
 #     define TLS_RX                  2
 #    endif
 
+/*
+ * The set of record protection schemes the kernel can offload grew after
+ * the initial AES-128-GCM/TLSv1.2 support.  Only advertise what the
+ * headers we are built against can describe.
+ */
+#    if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 1, 0)
+#     define OPENSSL_KTLS_AES_GCM_256
+#     define OPENSSL_KTLS_TLS13
+#    endif
+#    if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+#     define OPENSSL_KTLS_CHACHA20_POLY1305
+#    endif
+
+struct tls_crypto_info_all {
+    union {
+        struct tls12_crypto_info_aes_gcm_128 gcm128;
+#    ifdef OPENSSL_KTLS_AES_GCM_256
+        struct tls12_crypto_info_aes_gcm_256 gcm256;
+#    endif
+#    ifdef OPENSSL_KTLS_CHACHA20_POLY1305
+        struct tls12_crypto_info_chacha20_poly1305 chacha20poly1305;
+#    endif
+    } u;
+    size_t tls_crypto_info_len;
+};
+
 /*
  * When successful, this socket option doesn't change the behaviour of the
  * TCP socket, except changing the TCP setsockopt handler to enable the
@@ -120,11 +153,12 @@ static ossl_inline int ktls_enable(int fd)
  * authenticated and decapsulated using the crypto_info provided here.
  */
 static ossl_inline int ktls_start(int fd,
-                                  struct tls12_crypto_info_aes_gcm_128
-                                  *crypto_info, size_t len, int is_tx)
+                                  struct tls_crypto_info_all *crypto_info,
+                                  int is_tx)
 {
     return setsockopt(fd, SOL_TLS, is_tx ? TLS_TX : TLS_RX,
-                      crypto_info, sizeof(*crypto_info)) ? 0 : 1;
+                      &crypto_info->u, crypto_info->tls_crypto_info_len)
+           ? 0 : 1;
 }
 
 /*
@@ -193,6 +227,12 @@ static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
  * The kernel strips the TLS record header, IV and authentication tag,
  * returning only the plaintext data or an error on failure.
  * We add the TLS record header here to satisfy routines in rec_layer_s3.c
+ *
+ * The kernel reports the content type of each record in a TLS_GET_RECORD_TYPE
+ * control message and never merges records of different types into one read,
+ * so alerts and post-handshake messages come back one record at a time and
+ * can be fed to the state machine without leaving the kernel data-path.
+ * If we cannot tell what the record was we fail with EPROTO.
  */
 static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
 {
@@ -205,6 +245,7 @@ static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
     struct iovec msg_iov;
     int ret;
     unsigned char *p = data;
+    unsigned char record_type;
     const size_t prepend_length = SSL3_RT_HEADER_LENGTH;
 
     if (length < prepend_length + EVP_GCM_TLS_TAG_LEN) {
@@ -222,22 +263,37 @@ static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
     msg.msg_iovlen = 1;
 
     ret = recvmsg(fd, &msg, 0);
-    if (ret < 0)
+    if (ret <= 0)
         return ret;
 
-    if (msg.msg_controllen > 0) {
-        cmsg = CMSG_FIRSTHDR(&msg);
-        if (cmsg->cmsg_type == TLS_GET_RECORD_TYPE) {
-            p[0] = *((unsigned char *)CMSG_DATA(cmsg));
-            p[1] = TLS1_2_VERSION_MAJOR;
-            p[2] = TLS1_2_VERSION_MINOR;
-            /* returned length is limited to msg_iov.iov_len above */
-            p[3] = (ret >> 8) & 0xff;
-            p[4] = ret & 0xff;
-            ret += prepend_length;
-        }
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if ((msg.msg_flags & MSG_CTRUNC) != 0
+            || cmsg == NULL
+            || cmsg->cmsg_level != SOL_TLS
+            || cmsg->cmsg_type != TLS_GET_RECORD_TYPE) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    record_type = *((unsigned char *)CMSG_DATA(cmsg));
+    switch (record_type) {
+    case SSL3_RT_APPLICATION_DATA:
+    case SSL3_RT_ALERT:
+    case SSL3_RT_HANDSHAKE:
+        break;
+    default:
+        errno = EPROTO;
+        return -1;
     }
 
+    p[0] = record_type;
+    p[1] = TLS1_2_VERSION_MAJOR;
+    p[2] = TLS1_2_VERSION_MINOR;
+    /* returned length is limited to msg_iov.iov_len above */
+    p[3] = (ret >> 8) & 0xff;
+    p[4] = ret & 0xff;
+    ret += prepend_length;
+
     return ret;
 }
 
@@ -14,6 +14,7 @@
 #include "internal/cryptlib.h"
 
 typedef struct ossl_method_store_st OSSL_METHOD_STORE;
+typedef struct ossl_property_query_st OSSL_PROPERTY_QUERY;
 
 /* Initialisation */
 int ossl_property_parse_init(OPENSSL_CTX *ctx);
@@ -29,9 +30,16 @@ int ossl_method_store_remove(OSSL_METHOD_STORE *store, int nid,
                              const void *method);
 int ossl_method_store_fetch(OSSL_METHOD_STORE *store, int nid,
                             const char *prop_query, void **result);
+int ossl_method_store_fetch_query(OSSL_METHOD_STORE *store, int nid,
+                                  const OSSL_PROPERTY_QUERY *query,
+                                  void **result);
 int ossl_method_store_set_global_properties(OSSL_METHOD_STORE *store,
                                             const char *prop_query);
 
+/* Compiled property query functions */
+const OSSL_PROPERTY_QUERY *ossl_property_query_get(OPENSSL_CTX *ctx,
+                                                   const char *prop_query);
+
 /* property query cache functions */
 int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, int nid,
                                 const char *prop_query, void **result);
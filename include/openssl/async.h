@@ -31,6 +31,7 @@ extern "C" {
 
 typedef struct async_job_st ASYNC_JOB;
 typedef struct async_wait_ctx_st ASYNC_WAIT_CTX;
+typedef struct async_wait_queue_st ASYNC_WAIT_QUEUE;
 typedef int (*ASYNC_callback_fn)(void *arg);
 
 #define ASYNC_ERR      0
@@ -44,6 +45,7 @@ typedef int (*ASYNC_callback_fn)(void *arg);
 #define ASYNC_STATUS_EAGAIN         3
 
 int ASYNC_init_thread(size_t max_size, size_t init_size);
+int ASYNC_init_thread_ex(size_t max_size, size_t init_size, size_t stack_size);
 void ASYNC_cleanup_thread(void);
 
 #ifdef OSSL_ASYNC_FD
@@ -70,6 +72,16 @@ int ASYNC_WAIT_CTX_get_changed_fds(ASYNC_WAIT_CTX *ctx, OSSL_ASYNC_FD *addfd,
                                    size_t *numaddfds, OSSL_ASYNC_FD *delfd,
                                    size_t *numdelfds);
 int ASYNC_WAIT_CTX_clear_fd(ASYNC_WAIT_CTX *ctx, const void *key);
+int ASYNC_WAIT_CTX_set_queue(ASYNC_WAIT_CTX *ctx, ASYNC_WAIT_QUEUE *queue,
+                             void *done_arg);
+int ASYNC_WAIT_CTX_complete(ASYNC_WAIT_CTX **ctxs, size_t numctxs);
+
+ASYNC_WAIT_QUEUE *ASYNC_WAIT_QUEUE_new(void);
+void ASYNC_WAIT_QUEUE_free(ASYNC_WAIT_QUEUE *queue);
+int ASYNC_WAIT_QUEUE_set_notify(ASYNC_WAIT_QUEUE *queue,
+                                ASYNC_callback_fn notify, void *notify_arg);
+size_t ASYNC_WAIT_QUEUE_drain(ASYNC_WAIT_QUEUE *queue, void **done,
+                              size_t max);
 #endif
 
 int ASYNC_is_capable(void);
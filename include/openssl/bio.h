@@ -55,6 +55,7 @@ extern "C" {
 # ifndef OPENSSL_NO_SCTP
 #  define BIO_TYPE_DGRAM_SCTP    (24|BIO_TYPE_SOURCE_SINK|BIO_TYPE_DESCRIPTOR)
 # endif
+# define BIO_TYPE_DGRAM_DEMUX     (25|BIO_TYPE_SOURCE_SINK)
 
 #define BIO_TYPE_START           128
 
@@ -154,6 +155,9 @@ extern "C" {
 # define BIO_CTRL_DGRAM_SCTP_WAIT_FOR_DRY       77
 # define BIO_CTRL_DGRAM_SCTP_MSG_WAITING        78
 
+# define BIO_CTRL_DGRAM_SET_RECV_BATCH          79
+# define BIO_CTRL_DGRAM_SET_SEND_BATCH          80
+
 # ifndef OPENSSL_NO_KTLS
 #  define BIO_get_ktls_send(b)         \
      (BIO_method_type(b) == BIO_TYPE_SOCKET \
@@ -547,6 +551,10 @@ int BIO_ctrl_reset_read_request(BIO *b);
          (int)BIO_ctrl(b, BIO_CTRL_DGRAM_SET_PEER, 0, (char *)(peer))
 # define BIO_dgram_get_mtu_overhead(b) \
          (unsigned int)BIO_ctrl((b), BIO_CTRL_DGRAM_GET_MTU_OVERHEAD, 0, NULL)
+# define BIO_dgram_set_recv_batch(b, n) \
+         (int)BIO_ctrl((b), BIO_CTRL_DGRAM_SET_RECV_BATCH, (n), NULL)
+# define BIO_dgram_set_send_batch(b, n) \
+         (int)BIO_ctrl((b), BIO_CTRL_DGRAM_SET_SEND_BATCH, (n), NULL)
 
 #define BIO_get_ex_new_index(l, p, newf, dupf, freef) \
     CRYPTO_get_ex_new_index(CRYPTO_EX_INDEX_BIO, l, p, newf, dupf, freef)
@@ -55,6 +55,11 @@ extern "C" {
 #define OSSL_CIPHER_PARAM_AEAD_TLS1_IV_FIXED "tlsivfixed" /* octet_string */
 #define OSSL_CIPHER_PARAM_AEAD_IVLEN OSSL_CIPHER_PARAM_IVLEN
 #define OSSL_CIPHER_PARAM_RANDOM_KEY         "randkey"    /* octet_string */
+#define OSSL_CIPHER_PARAM_SPEED              "speed"      /* uint */
+/* Arrays of one element per pipelined record */
+#define OSSL_CIPHER_PARAM_PIPELINE_OUTPUT_BUFS "pipeoutbufs" /* octet_string */
+#define OSSL_CIPHER_PARAM_PIPELINE_INPUT_BUFS  "pipeinbufs"  /* octet_string */
+#define OSSL_CIPHER_PARAM_PIPELINE_INPUT_LENS  "pipeinlens"  /* octet_string */
 
 /* digest parameters */
 #define OSSL_DIGEST_PARAM_XOFLEN     "xoflen"    /* size_t */
@@ -983,6 +983,25 @@ void EC_KEY_set_asn1_flag(EC_KEY *eckey, int asn1_flag);
  */
 int EC_KEY_precompute_mult(EC_KEY *key, BN_CTX *ctx);
 
+/** Makes signature verification with the public key build a table of
+ *  pre-computed multiples of it once the key has been used a number of
+ *  times, and use the table from then on.  This must not be called while
+ *  other threads are verifying with the key, because a \p uses of 0 frees
+ *  the table.
+ *  \param  key   EC_KEY object
+ *  \param  uses  number of uses after which the table is built, or 0 to
+ *                never build one
+ *  \return 1 on success and 0 if an error occurred.
+ */
+int EC_KEY_set_precompute_pub(EC_KEY *key, int uses);
+
+/** Returns the number of uses after which a table of pre-computed multiples
+ *  of the public key is built.
+ *  \param  key  EC_KEY object
+ *  \return the number of uses, or 0 if no table is built.
+ */
+int EC_KEY_get_precompute_pub(const EC_KEY *key);
+
 /** Creates a new ec private (and optional a new public) key.
  *  \param  key  EC_KEY object
  *  \return 1 on success and 0 if an error occurred.
@@ -1318,6 +1337,24 @@ int ECDSA_sign_ex(int type, const unsigned char *dgst, int dgstlen,
 int ECDSA_verify(int type, const unsigned char *dgst, int dgstlen,
                  const unsigned char *sig, int siglen, EC_KEY *eckey);
 
+/** Verifies a batch of DER encoded ECDSA signatures, each of a hash value
+ *  with its own public key.  Signatures made with keys on the same curve
+ *  share the costly inversions.
+ *  \param  num      number of signatures
+ *  \param  dgst     array of pointers to the hash values
+ *  \param  dgstlen  array of lengths of the hash values
+ *  \param  sig      array of pointers to the DER encoded signatures
+ *  \param  siglen   array of lengths of the DER encoded signatures
+ *  \param  eckey    array of EC_KEY objects containing public EC keys
+ *  \param  results  array receiving, for each signature, 1 if it is valid,
+ *                   0 if it is invalid and -1 on error
+ *  \return 1 if all signatures are valid and 0 otherwise
+ */
+int ECDSA_verify_batch(size_t num, const unsigned char *const dgst[],
+                       const size_t dgstlen[], const unsigned char *const sig[],
+                       const size_t siglen[], EC_KEY *const eckey[],
+                       int results[]);
+
 /** Returns the maximum length of the DER encoded signature
  *  \param  eckey  EC_KEY object
  *  \return numbers of bytes required for the DER encoded signature
@@ -106,6 +106,11 @@ int RAND_DRBG_set_reseed_defaults(
                                   time_t slave_reseed_time_interval
                                   );
 
+int RAND_DRBG_set_buffer_size(RAND_DRBG *drbg, size_t size);
+size_t RAND_DRBG_get_buffer_size(const RAND_DRBG *drbg);
+int RAND_DRBG_set_buffer_defaults(size_t public_buffer_size,
+                                  size_t private_buffer_size);
+
 RAND_DRBG *OPENSSL_CTX_get0_master_drbg(OPENSSL_CTX *ctx);
 RAND_DRBG *OPENSSL_CTX_get0_public_drbg(OPENSSL_CTX *ctx);
 RAND_DRBG *OPENSSL_CTX_get0_private_drbg(OPENSSL_CTX *ctx);
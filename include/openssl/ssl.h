@@ -1317,6 +1317,8 @@ DECLARE_PEM_rw(SSL_SESSION, SSL_SESSION)
 # define SSL_CTRL_GET_SIGNATURE_NID              132
 # define SSL_CTRL_GET_TMP_KEY                    133
 # define SSL_CTRL_GET_NEGOTIATED_GROUP           134
+# define SSL_CTRL_SET_SESS_CACHE_SHARDS          135
+# define SSL_CTRL_GET_SESS_CACHE_SHARDS          136
 # define SSL_CERT_SET_FIRST                      1
 # define SSL_CERT_SET_NEXT                       2
 # define SSL_CERT_SET_SERVER                     3
@@ -1863,6 +1865,23 @@ __owur ossl_ssize_t SSL_sendfile(SSL *s, int fd, off_t offset, size_t size,
                                  int flags);
 __owur int SSL_write(SSL *ssl, const void *buf, int num);
 __owur int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written);
+
+/*
+ * One record's worth of application data for SSL_write_iov(). The caller
+ * owns SSL_WRITE_IOV_HEADROOM bytes before |data| and SSL_WRITE_IOV_TAILROOM
+ * bytes after |data| + |len|, into which the record is sealed in place.
+ */
+typedef struct ssl_iovec_st {
+    unsigned char *data;
+    size_t len;
+} SSL_IOVEC;
+
+# define SSL_WRITE_IOV_HEADROOM \
+                        (SSL3_RT_HEADER_LENGTH + SSL_RT_MAX_CIPHER_BLOCK_SIZE)
+# define SSL_WRITE_IOV_TAILROOM SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD
+
+__owur int SSL_write_iov(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                         size_t *written);
 __owur int SSL_write_early_data(SSL *s, const void *buf, size_t num,
                                 size_t *written);
 long SSL_ctrl(SSL *ssl, int cmd, long larg, void *parg);
@@ -2053,6 +2072,10 @@ __owur int SSL_get_ex_data_X509_STORE_CTX_idx(void);
         SSL_CTX_ctrl(ctx,SSL_CTRL_SET_SESS_CACHE_SIZE,t,NULL)
 # define SSL_CTX_sess_get_cache_size(ctx) \
         SSL_CTX_ctrl(ctx,SSL_CTRL_GET_SESS_CACHE_SIZE,0,NULL)
+# define SSL_CTX_sess_set_cache_shards(ctx,n) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_SET_SESS_CACHE_SHARDS,n,NULL)
+# define SSL_CTX_sess_get_cache_shards(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_GET_SESS_CACHE_SHARDS,0,NULL)
 # define SSL_CTX_set_session_cache_mode(ctx,m) \
         SSL_CTX_ctrl(ctx,SSL_CTRL_SET_SESS_CACHE_MODE,m,NULL)
 # define SSL_CTX_get_session_cache_mode(ctx) \
@@ -2088,6 +2111,8 @@ __owur int SSL_get_ex_data_X509_STORE_CTX_idx(void);
 
 void SSL_CTX_set_default_read_buffer_len(SSL_CTX *ctx, size_t len);
 void SSL_set_default_read_buffer_len(SSL *s, size_t len);
+__owur int SSL_CTX_set_buffer_pool_size(SSL_CTX *ctx, size_t max_idle);
+size_t SSL_CTX_get_buffer_pool_size(const SSL_CTX *ctx);
 
 # ifndef OPENSSL_NO_DH
 /* NB: the |keylength| is only applicable when is_export is true */
@@ -2192,6 +2217,16 @@ void SSL_trace(int write_p, int version, int content_type,
 
 # ifndef OPENSSL_NO_SOCK
 int DTLSv1_listen(SSL *s, BIO_ADDR *client);
+
+/* Serves many DTLS sessions over one unconnected datagram BIO */
+typedef struct dtls_demux_st DTLS_DEMUX;
+
+DTLS_DEMUX *DTLS_DEMUX_new(SSL_CTX *ctx, BIO *bio);
+void DTLS_DEMUX_free(DTLS_DEMUX *dm);
+int DTLS_DEMUX_recv(DTLS_DEMUX *dm);
+SSL *DTLS_DEMUX_accept(DTLS_DEMUX *dm);
+SSL *DTLS_DEMUX_get_readable(DTLS_DEMUX *dm);
+int DTLS_DEMUX_flush(DTLS_DEMUX *dm);
 # endif
 
 # ifndef OPENSSL_NO_CT
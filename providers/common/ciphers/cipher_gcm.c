@@ -20,6 +20,9 @@ static int gcm_tls_iv_set_fixed(PROV_GCM_CTX *ctx, unsigned char *iv,
                                 size_t len);
 static int gcm_tls_cipher(PROV_GCM_CTX *ctx, unsigned char *out, size_t *padlen,
                           const unsigned char *in, size_t len);
+static int gcm_tls_cipher_pipeline(PROV_GCM_CTX *ctx, size_t *padlen);
+static int gcm_set_pipeline(PROV_GCM_CTX *ctx, const OSSL_PARAM *p, void *arr,
+                            size_t elemsz, unsigned int which);
 static int gcm_cipher_internal(PROV_GCM_CTX *ctx, unsigned char *out,
                                size_t *padlen, const unsigned char *in,
                                size_t len);
@@ -49,6 +52,9 @@ static int gcm_init(void *vctx, const unsigned char *key, size_t keylen,
     PROV_GCM_CTX *ctx = (PROV_GCM_CTX *)vctx;
 
     ctx->enc = enc;
+    ctx->numpipes = 0;
+    ctx->pipes_set = 0;
+    ctx->tls_aad_count = 0;
 
     if (iv != NULL) {
         if (ivlen < ctx->ivlen_min || ivlen > sizeof(ctx->iv)) {
@@ -196,6 +202,28 @@ int gcm_set_ctx_params(void *vctx, const OSSL_PARAM params[])
         }
     }
 
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_PIPELINE_OUTPUT_BUFS);
+    if (p != NULL
+        && !gcm_set_pipeline(ctx, p, ctx->pipe_out, sizeof(ctx->pipe_out[0]),
+                             GCM_PIPE_OUT)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_PIPELINE_INPUT_BUFS);
+    if (p != NULL
+        && !gcm_set_pipeline(ctx, p, ctx->pipe_in, sizeof(ctx->pipe_in[0]),
+                             GCM_PIPE_IN)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_PIPELINE_INPUT_LENS);
+    if (p != NULL
+        && !gcm_set_pipeline(ctx, p, ctx->pipe_len, sizeof(ctx->pipe_len[0]),
+                             GCM_PIPE_LENS)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+        return 0;
+    }
+
     /*
      * TODO(3.0) Temporary solution to address fuzz test crash, which will be
      * reworked once the discussion in PR #9510 is resolved. i.e- We need a
@@ -299,8 +327,11 @@ static int gcm_cipher_internal(PROV_GCM_CTX *ctx, unsigned char *out,
     int rv = 0;
     const PROV_GCM_HW *hw = ctx->hw;
 
-    if (ctx->tls_aad_len != UNINITIALISED_SIZET)
+    if (ctx->tls_aad_len != UNINITIALISED_SIZET) {
+        if (ctx->pipes_set != 0)
+            return gcm_tls_cipher_pipeline(ctx, padlen);
         return gcm_tls_cipher(ctx, out, padlen, in, len);
+    }
 
     if (!ctx->key_set || ctx->iv_state == IV_STATE_FINISHED)
         goto err;
@@ -375,6 +406,11 @@ static int gcm_tls_init(PROV_GCM_CTX *dat, unsigned char *aad, size_t aad_len)
     }
     buf[aad_len - 2] = (unsigned char)(len >> 8);
     buf[aad_len - 1] = (unsigned char)(len & 0xff);
+
+    /* Each pipelined record has its own AAD, keep them in order */
+    if (dat->tls_aad_count >= GCM_MAX_PIPELINES)
+        return 0;
+    memcpy(dat->tls_aad[dat->tls_aad_count++], buf, aad_len);
     /* Extra padding: tag appended to record. */
     return EVP_GCM_TLS_TAG_LEN;
 }
@@ -496,6 +532,95 @@ static int gcm_tls_cipher(PROV_GCM_CTX *ctx, unsigned char *out, size_t *padlen,
 err:
     ctx->iv_state = IV_STATE_FINISHED;
     ctx->tls_aad_len = UNINITIALISED_SIZET;
+    ctx->tls_aad_count = 0;
     *padlen = plen;
     return rv;
 }
+
+static int gcm_set_pipeline(PROV_GCM_CTX *ctx, const OSSL_PARAM *p, void *arr,
+                            size_t elemsz, unsigned int which)
+{
+    size_t n;
+
+    if (p->data_type != OSSL_PARAM_OCTET_STRING
+        || p->data == NULL
+        || p->data_size % elemsz != 0)
+        return 0;
+    n = p->data_size / elemsz;
+    if (n == 0 || n > GCM_MAX_PIPELINES
+        || (ctx->pipes_set != 0 && n != ctx->numpipes))
+        return 0;
+    memcpy(arr, p->data, p->data_size);
+    ctx->numpipes = n;
+    ctx->pipes_set |= which;
+    return 1;
+}
+
+/*
+ * Handle a set of pipelined TLS records.  Each record has the same layout as
+ * in gcm_tls_cipher() and its own AAD, queued by gcm_tls_init() in record
+ * order.  The records share the key, so they are handed to the hardware
+ * specific code in one call, which processes them one after another.
+ */
+static int gcm_tls_cipher_pipeline(PROV_GCM_CTX *ctx, size_t *padlen)
+{
+    PROV_GCM_RECORD recs[GCM_MAX_PIPELINES];
+    const size_t arg = EVP_GCM_TLS_EXPLICIT_IV_LEN;
+    size_t i, n = ctx->numpipes;
+    int rv = 0;
+
+    if (!ctx->key_set
+        || ctx->iv_gen == 0
+        || ctx->pipes_set != GCM_PIPE_ALL
+        || ctx->tls_aad_count != n
+        || ctx->ivlen != GCM_IV_DEFAULT_SIZE)
+        goto err;
+
+    for (i = 0; i < n; i++) {
+        PROV_GCM_RECORD *rec = &recs[i];
+        unsigned char *out = ctx->pipe_out[i];
+        const unsigned char *in = ctx->pipe_in[i];
+        size_t len = ctx->pipe_len[i];
+
+        /* Encrypt/decrypt must be performed in place */
+        if (out != in || len < (arg + EVP_GCM_TLS_TAG_LEN))
+            goto err;
+
+        /* See gcm_tls_cipher() */
+        if (ctx->enc && ++ctx->tls_enc_records == 0) {
+            ERR_raise(ERR_LIB_PROV, EVP_R_TOO_MANY_RECORDS);
+            goto err;
+        }
+
+        if (ctx->enc) {
+            memcpy(rec->iv, ctx->iv, ctx->ivlen);
+            memcpy(out, ctx->iv + ctx->ivlen - arg, arg);
+            ctr64_inc(ctx->iv + ctx->ivlen - 8);
+        } else {
+            memcpy(rec->iv, ctx->iv, ctx->ivlen - arg);
+            memcpy(rec->iv + ctx->ivlen - arg, in, arg);
+        }
+        rec->aad = ctx->tls_aad[i];
+        rec->aad_len = EVP_AEAD_TLS1_AAD_LEN;
+        rec->in = in + arg;
+        rec->out = out + arg;
+        rec->len = len - arg - EVP_GCM_TLS_TAG_LEN;
+        rec->tag = rec->out + rec->len;
+    }
+
+    if (!gcm_one_shot_batch(ctx, recs, n)) {
+        if (!ctx->enc)
+            for (i = 0; i < n; i++)
+                OPENSSL_cleanse(recs[i].out, recs[i].len);
+        goto err;
+    }
+    rv = 1;
+err:
+    ctx->iv_state = IV_STATE_FINISHED;
+    ctx->tls_aad_len = UNINITIALISED_SIZET;
+    ctx->tls_aad_count = 0;
+    ctx->numpipes = 0;
+    ctx->pipes_set = 0;
+    *padlen = 0;
+    return rv;
+}
@@ -116,3 +116,30 @@ int gcm_one_shot(PROV_GCM_CTX *ctx, unsigned char *aad, size_t aad_len,
 err:
     return ret;
 }
+
+static int gcm_one_shot_record(PROV_GCM_CTX *ctx, PROV_GCM_RECORD *rec)
+{
+    return ctx->hw->setiv(ctx, rec->iv, sizeof(rec->iv))
+           && ctx->hw->oneshot(ctx, rec->aad, rec->aad_len, rec->in, rec->len,
+                               rec->out, rec->tag, GCM_TAG_MAX_SIZE);
+}
+
+/*
+ * Encrypt or decrypt |n| independent messages under the key of |ctx|, each
+ * with a 96 bit IV and a full length tag.  Returns 1 only if every message was
+ * processed (and, when decrypting, authenticated) successfully.
+ *
+ * The messages are processed one after another, each through the hardware's
+ * one-shot function, so each gets the stitched AES-GCM code where there is
+ * one.  They are not interleaved with each other.
+ */
+int gcm_one_shot_batch(PROV_GCM_CTX *ctx, PROV_GCM_RECORD *recs, size_t n)
+{
+    size_t i;
+    int ret = 1;
+
+    for (i = 0; i < n; i++)
+        if (!gcm_one_shot_record(ctx, &recs[i]))
+            ret = 0;
+    return ret;
+}
@@ -16,6 +16,12 @@ typedef struct prov_gcm_hw_st PROV_GCM_HW;
 #define GCM_IV_DEFAULT_SIZE 12 /* IV's for AES_GCM should normally be 12 bytes */
 #define GCM_IV_MAX_SIZE     64
 #define GCM_TAG_MAX_SIZE    16
+#define GCM_MAX_PIPELINES   32 /* Same as SSL_MAX_PIPELINES */
+
+#define GCM_PIPE_OUT        0x01
+#define GCM_PIPE_IN         0x02
+#define GCM_PIPE_LENS       0x04
+#define GCM_PIPE_ALL        (GCM_PIPE_OUT | GCM_PIPE_IN | GCM_PIPE_LENS)
 
 #if defined(OPENSSL_CPUID_OBJ) && defined(__s390__)
 /*-
@@ -72,6 +78,18 @@ typedef struct prov_gcm_ctx_st {
     unsigned char iv[GCM_IV_MAX_SIZE]; /* Buffer to use for IV's */
     unsigned char buf[AES_BLOCK_SIZE]; /* Buffer of partial blocks processed via update calls */
 
+    /*
+     * Pipelined TLS records: one AAD is queued per record and the buffers
+     * are passed in as arrays before the next cipher call.
+     */
+    size_t numpipes;
+    unsigned int pipes_set;     /* Set of GCM_PIPE_XXX arrays supplied */
+    size_t tls_aad_count;
+    unsigned char *pipe_out[GCM_MAX_PIPELINES];
+    const unsigned char *pipe_in[GCM_MAX_PIPELINES];
+    size_t pipe_len[GCM_MAX_PIPELINES];
+    unsigned char tls_aad[GCM_MAX_PIPELINES][EVP_AEAD_TLS1_AAD_LEN];
+
     OPENSSL_CTX *libctx;    /* needed for rand calls */
     const PROV_GCM_HW *hw;  /* hardware specific methods */
     GCM128_CONTEXT gcm;
@@ -108,6 +126,17 @@ typedef struct prov_aes_gcm_ctx_st {
     } plat;
 } PROV_AES_GCM_CTX;
 
+/* One message of a batch processed under a single key */
+typedef struct prov_gcm_record_st {
+    unsigned char iv[GCM_IV_DEFAULT_SIZE];
+    unsigned char *aad;
+    size_t aad_len;
+    const unsigned char *in;
+    unsigned char *out;
+    size_t len;
+    unsigned char *tag;         /* GCM_TAG_MAX_SIZE bytes */
+} PROV_GCM_RECORD;
+
 PROV_CIPHER_FUNC(int, GCM_setkey, (PROV_GCM_CTX *ctx, const unsigned char *key,
                                    size_t keylen));
 PROV_CIPHER_FUNC(int, GCM_setiv, (PROV_GCM_CTX *dat, const unsigned char *iv,
@@ -152,6 +181,7 @@ int gcm_one_shot(PROV_GCM_CTX *ctx, unsigned char *aad, size_t aad_len,
                  unsigned char *out, unsigned char *tag, size_t tag_len);
 int gcm_cipher_update(PROV_GCM_CTX *ctx, const unsigned char *in,
                       size_t len, unsigned char *out);
+int gcm_one_shot_batch(PROV_GCM_CTX *ctx, PROV_GCM_RECORD *recs, size_t n);
 
 #define GCM_HW_SET_KEY_CTR_FN(ks, fn_set_enc_key, fn_block, fn_ctr)            \
     ctx->ks = ks;                                                              \
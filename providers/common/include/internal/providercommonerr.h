@@ -71,5 +71,7 @@ int ERR_load_PROV_strings(void);
 # define PROV_R_TAG_NOTSET                                119
 # define PROV_R_TAG_NOT_NEEDED                            120
 # define PROV_R_WRONG_FINAL_BLOCK_LENGTH                  107
+# define PROV_R_XTS_DATA_UNIT_IS_TOO_LARGE                122
+# define PROV_R_XTS_DUPLICATED_KEYS                       123
 
 #endif
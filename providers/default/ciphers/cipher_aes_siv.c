@@ -0,0 +1,279 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* Dispatch functions for AES SIV mode */
+
+#include "cipher_aes_siv.h"
+#include "internal/ciphers/cipher_aead.h"
+#include "internal/provider_algs.h"
+#include "internal/providercommonerr.h"
+
+#define SIV_FLAGS AEAD_FLAGS
+
+static OSSL_OP_cipher_encrypt_init_fn aes_siv_einit;
+static OSSL_OP_cipher_decrypt_init_fn aes_siv_dinit;
+static OSSL_OP_cipher_update_fn aes_siv_stream_update;
+static OSSL_OP_cipher_final_fn aes_siv_stream_final;
+static OSSL_OP_cipher_cipher_fn aes_siv_cipher;
+static OSSL_OP_cipher_freectx_fn aes_siv_freectx;
+static OSSL_OP_cipher_dupctx_fn aes_siv_dupctx;
+static OSSL_OP_cipher_get_ctx_params_fn aes_siv_get_ctx_params;
+static OSSL_OP_cipher_set_ctx_params_fn aes_siv_set_ctx_params;
+static OSSL_OP_cipher_settable_ctx_params_fn aes_siv_settable_ctx_params;
+
+static void *aes_siv_newctx(void *provctx, size_t keybits, unsigned int mode)
+{
+    PROV_AES_SIV_CTX *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+    if (ctx != NULL) {
+        /* The key is two keys of |keybits| each, one for S2V and one for CTR */
+        cipher_generic_initkey(ctx, 2 * keybits, 8, 0, mode,
+                               PROV_CIPHER_HW_aes_siv(keybits), provctx);
+    }
+    return ctx;
+}
+
+static void aes_siv_freectx(void *vctx)
+{
+    PROV_AES_SIV_CTX *ctx = (PROV_AES_SIV_CTX *)vctx;
+
+    if (ctx != NULL) {
+        CRYPTO_siv128_cleanup(&ctx->siv);
+        EVP_CIPHER_free(ctx->cbc);
+        EVP_CIPHER_free(ctx->ctr);
+        OPENSSL_clear_free(ctx,  sizeof(*ctx));
+    }
+}
+
+static void *aes_siv_dupctx(void *vctx)
+{
+    PROV_AES_SIV_CTX *in = (PROV_AES_SIV_CTX *)vctx;
+    PROV_AES_SIV_CTX *ret = OPENSSL_malloc(sizeof(*ret));
+
+    if (ret == NULL) {
+        ERR_raise(ERR_LIB_PROV, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    *ret = *in;
+    ret->siv.cipher_ctx = NULL;
+    ret->siv.mac_ctx_init = NULL;
+    ret->siv.mac = NULL;
+    ret->cbc = NULL;
+    ret->ctr = NULL;
+    if (in->cbc != NULL && EVP_CIPHER_up_ref(in->cbc))
+        ret->cbc = in->cbc;
+    if (in->ctr != NULL && EVP_CIPHER_up_ref(in->ctr))
+        ret->ctr = in->ctr;
+    if (in->key_set) {
+        if ((ret->siv.cipher_ctx = EVP_CIPHER_CTX_new()) == NULL
+            || !EVP_MAC_up_ref(in->siv.mac)) {
+            aes_siv_freectx(ret);
+            return NULL;
+        }
+        ret->siv.mac = in->siv.mac;
+        if (!CRYPTO_siv128_copy_ctx(&ret->siv, &in->siv)) {
+            aes_siv_freectx(ret);
+            return NULL;
+        }
+    }
+    return ret;
+}
+
+static int aes_siv_init(void *vctx, const unsigned char *key, size_t keylen,
+                        const unsigned char *iv, size_t ivlen, int enc)
+{
+    PROV_AES_SIV_CTX *ctx = (PROV_AES_SIV_CTX *)vctx;
+
+    ctx->base.enc = enc;
+
+    if (key != NULL) {
+        if (keylen != ctx->base.keylen) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_INVALID_KEYLEN);
+            return 0;
+        }
+        return ctx->base.hw->init(&ctx->base, key, keylen);
+    }
+    return 1;
+}
+
+static int aes_siv_einit(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen)
+{
+    return aes_siv_init(vctx, key, keylen, iv, ivlen, 1);
+}
+
+static int aes_siv_dinit(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen)
+{
+    return aes_siv_init(vctx, key, keylen, iv, ivlen, 0);
+}
+
+static int aes_siv_cipher(void *vctx, unsigned char *out, size_t *outl,
+                          size_t outsize, const unsigned char *in, size_t inl)
+{
+    PROV_AES_SIV_CTX *ctx = (PROV_AES_SIV_CTX *)vctx;
+
+    if (inl == 0) {
+        *outl = 0;
+        return 1;
+    }
+
+    if (outsize < inl) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+
+    if (!ctx->key_set || !ctx->base.hw->cipher(&ctx->base, out, in, inl)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_CIPHER_OPERATION_FAILED);
+        return 0;
+    }
+
+    *outl = inl;
+    return 1;
+}
+
+static int aes_siv_stream_update(void *vctx, unsigned char *out, size_t *outl,
+                                 size_t outsize, const unsigned char *in,
+                                 size_t inl)
+{
+    return aes_siv_cipher(vctx, out, outl, outsize, in, inl);
+}
+
+static int aes_siv_stream_final(void *vctx, unsigned char *out, size_t *outl,
+                                size_t outsize)
+{
+    PROV_AES_SIV_CTX *ctx = (PROV_AES_SIV_CTX *)vctx;
+
+    if (!ctx->key_set || !ctx->base.hw->cipher(&ctx->base, out, NULL, 0))
+        return 0;
+
+    *outl = 0;
+    return 1;
+}
+
+static int aes_siv_get_ctx_params(void *vctx, OSSL_PARAM params[])
+{
+    PROV_AES_SIV_CTX *ctx = (PROV_AES_SIV_CTX *)vctx;
+    OSSL_PARAM *p;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL && p->data_type == OSSL_PARAM_OCTET_STRING) {
+        if (!ctx->base.enc
+            || p->data_size != SIV_LEN
+            || !CRYPTO_siv128_get_tag(&ctx->siv, p->data, p->data_size)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_SET_PARAMETER);
+            return 0;
+        }
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_IVLEN);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, ctx->base.ivlen)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, ctx->base.keylen)) {
+        ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    return 1;
+}
+
+static const OSSL_PARAM aes_siv_known_settable_ctx_params[] = {
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_KEYLEN, NULL),
+    OSSL_PARAM_uint(OSSL_CIPHER_PARAM_SPEED, NULL),
+    OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG, NULL, 0),
+    OSSL_PARAM_END
+};
+static const OSSL_PARAM *aes_siv_settable_ctx_params(void)
+{
+    return aes_siv_known_settable_ctx_params;
+}
+
+static int aes_siv_set_ctx_params(void *vctx, const OSSL_PARAM params[])
+{
+    PROV_AES_SIV_CTX *ctx = (PROV_AES_SIV_CTX *)vctx;
+    const OSSL_PARAM *p;
+    unsigned int speed = 0;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        /* The tag is only an input when decrypting */
+        if (ctx->base.enc)
+            return 1;
+        if (p->data_type != OSSL_PARAM_OCTET_STRING
+            || !CRYPTO_siv128_set_tag(&ctx->siv, p->data, p->data_size)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_SPEED);
+    if (p != NULL) {
+        if (!OSSL_PARAM_get_uint(p, &speed)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        CRYPTO_siv128_speed(&ctx->siv, (int)speed);
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL) {
+        size_t keylen;
+
+        if (!OSSL_PARAM_get_size_t(p, &keylen)) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        /* The key length can not be modified */
+        if (keylen != ctx->base.keylen)
+            return 0;
+    }
+    return 1;
+}
+
+#define IMPLEMENT_cipher(alg, lc, UCMODE, flags, kbits, blkbits, ivbits)       \
+static OSSL_OP_cipher_newctx_fn alg##kbits##lc##_newctx;                       \
+static void * alg##kbits##lc##_newctx(void *provctx)                           \
+{                                                                              \
+    return alg##_##lc##_newctx(provctx, kbits, EVP_CIPH_##UCMODE##_MODE);      \
+}                                                                              \
+static OSSL_OP_cipher_get_params_fn alg##_##kbits##_##lc##_get_params;         \
+static int alg##_##kbits##_##lc##_get_params(OSSL_PARAM params[])              \
+{                                                                              \
+    return cipher_generic_get_params(params, EVP_CIPH_##UCMODE##_MODE,         \
+                                     flags, 2 * kbits, blkbits, ivbits);       \
+}                                                                              \
+const OSSL_DISPATCH alg##kbits##lc##_functions[] = {                           \
+    { OSSL_FUNC_CIPHER_NEWCTX, (void (*)(void))alg##kbits##lc##_newctx },      \
+    { OSSL_FUNC_CIPHER_FREECTX, (void (*)(void))alg##_##lc##_freectx },        \
+    { OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void)) alg##_##lc##_dupctx },         \
+    { OSSL_FUNC_CIPHER_ENCRYPT_INIT, (void (*)(void)) alg##_##lc##_einit },    \
+    { OSSL_FUNC_CIPHER_DECRYPT_INIT, (void (*)(void)) alg##_##lc##_dinit },    \
+    { OSSL_FUNC_CIPHER_UPDATE, (void (*)(void)) alg##_##lc##_stream_update },  \
+    { OSSL_FUNC_CIPHER_FINAL, (void (*)(void)) alg##_##lc##_stream_final },    \
+    { OSSL_FUNC_CIPHER_CIPHER, (void (*)(void)) alg##_##lc##_cipher },         \
+    { OSSL_FUNC_CIPHER_GET_PARAMS,                                             \
+      (void (*)(void)) alg##_##kbits##_##lc##_get_params },                    \
+    { OSSL_FUNC_CIPHER_GETTABLE_PARAMS,                                        \
+      (void (*)(void))cipher_generic_gettable_params },                        \
+    { OSSL_FUNC_CIPHER_GET_CTX_PARAMS,                                         \
+      (void (*)(void)) alg##_##lc##_get_ctx_params },                          \
+    { OSSL_FUNC_CIPHER_GETTABLE_CTX_PARAMS,                                    \
+      (void (*)(void))cipher_aead_gettable_ctx_params },                       \
+    { OSSL_FUNC_CIPHER_SET_CTX_PARAMS,                                         \
+      (void (*)(void)) alg##_##lc##_set_ctx_params },                          \
+    { OSSL_FUNC_CIPHER_SETTABLE_CTX_PARAMS,                                    \
+      (void (*)(void)) alg##_##lc##_settable_ctx_params },                     \
+    { 0, NULL }                                                                \
+};
+
+/* aes128siv_functions */
+IMPLEMENT_cipher(aes, siv, SIV, SIV_FLAGS, 128, 8, 0)
+/* aes192siv_functions */
+IMPLEMENT_cipher(aes, siv, SIV, SIV_FLAGS, 192, 8, 0)
+/* aes256siv_functions */
+IMPLEMENT_cipher(aes, siv, SIV, SIV_FLAGS, 256, 8, 0)
@@ -0,0 +1,21 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "internal/ciphers/ciphercommon.h"
+#include "internal/siv_int.h"
+
+typedef struct prov_aes_siv_ctx_st {
+    PROV_CIPHER_CTX base;       /* Must be first */
+    SIV128_CONTEXT siv;
+    EVP_CIPHER *cbc;            /* Cipher used by the S2V CMAC */
+    EVP_CIPHER *ctr;            /* Cipher used to encrypt the data */
+    unsigned int key_set : 1;
+} PROV_AES_SIV_CTX;
+
+const PROV_CIPHER_HW *PROV_CIPHER_HW_aes_siv(size_t keybits);
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "cipher_aes_siv.h"
+
+static int aes_siv_initkey(PROV_CIPHER_CTX *vctx, const unsigned char *key,
+                           size_t keylen)
+{
+    PROV_AES_SIV_CTX *ctx = (PROV_AES_SIV_CTX *)vctx;
+    SIV128_CONTEXT *sctx = &ctx->siv;
+    size_t klen  = keylen / 2;
+    const char *cbc_name, *ctr_name;
+    unsigned char tag[SIV_LEN];
+
+    switch (klen) {
+    case 16:
+        cbc_name = "AES-128-CBC";
+        ctr_name = "AES-128-CTR";
+        break;
+    case 24:
+        cbc_name = "AES-192-CBC";
+        ctr_name = "AES-192-CTR";
+        break;
+    case 32:
+        cbc_name = "AES-256-CBC";
+        ctr_name = "AES-256-CTR";
+        break;
+    default:
+        return 0;
+    }
+
+    /*
+     * The key length never changes for a context, so the underlying ciphers
+     * are only fetched once.
+     */
+    if (ctx->cbc == NULL
+        && (ctx->cbc = EVP_CIPHER_fetch(ctx->base.libctx, cbc_name,
+                                        NULL)) == NULL)
+        return 0;
+    if (ctx->ctr == NULL
+        && (ctx->ctr = EVP_CIPHER_fetch(ctx->base.libctx, ctr_name,
+                                        NULL)) == NULL)
+        return 0;
+
+    /*
+     * Release the resources of an earlier key, but keep a tag that may have
+     * been supplied for decryption before the key was set.
+     */
+    if (ctx->key_set) {
+        CRYPTO_siv128_get_tag(sctx, tag, sizeof(tag));
+        CRYPTO_siv128_cleanup(sctx);
+        CRYPTO_siv128_set_tag(sctx, tag, sizeof(tag));
+        OPENSSL_cleanse(tag, sizeof(tag));
+        ctx->key_set = 0;
+    }
+
+    /*
+     * klen is the length of the underlying cipher, not the input key,
+     * which should be twice as long
+     */
+    if (!CRYPTO_siv128_init(sctx, key, klen, ctx->cbc, ctx->ctr))
+        return 0;
+    ctx->key_set = 1;
+    return 1;
+}
+
+static int aes_siv_cipher(PROV_CIPHER_CTX *vctx, unsigned char *out,
+                          const unsigned char *in, size_t len)
+{
+    PROV_AES_SIV_CTX *ctx = (PROV_AES_SIV_CTX *)vctx;
+    SIV128_CONTEXT *sctx = &ctx->siv;
+
+    /* EncryptFinal or DecryptFinal */
+    if (in == NULL)
+        return CRYPTO_siv128_finish(sctx) == 0;
+
+    /* Deal with associated data */
+    if (out == NULL)
+        return CRYPTO_siv128_aad(sctx, in, len) == 1;
+
+    /*
+     * The encrypt and decrypt calls return the length processed, so they
+     * return 0 for an empty message whether or not they succeed.  Reporting
+     * success then is safe: only a successful operation clears final_ret,
+     * so a failed one, such as a bad tag on an empty message, still makes
+     * the final call fail.
+     */
+    if (ctx->base.enc)
+        return CRYPTO_siv128_encrypt(sctx, in, out, len) > 0 || len == 0;
+    return CRYPTO_siv128_decrypt(sctx, in, out, len) > 0 || len == 0;
+}
+
+static const PROV_CIPHER_HW aes_siv_hw = {
+    aes_siv_initkey,
+    aes_siv_cipher
+};
+
+const PROV_CIPHER_HW *PROV_CIPHER_HW_aes_siv(size_t keybits)
+{
+    return &aes_siv_hw;
+}
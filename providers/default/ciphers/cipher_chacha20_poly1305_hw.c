@@ -0,0 +1,471 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* chacha20_poly1305 cipher implementation */
+
+#include "cipher_chacha20_poly1305.h"
+
+/*
+ * ChaCha20 and Poly1305 take turns on chunks of this size, see
+ * chacha20_poly1305_stitch().  A chunk and its output fit in the L1 cache
+ * together, and it is still long enough for the vectorised ChaCha20 and
+ * Poly1305 code to run at full speed.
+ */
+#define CHACHA20_POLY1305_CHUNK (32 * CHACHA_BLK_SIZE)
+
+static int chacha_poly1305_tls_init(PROV_CIPHER_CTX *bctx,
+                                    unsigned char *aad, size_t alen)
+{
+    unsigned int len;
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)bctx;
+
+    if (alen != EVP_AEAD_TLS1_AAD_LEN)
+        return 0;
+
+    memcpy(ctx->tls_aad, aad, EVP_AEAD_TLS1_AAD_LEN);
+    len = aad[EVP_AEAD_TLS1_AAD_LEN - 2] << 8 | aad[EVP_AEAD_TLS1_AAD_LEN - 1];
+    aad = ctx->tls_aad;
+    if (!bctx->enc) {
+        if (len < POLY1305_BLOCK_SIZE)
+            return 0;
+        len -= POLY1305_BLOCK_SIZE; /* discount attached tag */
+        aad[EVP_AEAD_TLS1_AAD_LEN - 2] = (unsigned char)(len >> 8);
+        aad[EVP_AEAD_TLS1_AAD_LEN - 1] = (unsigned char)len;
+    }
+    ctx->tls_payload_length = len;
+
+    /* merge record sequence number as per RFC7905 */
+    ctx->counter[1] = ctx->nonce[0];
+    ctx->counter[2] = ctx->nonce[1] ^ CHACHA_U8TOU32(aad);
+    ctx->counter[3] = ctx->nonce[2] ^ CHACHA_U8TOU32(aad+4);
+    ctx->mac_inited = 0;
+
+    return POLY1305_BLOCK_SIZE;         /* tag length */
+}
+
+static int chacha_poly1305_tls_iv_set_fixed(PROV_CIPHER_CTX *bctx,
+                                            unsigned char *fixed, size_t flen)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)bctx;
+
+    if (flen != CHACHA20_POLY1305_MAX_IVLEN)
+        return 0;
+    ctx->nonce[0] = ctx->counter[1] = CHACHA_U8TOU32(fixed);
+    ctx->nonce[1] = ctx->counter[2] = CHACHA_U8TOU32(fixed + 4);
+    ctx->nonce[2] = ctx->counter[3] = CHACHA_U8TOU32(fixed + 8);
+    return 1;
+}
+
+static int chacha20_poly1305_initkey(PROV_CIPHER_CTX *bctx,
+                                     const unsigned char *key, size_t keylen)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)bctx;
+    size_t i;
+
+    for (i = 0; i < CHACHA_KEY_SIZE; i += 4)
+        ctx->key.d[i / 4] = CHACHA_U8TOU32(key + i);
+    ctx->partial_len = 0;
+    return 1;
+}
+
+static int chacha20_poly1305_initiv(PROV_CIPHER_CTX *bctx)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)bctx;
+    unsigned char tempiv[CHACHA_CTR_SIZE] = { 0 };
+    size_t i;
+
+    /* pad on the left */
+    if (ctx->nonce_len <= CHACHA_CTR_SIZE)
+        memcpy(tempiv + CHACHA_CTR_SIZE - ctx->nonce_len, bctx->iv,
+               ctx->nonce_len);
+
+    for (i = 0; i < CHACHA_CTR_SIZE; i += 4)
+        ctx->counter[i / 4] = CHACHA_U8TOU32(tempiv + i);
+    ctx->partial_len = 0;
+
+    ctx->nonce[0] = ctx->counter[1];
+    ctx->nonce[1] = ctx->counter[2];
+    ctx->nonce[2] = ctx->counter[3];
+    return 1;
+}
+
+static void chacha20_cipher(PROV_CHACHA20_POLY1305_CTX *ctx,
+                            unsigned char *out, const unsigned char *in,
+                            size_t len)
+{
+    unsigned int n, rem, ctr32;
+
+    if ((n = ctx->partial_len)) {
+        while (len && n < CHACHA_BLK_SIZE) {
+            *out++ = *in++ ^ ctx->buf[n++];
+            len--;
+        }
+        ctx->partial_len = n;
+
+        if (len == 0)
+            return;
+
+        if (n == CHACHA_BLK_SIZE) {
+            ctx->partial_len = 0;
+            ctx->counter[0]++;
+            if (ctx->counter[0] == 0)
+                ctx->counter[1]++;
+        }
+    }
+
+    rem = (unsigned int)(len % CHACHA_BLK_SIZE);
+    len -= rem;
+    ctr32 = ctx->counter[0];
+    while (len >= CHACHA_BLK_SIZE) {
+        size_t blocks = len / CHACHA_BLK_SIZE;
+
+        /*
+         * 1<<28 is just a not-so-small yet not-so-large number...
+         * Below condition is practically never met, but it has to
+         * be checked for code correctness.
+         */
+        if (sizeof(size_t) > sizeof(unsigned int) && blocks > (1U << 28))
+            blocks = (1U << 28);
+
+        /*
+         * As ChaCha20_ctr32 operates on 32-bit counter, caller
+         * has to handle overflow. 'if' below detects the
+         * overflow, which is then handled by limiting the
+         * amount of blocks to the exact overflow point...
+         */
+        ctr32 += (unsigned int)blocks;
+        if (ctr32 < blocks) {
+            blocks -= ctr32;
+            ctr32 = 0;
+        }
+        blocks *= CHACHA_BLK_SIZE;
+        ChaCha20_ctr32(out, in, blocks, ctx->key.d, ctx->counter);
+        len -= blocks;
+        in += blocks;
+        out += blocks;
+
+        ctx->counter[0] = ctr32;
+        if (ctr32 == 0)
+            ctx->counter[1]++;
+    }
+
+    if (rem) {
+        memset(ctx->buf, 0, sizeof(ctx->buf));
+        ChaCha20_ctr32(ctx->buf, ctx->buf, CHACHA_BLK_SIZE,
+                       ctx->key.d, ctx->counter);
+        for (n = 0; n < rem; n++)
+            out[n] = in[n] ^ ctx->buf[n];
+        ctx->partial_len = rem;
+    }
+}
+
+/*
+ * Encrypts or decrypts |len| bytes and hashes the ciphertext, alternating
+ * between ChaCha20 and Poly1305 one chunk at a time.  This is not a fused
+ * kernel, each chunk is still read twice, but Poly1305 finds the ciphertext,
+ * which is the output of encryption and the input of decryption, still in
+ * the L1 cache.  Hashing before decrypting also keeps in-place operation
+ * working.
+ */
+static void chacha20_poly1305_stitch(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                     unsigned char *out,
+                                     const unsigned char *in, size_t len)
+{
+    POLY1305 *poly = POLY1305_ctx(ctx);
+    size_t n = CHACHA20_POLY1305_CHUNK;
+
+    /* Let the chunks after the first one start on a key stream block */
+    if (ctx->partial_len != 0)
+        n += CHACHA_BLK_SIZE - ctx->partial_len;
+
+    while (len > 0) {
+        if (n > len)
+            n = len;
+        if (ctx->base.enc) {
+            chacha20_cipher(ctx, out, in, n);
+            Poly1305_Update(poly, out, n);
+        } else {
+            Poly1305_Update(poly, in, n);
+            chacha20_cipher(ctx, out, in, n);
+        }
+        in += n;
+        out += n;
+        len -= n;
+        n = CHACHA20_POLY1305_CHUNK;
+    }
+}
+
+/* Serialises the lengths of the aad and of the text, as per RFC 7539 */
+static void chacha20_poly1305_lengths(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                      unsigned char out[POLY1305_BLOCK_SIZE])
+{
+    const union {
+        long one;
+        char little;
+    } is_endian = { 1 };
+    int i;
+
+    if (is_endian.little) {
+        memcpy(out, (unsigned char *)&ctx->len, POLY1305_BLOCK_SIZE);
+        return;
+    }
+    for (i = 0; i < 8; i++) {
+        out[i] = (unsigned char)(ctx->len.aad >> (8 * i));
+        out[8 + i] = (unsigned char)(ctx->len.text >> (8 * i));
+    }
+}
+
+#if !defined(OPENSSL_SMALL_FOOTPRINT)
+
+# if defined(POLY1305_ASM) && (defined(__x86_64) || defined(__x86_64__) \
+                               || defined(_M_AMD64) || defined(_M_X64))
+#  define XOR128_HELPERS
+void *xor128_encrypt_n_pad(void *out, const void *inp, void *otp, size_t len);
+void *xor128_decrypt_n_pad(void *out, const void *inp, void *otp, size_t len);
+static const unsigned char zero[4 * CHACHA_BLK_SIZE] = { 0 };
+# else
+static const unsigned char zero[2 * CHACHA_BLK_SIZE] = { 0 };
+# endif
+
+static int chacha20_poly1305_tls_cipher(PROV_CIPHER_CTX *bctx,
+                                        unsigned char *out,
+                                        size_t *out_padlen,
+                                        const unsigned char *in, size_t len)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)bctx;
+    POLY1305 *poly = POLY1305_ctx(ctx);
+    size_t tail, tohash_len, buf_len, plen = ctx->tls_payload_length;
+    unsigned char *buf, *tohash, *ctr, storage[sizeof(zero) + 32];
+
+    *out_padlen = 0;
+    if (len != plen + POLY1305_BLOCK_SIZE)
+        return 0;
+
+    buf = storage + ((0 - (size_t)storage) & 15);   /* align */
+    ctr = buf + CHACHA_BLK_SIZE;
+    tohash = buf + CHACHA_BLK_SIZE - POLY1305_BLOCK_SIZE;
+
+# ifdef XOR128_HELPERS
+    if (plen <= 3 * CHACHA_BLK_SIZE) {
+        ctx->counter[0] = 0;
+        buf_len = (plen + 2 * CHACHA_BLK_SIZE - 1) & (0 - CHACHA_BLK_SIZE);
+        ChaCha20_ctr32(buf, zero, buf_len, ctx->key.d, ctx->counter);
+        Poly1305_Init(poly, buf);
+        ctx->partial_len = 0;
+        memcpy(tohash, ctx->tls_aad, POLY1305_BLOCK_SIZE);
+        tohash_len = POLY1305_BLOCK_SIZE;
+        ctx->len.aad = EVP_AEAD_TLS1_AAD_LEN;
+        ctx->len.text = plen;
+
+        if (plen) {
+            if (bctx->enc)
+                ctr = xor128_encrypt_n_pad(out, in, ctr, plen);
+            else
+                ctr = xor128_decrypt_n_pad(out, in, ctr, plen);
+
+            in += plen;
+            out += plen;
+            tohash_len = (size_t)(ctr - tohash);
+        }
+    }
+# else
+    if (plen <= CHACHA_BLK_SIZE) {
+        size_t i;
+
+        ctx->counter[0] = 0;
+        buf_len = 2 * CHACHA_BLK_SIZE;
+        ChaCha20_ctr32(buf, zero, buf_len, ctx->key.d, ctx->counter);
+        Poly1305_Init(poly, buf);
+        ctx->partial_len = 0;
+        memcpy(tohash, ctx->tls_aad, POLY1305_BLOCK_SIZE);
+        tohash_len = POLY1305_BLOCK_SIZE;
+        ctx->len.aad = EVP_AEAD_TLS1_AAD_LEN;
+        ctx->len.text = plen;
+
+        if (bctx->enc) {
+            for (i = 0; i < plen; i++)
+                out[i] = ctr[i] ^= in[i];
+        } else {
+            for (i = 0; i < plen; i++) {
+                unsigned char c = in[i];
+
+                out[i] = ctr[i] ^ c;
+                ctr[i] = c;
+            }
+        }
+
+        in += i;
+        out += i;
+
+        tail = (0 - i) & (POLY1305_BLOCK_SIZE - 1);
+        memset(ctr + i, 0, tail);
+        ctr += i + tail;
+        tohash_len += i + tail;
+    }
+# endif
+    else {
+        ctx->counter[0] = 0;
+        buf_len = CHACHA_BLK_SIZE;
+        ChaCha20_ctr32(buf, zero, buf_len, ctx->key.d, ctx->counter);
+        Poly1305_Init(poly, buf);
+        ctx->counter[0] = 1;
+        ctx->partial_len = 0;
+        Poly1305_Update(poly, ctx->tls_aad, POLY1305_BLOCK_SIZE);
+        tohash = ctr;
+        tohash_len = 0;
+        ctx->len.aad = EVP_AEAD_TLS1_AAD_LEN;
+        ctx->len.text = plen;
+
+        chacha20_poly1305_stitch(ctx, out, in, plen);
+
+        in += plen;
+        out += plen;
+        tail = (0 - plen) & (POLY1305_BLOCK_SIZE - 1);
+        Poly1305_Update(poly, zero, tail);
+    }
+
+    chacha20_poly1305_lengths(ctx, ctr);
+    tohash_len += POLY1305_BLOCK_SIZE;
+
+    Poly1305_Update(poly, tohash, tohash_len);
+    OPENSSL_cleanse(buf, buf_len);
+    Poly1305_Final(poly, bctx->enc ? ctx->tag : tohash);
+
+    ctx->tls_payload_length = NO_TLS_PAYLOAD_LENGTH;
+
+    if (bctx->enc) {
+        memcpy(out, ctx->tag, POLY1305_BLOCK_SIZE);
+    } else {
+        if (CRYPTO_memcmp(tohash, in, POLY1305_BLOCK_SIZE)) {
+            memset(out - plen, 0, plen);
+            return 0;
+        }
+        /* Strip the tag */
+        len -= POLY1305_BLOCK_SIZE;
+    }
+
+    *out_padlen = len;
+    return 1;
+}
+#else
+static const unsigned char zero[CHACHA_BLK_SIZE] = { 0 };
+#endif /* OPENSSL_SMALL_FOOTPRINT */
+
+static int chacha20_poly1305_aead_cipher(PROV_CIPHER_CTX *bctx,
+                                         unsigned char *out, size_t *outl,
+                                         const unsigned char *in, size_t inl)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)bctx;
+    POLY1305 *poly = POLY1305_ctx(ctx);
+    size_t rem, plen = ctx->tls_payload_length;
+    size_t olen = 0;
+    int rv = 0;
+
+    if (!ctx->mac_inited) {
+#if !defined(OPENSSL_SMALL_FOOTPRINT)
+        if (plen != NO_TLS_PAYLOAD_LENGTH && out != NULL)
+            return chacha20_poly1305_tls_cipher(bctx, out, outl, in, inl);
+#endif
+
+        ctx->counter[0] = 0;
+        ChaCha20_ctr32(ctx->buf, zero, CHACHA_BLK_SIZE, ctx->key.d,
+                       ctx->counter);
+        Poly1305_Init(poly, ctx->buf);
+        ctx->counter[0] = 1;
+        ctx->partial_len = 0;
+        ctx->len.aad = ctx->len.text = 0;
+        ctx->mac_inited = 1;
+        if (plen != NO_TLS_PAYLOAD_LENGTH) {
+            Poly1305_Update(poly, ctx->tls_aad, EVP_AEAD_TLS1_AAD_LEN);
+            ctx->len.aad = EVP_AEAD_TLS1_AAD_LEN;
+            ctx->aad = 1;
+        }
+    }
+
+    if (in != NULL) { /* aad or text */
+        if (out == NULL) { /* aad */
+            Poly1305_Update(poly, in, inl);
+            ctx->len.aad += inl;
+            ctx->aad = 1;
+            goto finish;
+        } else { /* plain- or ciphertext */
+            if (ctx->aad) { /* wrap up aad */
+                if ((rem = (size_t)ctx->len.aad % POLY1305_BLOCK_SIZE))
+                    Poly1305_Update(poly, zero, POLY1305_BLOCK_SIZE - rem);
+                ctx->aad = 0;
+            }
+
+            ctx->tls_payload_length = NO_TLS_PAYLOAD_LENGTH;
+            if (plen == NO_TLS_PAYLOAD_LENGTH)
+                plen = inl;
+            else if (inl != plen + POLY1305_BLOCK_SIZE)
+                goto err;
+
+            chacha20_poly1305_stitch(ctx, out, in, plen);
+            in += plen;
+            out += plen;
+            ctx->len.text += plen;
+        }
+    }
+    /* explicit final, or tls mode */
+    if (in == NULL || inl != plen) {
+        unsigned char temp[POLY1305_BLOCK_SIZE];
+
+        if (ctx->aad) { /* wrap up aad */
+            if ((rem = (size_t)ctx->len.aad % POLY1305_BLOCK_SIZE))
+                Poly1305_Update(poly, zero, POLY1305_BLOCK_SIZE - rem);
+            ctx->aad = 0;
+        }
+
+        if ((rem = (size_t)ctx->len.text % POLY1305_BLOCK_SIZE))
+            Poly1305_Update(poly, zero, POLY1305_BLOCK_SIZE - rem);
+
+        chacha20_poly1305_lengths(ctx, temp);
+        Poly1305_Update(poly, temp, POLY1305_BLOCK_SIZE);
+        Poly1305_Final(poly, bctx->enc ? ctx->tag : temp);
+        ctx->mac_inited = 0;
+
+        if (in != NULL && inl != plen) { /* tls mode */
+            if (bctx->enc) {
+                memcpy(out, ctx->tag, POLY1305_BLOCK_SIZE);
+            } else {
+                if (CRYPTO_memcmp(temp, in, POLY1305_BLOCK_SIZE)) {
+                    memset(out - plen, 0, plen);
+                    goto err;
+                }
+                /* Strip the tag */
+                inl -= POLY1305_BLOCK_SIZE;
+            }
+        }
+        else if (!bctx->enc) {
+            if (CRYPTO_memcmp(temp, ctx->tag, ctx->tag_len))
+                goto err;
+        }
+    }
+finish:
+    olen = inl;
+    rv = 1;
+err:
+    *outl = olen;
+    return rv;
+}
+
+static const PROV_CIPHER_HW_CHACHA20_POLY1305 chacha20poly1305_hw =
+{
+    { chacha20_poly1305_initkey, NULL },
+    chacha20_poly1305_aead_cipher,
+    chacha20_poly1305_initiv,
+    chacha_poly1305_tls_init,
+    chacha_poly1305_tls_iv_set_fixed
+};
+
+const PROV_CIPHER_HW *PROV_CIPHER_HW_chacha20_poly1305(size_t keybits)
+{
+    return (PROV_CIPHER_HW *)&chacha20poly1305_hw;
+}
@@ -0,0 +1,621 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <string.h>
+#include <limits.h>
+#include <openssl/rand.h>
+#include "internal/sockets.h"
+#include "ssl_locl.h"
+
+#ifndef OPENSSL_NO_SOCK
+
+/* The largest datagram the DTLS record layer will read */
+# define DTLS_DEMUX_MAX_DATAGRAM \
+    (SSL3_RT_MAX_PLAIN_LENGTH + SSL3_RT_MAX_ENCRYPTED_OVERHEAD \
+     + DTLS1_RT_HEADER_LENGTH)
+/* Datagrams up to this size are held in buffers from the shared pool */
+# define DTLS_DEMUX_POOL_BUF_LEN    2048
+/* The most idle buffers the pool keeps */
+# define DTLS_DEMUX_MAX_IDLE        1024
+/* The most datagrams queued for one peer, any more are dropped */
+# define DTLS_DEMUX_MAX_QUEUE       64
+/* The most datagrams a single DTLS_DEMUX_recv() call reads */
+# define DTLS_DEMUX_MAX_RECV        256
+/* The most new sessions waiting for DTLS_DEMUX_accept(), any more are dropped */
+# define DTLS_DEMUX_MAX_PENDING     256
+/* Address family, port and IPv4 or IPv6 address of a peer */
+# define DTLS_DEMUX_KEY_LEN         (1 + 2 + 16)
+
+/* Which list of the demultiplexer a peer is on */
+# define DTLS_DEMUX_LIST_NONE       0
+# define DTLS_DEMUX_LIST_ACCEPT     1
+# define DTLS_DEMUX_LIST_READY      2
+
+typedef struct dtls_demux_buf_st DTLS_DEMUX_BUF;
+typedef struct dtls_demux_peer_st DTLS_DEMUX_PEER;
+
+struct dtls_demux_buf_st {
+    DTLS_DEMUX_BUF *next;
+    size_t len;
+    /* DTLS_DEMUX_POOL_BUF_LEN if the buffer belongs in the pool */
+    size_t size;
+    unsigned char *data;
+};
+
+/*
+ * A peer of the shared socket. It is owned by the BIO that the peer's SSL
+ * object reads and writes through, and lives as long as that BIO does.
+ */
+struct dtls_demux_peer_st {
+    unsigned char key[DTLS_DEMUX_KEY_LEN];
+    size_t keylen;
+    unsigned long hash;
+    /* NULL once the demultiplexer has been freed */
+    DTLS_DEMUX *dm;
+    SSL *ssl;
+    int in_hash;
+    int list;
+    DTLS_DEMUX_PEER *prev;
+    DTLS_DEMUX_PEER *next;
+    /* Datagrams received from the peer and not read yet */
+    DTLS_DEMUX_BUF *head;
+    DTLS_DEMUX_BUF *tail;
+    size_t queued;
+};
+
+DEFINE_LHASH_OF(DTLS_DEMUX_PEER);
+
+typedef struct dtls_demux_list_st {
+    DTLS_DEMUX_PEER *head;
+    DTLS_DEMUX_PEER *tail;
+} DTLS_DEMUX_LIST;
+
+struct dtls_demux_st {
+    SSL_CTX *ctx;
+    BIO *bio;
+    LHASH_OF(DTLS_DEMUX_PEER) *peers;
+    /* New sessions that the application hasn't taken yet */
+    DTLS_DEMUX_LIST accept;
+    size_t pending;
+    /* Sessions that have been taken and have datagrams queued */
+    DTLS_DEMUX_LIST ready;
+    /* Runs the cookie exchange with peers that have no session yet */
+    SSL *listener;
+    /* Idle receive buffers, shared by all the peers */
+    DTLS_DEMUX_BUF *pool;
+    size_t pool_idle;
+    unsigned char *scratch;
+    BIO_ADDR *addr;
+    /* Random basis of the peer hash, so that senders can't pick collisions */
+    unsigned long hash_seed;
+};
+
+static int demux_bio_write(BIO *b, const char *in, size_t inl,
+                           size_t *written);
+static int demux_bio_read(BIO *b, char *out, size_t outl, size_t *readbytes);
+static long demux_bio_ctrl(BIO *b, int cmd, long num, void *ptr);
+static int demux_bio_free(BIO *b);
+
+static const BIO_METHOD methods_demux = {
+    BIO_TYPE_DGRAM_DEMUX,
+    "DTLS demultiplexed datagram",
+    demux_bio_write,
+    NULL,                       /* demux_bio_write_old, */
+    demux_bio_read,
+    NULL,                       /* demux_bio_read_old,  */
+    NULL,                       /* demux_bio_puts,      */
+    NULL,                       /* demux_bio_gets,      */
+    demux_bio_ctrl,
+    NULL,                       /* demux_bio_new,       */
+    demux_bio_free,
+    NULL,                       /* demux_bio_callback_ctrl */
+};
+
+static unsigned long demux_peer_hash(const DTLS_DEMUX_PEER *peer)
+{
+    return peer->hash;
+}
+
+static int demux_peer_cmp(const DTLS_DEMUX_PEER *a, const DTLS_DEMUX_PEER *b)
+{
+    if (a->keylen != b->keylen)
+        return 1;
+    return memcmp(a->key, b->key, a->keylen);
+}
+
+/* Sets the hash key of |peer| from |addr|, which must be an IP address */
+static int demux_peer_set_key(const DTLS_DEMUX *dm, DTLS_DEMUX_PEER *peer,
+                              const BIO_ADDR *addr)
+{
+    int family = BIO_ADDR_family(addr);
+    unsigned short port = BIO_ADDR_rawport(addr);
+    unsigned long hash = 2166136261UL ^ dm->hash_seed;
+    size_t len, i;
+
+    if (family == AF_INET)
+        len = 4;
+# if OPENSSL_USE_IPV6
+    else if (family == AF_INET6)
+        len = 16;
+# endif
+    else
+        return 0;
+
+    if (!BIO_ADDR_rawaddress(addr, peer->key + 3, &len))
+        return 0;
+    peer->key[0] = (unsigned char)family;
+    memcpy(peer->key + 1, &port, sizeof(port));
+    peer->keylen = 3 + len;
+
+    /* FNV-1a, from a secret basis */
+    for (i = 0; i < peer->keylen; i++)
+        hash = (hash ^ peer->key[i]) * 16777619UL;
+    peer->hash = hash;
+    return 1;
+}
+
+static int demux_peer_get_addr(const DTLS_DEMUX_PEER *peer, BIO_ADDR *addr)
+{
+    unsigned short port;
+
+    memcpy(&port, peer->key + 1, sizeof(port));
+    return BIO_ADDR_rawmake(addr, peer->key[0], peer->key + 3,
+                            peer->keylen - 3, port);
+}
+
+static DTLS_DEMUX_BUF *demux_buf_new(DTLS_DEMUX *dm, size_t len)
+{
+    DTLS_DEMUX_BUF *buf;
+    size_t size = len > DTLS_DEMUX_POOL_BUF_LEN ? len : DTLS_DEMUX_POOL_BUF_LEN;
+
+    if (size == DTLS_DEMUX_POOL_BUF_LEN && dm->pool != NULL) {
+        buf = dm->pool;
+        dm->pool = buf->next;
+        dm->pool_idle--;
+    } else {
+        if ((buf = OPENSSL_malloc(sizeof(*buf) + size)) == NULL) {
+            SSLerr(SSL_F_DEMUX_BUF_NEW, ERR_R_MALLOC_FAILURE);
+            return NULL;
+        }
+        buf->size = size;
+        buf->data = (unsigned char *)(buf + 1);
+    }
+    buf->next = NULL;
+    buf->len = len;
+    return buf;
+}
+
+/* Returns |buf| to the pool of |dm|, or frees it if |dm| is NULL */
+static void demux_buf_free(DTLS_DEMUX *dm, DTLS_DEMUX_BUF *buf)
+{
+    if (dm != NULL && buf->size == DTLS_DEMUX_POOL_BUF_LEN
+            && dm->pool_idle < DTLS_DEMUX_MAX_IDLE) {
+        buf->next = dm->pool;
+        dm->pool = buf;
+        dm->pool_idle++;
+        return;
+    }
+    OPENSSL_free(buf);
+}
+
+static void demux_list_add(DTLS_DEMUX *dm, DTLS_DEMUX_PEER *peer, int which)
+{
+    DTLS_DEMUX_LIST *list = which == DTLS_DEMUX_LIST_ACCEPT ? &dm->accept
+                                                            : &dm->ready;
+
+    if (which == DTLS_DEMUX_LIST_ACCEPT)
+        dm->pending++;
+    peer->list = which;
+    peer->next = NULL;
+    peer->prev = list->tail;
+    if (list->tail != NULL)
+        list->tail->next = peer;
+    else
+        list->head = peer;
+    list->tail = peer;
+}
+
+static void demux_list_remove(DTLS_DEMUX *dm, DTLS_DEMUX_PEER *peer)
+{
+    DTLS_DEMUX_LIST *list;
+
+    if (peer->list == DTLS_DEMUX_LIST_NONE)
+        return;
+    if (peer->list == DTLS_DEMUX_LIST_ACCEPT) {
+        list = &dm->accept;
+        dm->pending--;
+    } else {
+        list = &dm->ready;
+    }
+    if (peer->prev != NULL)
+        peer->prev->next = peer->next;
+    else
+        list->head = peer->next;
+    if (peer->next != NULL)
+        peer->next->prev = peer->prev;
+    else
+        list->tail = peer->prev;
+    peer->prev = peer->next = NULL;
+    peer->list = DTLS_DEMUX_LIST_NONE;
+}
+
+static void demux_peer_clear_queue(DTLS_DEMUX_PEER *peer)
+{
+    DTLS_DEMUX_BUF *buf;
+
+    while ((buf = peer->head) != NULL) {
+        peer->head = buf->next;
+        demux_buf_free(peer->dm, buf);
+    }
+    peer->tail = NULL;
+    peer->queued = 0;
+}
+
+/* Cuts |peer| loose from a demultiplexer that is being freed */
+static void demux_peer_detach(DTLS_DEMUX_PEER *peer)
+{
+    peer->dm = NULL;
+    demux_peer_clear_queue(peer);
+    peer->in_hash = 0;
+    peer->list = DTLS_DEMUX_LIST_NONE;
+    peer->prev = peer->next = NULL;
+}
+
+/* Queues the datagram in the scratch buffer, or drops it if |peer| is full */
+static int demux_peer_queue(DTLS_DEMUX *dm, DTLS_DEMUX_PEER *peer, size_t len)
+{
+    DTLS_DEMUX_BUF *buf;
+
+    if (peer->queued >= DTLS_DEMUX_MAX_QUEUE)
+        return 1;
+    if ((buf = demux_buf_new(dm, len)) == NULL)
+        return 0;
+    memcpy(buf->data, dm->scratch, len);
+    if (peer->tail != NULL)
+        peer->tail->next = buf;
+    else
+        peer->head = buf;
+    peer->tail = buf;
+    peer->queued++;
+    return 1;
+}
+
+/* Returns a BIO that reads and writes the datagrams of the peer in |key| */
+static BIO *demux_bio_new(DTLS_DEMUX *dm, const DTLS_DEMUX_PEER *key)
+{
+    DTLS_DEMUX_PEER *peer;
+    BIO *bio;
+
+    if ((peer = OPENSSL_zalloc(sizeof(*peer))) == NULL) {
+        SSLerr(SSL_F_DEMUX_BIO_NEW, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    if ((bio = BIO_new(&methods_demux)) == NULL) {
+        OPENSSL_free(peer);
+        return NULL;
+    }
+    memcpy(peer->key, key->key, key->keylen);
+    peer->keylen = key->keylen;
+    peer->hash = key->hash;
+    peer->dm = dm;
+    BIO_set_data(bio, peer);
+    BIO_set_init(bio, 1);
+    return bio;
+}
+
+static int demux_bio_free(BIO *b)
+{
+    DTLS_DEMUX_PEER *peer = BIO_get_data(b);
+    DTLS_DEMUX *dm;
+
+    if (peer == NULL)
+        return 1;
+    dm = peer->dm;
+    if (dm != NULL) {
+        if (peer->in_hash)
+            (void)lh_DTLS_DEMUX_PEER_delete(dm->peers, peer);
+        demux_list_remove(dm, peer);
+    }
+    demux_peer_clear_queue(peer);
+    OPENSSL_free(peer);
+    BIO_set_data(b, NULL);
+    BIO_set_init(b, 0);
+    return 1;
+}
+
+static int demux_bio_read(BIO *b, char *out, size_t outl, size_t *readbytes)
+{
+    DTLS_DEMUX_PEER *peer = BIO_get_data(b);
+    DTLS_DEMUX_BUF *buf = peer->head;
+
+    BIO_clear_retry_flags(b);
+    *readbytes = 0;
+    if (buf == NULL) {
+        /* Nothing more will arrive once the demultiplexer is gone */
+        if (peer->dm == NULL)
+            return 0;
+        BIO_set_retry_read(b);
+        return -1;
+    }
+
+    /* Like recvfrom(), a read consumes the datagram even if it is truncated */
+    *readbytes = outl < buf->len ? outl : buf->len;
+    memcpy(out, buf->data, *readbytes);
+    peer->head = buf->next;
+    if (peer->head == NULL)
+        peer->tail = NULL;
+    peer->queued--;
+    demux_buf_free(peer->dm, buf);
+    return 1;
+}
+
+static int demux_bio_write(BIO *b, const char *in, size_t inl,
+                           size_t *written)
+{
+    DTLS_DEMUX_PEER *peer = BIO_get_data(b);
+    DTLS_DEMUX *dm = peer->dm;
+    int ret;
+
+    BIO_clear_retry_flags(b);
+    *written = 0;
+    if (dm == NULL || inl > INT_MAX || !demux_peer_get_addr(peer, dm->addr))
+        return -1;
+
+    (void)BIO_dgram_set_peer(dm->bio, dm->addr);
+    ret = BIO_write(dm->bio, in, (int)inl);
+    if (ret <= 0) {
+        BIO_set_flags(b, BIO_get_retry_flags(dm->bio));
+        return ret;
+    }
+    *written = ret;
+    return 1;
+}
+
+static long demux_bio_ctrl(BIO *b, int cmd, long num, void *ptr)
+{
+    DTLS_DEMUX_PEER *peer = BIO_get_data(b);
+    DTLS_DEMUX *dm = peer->dm;
+    long ret = 0;
+
+    switch (cmd) {
+    case BIO_CTRL_PENDING:
+        if (peer->head != NULL)
+            ret = (long)peer->head->len;
+        break;
+    case BIO_CTRL_FLUSH:
+        BIO_clear_retry_flags(b);
+        if (dm != NULL) {
+            ret = BIO_flush(dm->bio);
+            if (ret <= 0)
+                BIO_set_flags(b, BIO_get_retry_flags(dm->bio));
+        }
+        break;
+    case BIO_CTRL_DGRAM_GET_PEER:
+        ret = demux_peer_get_addr(peer, ptr);
+        break;
+    case BIO_CTRL_DGRAM_SET_PEER:
+        /* The peer is fixed, DTLSv1_listen() sets the same one again */
+        ret = 1;
+        break;
+    case BIO_CTRL_DGRAM_SET_MTU:
+        ret = num;
+        break;
+    case BIO_CTRL_DGRAM_QUERY_MTU:
+    case BIO_CTRL_DGRAM_GET_FALLBACK_MTU:
+    case BIO_CTRL_DGRAM_GET_MTU_OVERHEAD:
+    case BIO_CTRL_DGRAM_MTU_EXCEEDED:
+        /* The shared socket answers these for the address of the peer */
+        if (dm != NULL && demux_peer_get_addr(peer, dm->addr)) {
+            (void)BIO_dgram_set_peer(dm->bio, dm->addr);
+            ret = BIO_ctrl(dm->bio, cmd, num, ptr);
+        }
+        break;
+    default:
+        ret = 0;
+        break;
+    }
+    return ret;
+}
+
+/*
+ * Creates a session for a peer that has none yet and queues its first
+ * datagram. If the SSL_CTX uses SSL_OP_COOKIE_EXCHANGE the session is only
+ * created once the peer has returned a valid cookie. The datagram is dropped
+ * while DTLS_DEMUX_MAX_PENDING sessions are waiting to be accepted, so that a
+ * flood of datagrams from spoofed addresses can't take unbounded memory.
+ * Returns 1 if the datagram was handled, even if it was dropped, and -1 on
+ * error.
+ */
+static int demux_new_peer(DTLS_DEMUX *dm, const DTLS_DEMUX_PEER *key,
+                          size_t len)
+{
+    DTLS_DEMUX_PEER *peer;
+    BIO *bio;
+    SSL *s;
+    int ret;
+
+    if (dm->pending >= DTLS_DEMUX_MAX_PENDING)
+        return 1;
+
+    if ((bio = demux_bio_new(dm, key)) == NULL)
+        return -1;
+    peer = BIO_get_data(bio);
+    if (!demux_peer_queue(dm, peer, len)) {
+        BIO_free(bio);
+        return -1;
+    }
+
+    if ((SSL_CTX_get_options(dm->ctx) & SSL_OP_COOKIE_EXCHANGE) != 0) {
+        if (dm->listener == NULL && (dm->listener = SSL_new(dm->ctx)) == NULL) {
+            BIO_free(bio);
+            return -1;
+        }
+        s = dm->listener;
+        SSL_set_bio(s, bio, bio);
+        ret = DTLSv1_listen(s, dm->addr);
+        if (ret <= 0) {
+            /* A HelloVerifyRequest went out or the datagram was dropped */
+            SSL_set_bio(s, NULL, NULL);
+            return ret < 0 ? -1 : 1;
+        }
+        /* The listener becomes the peer's session */
+        dm->listener = NULL;
+    } else {
+        if ((s = SSL_new(dm->ctx)) == NULL) {
+            BIO_free(bio);
+            return -1;
+        }
+        SSL_set_accept_state(s);
+        SSL_set_bio(s, bio, bio);
+    }
+
+    peer->ssl = s;
+    (void)lh_DTLS_DEMUX_PEER_insert(dm->peers, peer);
+    if (lh_DTLS_DEMUX_PEER_error(dm->peers) > 0) {
+        SSLerr(SSL_F_DEMUX_NEW_PEER, ERR_R_MALLOC_FAILURE);
+        SSL_free(s);
+        return -1;
+    }
+    peer->in_hash = 1;
+    demux_list_add(dm, peer, DTLS_DEMUX_LIST_ACCEPT);
+    return 1;
+}
+
+DTLS_DEMUX *DTLS_DEMUX_new(SSL_CTX *ctx, BIO *bio)
+{
+    DTLS_DEMUX *dm;
+
+    if (ctx == NULL || bio == NULL) {
+        SSLerr(SSL_F_DTLS_DEMUX_NEW, ERR_R_PASSED_NULL_PARAMETER);
+        return NULL;
+    }
+    if ((ctx->method->ssl3_enc->enc_flags & SSL_ENC_FLAG_DTLS) == 0) {
+        SSLerr(SSL_F_DTLS_DEMUX_NEW, SSL_R_WRONG_SSL_VERSION);
+        return NULL;
+    }
+
+    if ((dm = OPENSSL_zalloc(sizeof(*dm))) == NULL
+            || (dm->peers = lh_DTLS_DEMUX_PEER_new(demux_peer_hash,
+                                                   demux_peer_cmp)) == NULL
+            || (dm->scratch = OPENSSL_malloc(DTLS_DEMUX_MAX_DATAGRAM)) == NULL
+            || (dm->addr = BIO_ADDR_new()) == NULL) {
+        SSLerr(SSL_F_DTLS_DEMUX_NEW, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    if (RAND_bytes((unsigned char *)&dm->hash_seed,
+                   sizeof(dm->hash_seed)) <= 0)
+        goto err;
+    /* The hash table grows with the number of peers, never shrinks */
+    lh_DTLS_DEMUX_PEER_set_down_load(dm->peers, 0);
+
+    SSL_CTX_up_ref(ctx);
+    dm->ctx = ctx;
+    dm->bio = bio;
+    return dm;
+
+ err:
+    if (dm != NULL) {
+        lh_DTLS_DEMUX_PEER_free(dm->peers);
+        OPENSSL_free(dm->scratch);
+        BIO_ADDR_free(dm->addr);
+        OPENSSL_free(dm);
+    }
+    return NULL;
+}
+
+void DTLS_DEMUX_free(DTLS_DEMUX *dm)
+{
+    DTLS_DEMUX_PEER *peer;
+    DTLS_DEMUX_BUF *buf;
+
+    if (dm == NULL)
+        return;
+
+    /* Sessions the application hasn't taken are still ours */
+    while ((peer = dm->accept.head) != NULL)
+        SSL_free(peer->ssl);
+    SSL_free(dm->listener);
+
+    /* The rest belong to the application, and just stop receiving */
+    lh_DTLS_DEMUX_PEER_doall(dm->peers, demux_peer_detach);
+    lh_DTLS_DEMUX_PEER_free(dm->peers);
+
+    while ((buf = dm->pool) != NULL) {
+        dm->pool = buf->next;
+        OPENSSL_free(buf);
+    }
+    OPENSSL_free(dm->scratch);
+    BIO_ADDR_free(dm->addr);
+    BIO_free_all(dm->bio);
+    SSL_CTX_free(dm->ctx);
+    OPENSSL_free(dm);
+}
+
+int DTLS_DEMUX_recv(DTLS_DEMUX *dm)
+{
+    DTLS_DEMUX_PEER key, *peer;
+    int n, count;
+
+    for (count = 0; count < DTLS_DEMUX_MAX_RECV; count++) {
+        clear_sys_error();
+        n = BIO_read(dm->bio, dm->scratch, DTLS_DEMUX_MAX_DATAGRAM);
+        if (n <= 0) {
+            if (BIO_should_retry(dm->bio))
+                break;
+            /* An empty datagram carries no record */
+            if (n == 0)
+                continue;
+            return count > 0 ? count : -1;
+        }
+
+        /* Datagrams whose sender we can't tell are dropped */
+        if (BIO_dgram_get_peer(dm->bio, dm->addr) <= 0
+                || !demux_peer_set_key(dm, &key, dm->addr))
+            continue;
+
+        peer = lh_DTLS_DEMUX_PEER_retrieve(dm->peers, &key);
+        if (peer == NULL) {
+            if (demux_new_peer(dm, &key, n) < 0)
+                return -1;
+            continue;
+        }
+        if (!demux_peer_queue(dm, peer, n))
+            return -1;
+        if (peer->list == DTLS_DEMUX_LIST_NONE && peer->queued > 0)
+            demux_list_add(dm, peer, DTLS_DEMUX_LIST_READY);
+    }
+    return count;
+}
+
+SSL *DTLS_DEMUX_accept(DTLS_DEMUX *dm)
+{
+    DTLS_DEMUX_PEER *peer = dm->accept.head;
+
+    if (peer == NULL)
+        return NULL;
+    demux_list_remove(dm, peer);
+    return peer->ssl;
+}
+
+SSL *DTLS_DEMUX_get_readable(DTLS_DEMUX *dm)
+{
+    DTLS_DEMUX_PEER *peer = dm->ready.head;
+
+    if (peer == NULL)
+        return NULL;
+    demux_list_remove(dm, peer);
+    return peer->ssl;
+}
+
+int DTLS_DEMUX_flush(DTLS_DEMUX *dm)
+{
+    return BIO_flush(dm->bio);
+}
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2018-2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "ssl_locl.h"
+#include "internal/ktls.h"
+
+/*
+ * Count the number of records that were not processed yet from record boundary.
+ *
+ * This function assumes that there are only fully formed records read in the
+ * record layer. If read_ahead is enabled, then this might be false and this
+ * function will fail.
+ */
+static int count_unprocessed_records(SSL *s)
+{
+    SSL3_BUFFER *rbuf = RECORD_LAYER_get_rbuf(&s->rlayer);
+    PACKET pkt, subpkt;
+    int count = 0;
+
+    if (!PACKET_buf_init(&pkt, rbuf->buf + rbuf->offset, rbuf->left))
+        return -1;
+
+    while (PACKET_remaining(&pkt) > 0) {
+        /* Skip record type and version */
+        if (!PACKET_forward(&pkt, 3))
+            return -1;
+
+        /* Read until next record */
+        if (!PACKET_get_length_prefixed_2(&pkt, &subpkt))
+            return -1;
+
+        count += 1;
+    }
+
+    return count;
+}
+
+/*
+ * Check if a given cipher is supported by the KTLS interface.
+ * The kernel might still fail the setsockopt() if no suitable
+ * implementation is available, but this checks whether the socket option
+ * can describe the protocol version and cipher in use at all.
+ */
+int ktls_check_supported_cipher(const SSL *s, const EVP_CIPHER *c)
+{
+    switch (s->version) {
+    case TLS1_2_VERSION:
+#ifdef OPENSSL_KTLS_TLS13
+    case TLS1_3_VERSION:
+#endif
+        break;
+    default:
+        return 0;
+    }
+
+    switch (EVP_CIPHER_nid(c)) {
+    case NID_aes_128_gcm:
+#ifdef OPENSSL_KTLS_AES_GCM_256
+    case NID_aes_256_gcm:
+#endif
+#ifdef OPENSSL_KTLS_CHACHA20_POLY1305
+    case NID_chacha20_poly1305:
+#endif
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Fill in |crypto_info| for cipher |c| from the record protection state.
+ * For TLSv1.2 |iv| is the fixed IV and |dd| supplies the explicit part for
+ * GCM; for TLSv1.3 |iv| is the full per-record static IV.  |rl_sequence| is
+ * the record layer sequence number for the direction being configured.
+ * Returns 1 on success or 0 if the kernel cannot take over this state.
+ */
+int ktls_configure_crypto(SSL *s, const EVP_CIPHER *c, EVP_CIPHER_CTX *dd,
+                          void *rl_sequence,
+                          struct tls_crypto_info_all *crypto_info,
+                          int is_tx, unsigned char *iv, unsigned char *key)
+{
+    unsigned char geniv[EVP_GCM_TLS_FIXED_IV_LEN + EVP_GCM_TLS_EXPLICIT_IV_LEN];
+    unsigned char *eiv = iv;
+    unsigned char *rec_seq;
+    int count_unprocessed;
+    int bit;
+
+    if (s->version == TLS1_2_VERSION
+            && EVP_CIPHER_mode(c) == EVP_CIPH_GCM_MODE) {
+        if (EVP_CIPHER_CTX_ctrl(dd, EVP_CTRL_GET_IV, sizeof(geniv),
+                                geniv) <= 0)
+            return 0;
+        eiv = geniv;
+    }
+
+    memset(crypto_info, 0, sizeof(*crypto_info));
+    switch (EVP_CIPHER_nid(c)) {
+    case NID_aes_128_gcm:
+        crypto_info->u.gcm128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        crypto_info->u.gcm128.info.version = s->version;
+        crypto_info->tls_crypto_info_len = sizeof(crypto_info->u.gcm128);
+        memcpy(crypto_info->u.gcm128.salt, eiv,
+               TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+        memcpy(crypto_info->u.gcm128.iv, eiv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+               TLS_CIPHER_AES_GCM_128_IV_SIZE);
+        memcpy(crypto_info->u.gcm128.key, key, EVP_CIPHER_key_length(c));
+        rec_seq = crypto_info->u.gcm128.rec_seq;
+        break;
+#ifdef OPENSSL_KTLS_AES_GCM_256
+    case NID_aes_256_gcm:
+        crypto_info->u.gcm256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        crypto_info->u.gcm256.info.version = s->version;
+        crypto_info->tls_crypto_info_len = sizeof(crypto_info->u.gcm256);
+        memcpy(crypto_info->u.gcm256.salt, eiv,
+               TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+        memcpy(crypto_info->u.gcm256.iv, eiv + TLS_CIPHER_AES_GCM_256_SALT_SIZE,
+               TLS_CIPHER_AES_GCM_256_IV_SIZE);
+        memcpy(crypto_info->u.gcm256.key, key, EVP_CIPHER_key_length(c));
+        rec_seq = crypto_info->u.gcm256.rec_seq;
+        break;
+#endif
+#ifdef OPENSSL_KTLS_CHACHA20_POLY1305
+    case NID_chacha20_poly1305:
+        crypto_info->u.chacha20poly1305.info.cipher_type
+            = TLS_CIPHER_CHACHA20_POLY1305;
+        crypto_info->u.chacha20poly1305.info.version = s->version;
+        crypto_info->tls_crypto_info_len
+            = sizeof(crypto_info->u.chacha20poly1305);
+        memcpy(crypto_info->u.chacha20poly1305.iv, iv,
+               TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE);
+        memcpy(crypto_info->u.chacha20poly1305.key, key,
+               EVP_CIPHER_key_length(c));
+        rec_seq = crypto_info->u.chacha20poly1305.rec_seq;
+        break;
+#endif
+    default:
+        return 0;
+    }
+
+    memcpy(rec_seq, rl_sequence, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+    if (is_tx)
+        return 1;
+
+    /*
+     * Records already pulled into the read buffer were protected with
+     * sequence numbers the kernel must skip past.
+     */
+    count_unprocessed = count_unprocessed_records(s);
+    if (count_unprocessed < 0) {
+        OPENSSL_cleanse(crypto_info, sizeof(*crypto_info));
+        return 0;
+    }
+
+    /* increment the crypto_info record sequence */
+    while (count_unprocessed) {
+        for (bit = 7; bit >= 0; bit--) { /* increment */
+            ++rec_seq[bit];
+            if (rec_seq[bit] != 0)
+                break;
+        }
+        count_unprocessed--;
+    }
+
+    return 1;
+}
@@ -307,6 +307,22 @@ int dtls1_process_buffered_records(SSL *s)
     return 1;
 }
 
+/*
+ * Checks if the read BIO is a datagram BIO that has received datagrams in a
+ * batch, or a DTLS_DEMUX session BIO that has datagrams queued, that have not
+ * been read yet. These can be processed by further calls to
+ * dtls1_read_bytes() without waiting for the socket to become readable.
+ */
+int dtls1_read_batch_pending(const SSL *s)
+{
+    BIO *rbio = SSL_get_rbio(s);
+
+    return rbio != NULL
+        && (BIO_method_type(rbio) == BIO_TYPE_DGRAM
+            || BIO_method_type(rbio) == BIO_TYPE_DGRAM_DEMUX)
+        && BIO_ctrl_pending(rbio) > 0;
+}
+
 /*-
  * Return up to 'len' payload bytes received in 'type' records.
  * 'type' is one of the following:
@@ -46,6 +46,8 @@ void RECORD_LAYER_clear(RECORD_LAYER *rl)
     rl->packet = NULL;
     rl->packet_length = 0;
     rl->wnum = 0;
+    rl->wiov_next = 0;
+    rl->wiov_off = 0;
     memset(rl->handshake_fragment, 0, sizeof(rl->handshake_fragment));
     rl->handshake_fragment_len = 0;
     rl->wpend_tot = 0;
@@ -135,6 +137,24 @@ void SSL_set_default_read_buffer_len(SSL *s, size_t len)
     SSL3_BUFFER_set_default_len(RECORD_LAYER_get_rbuf(&s->rlayer), len);
 }
 
+int SSL_CTX_set_buffer_pool_size(SSL_CTX *ctx, size_t max_idle)
+{
+    SSL_BUF_POOL *pool = NULL;
+
+    if (max_idle > 0 && (pool = ssl_buf_pool_new(max_idle)) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_BUFFER_POOL_SIZE, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    ssl_buf_pool_free(ctx->bufpool);
+    ctx->bufpool = pool;
+    return 1;
+}
+
+size_t SSL_CTX_get_buffer_pool_size(const SSL_CTX *ctx)
+{
+    return ssl_buf_pool_max_idle(ctx->bufpool);
+}
+
 const char *SSL_rstate_string_long(const SSL *s)
 {
     switch (s->rlayer.rstate) {
@@ -202,10 +222,11 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
         /* start with empty packet ... */
         if (left == 0)
             rb->offset = align;
-        else if (align != 0 && left >= SSL3_RT_HEADER_LENGTH) {
+        else if (align != 0 && left >= SSL3_RT_HEADER_LENGTH && clearold) {
             /*
              * check if next packet length is large enough to justify payload
-             * alignment...
+             * alignment... but not if earlier pipelined records are still in
+             * the buffer waiting to be decrypted.
              */
             pkt = rb->buf + rb->offset;
             if (pkt[0] == SSL3_RT_APPLICATION_DATA
@@ -562,7 +583,7 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
      * If max_pipelines is 0 then this means "undefined" and we default to
      * 1 pipeline. Similarly if the cipher does not support pipelined
      * processing then we also only use 1 pipeline, or if we're not using
-     * explicit IVs
+     * explicit IVs, or if the kernel is doing the encryption
      */
     maxpipes = s->max_pipelines;
     if (maxpipes > SSL_MAX_PIPELINES) {
@@ -578,7 +599,8 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
         || s->enc_write_ctx == NULL
         || !(EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(s->enc_write_ctx))
              & EVP_CIPH_FLAG_PIPELINE)
-        || !SSL_USE_EXPLICIT_IV(s))
+        || !SSL_USE_EXPLICIT_IV(s)
+        || BIO_get_ktls_send(s->wbio))
         maxpipes = 1;
     if (max_send_fragment == 0 || split_send_fragment == 0
         || split_send_fragment > max_send_fragment) {
@@ -653,9 +675,159 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
     }
 }
 
+static int do_ssl3_write_int(SSL *s, int type, const unsigned char *buf,
+                             const SSL_IOVEC *iov, size_t *pipelens,
+                             size_t numpipes, int create_empty_fragment,
+                             size_t *written);
+
+/*
+ * Application data records can only be sealed in place over the caller's
+ * buffers once the handshake is done and each record is simply the payload
+ * run through the write cipher. Anything else (compression, the CBC empty
+ * fragment, KTLS, DTLS, early data) goes through the copying path.
+ */
+static int ssl3_can_write_in_place(SSL *s)
+{
+    return !SSL_IS_DTLS(s)
+        && !SSL_in_init(s)
+        && s->enc_write_ctx != NULL
+        && s->statem.enc_write_state == ENC_WRITE_STATE_VALID
+        && s->compress == NULL
+        && !s->s3.need_empty_fragments
+        && (s->early_data_state == SSL_EARLY_DATA_NONE
+            || s->early_data_state == SSL_EARLY_DATA_FINISHED_WRITING
+            || s->early_data_state == SSL_EARLY_DATA_FINISHED_READING)
+        && !BIO_get_ktls_send(s->wbio);
+}
+
+/*
+ * Write every element of |iov| as application data, see SSL_write_iov(3).
+ * Progress across non-blocking retries is kept in s->rlayer.wiov_next and
+ * s->rlayer.wiov_off. Return values are as per SSL_write().
+ */
+int ssl3_write_iov(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                   size_t *written)
+{
+    SSL3_BUFFER *wb = &s->rlayer.wbuf[0];
+    size_t next = s->rlayer.wiov_next, off = s->rlayer.wiov_off;
+    size_t tot = 0, maxpipes, numpipes, j, tmpwrit;
+    size_t pipelens[SSL_MAX_PIPELINES];
+    int i;
+
+    s->rwstate = SSL_NOTHING;
+    s->rlayer.wiov_next = 0;
+    s->rlayer.wiov_off = 0;
+
+    if (next > iovcnt || (next == iovcnt && off != 0)
+            || (next < iovcnt && off > iov[next].len)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_WRITE_IOV,
+                 SSL_R_BAD_LENGTH);
+        return -1;
+    }
+
+    /* Finish off records that an earlier call sealed in place */
+    if (wb->app_buffer && RECORD_LAYER_write_pending(&s->rlayer)) {
+        i = ssl3_write_pending(s, SSL3_RT_APPLICATION_DATA,
+                               (const unsigned char *)&iov[next],
+                               s->rlayer.wpend_tot, &tmpwrit);
+        if (i <= 0) {
+            /* SSLfatal() already called if appropriate */
+            s->rlayer.wiov_next = next;
+            return i;
+        }
+        next += s->rlayer.numwpipes;
+        ssl3_release_write_buffer(s);
+    }
+
+    /*
+     * As in ssl3_write_bytes(): send a pending KeyUpdate, or finish the
+     * handshake, before any application data.
+     */
+    if (!RECORD_LAYER_write_pending(&s->rlayer)
+            && s->key_update != SSL_KEY_UPDATE_NONE)
+        ossl_statem_set_in_init(s, 1);
+
+    if (SSL_in_init(s) && !ossl_statem_get_in_handshake(s)
+            && s->early_data_state != SSL_EARLY_DATA_UNAUTH_WRITING) {
+        i = s->handshake_func(s);
+        if (i <= 0) {
+            /* SSLfatal() already called if appropriate */
+            s->rlayer.wiov_next = next;
+            return i < 0 ? i : -1;
+        }
+    }
+
+    if (RECORD_LAYER_write_pending(&s->rlayer) || !ssl3_can_write_in_place(s)) {
+        /* Copy each element through the normal write path */
+        for (; next < iovcnt; next++, off = 0) {
+            while (off < iov[next].len) {
+                i = s->method->ssl_write(s, iov[next].data + off,
+                                         iov[next].len - off, &tmpwrit);
+                if (i <= 0) {
+                    s->rlayer.wiov_next = next;
+                    s->rlayer.wiov_off = off;
+                    return i;
+                }
+                off += tmpwrit;
+            }
+        }
+    } else {
+        maxpipes = s->max_pipelines;
+        if (maxpipes == 0
+            || maxpipes > SSL_MAX_PIPELINES
+            || !(EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(s->enc_write_ctx))
+                 & EVP_CIPH_FLAG_PIPELINE)
+            || !SSL_USE_EXPLICIT_IV(s))
+            maxpipes = 1;
+
+        while (next < iovcnt) {
+            /* Empty elements carry nothing, don't send empty records */
+            if (iov[next].len == 0) {
+                next++;
+                continue;
+            }
+            for (numpipes = 0; numpipes < maxpipes
+                               && next + numpipes < iovcnt
+                               && iov[next + numpipes].len != 0; numpipes++)
+                pipelens[numpipes] = iov[next + numpipes].len;
+
+            i = do_ssl3_write_int(s, SSL3_RT_APPLICATION_DATA,
+                                  (const unsigned char *)&iov[next],
+                                  &iov[next], pipelens, numpipes, 0,
+                                  &tmpwrit);
+            if (i <= 0) {
+                /* SSLfatal() already called if appropriate */
+                s->rlayer.wiov_next = next;
+                return i;
+            }
+            next += numpipes;
+            ssl3_release_write_buffer(s);
+        }
+    }
+
+    for (j = 0; j < iovcnt; j++)
+        tot += iov[j].len;
+    *written = tot;
+    return 1;
+}
+
 int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                   size_t *pipelens, size_t numpipes,
                   int create_empty_fragment, size_t *written)
+{
+    return do_ssl3_write_int(s, type, buf, NULL, pipelens, numpipes,
+                             create_empty_fragment, written);
+}
+
+/*
+ * As do_ssl3_write(), but if |iov| is not NULL each record j is sealed in
+ * place around iov[j].data instead of being copied into our own write
+ * buffers. |buf| then only identifies the write for ssl3_write_pending().
+ */
+static int do_ssl3_write_int(SSL *s, int type, const unsigned char *buf,
+                             const SSL_IOVEC *iov, size_t *pipelens,
+                             size_t numpipes, int create_empty_fragment,
+                             size_t *written)
 {
     WPACKET pkt[SSL_MAX_PIPELINES];
     SSL3_RECORD wr[SSL_MAX_PIPELINES];
@@ -692,7 +864,7 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         /* if it went, fall through and send more stuff */
     }
 
-    if (s->rlayer.numwpipes < numpipes) {
+    if (iov == NULL && s->rlayer.numwpipes < numpipes) {
         if (!ssl3_setup_write_buffer(s, numpipes, 0)) {
             /* SSLfatal() already called */
             return -1;
@@ -718,6 +890,40 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         }
     }
 
+    /* Explicit IV length, block ciphers appropriate version flag */
+    if (s->enc_write_ctx && SSL_USE_EXPLICIT_IV(s) && !SSL_TREAT_AS_TLS13(s)) {
+        int mode = EVP_CIPHER_CTX_mode(s->enc_write_ctx);
+        if (mode == EVP_CIPH_CBC_MODE) {
+            /* TODO(size_t): Convert me */
+            eivlen = EVP_CIPHER_CTX_iv_length(s->enc_write_ctx);
+            if (eivlen <= 1)
+                eivlen = 0;
+        } else if (mode == EVP_CIPH_GCM_MODE) {
+            /* Need explicit part of IV for GCM mode */
+            eivlen = EVP_GCM_TLS_EXPLICIT_IV_LEN;
+        } else if (mode == EVP_CIPH_CCM_MODE) {
+            eivlen = EVP_CCM_TLS_EXPLICIT_IV_LEN;
+        }
+    }
+
+    if (iov != NULL) {
+        size_t headroom = SSL3_RT_HEADER_LENGTH + eivlen;
+
+        /*
+         * Nothing is pending, so our own buffers can go: the records are
+         * written out straight from the caller's memory.
+         */
+        ssl3_release_write_buffer(s);
+        for (j = 0; j < numpipes; j++) {
+            wb = &s->rlayer.wbuf[j];
+            memset(wb, 0, sizeof(*wb));
+            wb->buf = iov[j].data - headroom;
+            wb->len = headroom + iov[j].len + SSL_WRITE_IOV_TAILROOM;
+            wb->app_buffer = 1;
+        }
+        s->rlayer.numwpipes = numpipes;
+    }
+
     /*
      * 'create_empty_fragment' is true only when this function calls itself
      */
@@ -767,7 +973,18 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         goto wpacket_init_complete;
     }
 
-    if (create_empty_fragment) {
+    if (iov != NULL) {
+        for (j = 0; j < numpipes; j++) {
+            wb = &s->rlayer.wbuf[j];
+            if (!WPACKET_init_static_len(&pkt[j], SSL3_BUFFER_get_buf(wb),
+                                         SSL3_BUFFER_get_len(wb), 0)) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
+                         ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
+            wpinited++;
+        }
+    } else if (create_empty_fragment) {
         wb = &s->rlayer.wbuf[0];
 #if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD!=0
         /*
@@ -820,22 +1037,6 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         }
     }
 
-    /* Explicit IV length, block ciphers appropriate version flag */
-    if (s->enc_write_ctx && SSL_USE_EXPLICIT_IV(s) && !SSL_TREAT_AS_TLS13(s)) {
-        int mode = EVP_CIPHER_CTX_mode(s->enc_write_ctx);
-        if (mode == EVP_CIPH_CBC_MODE) {
-            /* TODO(size_t): Convert me */
-            eivlen = EVP_CIPHER_CTX_iv_length(s->enc_write_ctx);
-            if (eivlen <= 1)
-                eivlen = 0;
-        } else if (mode == EVP_CIPH_GCM_MODE) {
-            /* Need explicit part of IV for GCM mode */
-            eivlen = EVP_GCM_TLS_EXPLICIT_IV_LEN;
-        } else if (mode == EVP_CIPH_CCM_MODE) {
-            eivlen = EVP_CCM_TLS_EXPLICIT_IV_LEN;
-        }
-    }
-
  wpacket_init_complete:
 
     totlen = 0;
@@ -900,7 +1101,8 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         /* lets setup the record stuff. */
         SSL3_RECORD_set_data(thiswr, compressdata);
         SSL3_RECORD_set_length(thiswr, pipelens[j]);
-        SSL3_RECORD_set_input(thiswr, (unsigned char *)&buf[totlen]);
+        SSL3_RECORD_set_input(thiswr, iov != NULL ? iov[j].data
+                                                  : (unsigned char *)&buf[totlen]);
         totlen += pipelens[j];
 
         /*
@@ -919,6 +1121,16 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         } else {
             if (BIO_get_ktls_send(s->wbio)) {
                 SSL3_RECORD_reset_data(&wr[j]);
+            } else if (iov != NULL) {
+                /* The payload already sits right behind the header */
+                if (compressdata != iov[j].data
+                        || !WPACKET_allocate_bytes(thispkt, thiswr->length,
+                                                   NULL)) {
+                    SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
+                             ERR_R_INTERNAL_ERROR);
+                    goto err;
+                }
+                SSL3_RECORD_reset_input(&wr[j]);
             } else {
                 if (!WPACKET_memcpy(thispkt, thiswr->input, thiswr->length)) {
                     SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
@@ -929,7 +1141,12 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
             }
         }
 
+        /*
+         * With KTLS the kernel appends the inner content type, which is
+         * passed down separately as a control message.
+         */
         if (SSL_TREAT_AS_TLS13(s)
+                && !BIO_get_ktls_send(s->wbio)
                 && s->enc_write_ctx != NULL
                 && (s->statem.enc_write_state != ENC_WRITE_STATE_WRITE_PLAIN_ALERTS
                     || type != SSL3_RT_ALERT)) {
@@ -948,6 +1165,13 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
             if (rlen < max_send_fragment) {
                 size_t padding = 0;
                 size_t max_padding = max_send_fragment - rlen;
+
+                /* The type byte and tag also live in the caller's tailroom */
+                if (iov != NULL
+                        && max_padding > SSL_WRITE_IOV_TAILROOM - 1
+                                         - SSL_RT_MAX_CIPHER_BLOCK_SIZE)
+                    max_padding = SSL_WRITE_IOV_TAILROOM - 1
+                                  - SSL_RT_MAX_CIPHER_BLOCK_SIZE;
                 if (s->record_padding_cb != NULL) {
                     padding = s->record_padding_cb(s, type, rlen, s->record_padding_arg);
                 } else if (s->block_padding > 0) {
@@ -25,6 +25,8 @@ typedef struct ssl3_buffer_st {
     size_t offset;
     /* how many bytes left */
     size_t left;
+    /* buf belongs to the application (SSL_write_iov()), never free it */
+    int app_buffer;
 } SSL3_BUFFER;
 
 #define SEQ_NUM_SIZE                            8
@@ -149,6 +151,9 @@ typedef struct record_layer_st {
     size_t packet_length;
     /* number of bytes sent so far */
     size_t wnum;
+    /* SSL_write_iov() progress: next element and offset into it */
+    size_t wiov_next;
+    size_t wiov_off;
     unsigned char handshake_fragment[4];
     size_t handshake_fragment_len;
     /* The number of consecutive empty records we have received */
@@ -190,6 +195,16 @@ typedef struct record_layer_st {
                                                 ((rl)->d->unprocessed_rcds)
 #define RECORD_LAYER_get_rbuf(rl)               (&(rl)->rbuf)
 #define RECORD_LAYER_get_wbuf(rl)               ((rl)->wbuf)
+#define RECORD_LAYER_get_read_sequence(rl)      ((rl)->read_sequence)
+#define RECORD_LAYER_get_write_sequence(rl)     ((rl)->write_sequence)
+
+typedef struct ssl_buf_pool_st SSL_BUF_POOL;
+
+int ssl_buf_pool_init(void);
+void ssl_buf_pool_cleanup(void);
+SSL_BUF_POOL *ssl_buf_pool_new(size_t max_idle);
+void ssl_buf_pool_free(SSL_BUF_POOL *pool);
+size_t ssl_buf_pool_max_idle(const SSL_BUF_POOL *pool);
 
 void RECORD_LAYER_init(RECORD_LAYER *rl, SSL *s);
 void RECORD_LAYER_clear(RECORD_LAYER *rl);
@@ -207,6 +222,8 @@ __owur int ssl3_write_bytes(SSL *s, int type, const void *buf, size_t len,
 int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                   size_t *pipelens, size_t numpipes,
                   int create_empty_fragment, size_t *written);
+__owur int ssl3_write_iov(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                          size_t *written);
 __owur int ssl3_read_bytes(SSL *s, int type, int *recvd_type,
                            unsigned char *buf, size_t len, int peek,
                            size_t *readbytes);
@@ -232,5 +249,6 @@ __owur int dtls1_write_bytes(SSL *s, int type, const void *buf, size_t len,
 int do_dtls1_write(SSL *s, int type, const unsigned char *buf,
                    size_t len, int create_empty_fragment, size_t *written);
 void dtls1_reset_seq_numbers(SSL *s, int rw);
+int dtls1_read_batch_pending(const SSL *s);
 int dtls_buffer_listen_record(SSL *s, size_t len, unsigned char *seq,
                               size_t off);
@@ -10,6 +10,334 @@
 #include "../ssl_locl.h"
 #include "record_locl.h"
 
+/*
+ * Record buffer pool
+ *
+ * An SSL_CTX can keep idle record buffers around for its connections to
+ * borrow, so that a connection only owns buffers while it has data in
+ * flight (SSL_MODE_RELEASE_BUFFERS) without paying for malloc/free on every
+ * transition. The pool is a classic magazine allocator: every thread is dealt
+ * one of BUF_POOL_SHARDS shards, each holding a loaded and a previous
+ * magazine per buffer size, and a shared depot holds spare full magazines.
+ * Threads only touch the depot lock when both of their magazines run empty or
+ * full. Buffers are classed by their exact length, which already captures
+ * max_send_fragment, read_ahead, compression and DTLS; pipelined writes just
+ * take several buffers of one class.
+ *
+ * Pooled buffers are plain OPENSSL_malloc() memory, so a buffer may be
+ * returned to a different pool, or just freed, without harm. They are
+ * cleansed before they go back into a pool: a read buffer holds decrypted
+ * plaintext, which must not reach the next connection that borrows it.
+ */
+#define BUF_POOL_SHARDS     8
+#define BUF_POOL_CLASSES    4
+#define BUF_POOL_MAG_SIZE   8
+
+typedef struct buf_mag_st {
+    struct buf_mag_st *next;
+    size_t n;
+    unsigned char *bufs[BUF_POOL_MAG_SIZE];
+} BUF_MAG;
+
+typedef struct {
+    size_t len;
+    BUF_MAG *loaded;
+    BUF_MAG *prev;
+} BUF_SHARD_CLASS;
+
+typedef struct {
+    CRYPTO_RWLOCK *lock;
+    BUF_SHARD_CLASS cls[BUF_POOL_CLASSES];
+} BUF_SHARD;
+
+typedef struct {
+    size_t len;
+    size_t nfull;
+    BUF_MAG *full;
+} BUF_DEPOT_CLASS;
+
+struct ssl_buf_pool_st {
+    size_t max_idle;
+    /* Depot, protected by |lock| */
+    CRYPTO_RWLOCK *lock;
+    size_t maxfull;
+    BUF_DEPOT_CLASS cls[BUF_POOL_CLASSES];
+    BUF_MAG *empty;
+    unsigned int next_shard;
+    BUF_SHARD shards[BUF_POOL_SHARDS];
+};
+
+/* Which shard this thread uses, as a pointer into |shard_tags| */
+static CRYPTO_THREAD_LOCAL shard_key;
+static int shard_key_inited = 0;
+static const char shard_tags[BUF_POOL_SHARDS];
+
+int ssl_buf_pool_init(void)
+{
+    if (!CRYPTO_THREAD_init_local(&shard_key, NULL))
+        return 0;
+    shard_key_inited = 1;
+    return 1;
+}
+
+void ssl_buf_pool_cleanup(void)
+{
+    if (shard_key_inited) {
+        CRYPTO_THREAD_cleanup_local(&shard_key);
+        shard_key_inited = 0;
+    }
+}
+
+SSL_BUF_POOL *ssl_buf_pool_new(size_t max_idle)
+{
+    SSL_BUF_POOL *pool = OPENSSL_zalloc(sizeof(*pool));
+    size_t i;
+
+    if (pool == NULL)
+        return NULL;
+    pool->max_idle = max_idle;
+    pool->maxfull = (max_idle + BUF_POOL_MAG_SIZE - 1) / BUF_POOL_MAG_SIZE;
+    if ((pool->lock = CRYPTO_THREAD_lock_new()) == NULL)
+        goto err;
+    for (i = 0; i < BUF_POOL_SHARDS; i++)
+        if ((pool->shards[i].lock = CRYPTO_THREAD_lock_new()) == NULL)
+            goto err;
+    return pool;
+ err:
+    ssl_buf_pool_free(pool);
+    return NULL;
+}
+
+static void buf_mag_free(BUF_MAG *mag)
+{
+    while (mag != NULL) {
+        BUF_MAG *next = mag->next;
+
+        while (mag->n > 0)
+            OPENSSL_free(mag->bufs[--mag->n]);
+        OPENSSL_free(mag);
+        mag = next;
+    }
+}
+
+void ssl_buf_pool_free(SSL_BUF_POOL *pool)
+{
+    size_t i, j;
+
+    if (pool == NULL)
+        return;
+    for (i = 0; i < BUF_POOL_SHARDS; i++) {
+        for (j = 0; j < BUF_POOL_CLASSES; j++) {
+            buf_mag_free(pool->shards[i].cls[j].loaded);
+            buf_mag_free(pool->shards[i].cls[j].prev);
+        }
+        CRYPTO_THREAD_lock_free(pool->shards[i].lock);
+    }
+    for (j = 0; j < BUF_POOL_CLASSES; j++)
+        buf_mag_free(pool->cls[j].full);
+    buf_mag_free(pool->empty);
+    CRYPTO_THREAD_lock_free(pool->lock);
+    OPENSSL_free(pool);
+}
+
+size_t ssl_buf_pool_max_idle(const SSL_BUF_POOL *pool)
+{
+    return pool == NULL ? 0 : pool->max_idle;
+}
+
+static BUF_SHARD *buf_pool_shard(SSL_BUF_POOL *pool)
+{
+    const char *tag = NULL;
+    unsigned int n = 0;
+
+    if (shard_key_inited)
+        tag = CRYPTO_THREAD_get_local(&shard_key);
+    if (tag == NULL) {
+        /* First pool operation on this thread: deal it a shard */
+        if (CRYPTO_THREAD_write_lock(pool->lock)) {
+            n = pool->next_shard++;
+            CRYPTO_THREAD_unlock(pool->lock);
+        }
+        tag = &shard_tags[n % BUF_POOL_SHARDS];
+        if (shard_key_inited)
+            CRYPTO_THREAD_set_local(&shard_key, (void *)tag);
+    }
+    return &pool->shards[tag - shard_tags];
+}
+
+/*
+ * Find the class for |len| in this shard, claiming a free slot for it if
+ * there is none yet. Called with the shard lock held.
+ */
+static BUF_SHARD_CLASS *buf_shard_class(BUF_SHARD *shard, size_t len)
+{
+    BUF_SHARD_CLASS *c;
+    size_t i;
+
+    for (i = 0; i < BUF_POOL_CLASSES; i++) {
+        c = &shard->cls[i];
+        if (c->len == len)
+            return c;
+        if (c->len == 0) {
+            if (c->loaded == NULL
+                    && (c->loaded = OPENSSL_zalloc(sizeof(BUF_MAG))) == NULL)
+                return NULL;
+            if (c->prev == NULL
+                    && (c->prev = OPENSSL_zalloc(sizeof(BUF_MAG))) == NULL)
+                return NULL;
+            c->len = len;
+            return c;
+        }
+    }
+    return NULL;
+}
+
+/* Called with the depot lock held */
+static BUF_DEPOT_CLASS *buf_depot_class(SSL_BUF_POOL *pool, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < BUF_POOL_CLASSES; i++) {
+        if (pool->cls[i].len == len)
+            return &pool->cls[i];
+        if (pool->cls[i].len == 0) {
+            pool->cls[i].len = len;
+            return &pool->cls[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Swap the empty magazine |mag| for a full one of |len| byte buffers from
+ * the depot. Returns |mag| unchanged if the depot has none.
+ */
+static BUF_MAG *buf_depot_get_full(SSL_BUF_POOL *pool, size_t len,
+                                   BUF_MAG *mag)
+{
+    BUF_DEPOT_CLASS *dc;
+    BUF_MAG *full;
+
+    if (!CRYPTO_THREAD_write_lock(pool->lock))
+        return mag;
+    dc = buf_depot_class(pool, len);
+    if (dc != NULL && (full = dc->full) != NULL) {
+        dc->full = full->next;
+        dc->nfull--;
+        full->next = NULL;
+        mag->next = pool->empty;
+        pool->empty = mag;
+        mag = full;
+    }
+    CRYPTO_THREAD_unlock(pool->lock);
+    return mag;
+}
+
+/*
+ * Hand the full magazine |mag| of |len| byte buffers to the depot in
+ * exchange for an empty one. If the depot is at its limit the buffers are
+ * freed instead and |mag| comes back empty.
+ */
+static BUF_MAG *buf_depot_put_full(SSL_BUF_POOL *pool, size_t len,
+                                   BUF_MAG *mag)
+{
+    BUF_DEPOT_CLASS *dc = NULL;
+    BUF_MAG *empty = NULL;
+
+    if (CRYPTO_THREAD_write_lock(pool->lock)) {
+        dc = buf_depot_class(pool, len);
+        if (dc != NULL && dc->nfull < pool->maxfull) {
+            if ((empty = pool->empty) != NULL)
+                pool->empty = empty->next;
+            else
+                empty = OPENSSL_zalloc(sizeof(*empty));
+            if (empty != NULL) {
+                empty->next = NULL;
+                mag->next = dc->full;
+                dc->full = mag;
+                dc->nfull++;
+            }
+        }
+        CRYPTO_THREAD_unlock(pool->lock);
+    }
+    if (empty != NULL)
+        return empty;
+
+    while (mag->n > 0)
+        OPENSSL_free(mag->bufs[--mag->n]);
+    return mag;
+}
+
+static SSL_BUF_POOL *ssl_buf_pool_of(const SSL *s)
+{
+    return s->ctx != NULL ? s->ctx->bufpool : NULL;
+}
+
+static unsigned char *ssl_buf_pool_get(SSL_BUF_POOL *pool, size_t len)
+{
+    BUF_SHARD *shard;
+    BUF_SHARD_CLASS *c;
+    BUF_MAG *tmp;
+    unsigned char *p = NULL;
+
+    if (pool == NULL || pool->max_idle == 0)
+        return OPENSSL_malloc(len);
+
+    shard = buf_pool_shard(pool);
+    if (!CRYPTO_THREAD_write_lock(shard->lock))
+        return OPENSSL_malloc(len);
+    if ((c = buf_shard_class(shard, len)) != NULL) {
+        if (c->loaded->n == 0 && c->prev->n != 0) {
+            tmp = c->loaded;
+            c->loaded = c->prev;
+            c->prev = tmp;
+        }
+        if (c->loaded->n == 0)
+            c->loaded = buf_depot_get_full(pool, len, c->loaded);
+        if (c->loaded->n > 0)
+            p = c->loaded->bufs[--c->loaded->n];
+    }
+    CRYPTO_THREAD_unlock(shard->lock);
+
+    return p != NULL ? p : OPENSSL_malloc(len);
+}
+
+static void ssl_buf_pool_put(SSL_BUF_POOL *pool, unsigned char *buf,
+                             size_t len)
+{
+    BUF_SHARD *shard;
+    BUF_SHARD_CLASS *c;
+    BUF_MAG *tmp;
+
+    if (buf == NULL)
+        return;
+    if (pool == NULL || pool->max_idle == 0) {
+        OPENSSL_free(buf);
+        return;
+    }
+
+    OPENSSL_cleanse(buf, len);
+    shard = buf_pool_shard(pool);
+    if (!CRYPTO_THREAD_write_lock(shard->lock)) {
+        OPENSSL_free(buf);
+        return;
+    }
+    if ((c = buf_shard_class(shard, len)) != NULL) {
+        if (c->loaded->n == BUF_POOL_MAG_SIZE) {
+            if (c->prev->n == BUF_POOL_MAG_SIZE)
+                c->prev = buf_depot_put_full(pool, len, c->prev);
+            tmp = c->loaded;
+            c->loaded = c->prev;
+            c->prev = tmp;
+        }
+        c->loaded->bufs[c->loaded->n++] = buf;
+        buf = NULL;
+    }
+    CRYPTO_THREAD_unlock(shard->lock);
+
+    OPENSSL_free(buf);
+}
+
 void SSL3_BUFFER_set_data(SSL3_BUFFER *b, const unsigned char *d, size_t n)
 {
     if (d != NULL)
@@ -60,7 +388,7 @@ int ssl3_setup_read_buffer(SSL *s)
 #endif
         if (b->default_len > len)
             len = b->default_len;
-        if ((p = OPENSSL_malloc(len)) == NULL) {
+        if ((p = ssl_buf_pool_get(ssl_buf_pool_of(s), len)) == NULL) {
             /*
              * We've got a malloc failure, and we're still initialising buffers.
              * We assume we're so doomed that we won't even be able to send an
@@ -111,14 +439,17 @@ int ssl3_setup_write_buffer(SSL *s, size_t numwpipes, size_t len)
     for (currpipe = 0; currpipe < numwpipes; currpipe++) {
         SSL3_BUFFER *thiswb = &wb[currpipe];
 
-        if (thiswb->len != len) {
-            OPENSSL_free(thiswb->buf);
+        if (thiswb->app_buffer) {
+            /* Left over from SSL_write_iov(), not ours to free */
+            memset(thiswb, 0, sizeof(SSL3_BUFFER));
+        } else if (thiswb->len != len) {
+            ssl_buf_pool_put(ssl_buf_pool_of(s), thiswb->buf, thiswb->len);
             thiswb->buf = NULL;         /* force reallocation */
         }
 
         if (thiswb->buf == NULL) {
             if (s->wbio == NULL || !BIO_get_ktls_send(s->wbio)) {
-                p = OPENSSL_malloc(len);
+                p = ssl_buf_pool_get(ssl_buf_pool_of(s), len);
                 if (p == NULL) {
                     s->rlayer.numwpipes = currpipe;
                     /*
@@ -164,9 +495,11 @@ int ssl3_release_write_buffer(SSL *s)
     while (pipes > 0) {
         wb = &RECORD_LAYER_get_wbuf(&s->rlayer)[pipes - 1];
 
-        if (s->wbio == NULL || !BIO_get_ktls_send(s->wbio))
-            OPENSSL_free(wb->buf);
+        if (!wb->app_buffer
+                && (s->wbio == NULL || !BIO_get_ktls_send(s->wbio)))
+            ssl_buf_pool_put(ssl_buf_pool_of(s), wb->buf, wb->len);
         wb->buf = NULL;
+        wb->app_buffer = 0;
         pipes--;
     }
     s->rlayer.numwpipes = 0;
@@ -178,7 +511,7 @@ int ssl3_release_read_buffer(SSL *s)
     SSL3_BUFFER *b;
 
     b = RECORD_LAYER_get_rbuf(&s->rlayer);
-    OPENSSL_free(b->buf);
+    ssl_buf_pool_put(ssl_buf_pool_of(s), b->buf, b->len);
     b->buf = NULL;
     return 1;
 }
@@ -188,10 +188,12 @@ int ssl3_get_record(SSL *s)
     PACKET pkt, sslv2pkt;
     size_t first_rec_len;
     int is_ktls_left;
+    int using_ktls;
 
     rr = RECORD_LAYER_get_rrec(&s->rlayer);
     rbuf = RECORD_LAYER_get_rbuf(&s->rlayer);
     is_ktls_left = (rbuf->left > 0);
+    using_ktls = BIO_get_ktls_recv(s->rbio);
     max_recs = s->max_pipelines;
     if (max_recs == 0)
         max_recs = 1;
@@ -230,6 +232,11 @@ int ssl3_get_record(SSL *s)
                              SSL_F_SSL3_GET_RECORD,
                              SSL_R_WRONG_VERSION_NUMBER);
                     break;
+                case EPROTO:
+                    SSLfatal(s, SSL_AD_UNEXPECTED_MESSAGE,
+                             SSL_F_SSL3_GET_RECORD,
+                             SSL_R_BAD_RECORD_TYPE);
+                    break;
                 default:
                     break;
                 }
@@ -366,7 +373,11 @@ int ssl3_get_record(SSL *s)
                     }
                 }
 
-                if (SSL_IS_TLS13(s) && s->enc_read_ctx != NULL) {
+                /*
+                 * With KTLS the kernel has already removed the record
+                 * protection and reports the inner content type here.
+                 */
+                if (SSL_IS_TLS13(s) && s->enc_read_ctx != NULL && !using_ktls) {
                     if (thisrr->type != SSL3_RT_APPLICATION_DATA
                             && (thisrr->type != SSL3_RT_CHANGE_CIPHER_SPEC
                                 || !SSL_IS_FIRST_HANDSHAKE(s))
@@ -396,7 +407,8 @@ int ssl3_get_record(SSL *s)
         }
 
         if (SSL_IS_TLS13(s)) {
-            if (thisrr->length > SSL3_RT_MAX_TLS13_ENCRYPTED_LENGTH) {
+            if (thisrr->length > SSL3_RT_MAX_TLS13_ENCRYPTED_LENGTH
+                    && !using_ktls) {
                 SSLfatal(s, SSL_AD_RECORD_OVERFLOW, SSL_F_SSL3_GET_RECORD,
                          SSL_R_ENCRYPTED_LENGTH_TOO_LONG);
                 return -1;
@@ -484,6 +496,7 @@ int ssl3_get_record(SSL *s)
     } while (num_recs < max_recs
              && thisrr->type == SSL3_RT_APPLICATION_DATA
              && SSL_USE_EXPLICIT_IV(s)
+             && !using_ktls
              && s->enc_read_ctx != NULL
              && (EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(s->enc_read_ctx))
                  & EVP_CIPH_FLAG_PIPELINE)
@@ -727,9 +740,14 @@ int ssl3_get_record(SSL *s)
             }
         }
 
+        /*
+         * KTLS hands us the unprotected record: the padding has been
+         * stripped and the header already carries the real content type.
+         */
         if (SSL_IS_TLS13(s)
                 && s->enc_read_ctx != NULL
-                && thisrr->type != SSL3_RT_ALERT) {
+                && thisrr->type != SSL3_RT_ALERT
+                && !(using_ktls && !is_ktls_left)) {
             size_t end;
 
             if (thisrr->length == 0
@@ -47,6 +47,119 @@ int SSL_get_ex_data_X509_STORE_CTX_idx(void)
     return ssl_x509_store_ctx_idx;
 }
 
+struct ssl_cert_msg_cache_st {
+    SSL_CERT_MSG *msgs[SSL_PKEY_NUM];
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+};
+
+static SSL_CERT_MSG_CACHE *ssl_cert_msg_cache_new(void)
+{
+    SSL_CERT_MSG_CACHE *ret = OPENSSL_zalloc(sizeof(*ret));
+
+    if (ret == NULL)
+        return NULL;
+
+    ret->references = 1;
+    ret->lock = CRYPTO_THREAD_lock_new();
+    if (ret->lock == NULL) {
+        OPENSSL_free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+static void ssl_cert_msg_cache_free(SSL_CERT_MSG_CACHE *cache)
+{
+    int i;
+
+    if (cache == NULL)
+        return;
+    CRYPTO_DOWN_REF(&cache->references, &i, cache->lock);
+    REF_PRINT_COUNT("SSL_CERT_MSG_CACHE", cache);
+    if (i > 0)
+        return;
+    REF_ASSERT_ISNT(i < 0);
+
+    for (i = 0; i < SSL_PKEY_NUM; i++)
+        ssl_cert_msg_free(cache->msgs[i]);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+SSL_CERT_MSG *ssl_cert_msg_new(void)
+{
+    SSL_CERT_MSG *ret = OPENSSL_zalloc(sizeof(*ret));
+
+    if (ret == NULL)
+        return NULL;
+
+    ret->references = 1;
+    ret->lock = CRYPTO_THREAD_lock_new();
+    if (ret->lock == NULL) {
+        OPENSSL_free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+void ssl_cert_msg_free(SSL_CERT_MSG *msg)
+{
+    int i;
+
+    if (msg == NULL)
+        return;
+    CRYPTO_DOWN_REF(&msg->references, &i, msg->lock);
+    REF_PRINT_COUNT("SSL_CERT_MSG", msg);
+    if (i > 0)
+        return;
+    REF_ASSERT_ISNT(i < 0);
+
+    sk_X509_pop_free(msg->chain, X509_free);
+    X509_STORE_free(msg->store);
+    OPENSSL_free(msg->data);
+    OPENSSL_free(msg->offsets);
+    CRYPTO_THREAD_lock_free(msg->lock);
+    OPENSSL_free(msg);
+}
+
+/*
+ * Return the cached Certificate message body of |cpk|, which must be one of
+ * the pkeys of |c|, or NULL if there is none.  The caller must free the
+ * returned reference, and check that it was built from the chain and store
+ * it is going to send.
+ */
+SSL_CERT_MSG *ssl_cert_msg_get(CERT *c, CERT_PKEY *cpk)
+{
+    SSL_CERT_MSG_CACHE *cache = c->msg_cache;
+    SSL_CERT_MSG *msg;
+    int i;
+
+    if (cache == NULL || !CRYPTO_THREAD_read_lock(cache->lock))
+        return NULL;
+    msg = cache->msgs[cpk - c->pkeys];
+    if (msg != NULL)
+        CRYPTO_UP_REF(&msg->references, &i, msg->lock);
+    CRYPTO_THREAD_unlock(cache->lock);
+    return msg;
+}
+
+/* Replace the cached Certificate message body of |cpk| by |msg| */
+void ssl_cert_msg_set(CERT *c, CERT_PKEY *cpk, SSL_CERT_MSG *msg)
+{
+    SSL_CERT_MSG_CACHE *cache = c->msg_cache;
+    SSL_CERT_MSG *old;
+    int i;
+
+    if (cache == NULL || !CRYPTO_THREAD_write_lock(cache->lock))
+        return;
+    old = cache->msgs[cpk - c->pkeys];
+    CRYPTO_UP_REF(&msg->references, &i, msg->lock);
+    cache->msgs[cpk - c->pkeys] = msg;
+    CRYPTO_THREAD_unlock(cache->lock);
+    ssl_cert_msg_free(old);
+}
+
 CERT *ssl_cert_new(void)
 {
     CERT *ret = OPENSSL_zalloc(sizeof(*ret));
@@ -67,6 +180,13 @@ CERT *ssl_cert_new(void)
         OPENSSL_free(ret);
         return NULL;
     }
+    ret->msg_cache = ssl_cert_msg_cache_new();
+    if (ret->msg_cache == NULL) {
+        SSLerr(SSL_F_SSL_CERT_NEW, ERR_R_MALLOC_FAILURE);
+        CRYPTO_THREAD_lock_free(ret->lock);
+        OPENSSL_free(ret);
+        return NULL;
+    }
 
     return ret;
 }
@@ -177,6 +297,15 @@ CERT *ssl_cert_dup(CERT *cert)
         ret->chain_store = cert->chain_store;
     }
 
+    /*
+     * The copy usually sends the same chains, so it shares the encoded ones.
+     * Each user checks that a cached chain is still the one it would build.
+     */
+    if (cert->msg_cache != NULL) {
+        CRYPTO_UP_REF(&cert->msg_cache->references, &i, cert->msg_cache->lock);
+        ret->msg_cache = cert->msg_cache;
+    }
+
     ret->sec_cb = cert->sec_cb;
     ret->sec_level = cert->sec_level;
     ret->sec_ex = cert->sec_ex;
@@ -241,6 +370,7 @@ void ssl_cert_free(CERT *c)
     OPENSSL_free(c->ctype);
     X509_STORE_free(c->verify_store);
     X509_STORE_free(c->chain_store);
+    ssl_cert_msg_cache_free(c->msg_cache);
     custom_exts_free(&c->custext);
 #ifndef OPENSSL_NO_PSK
     OPENSSL_free(c->psk_identity_hint);
@@ -97,6 +97,8 @@ DEFINE_RUN_ONCE_STATIC(ossl_init_ssl_base)
     /* initialize cipher/digest methods table */
     if (!ssl_load_ciphers())
         return 0;
+    if (!ssl_buf_pool_init())
+        return 0;
 
     OSSL_TRACE(INIT,"ossl_init_ssl_base: SSL_add_ssl_module()\n");
     /*
@@ -144,6 +146,7 @@ static void ssl_library_stop(void)
                    "ssl_comp_free_compression_methods_int()\n");
         ssl_comp_free_compression_methods_int();
 #endif
+        ssl_buf_pool_cleanup();
     }
 
     if (ssl_strings_inited) {
@@ -928,7 +928,7 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
      * any new session built out of this id/id_len and the ssl_version in use
      * by this SSL.
      */
-    SSL_SESSION r, *p;
+    SSL_SESSION r;
 
     if (id_len > sizeof(r.session_id))
         return 0;
@@ -937,10 +937,7 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
     r.session_id_length = id_len;
     memcpy(r.session_id, id, id_len);
 
-    CRYPTO_THREAD_read_lock(ssl->session_ctx->lock);
-    p = lh_SSL_SESSION_retrieve(ssl->session_ctx->sessions, &r);
-    CRYPTO_THREAD_unlock(ssl->session_ctx->lock);
-    return (p != NULL);
+    return ssl_sess_cache_has(ssl->session_ctx, &r);
 }
 
 int SSL_CTX_set_purpose(SSL_CTX *s, int purpose)
@@ -1532,6 +1529,13 @@ int SSL_has_pending(const SSL *s)
     if (RECORD_LAYER_processed_read_pending(&s->rlayer))
         return 1;
 
+    /*
+     * A batching datagram BIO has taken the datagrams off the socket already,
+     * so the application won't be told that they can be read.
+     */
+    if (SSL_IS_DTLS(s) && dtls1_read_batch_pending(s))
+        return 1;
+
     return RECORD_LAYER_read_pending(&s->rlayer);
 }
 
@@ -2117,6 +2121,73 @@ int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written)
     return ret;
 }
 
+/* Lets SSL_write_iov() run as an async job: |buf| is the iovec array */
+static int ssl_write_iov_intern(SSL *s, const void *buf, size_t num,
+                                size_t *written)
+{
+    return ssl3_write_iov(s, buf, num, written);
+}
+
+int SSL_write_iov(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                  size_t *written)
+{
+    size_t i, max_send_fragment;
+    int ret;
+
+    if (s->handshake_func == NULL) {
+        SSLerr(SSL_F_SSL_WRITE_IOV, SSL_R_UNINITIALIZED);
+        return 0;
+    }
+
+    if (s->shutdown & SSL_SENT_SHUTDOWN) {
+        s->rwstate = SSL_NOTHING;
+        SSLerr(SSL_F_SSL_WRITE_IOV, SSL_R_PROTOCOL_IS_SHUTDOWN);
+        return 0;
+    }
+
+    if (s->early_data_state == SSL_EARLY_DATA_CONNECT_RETRY
+                || s->early_data_state == SSL_EARLY_DATA_ACCEPT_RETRY
+                || s->early_data_state == SSL_EARLY_DATA_READ_RETRY) {
+        SSLerr(SSL_F_SSL_WRITE_IOV, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        return 0;
+    }
+
+    if (iov == NULL && iovcnt != 0) {
+        SSLerr(SSL_F_SSL_WRITE_IOV, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+
+    /* Every element has to fit in a single record */
+    max_send_fragment = ssl_get_max_send_fragment(s);
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].len > max_send_fragment) {
+            SSLerr(SSL_F_SSL_WRITE_IOV, SSL_R_BAD_LENGTH);
+            return 0;
+        }
+    }
+
+    /* If we are a client and haven't sent the Finished we better do that */
+    ossl_statem_check_finish_init(s, 1);
+
+    if ((s->mode & SSL_MODE_ASYNC) && ASYNC_get_current_job() == NULL) {
+        struct ssl_async_args args;
+
+        args.s = s;
+        args.buf = (void *)iov;
+        args.num = iovcnt;
+        args.type = WRITEFUNC;
+        args.f.func_write = ssl_write_iov_intern;
+
+        ret = ssl_start_async_job(s, &args, ssl_io_intern);
+        *written = s->asyncrw;
+    } else {
+        ret = ssl3_write_iov(s, iov, iovcnt, written);
+    }
+    if (ret < 0)
+        ret = 0;
+    return ret;
+}
+
 int SSL_write_early_data(SSL *s, const void *buf, size_t num, size_t *written)
 {
     int ret, early_data_state;
@@ -2407,7 +2478,10 @@ long SSL_callback_ctrl(SSL *s, int cmd, void (*fp) (void))
 
 LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx)
 {
-    return ctx->sessions;
+    /* There is no single table to hand out once the cache is sharded */
+    if (ctx->sess_num_shards != 1)
+        return NULL;
+    return ctx->sess_shards[0].sessions;
 }
 
 long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
@@ -2457,6 +2531,13 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         return l;
     case SSL_CTRL_GET_SESS_CACHE_SIZE:
         return (long)ctx->session_cache_size;
+    case SSL_CTRL_SET_SESS_CACHE_SHARDS:
+        l = (long)ctx->sess_num_shards;
+        if (larg <= 0 || !ssl_sess_cache_init(ctx, (size_t)larg))
+            return 0;
+        return l;
+    case SSL_CTRL_GET_SESS_CACHE_SHARDS:
+        return (long)ctx->sess_num_shards;
     case SSL_CTRL_SET_SESS_CACHE_MODE:
         l = ctx->session_cache_mode;
         ctx->session_cache_mode = larg;
@@ -2465,7 +2546,7 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         return ctx->session_cache_mode;
 
     case SSL_CTRL_SESS_NUMBER:
-        return lh_SSL_SESSION_num_items(ctx->sessions);
+        return (long)ssl_sess_cache_number(ctx);
     case SSL_CTRL_SESS_CONNECT:
         return tsan_load(&ctx->stats.sess_connect);
     case SSL_CTRL_SESS_CONNECT_GOOD:
@@ -2993,7 +3074,7 @@ int SSL_export_keying_material_early(SSL *s, unsigned char *out, size_t olen,
                                               context, contextlen);
 }
 
-static unsigned long ssl_session_hash(const SSL_SESSION *a)
+unsigned long ssl_session_hash(const SSL_SESSION *a)
 {
     const unsigned char *session_id = a->session_id;
     unsigned long l;
@@ -3020,7 +3101,7 @@ static unsigned long ssl_session_hash(const SSL_SESSION *a)
  * being able to construct an SSL_SESSION that will collide with any existing
  * session with a matching session ID.
  */
-static int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
+int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
 {
     if (a->ssl_version != b->ssl_version)
         return 1;
@@ -3076,8 +3157,7 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
     if ((ret->cert = ssl_cert_new()) == NULL)
         goto err;
 
-    ret->sessions = lh_SSL_SESSION_new(ssl_session_hash, ssl_session_cmp);
-    if (ret->sessions == NULL)
+    if (!ssl_sess_cache_init(ret, 1))
         goto err;
     ret->cert_store = X509_STORE_new();
     if (ret->cert_store == NULL)
@@ -3262,11 +3342,10 @@ void SSL_CTX_free(SSL_CTX *a)
      * free ex_data, then finally free the cache.
      * (See ticket [openssl.org #212].)
      */
-    if (a->sessions != NULL)
-        SSL_CTX_flush_sessions(a, 0);
+    SSL_CTX_flush_sessions(a, 0);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_SSL_CTX, a, &a->ex_data);
-    lh_SSL_SESSION_free(a->sessions);
+    ssl_sess_cache_free(a);
     X509_STORE_free(a->cert_store);
 #ifndef OPENSSL_NO_CT
     CTLOG_STORE_free(a->ctlog_store);
@@ -3296,6 +3375,7 @@ void SSL_CTX_free(SSL_CTX *a)
     OPENSSL_free(a->ext.alpn);
     OPENSSL_secure_free(a->ext.secure);
 
+    ssl_buf_pool_free(a->bufpool);
     CRYPTO_THREAD_lock_free(a->lock);
 
     OPENSSL_free(a);
@@ -3574,7 +3654,11 @@ void ssl_update_cache(SSL *s, int mode)
         }
     }
 
-    /* auto flush every 255 connections */
+    /*
+     * SSL_CTX_add_session() only checks the oldest few sessions of a shard,
+     * which misses expired sessions behind one that lives longer, so also
+     * flush every 255 connections.  This locks one shard at a time.
+     */
     if ((!(i & SSL_SESS_CACHE_NO_AUTO_CLEAR)) && ((i & mode) == mode)) {
         TSAN_QUALIFIER int *stat;
         if (mode & SSL_SESS_CACHE_CLIENT)
@@ -737,6 +737,18 @@ typedef struct ssl_ctx_ext_secure_st {
     unsigned char tick_aes_key[TLSEXT_TICK_KEY_LENGTH];
 } SSL_CTX_EXT_SECURE;
 
+/*
+ * One shard of the internal session cache. A session lives in the shard
+ * picked by its session ID, see ssl_sess.c.
+ */
+typedef struct ssl_sess_shard_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(SSL_SESSION) *sessions;
+    /* The shard's sessions in the order they were added, newest first */
+    struct ssl_session_st *session_cache_head;
+    struct ssl_session_st *session_cache_tail;
+} SSL_SESS_SHARD;
+
 struct ssl_ctx_st {
     const SSL_METHOD *method;
     STACK_OF(SSL_CIPHER) *cipher_list;
@@ -745,14 +757,14 @@ struct ssl_ctx_st {
     /* TLSv1.3 specific ciphersuites */
     STACK_OF(SSL_CIPHER) *tls13_ciphersuites;
     struct x509_store_st /* X509_STORE */ *cert_store;
-    LHASH_OF(SSL_SESSION) *sessions;
+    /* The internal session cache, split into |sess_num_shards| shards */
+    SSL_SESS_SHARD *sess_shards;
+    size_t sess_num_shards;
     /*
      * Most session-ids that will be cached, default is
      * SSL_SESSION_CACHE_MAX_SIZE_DEFAULT. 0 is unlimited.
      */
     size_t session_cache_size;
-    struct ssl_session_st *session_cache_head;
-    struct ssl_session_st *session_cache_tail;
     /*
      * This can have one of 2 values, ored together, SSL_SESS_CACHE_CLIENT,
      * SSL_SESS_CACHE_SERVER, Default is SSL_SESSION_CACHE_SERVER, which
@@ -915,6 +927,9 @@ struct ssl_ctx_st {
     /* The default read buffer length to use (0 means not set) */
     size_t default_read_buf_len;
 
+    /* Idle record buffers shared by our connections, or NULL */
+    SSL_BUF_POOL *bufpool;
+
 # ifndef OPENSSL_NO_ENGINE
     /*
      * Engine to pass requests for client certs to
@@ -1846,6 +1861,34 @@ struct cert_pkey_st {
     unsigned char *serverinfo;
     size_t serverinfo_length;
 };
+
+/*
+ * The body of a Certificate message for a CERT_PKEY, encoded once and then
+ * copied into every handshake that sends it.  It is never modified after it
+ * has been built, so it can be used without holding a lock.
+ */
+typedef struct ssl_cert_msg_st {
+    /* Certificates sent, the end entity certificate first */
+    STACK_OF(X509) *chain;
+    /* Store the chain was built from, or NULL */
+    X509_STORE *store;
+    /* Generation of |store| the chain was built from, and when to rebuild */
+    uint64_t store_gen;
+    time_t expires;
+    /*
+     * Each certificate with its 3 byte length prefix, back to back.
+     * offsets[i] is the start of certificate i and offsets[n] the length of
+     * |data|, so the TLSv1.3 extensions of each certificate can be added in
+     * between.
+     */
+    unsigned char *data;
+    size_t *offsets;
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+} SSL_CERT_MSG;
+
+/* Cached SSL_CERT_MSGs, shared between a CERT and its copies */
+typedef struct ssl_cert_msg_cache_st SSL_CERT_MSG_CACHE;
 /* Retrieve Suite B flags */
 # define tls1_suiteb(s)  (s->cert->cert_flags & SSL_CERT_FLAG_SUITEB_128_LOS)
 /* Uses to check strict mode: suite B modes are always strict */
@@ -1946,6 +1989,8 @@ typedef struct cert_st {
      */
     X509_STORE *chain_store;
     X509_STORE *verify_store;
+    /* Encoded certificate chains of pkeys[], shared with copies of this CERT */
+    SSL_CERT_MSG_CACHE *msg_cache;
     /* Custom extensions */
     custom_ext_methods custext;
     /* Security callback */
@@ -2279,6 +2324,12 @@ __owur int ssl_generate_session_id(SSL *s, SSL_SESSION *ss);
 __owur int ssl_get_new_session(SSL *s, int session);
 __owur SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
                                          size_t sess_id_len);
+__owur int ssl_sess_cache_init(SSL_CTX *ctx, size_t nshards);
+void ssl_sess_cache_free(SSL_CTX *ctx);
+__owur size_t ssl_sess_cache_number(SSL_CTX *ctx);
+__owur int ssl_sess_cache_has(SSL_CTX *ctx, const SSL_SESSION *key);
+unsigned long ssl_session_hash(const SSL_SESSION *a);
+int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b);
 __owur int ssl_get_prev_session(SSL *s, CLIENTHELLO_MSG *hello);
 __owur SSL_SESSION *ssl_session_dup(const SSL_SESSION *src, int ticket);
 __owur int ssl_cipher_id_cmp(const SSL_CIPHER *a, const SSL_CIPHER *b);
@@ -2308,6 +2359,10 @@ __owur int ssl_cert_is_disabled(size_t idx);
 __owur const SSL_CIPHER *ssl_get_cipher_by_char(SSL *ssl,
                                                 const unsigned char *ptr,
                                                 int all);
+__owur SSL_CERT_MSG *ssl_cert_msg_get(CERT *c, CERT_PKEY *cpk);
+void ssl_cert_msg_set(CERT *c, CERT_PKEY *cpk, SSL_CERT_MSG *msg);
+SSL_CERT_MSG *ssl_cert_msg_new(void);
+void ssl_cert_msg_free(SSL_CERT_MSG *msg);
 __owur int ssl_cert_set0_chain(SSL *s, SSL_CTX *ctx, STACK_OF(X509) *chain);
 __owur int ssl_cert_set1_chain(SSL *s, SSL_CTX *ctx, STACK_OF(X509) *chain);
 __owur int ssl_cert_add0_chain_cert(SSL *s, SSL_CTX *ctx, X509 *x);
@@ -2523,6 +2578,17 @@ __owur int tls1_alert_code(int code);
 __owur int tls13_alert_code(int code);
 __owur int ssl3_alert_code(int code);
 
+#  ifndef OPENSSL_NO_KTLS
+struct tls_crypto_info_all;
+
+__owur int ktls_check_supported_cipher(const SSL *s, const EVP_CIPHER *c);
+__owur int ktls_configure_crypto(SSL *s, const EVP_CIPHER *c,
+                                 EVP_CIPHER_CTX *dd, void *rl_sequence,
+                                 struct tls_crypto_info_all *crypto_info,
+                                 int is_tx, unsigned char *iv,
+                                 unsigned char *key);
+#  endif
+
 #  ifndef OPENSSL_NO_EC
 __owur int ssl_check_srvr_ecc_cert_and_alg(X509 *x, SSL *s);
 #  endif
@@ -16,10 +16,142 @@
 #include "ssl_locl.h"
 #include "statem/statem_locl.h"
 
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s);
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s);
+static void SSL_SESSION_list_remove(SSL_SESS_SHARD *sh, SSL_SESSION *s);
+static void SSL_SESSION_list_add(SSL_SESS_SHARD *sh, SSL_SESSION *s);
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck);
 
+/*
+ * The internal session cache is split into shards, each with its own lock,
+ * hash table and list, so that connections resuming or adding sessions
+ * with different IDs rarely contend. The number of shards is set with
+ * SSL_CTX_sess_set_cache_shards(), and the cache size limit applies to each
+ * shard in proportion.
+ *
+ * Expired sessions are removed a few at a time, from the oldest end of the
+ * shard a session is being added to.  Sessions can have different timeouts,
+ * so this doesn't find all of them, and ssl_update_cache() still flushes the
+ * whole cache every 255 connections, one shard at a time.
+ */
+#define SSL_SESS_CACHE_MAX_SHARDS   256
+/* How many of the oldest sessions to check for expiry on each add */
+#define SSL_SESS_EXPIRE_BATCH       4
+
+static SSL_SESS_SHARD *sess_shard(SSL_CTX *ctx, const SSL_SESSION *s)
+{
+    /*
+     * The shard's hash table picks buckets from the low bits of the session
+     * hash, so pick the shard from the high bits of a multiplicative mix.
+     */
+    uint32_t h = (uint32_t)ssl_session_hash(s) * 0x9e3779b1U;
+
+    return &ctx->sess_shards[(h >> 16) % ctx->sess_num_shards];
+}
+
+static void sess_shards_free(SSL_SESS_SHARD *shards, size_t n)
+{
+    size_t i;
+
+    if (shards == NULL)
+        return;
+    for (i = 0; i < n; i++) {
+        lh_SSL_SESSION_free(shards[i].sessions);
+        CRYPTO_THREAD_lock_free(shards[i].lock);
+    }
+    OPENSSL_free(shards);
+}
+
+/*
+ * Set up the session cache of |ctx| with |nshards| shards. Any sessions in
+ * an existing cache are flushed first.
+ */
+int ssl_sess_cache_init(SSL_CTX *ctx, size_t nshards)
+{
+    SSL_SESS_SHARD *shards;
+    size_t i;
+
+    if (nshards == 0 || nshards > SSL_SESS_CACHE_MAX_SHARDS)
+        return 0;
+    if ((shards = OPENSSL_zalloc(nshards * sizeof(*shards))) == NULL)
+        return 0;
+    for (i = 0; i < nshards; i++) {
+        shards[i].lock = CRYPTO_THREAD_lock_new();
+        shards[i].sessions = lh_SSL_SESSION_new(ssl_session_hash,
+                                                ssl_session_cmp);
+        if (shards[i].lock == NULL || shards[i].sessions == NULL) {
+            sess_shards_free(shards, i + 1);
+            return 0;
+        }
+    }
+
+    ssl_sess_cache_free(ctx);
+    ctx->sess_shards = shards;
+    ctx->sess_num_shards = nshards;
+    return 1;
+}
+
+void ssl_sess_cache_free(SSL_CTX *ctx)
+{
+    if (ctx->sess_shards == NULL)
+        return;
+    SSL_CTX_flush_sessions(ctx, 0);
+    sess_shards_free(ctx->sess_shards, ctx->sess_num_shards);
+    ctx->sess_shards = NULL;
+    ctx->sess_num_shards = 0;
+}
+
+size_t ssl_sess_cache_number(SSL_CTX *ctx)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < ctx->sess_num_shards; i++) {
+        SSL_SESS_SHARD *sh = &ctx->sess_shards[i];
+
+        CRYPTO_THREAD_read_lock(sh->lock);
+        n += lh_SSL_SESSION_num_items(sh->sessions);
+        CRYPTO_THREAD_unlock(sh->lock);
+    }
+    return n;
+}
+
+int ssl_sess_cache_has(SSL_CTX *ctx, const SSL_SESSION *key)
+{
+    SSL_SESS_SHARD *sh = sess_shard(ctx, key);
+    SSL_SESSION *p;
+
+    CRYPTO_THREAD_read_lock(sh->lock);
+    p = lh_SSL_SESSION_retrieve(sh->sessions, key);
+    CRYPTO_THREAD_unlock(sh->lock);
+    return p != NULL;
+}
+
+/*
+ * Remove the sessions of |sh| that have expired at time |t|, or all of them if
+ * |t| is 0, oldest first. At most |max| sessions are looked at, or all of them
+ * if |max| is 0. Called with the shard locked.
+ */
+static void sess_shard_expire(SSL_CTX *ctx, SSL_SESS_SHARD *sh, long t,
+                              size_t max)
+{
+    SSL_SESSION *s, *prev;
+    size_t n = 0;
+
+    for (s = sh->session_cache_tail;
+         s != NULL && s != (SSL_SESSION *)&sh->session_cache_head;
+         s = prev) {
+        prev = s->prev;
+        if (t == 0 || t > s->time + s->timeout) { /* timeout */
+            (void)lh_SSL_SESSION_delete(sh->sessions, s);
+            SSL_SESSION_list_remove(sh, s);
+            s->not_resumable = 1;
+            if (ctx->remove_session_cb != NULL)
+                ctx->remove_session_cb(ctx, s);
+            SSL_SESSION_free(s);
+        }
+        if (max != 0 && ++n == max)
+            break;
+    }
+}
+
 /*
  * SSL_get_session() and SSL_get1_session() are problematic in TLS1.3 because,
  * unlike in earlier protocol versions, the session ticket may not have been
@@ -424,6 +556,7 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
     if ((s->session_ctx->session_cache_mode
          & SSL_SESS_CACHE_NO_INTERNAL_LOOKUP) == 0) {
         SSL_SESSION data;
+        SSL_SESS_SHARD *sh;
 
         data.ssl_version = s->version;
         if (!ossl_assert(sess_id_len <= SSL_MAX_SSL_SESSION_ID_LENGTH))
@@ -432,13 +565,14 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
         memcpy(data.session_id, sess_id, sess_id_len);
         data.session_id_length = sess_id_len;
 
-        CRYPTO_THREAD_read_lock(s->session_ctx->lock);
-        ret = lh_SSL_SESSION_retrieve(s->session_ctx->sessions, &data);
+        sh = sess_shard(s->session_ctx, &data);
+        CRYPTO_THREAD_read_lock(sh->lock);
+        ret = lh_SSL_SESSION_retrieve(sh->sessions, &data);
         if (ret != NULL) {
             /* don't allow other threads to steal it: */
             SSL_SESSION_up_ref(ret);
         }
-        CRYPTO_THREAD_unlock(s->session_ctx->lock);
+        CRYPTO_THREAD_unlock(sh->lock);
         if (ret == NULL)
             tsan_counter(&s->session_ctx->stats.sess_miss);
     }
@@ -638,6 +772,8 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
     int ret = 0;
     SSL_SESSION *s;
+    SSL_SESS_SHARD *sh = sess_shard(ctx, c);
+    size_t max;
 
     /*
      * add just 1 reference count for the SSL_CTX's session cache even though
@@ -649,17 +785,17 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
      * if session c is in already in cache, we take back the increment later
      */
 
-    CRYPTO_THREAD_write_lock(ctx->lock);
-    s = lh_SSL_SESSION_insert(ctx->sessions, c);
+    CRYPTO_THREAD_write_lock(sh->lock);
+    s = lh_SSL_SESSION_insert(sh->sessions, c);
 
     /*
      * s != NULL iff we already had a session with the given PID. In this
      * case, s == c should hold (then we did not really modify
-     * ctx->sessions), or we're in trouble.
+     * sh->sessions), or we're in trouble.
      */
     if (s != NULL && s != c) {
         /* We *are* in trouble ... */
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(sh, s);
         SSL_SESSION_free(s);
         /*
          * ... so pretend the other session did not exist in cache (we cannot
@@ -669,7 +805,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
          */
         s = NULL;
     } else if (s == NULL &&
-               lh_SSL_SESSION_retrieve(ctx->sessions, c) == NULL) {
+               lh_SSL_SESSION_retrieve(sh->sessions, c) == NULL) {
         /* s == NULL can also mean OOM error in lh_SSL_SESSION_insert ... */
 
         /*
@@ -681,7 +817,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 
     /* Put at the head of the queue unless it is already in the cache */
     if (s == NULL)
-        SSL_SESSION_list_add(ctx, c);
+        SSL_SESSION_list_add(sh, c);
 
     if (s != NULL) {
         /*
@@ -693,21 +829,28 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
         ret = 0;
     } else {
         /*
-         * new cache entry -- remove old ones if cache has become too large
+         * new cache entry -- expire a few of the oldest ones, and remove old
+         * ones if this shard has become too large
          */
 
         ret = 1;
 
+        if ((ctx->session_cache_mode & SSL_SESS_CACHE_NO_AUTO_CLEAR) == 0)
+            sess_shard_expire(ctx, sh, (long)time(NULL),
+                              SSL_SESS_EXPIRE_BATCH);
+
         if (SSL_CTX_sess_get_cache_size(ctx) > 0) {
-            while (SSL_CTX_sess_number(ctx) > SSL_CTX_sess_get_cache_size(ctx)) {
-                if (!remove_session_lock(ctx, ctx->session_cache_tail, 0))
+            max = (SSL_CTX_sess_get_cache_size(ctx) + ctx->sess_num_shards - 1)
+                  / ctx->sess_num_shards;
+            while (lh_SSL_SESSION_num_items(sh->sessions) > max) {
+                if (!remove_session_lock(ctx, sh->session_cache_tail, 0))
                     break;
                 else
                     tsan_counter(&ctx->stats.sess_cache_full);
             }
         }
     }
-    CRYPTO_THREAD_unlock(ctx->lock);
+    CRYPTO_THREAD_unlock(sh->lock);
     return ret;
 }
 
@@ -719,20 +862,22 @@ int SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *c)
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck)
 {
     SSL_SESSION *r;
+    SSL_SESS_SHARD *sh;
     int ret = 0;
 
     if ((c != NULL) && (c->session_id_length != 0)) {
+        sh = sess_shard(ctx, c);
         if (lck)
-            CRYPTO_THREAD_write_lock(ctx->lock);
-        if ((r = lh_SSL_SESSION_retrieve(ctx->sessions, c)) != NULL) {
+            CRYPTO_THREAD_write_lock(sh->lock);
+        if ((r = lh_SSL_SESSION_retrieve(sh->sessions, c)) != NULL) {
             ret = 1;
-            r = lh_SSL_SESSION_delete(ctx->sessions, r);
-            SSL_SESSION_list_remove(ctx, r);
+            r = lh_SSL_SESSION_delete(sh->sessions, r);
+            SSL_SESSION_list_remove(sh, r);
         }
         c->not_resumable = 1;
 
         if (lck)
-            CRYPTO_THREAD_unlock(ctx->lock);
+            CRYPTO_THREAD_unlock(sh->lock);
 
         if (ctx->remove_session_cb != NULL)
             ctx->remove_session_cb(ctx, c);
@@ -1042,46 +1187,18 @@ int SSL_set_session_ticket_ext(SSL *s, void *ext_data, int ext_len)
     return 0;
 }
 
-typedef struct timeout_param_st {
-    SSL_CTX *ctx;
-    long time;
-    LHASH_OF(SSL_SESSION) *cache;
-} TIMEOUT_PARAM;
-
-static void timeout_cb(SSL_SESSION *s, TIMEOUT_PARAM *p)
-{
-    if ((p->time == 0) || (p->time > (s->time + s->timeout))) { /* timeout */
-        /*
-         * The reason we don't call SSL_CTX_remove_session() is to save on
-         * locking overhead
-         */
-        (void)lh_SSL_SESSION_delete(p->cache, s);
-        SSL_SESSION_list_remove(p->ctx, s);
-        s->not_resumable = 1;
-        if (p->ctx->remove_session_cb != NULL)
-            p->ctx->remove_session_cb(p->ctx, s);
-        SSL_SESSION_free(s);
-    }
-}
-
-IMPLEMENT_LHASH_DOALL_ARG(SSL_SESSION, TIMEOUT_PARAM);
-
 void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
 {
-    unsigned long i;
-    TIMEOUT_PARAM tp;
+    size_t i;
 
-    tp.ctx = s;
-    tp.cache = s->sessions;
-    if (tp.cache == NULL)
-        return;
-    tp.time = t;
-    CRYPTO_THREAD_write_lock(s->lock);
-    i = lh_SSL_SESSION_get_down_load(s->sessions);
-    lh_SSL_SESSION_set_down_load(s->sessions, 0);
-    lh_SSL_SESSION_doall_TIMEOUT_PARAM(tp.cache, timeout_cb, &tp);
-    lh_SSL_SESSION_set_down_load(s->sessions, i);
-    CRYPTO_THREAD_unlock(s->lock);
+    /* One shard at a time, so lookups in the others carry on meanwhile */
+    for (i = 0; i < s->sess_num_shards; i++) {
+        SSL_SESS_SHARD *sh = &s->sess_shards[i];
+
+        CRYPTO_THREAD_write_lock(sh->lock);
+        sess_shard_expire(s, sh, t, 0);
+        CRYPTO_THREAD_unlock(sh->lock);
+    }
 }
 
 int ssl_clear_bad_session(SSL *s)
@@ -1095,27 +1212,27 @@ int ssl_clear_bad_session(SSL *s)
         return 0;
 }
 
-/* locked by SSL_CTX in the calling function */
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
+/* locked by the shard in the calling function */
+static void SSL_SESSION_list_remove(SSL_SESS_SHARD *sh, SSL_SESSION *s)
 {
     if ((s->next == NULL) || (s->prev == NULL))
         return;
 
-    if (s->next == (SSL_SESSION *)&(ctx->session_cache_tail)) {
+    if (s->next == (SSL_SESSION *)&(sh->session_cache_tail)) {
         /* last element in list */
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)&(sh->session_cache_head)) {
             /* only one element in list */
-            ctx->session_cache_head = NULL;
-            ctx->session_cache_tail = NULL;
+            sh->session_cache_head = NULL;
+            sh->session_cache_tail = NULL;
         } else {
-            ctx->session_cache_tail = s->prev;
-            s->prev->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+            sh->session_cache_tail = s->prev;
+            s->prev->next = (SSL_SESSION *)&(sh->session_cache_tail);
         }
     } else {
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)&(sh->session_cache_head)) {
             /* first element in list */
-            ctx->session_cache_head = s->next;
-            s->next->prev = (SSL_SESSION *)&(ctx->session_cache_head);
+            sh->session_cache_head = s->next;
+            s->next->prev = (SSL_SESSION *)&(sh->session_cache_head);
         } else {
             /* middle of list */
             s->next->prev = s->prev;
@@ -1125,21 +1242,21 @@ static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
     s->prev = s->next = NULL;
 }
 
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s)
+static void SSL_SESSION_list_add(SSL_SESS_SHARD *sh, SSL_SESSION *s)
 {
     if ((s->next != NULL) && (s->prev != NULL))
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(sh, s);
 
-    if (ctx->session_cache_head == NULL) {
-        ctx->session_cache_head = s;
-        ctx->session_cache_tail = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        s->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+    if (sh->session_cache_head == NULL) {
+        sh->session_cache_head = s;
+        sh->session_cache_tail = s;
+        s->prev = (SSL_SESSION *)&(sh->session_cache_head);
+        s->next = (SSL_SESSION *)&(sh->session_cache_tail);
     } else {
-        s->next = ctx->session_cache_head;
+        s->next = sh->session_cache_head;
         s->next->prev = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        ctx->session_cache_head = s;
+        s->prev = (SSL_SESSION *)&(sh->session_cache_head);
+        sh->session_cache_head = s;
     }
 }
 
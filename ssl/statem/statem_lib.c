@@ -882,47 +882,205 @@ int tls_construct_change_cipher_spec(SSL *s, WPACKET *pkt)
     return 1;
 }
 
-/* Add a certificate to the WPACKET */
-static int ssl_add_cert_to_wpacket(SSL *s, WPACKET *pkt, X509 *x, int chain)
+/* A chain built from a store is rebuilt at least this often, in seconds */
+#define SSL_CERT_MSG_LIFETIME   3600
+
+/* Bring |*expires| forward to |t| if that is between |now| and |*expires| */
+static void ssl_cert_msg_expire_at(time_t *expires, time_t now,
+                                   const ASN1_TIME *t)
 {
-    int len;
-    unsigned char *outbytes;
+    int day, sec;
+
+    if (ASN1_TIME_diff(&day, &sec, NULL, t) && day == 0 && sec > 0
+            && now + sec < *expires)
+        *expires = now + sec;
+}
+
+/*
+ * Check that |msg| is the chain we would build for |x| from |extra_certs| or
+ * |store|.  |msg| holds references to every certificate and store it was
+ * built from, so comparing pointers is sufficient, except that a chain from
+ * a store is only good while the store is at the same generation and the
+ * chain has not expired.
+ */
+static int ssl_cert_msg_matches(const SSL_CERT_MSG *msg, X509 *x,
+                                STACK_OF(X509) *extra_certs,
+                                X509_STORE *store, uint64_t store_gen,
+                                time_t now)
+{
+    int i;
 
-    len = i2d_X509(x, NULL);
-    if (len < 0) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_TO_WPACKET,
-                 ERR_R_BUF_LIB);
+    if (msg->store != store || sk_X509_value(msg->chain, 0) != x)
         return 0;
+    if (store != NULL)
+        return msg->store_gen == store_gen && now < msg->expires;
+
+    if (sk_X509_num(msg->chain) != sk_X509_num(extra_certs) + 1)
+        return 0;
+    for (i = 0; i < sk_X509_num(extra_certs); i++) {
+        if (sk_X509_value(msg->chain, i + 1) != sk_X509_value(extra_certs, i))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Build the chain for |x|, either from |store| or from |extra_certs|, and
+ * encode each certificate of it with its length.  |store_gen| is the
+ * generation of |store| from before the chain is built, so that any change
+ * made while it is being built makes the next handshake build it again.
+ */
+static SSL_CERT_MSG *ssl_cert_msg_build(SSL *s, X509 *x,
+                                        STACK_OF(X509) *extra_certs,
+                                        X509_STORE *store,
+                                        uint64_t store_gen, time_t now)
+{
+    SSL_CERT_MSG *msg = ssl_cert_msg_new();
+    WPACKET pkt;
+    unsigned char *outbytes;
+    size_t totlen = 0;
+    int i, len, chain_count;
+
+    if (msg == NULL) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                 ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+
+    if (store != NULL) {
+        X509_STORE_CTX *xs_ctx = X509_STORE_CTX_new();
+
+        if (xs_ctx == NULL) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                     ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+        if (!X509_STORE_CTX_init(xs_ctx, store, x, NULL)) {
+            X509_STORE_CTX_free(xs_ctx);
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                     ERR_R_X509_LIB);
+            goto err;
+        }
+        /*
+         * It is valid for the chain not to be complete (because normally we
+         * don't include the root cert in the chain). Therefore we deliberately
+         * ignore the error return from this call. We're not actually verifying
+         * the cert - we're just building as much of the chain as we can
+         */
+        (void)X509_verify_cert(xs_ctx);
+        /* Don't leave errors in the queue */
+        ERR_clear_error();
+        msg->chain = X509_STORE_CTX_get1_chain(xs_ctx);
+        X509_STORE_CTX_free(xs_ctx);
+        if (msg->chain == NULL) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                     ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+        X509_STORE_up_ref(store);
+        msg->store = store;
+        msg->store_gen = store_gen;
+        /*
+         * Another issuer may be picked once a certificate becomes valid or
+         * expires, including ones in the store that are not in this chain.
+         */
+        msg->expires = now + SSL_CERT_MSG_LIFETIME;
+        for (i = 0; i < sk_X509_num(msg->chain); i++) {
+            X509 *cert = sk_X509_value(msg->chain, i);
+
+            ssl_cert_msg_expire_at(&msg->expires, now,
+                                   X509_get0_notBefore(cert));
+            ssl_cert_msg_expire_at(&msg->expires, now,
+                                   X509_get0_notAfter(cert));
+        }
+    } else {
+        if (extra_certs != NULL)
+            msg->chain = X509_chain_up_ref(extra_certs);
+        else
+            msg->chain = sk_X509_new_null();
+        if (msg->chain == NULL || !sk_X509_unshift(msg->chain, x)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                     ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+        X509_up_ref(x);
     }
-    if (!WPACKET_sub_allocate_bytes_u24(pkt, len, &outbytes)
-            || i2d_X509(x, &outbytes) != len) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_TO_WPACKET,
+
+    chain_count = sk_X509_num(msg->chain);
+    for (i = 0; i < chain_count; i++) {
+        len = i2d_X509(sk_X509_value(msg->chain, i), NULL);
+        if (len < 0) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                     ERR_R_BUF_LIB);
+            goto err;
+        }
+        totlen += 3 + len;       /* 3 byte length prefix */
+    }
+
+    msg->data = OPENSSL_malloc(totlen);
+    msg->offsets = OPENSSL_malloc((chain_count + 1) * sizeof(*msg->offsets));
+    if (msg->data == NULL || msg->offsets == NULL) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                 ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    if (!WPACKET_init_static_len(&pkt, msg->data, totlen, 0)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
                  ERR_R_INTERNAL_ERROR);
-        return 0;
+        goto err;
     }
+    for (i = 0; i < chain_count; i++) {
+        X509 *cert = sk_X509_value(msg->chain, i);
 
-    if (SSL_IS_TLS13(s)
-            && !tls_construct_extensions(s, pkt, SSL_EXT_TLS1_3_CERTIFICATE, x,
-                                         chain)) {
-        /* SSLfatal() already called */
-        return 0;
+        if (!WPACKET_get_total_written(&pkt, &msg->offsets[i])
+                || (len = i2d_X509(cert, NULL)) < 0
+                || !WPACKET_sub_allocate_bytes_u24(&pkt, len, &outbytes)
+                || i2d_X509(cert, &outbytes) != len) {
+            WPACKET_cleanup(&pkt);
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                     ERR_R_INTERNAL_ERROR);
+            goto err;
+        }
+    }
+    if (!WPACKET_get_total_written(&pkt, &msg->offsets[chain_count])
+            || !WPACKET_finish(&pkt)) {
+        WPACKET_cleanup(&pkt);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                 ERR_R_INTERNAL_ERROR);
+        goto err;
     }
 
-    return 1;
+    return msg;
+ err:
+    ssl_cert_msg_free(msg);
+    return NULL;
 }
 
-/* Add certificate chain to provided WPACKET */
+/*
+ * Add certificate chain to provided WPACKET.  The chain is built and encoded
+ * once per CERT_PKEY and then copied as is, with only the TLSv1.3 extensions
+ * of each certificate constructed per handshake.
+ */
 static int ssl_add_cert_chain(SSL *s, WPACKET *pkt, CERT_PKEY *cpk)
 {
-    int i, chain_count;
+    int i, chain_count, ret = 0;
+    uint64_t store_gen = 0;
+    time_t now = 0;
     X509 *x;
     STACK_OF(X509) *extra_certs;
-    STACK_OF(X509) *chain = NULL;
     X509_STORE *chain_store;
+    SSL_CERT_MSG *msg;
 
     if (cpk == NULL || cpk->x509 == NULL)
         return 1;
 
+    if (cpk < s->cert->pkeys || cpk >= s->cert->pkeys + SSL_PKEY_NUM) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+
     x = cpk->x509;
 
     /*
@@ -941,71 +1099,66 @@ static int ssl_add_cert_chain(SSL *s, WPACKET *pkt, CERT_PKEY *cpk)
         chain_store = s->ctx->cert_store;
 
     if (chain_store != NULL) {
-        X509_STORE_CTX *xs_ctx = X509_STORE_CTX_new();
+        store_gen = X509_STORE_get_generation(chain_store);
+        now = time(NULL);
+    }
 
-        if (xs_ctx == NULL) {
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
-                     ERR_R_MALLOC_FAILURE);
-            return 0;
-        }
-        if (!X509_STORE_CTX_init(xs_ctx, chain_store, x, NULL)) {
-            X509_STORE_CTX_free(xs_ctx);
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
-                     ERR_R_X509_LIB);
+    msg = ssl_cert_msg_get(s->cert, cpk);
+    if (msg != NULL
+            && !ssl_cert_msg_matches(msg, x, extra_certs, chain_store,
+                                     store_gen, now)) {
+        ssl_cert_msg_free(msg);
+        msg = NULL;
+    }
+    if (msg == NULL) {
+        msg = ssl_cert_msg_build(s, x, extra_certs, chain_store, store_gen,
+                                 now);
+        if (msg == NULL) {
+            /* SSLfatal() already called */
             return 0;
         }
-        /*
-         * It is valid for the chain not to be complete (because normally we
-         * don't include the root cert in the chain). Therefore we deliberately
-         * ignore the error return from this call. We're not actually verifying
-         * the cert - we're just building as much of the chain as we can
-         */
-        (void)X509_verify_cert(xs_ctx);
-        /* Don't leave errors in the queue */
-        ERR_clear_error();
-        chain = X509_STORE_CTX_get0_chain(xs_ctx);
-        i = ssl_security_cert_chain(s, chain, NULL, 0);
-        if (i != 1) {
+        ssl_cert_msg_set(s->cert, cpk, msg);
+    }
+
+    i = ssl_security_cert_chain(s, msg->chain, NULL, 0);
+    if (i != 1) {
 #if 0
-            /* Dummy error calls so mkerr generates them */
-            SSLerr(SSL_F_SSL_ADD_CERT_CHAIN, SSL_R_EE_KEY_TOO_SMALL);
-            SSLerr(SSL_F_SSL_ADD_CERT_CHAIN, SSL_R_CA_KEY_TOO_SMALL);
-            SSLerr(SSL_F_SSL_ADD_CERT_CHAIN, SSL_R_CA_MD_TOO_WEAK);
+        /* Dummy error calls so mkerr generates them */
+        SSLerr(SSL_F_SSL_ADD_CERT_CHAIN, SSL_R_EE_KEY_TOO_SMALL);
+        SSLerr(SSL_F_SSL_ADD_CERT_CHAIN, SSL_R_CA_KEY_TOO_SMALL);
+        SSLerr(SSL_F_SSL_ADD_CERT_CHAIN, SSL_R_CA_MD_TOO_WEAK);
 #endif
-            X509_STORE_CTX_free(xs_ctx);
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN, i);
-            return 0;
-        }
-        chain_count = sk_X509_num(chain);
-        for (i = 0; i < chain_count; i++) {
-            x = sk_X509_value(chain, i);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN, i);
+        goto err;
+    }
 
-            if (!ssl_add_cert_to_wpacket(s, pkt, x, i)) {
-                /* SSLfatal() already called */
-                X509_STORE_CTX_free(xs_ctx);
-                return 0;
-            }
+    chain_count = sk_X509_num(msg->chain);
+    if (!SSL_IS_TLS13(s)) {
+        if (!WPACKET_memcpy(pkt, msg->data, msg->offsets[chain_count])) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                     ERR_R_INTERNAL_ERROR);
+            goto err;
         }
-        X509_STORE_CTX_free(xs_ctx);
     } else {
-        i = ssl_security_cert_chain(s, extra_certs, x, 0);
-        if (i != 1) {
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN, i);
-            return 0;
-        }
-        if (!ssl_add_cert_to_wpacket(s, pkt, x, 0)) {
-            /* SSLfatal() already called */
-            return 0;
-        }
-        for (i = 0; i < sk_X509_num(extra_certs); i++) {
-            x = sk_X509_value(extra_certs, i);
-            if (!ssl_add_cert_to_wpacket(s, pkt, x, i + 1)) {
+        for (i = 0; i < chain_count; i++) {
+            if (!WPACKET_memcpy(pkt, msg->data + msg->offsets[i],
+                                msg->offsets[i + 1] - msg->offsets[i])) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN,
+                         ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
+            if (!tls_construct_extensions(s, pkt, SSL_EXT_TLS1_3_CERTIFICATE,
+                                          sk_X509_value(msg->chain, i), i)) {
                 /* SSLfatal() already called */
-                return 0;
+                goto err;
             }
         }
     }
-    return 1;
+
+    ret = 1;
+ err:
+    ssl_cert_msg_free(msg);
+    return ret;
 }
 
 unsigned long ssl3_output_cert_chain(SSL *s, WPACKET *pkt, CERT_PKEY *cpk)
@@ -9,6 +9,8 @@
 
 #include <stdlib.h>
 #include "ssl_locl.h"
+#include "record/record_locl.h"
+#include "internal/ktls.h"
 #include "internal/cryptlib.h"
 #include <openssl/evp.h>
 #include <openssl/kdf.h>
@@ -362,9 +364,9 @@ static int derive_secret_key_and_iv(SSL *s, int sending, const EVP_MD *md,
                                     const unsigned char *hash,
                                     const unsigned char *label,
                                     size_t labellen, unsigned char *secret,
-                                    unsigned char *iv, EVP_CIPHER_CTX *ciph_ctx)
+                                    unsigned char *key, unsigned char *iv,
+                                    EVP_CIPHER_CTX *ciph_ctx)
 {
-    unsigned char key[EVP_MAX_KEY_LENGTH];
     size_t ivlen, keylen, taglen;
     int hashleni = EVP_MD_size(md);
     size_t hashlen;
@@ -422,10 +424,93 @@ static int derive_secret_key_and_iv(SSL *s, int sending, const EVP_MD *md,
 
     return 1;
  err:
-    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(key, EVP_MAX_KEY_LENGTH);
     return 0;
 }
 
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+/*
+ * Hand the traffic key just derived into |ciph_ctx| over to the kernel for
+ * the direction given by |sending|.  If the kernel already holds a key for
+ * that direction then this is a key update and it must take the new key,
+ * otherwise it would go on protecting records with the old one.
+ * Returns 1 if the kernel now protects that direction, 0 if we carry on in
+ * user space and -1 on a fatal error.
+ */
+static int tls13_ktls_start(SSL *s, int sending, const EVP_CIPHER *cipher,
+                            EVP_CIPHER_CTX *ciph_ctx, unsigned char *iv,
+                            unsigned char *key)
+{
+    struct tls_crypto_info_all crypto_info;
+    void *rl_sequence;
+    BIO *bio;
+    int rekey, ret = 0;
+
+    if (sending) {
+        bio = s->wbio;
+        rekey = BIO_get_ktls_send(bio);
+    } else {
+        bio = s->rbio;
+        rekey = BIO_get_ktls_recv(bio);
+    }
+
+    if ((sending && (s->mode & SSL_MODE_NO_KTLS_TX))
+            || (!sending && (s->mode & SSL_MODE_NO_KTLS_RX)))
+        goto skip_ktls;
+
+    /* ktls supports only the maximum fragment size */
+    if (ssl_get_max_send_fragment(s) != SSL3_RT_MAX_PLAIN_LENGTH)
+        goto skip_ktls;
+
+    /* ktls does not support record padding */
+    if (s->record_padding_cb != NULL || s->block_padding > 0)
+        goto skip_ktls;
+
+    /* check that cipher is supported */
+    if (!ktls_check_supported_cipher(s, cipher))
+        goto skip_ktls;
+
+    if (!ossl_assert(bio != NULL)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS13_KTLS_START,
+                 ERR_R_INTERNAL_ERROR);
+        return -1;
+    }
+
+    /* All future data will get encrypted by ktls. Flush the BIO or skip ktls */
+    if (sending) {
+        if (BIO_flush(bio) <= 0)
+            goto skip_ktls;
+    }
+
+    /* configure kernel crypto structure */
+    if (sending)
+        rl_sequence = RECORD_LAYER_get_write_sequence(&s->rlayer);
+    else
+        rl_sequence = RECORD_LAYER_get_read_sequence(&s->rlayer);
+
+    if (!ktls_configure_crypto(s, cipher, ciph_ctx, rl_sequence, &crypto_info,
+                               sending, iv, key))
+        goto skip_ktls;
+
+    /* ktls works with user provided buffers directly */
+    if (BIO_set_ktls(bio, &crypto_info, sending)) {
+        if (sending && !rekey)
+            ssl3_release_write_buffer(s);
+        ret = 1;
+    }
+    OPENSSL_cleanse(&crypto_info, sizeof(crypto_info));
+
+ skip_ktls:
+    if (rekey && ret == 0) {
+        /* The kernel would carry on using the previous traffic key */
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS13_KTLS_START,
+                 SSL_R_KTLS_REKEY_FAILED);
+        return -1;
+    }
+    return ret;
+}
+#endif
+
 int tls13_change_cipher_state(SSL *s, int which)
 {
 #ifdef CHARSET_EBCDIC
@@ -448,6 +533,7 @@ int tls13_change_cipher_state(SSL *s, int which)
     static const unsigned char early_exporter_master_secret[] = "e exp master";
 #endif
     unsigned char *iv;
+    unsigned char key[EVP_MAX_KEY_LENGTH];
     unsigned char secret[EVP_MAX_MD_SIZE];
     unsigned char hashval[EVP_MAX_MD_SIZE];
     unsigned char *hash = hashval;
@@ -664,8 +750,8 @@ int tls13_change_cipher_state(SSL *s, int which)
     }
 
     if (!derive_secret_key_and_iv(s, which & SSL3_CC_WRITE, md, cipher,
-                                  insecret, hash, label, labellen, secret, iv,
-                                  ciph_ctx)) {
+                                  insecret, hash, label, labellen, secret, key,
+                                  iv, ciph_ctx)) {
         /* SSLfatal() already called */
         goto err;
     }
@@ -706,8 +792,18 @@ int tls13_change_cipher_state(SSL *s, int which)
         s->statem.enc_write_state = ENC_WRITE_STATE_WRITE_PLAIN_ALERTS;
     else
         s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+    /* Only the application traffic keys are handed over to the kernel */
+    if ((which & SSL3_CC_APPLICATION) != 0
+            && tls13_ktls_start(s, which & SSL3_CC_WRITE, cipher, ciph_ctx,
+                                iv, key) < 0) {
+        /* SSLfatal() already called */
+        goto err;
+    }
+#endif
     ret = 1;
  err:
+    OPENSSL_cleanse(key, sizeof(key));
     OPENSSL_cleanse(secret, sizeof(secret));
     return ret;
 }
@@ -722,6 +818,7 @@ int tls13_update_key(SSL *s, int sending)
     const EVP_MD *md = ssl_handshake_md(s);
     size_t hashlen = EVP_MD_size(md);
     unsigned char *insecret, *iv;
+    unsigned char key[EVP_MAX_KEY_LENGTH];
     unsigned char secret[EVP_MAX_MD_SIZE];
     EVP_CIPHER_CTX *ciph_ctx;
     int ret = 0;
@@ -745,17 +842,29 @@ int tls13_update_key(SSL *s, int sending)
     if (!derive_secret_key_and_iv(s, sending, ssl_handshake_md(s),
                                   s->s3.tmp.new_sym_enc, insecret, NULL,
                                   application_traffic,
-                                  sizeof(application_traffic) - 1, secret, iv,
-                                  ciph_ctx)) {
+                                  sizeof(application_traffic) - 1, secret, key,
+                                  iv, ciph_ctx)) {
         /* SSLfatal() already called */
         goto err;
     }
 
     memcpy(insecret, secret, hashlen);
 
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+    /* Keep the kernel in step if it is protecting this direction */
+    if (((sending && BIO_get_ktls_send(s->wbio))
+                || (!sending && BIO_get_ktls_recv(s->rbio)))
+            && tls13_ktls_start(s, sending, s->s3.tmp.new_sym_enc, ciph_ctx,
+                                iv, key) < 0) {
+        /* SSLfatal() already called */
+        goto err;
+    }
+#endif
+
     s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
     ret = 1;
  err:
+    OPENSSL_cleanse(key, sizeof(key));
     OPENSSL_cleanse(secret, sizeof(secret));
     return ret;
 }
@@ -160,6 +160,139 @@ static int test_ASYNC_callback_status(void)
 
 }
 
+static int notified = 0;
+
+static int test_notify(void *arg)
+{
+    notified++;
+    return 1;
+}
+
+static int test_ASYNC_WAIT_QUEUE(void)
+{
+    ASYNC_WAIT_QUEUE *queue = NULL;
+    ASYNC_WAIT_CTX *waitctx[3] = { NULL, NULL, NULL };
+    ASYNC_WAIT_CTX *batch[30];
+    ASYNC_JOB *job[3] = { NULL, NULL, NULL };
+    ASYNC_callback_fn callback;
+    void *callback_arg;
+    void *done[64];
+    int vals[3], funcret, i, ret = 0;
+
+    notified = 0;
+
+    if (!ASYNC_init_thread(3, 0)
+            || (queue = ASYNC_WAIT_QUEUE_new()) == NULL
+            || !ASYNC_WAIT_QUEUE_set_notify(queue, test_notify, NULL))
+        goto err;
+    for (i = 0; i < 3; i++) {
+        if ((waitctx[i] = ASYNC_WAIT_CTX_new()) == NULL
+                || !ASYNC_WAIT_CTX_set_queue(waitctx[i], queue, &vals[i])
+                || ASYNC_start_job(&job[i], waitctx[i], &funcret, only_pause,
+                                   NULL, 0) != ASYNC_PAUSE)
+            goto err;
+    }
+
+    /*
+     * Complete the first job the way an engine that calls the callback of each
+     * job would, and the other two as a batch.  Only the first completion on
+     * an empty queue wakes the application.
+     */
+    if (!ASYNC_WAIT_CTX_get_callback(waitctx[0], &callback, &callback_arg)
+            || !callback(callback_arg)
+            || notified != 1
+            || !ASYNC_WAIT_CTX_complete(waitctx + 1, 2)
+            || notified != 1
+            || ASYNC_WAIT_QUEUE_drain(queue, done, 2) != 2
+            || done[0] != &vals[0]
+            || done[1] != &vals[1]
+            || ASYNC_WAIT_QUEUE_drain(queue, done, 2) != 1
+            || done[0] != &vals[2]
+            || ASYNC_WAIT_QUEUE_drain(queue, done, 2) != 0)
+        goto err;
+
+    for (i = 0; i < 3; i++) {
+        if (ASYNC_start_job(&job[i], waitctx[i], &funcret, only_pause,
+                            NULL, 0) != ASYNC_FINISH
+                || funcret != 1)
+            goto err;
+    }
+
+    /* A batch larger than the ring, which has to grow and keep the order */
+    for (i = 0; i < 30; i++)
+        batch[i] = waitctx[i % 3];
+    if (!ASYNC_WAIT_CTX_complete(batch, 2)
+            || !ASYNC_WAIT_CTX_complete(batch + 2, 28)
+            || notified != 2
+            || ASYNC_WAIT_QUEUE_drain(queue, done, 64) != 30)
+        goto err;
+    for (i = 0; i < 30; i++) {
+        if (done[i] != &vals[i % 3])
+            goto err;
+    }
+
+    if (!ASYNC_WAIT_CTX_set_queue(waitctx[0], NULL, NULL)
+            || ASYNC_WAIT_CTX_get_callback(waitctx[0], &callback,
+                                           &callback_arg))
+        goto err;
+
+    ret = 1;
+ err:
+    if (!ret)
+        fprintf(stderr, "test_ASYNC_WAIT_QUEUE() failed\n");
+    for (i = 0; i < 3; i++)
+        ASYNC_WAIT_CTX_free(waitctx[i]);
+    ASYNC_WAIT_QUEUE_free(queue);
+    ASYNC_cleanup_thread();
+    return ret;
+}
+
+/* Uses more stack than the default fibre stack size provides */
+static int big_frame(void *args)
+{
+    volatile unsigned char buf[64 * 1024];
+    size_t i;
+
+    for (i = 0; i < sizeof(buf); i += 512)
+        buf[i] = (unsigned char)i;
+    ASYNC_pause_job();
+    for (i = 0; i < sizeof(buf); i += 512) {
+        if (buf[i] != (unsigned char)i)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int test_ASYNC_init_thread_ex(void)
+{
+    ASYNC_JOB *job1 = NULL, *job2 = NULL;
+    int funcret1, funcret2;
+    ASYNC_WAIT_CTX *waitctx = NULL;
+
+    if (       !ASYNC_init_thread_ex(2, 1, 128 * 1024)
+            || (waitctx = ASYNC_WAIT_CTX_new()) == NULL
+            || ASYNC_start_job(&job1, waitctx, &funcret1, big_frame, NULL, 0)
+                != ASYNC_PAUSE
+            || ASYNC_start_job(&job2, waitctx, &funcret2, big_frame, NULL, 0)
+                != ASYNC_PAUSE
+            || ASYNC_start_job(&job1, waitctx, &funcret1, big_frame, NULL, 0)
+                != ASYNC_FINISH
+            || ASYNC_start_job(&job2, waitctx, &funcret2, big_frame, NULL, 0)
+                != ASYNC_FINISH
+            || funcret1 != 1
+            || funcret2 != 1) {
+        fprintf(stderr, "test_ASYNC_init_thread_ex() failed\n");
+        ASYNC_WAIT_CTX_free(waitctx);
+        ASYNC_cleanup_thread();
+        return 0;
+    }
+
+    ASYNC_WAIT_CTX_free(waitctx);
+    ASYNC_cleanup_thread();
+    return 1;
+}
+
 static int test_ASYNC_start_job(void)
 {
     ASYNC_JOB *job = NULL;
@@ -316,7 +449,9 @@ int main(int argc, char **argv)
         CRYPTO_mem_ctrl(CRYPTO_MEM_CHECK_ON);
 
         if (       !test_ASYNC_init_thread()
+                || !test_ASYNC_init_thread_ex()
                 || !test_ASYNC_callback_status()
+                || !test_ASYNC_WAIT_QUEUE()
                 || !test_ASYNC_start_job()
                 || !test_ASYNC_get_current_job()
                 || !test_ASYNC_WAIT_CTX_get_all_fds()
@@ -601,6 +601,97 @@ static int test_modexp_mont5(void)
     return st;
 }
 
+/*
+ * Check BN_mod_exp_mont_consttime_x2() against BN_mod_exp_simple(), with
+ * 1024-bit moduli, which may take the parallel path, and other sizes.
+ */
+static int test_modexp_consttime_x2(void)
+{
+    static const int sizes[] = { 1024, 1024, 1024, 1023, 512 };
+    BIGNUM *a1 = NULL, *ex1 = NULL, *m1 = NULL, *r1 = NULL;
+    BIGNUM *a2 = NULL, *ex2 = NULL, *m2 = NULL, *r2 = NULL;
+    BIGNUM *e = NULL;
+    BN_MONT_CTX *mont1 = NULL, *mont2 = NULL;
+    size_t i;
+    int st = 0;
+
+    if (!TEST_ptr(a1 = BN_new())
+            || !TEST_ptr(ex1 = BN_new())
+            || !TEST_ptr(m1 = BN_new())
+            || !TEST_ptr(r1 = BN_new())
+            || !TEST_ptr(a2 = BN_new())
+            || !TEST_ptr(ex2 = BN_new())
+            || !TEST_ptr(m2 = BN_new())
+            || !TEST_ptr(r2 = BN_new())
+            || !TEST_ptr(e = BN_new())
+            || !TEST_ptr(mont1 = BN_MONT_CTX_new())
+            || !TEST_ptr(mont2 = BN_MONT_CTX_new()))
+        goto err;
+
+    for (i = 0; i < OSSL_NELEM(sizes); i++) {
+        int bits = sizes[i];
+
+        if (!TEST_true(BN_bntest_rand(m1, bits, 0, 1))
+                || !TEST_true(BN_bntest_rand(m2, bits, 0, 1))
+                || !TEST_true(BN_rand_range(a1, m1))
+                || !TEST_true(BN_rand_range(a2, m2))
+                || !TEST_true(BN_bntest_rand(ex1, bits, -1, 0))
+                || !TEST_true(BN_bntest_rand(ex2, bits, -1, 0))
+                || !TEST_true(BN_MONT_CTX_set(mont1, m1, ctx))
+                || !TEST_true(BN_MONT_CTX_set(mont2, m2, ctx)))
+            goto err;
+
+        /* Largest base and an all ones exponent, and a zero exponent */
+        if (i == 1) {
+            if (!TEST_true(BN_sub(a1, m1, BN_value_one()))
+                    || !TEST_true(BN_set_word(ex1, 0))
+                    || !TEST_true(BN_set_bit(ex1, bits))
+                    || !TEST_true(BN_sub_word(ex1, 1)))
+                goto err;
+            BN_zero(ex2);
+        }
+
+        if (!TEST_true(BN_mod_exp_mont_consttime_x2(r1, a1, ex1, m1,
+                                                    i == 2 ? NULL : mont1,
+                                                    r2, a2, ex2, m2,
+                                                    i == 2 ? NULL : mont2,
+                                                    ctx))
+                || !TEST_true(BN_mod_exp_simple(e, a1, ex1, m1, ctx))
+                || !TEST_BN_eq(r1, e)
+                || !TEST_true(BN_mod_exp_simple(e, a2, ex2, m2, ctx))
+                || !TEST_BN_eq(r2, e)) {
+            TEST_info("Modulus size %d, run %d", bits, (int)i);
+            goto err;
+        }
+
+        /* The results may alias the bases */
+        if (!TEST_true(BN_mod_exp_simple(e, a1, ex1, m1, ctx))
+                || !TEST_true(BN_mod_exp_mont_consttime_x2(a1, a1, ex1, m1,
+                                                           mont1,
+                                                           a2, a2, ex2, m2,
+                                                           mont2, ctx))
+                || !TEST_BN_eq(a1, e)
+                || !TEST_BN_eq(a2, r2))
+            goto err;
+    }
+
+    st = 1;
+
+ err:
+    BN_MONT_CTX_free(mont1);
+    BN_MONT_CTX_free(mont2);
+    BN_free(a1);
+    BN_free(ex1);
+    BN_free(m1);
+    BN_free(r1);
+    BN_free(a2);
+    BN_free(ex2);
+    BN_free(m2);
+    BN_free(r2);
+    BN_free(e);
+    return st;
+}
+
 #ifndef OPENSSL_NO_EC2M
 static int test_gf2m_add(void)
 {
@@ -2539,6 +2630,7 @@ int setup_tests(void)
         ADD_TEST(test_div_recip);
         ADD_TEST(test_mod);
         ADD_TEST(test_modexp_mont5);
+        ADD_TEST(test_modexp_consttime_x2);
         ADD_TEST(test_kronecker);
         ADD_TEST(test_rand);
         ADD_TEST(test_bn2padded);
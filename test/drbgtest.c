@@ -854,6 +854,62 @@ error:
     return rv;
 }
 
+/*
+ * Test that the <public> DRBG reseeds from its seed shard, and that the
+ * shard only goes to the <master> when the <master> has reseeded.
+ */
+static int test_rand_drbg_seed_shards(void)
+{
+    RAND_DRBG *master, *public, *shard;
+    unsigned char buf[32];
+    unsigned int interval, gen;
+    time_t time_interval;
+    int rv = 0;
+
+    if (!TEST_ptr(master = RAND_DRBG_get0_master())
+        || !TEST_ptr(public = RAND_DRBG_get0_public())
+        || !TEST_ptr(master->seed_shards))
+        return 0;
+    shard = master->seed_shards[public->seed_shard % DRBG_SEED_SHARDS];
+
+    /* Keep the master from reseeding by itself */
+    interval = master->reseed_interval;
+    time_interval = master->reseed_time_interval;
+    master->reseed_interval = 0;
+    master->reseed_time_interval = 0;
+
+    if (!TEST_int_eq(RAND_bytes(buf, sizeof(buf)), 1)
+        || !TEST_int_eq(shard->state, DRBG_READY)
+        || !TEST_int_eq(shard->reseed_prop_counter,
+                        master->reseed_prop_counter))
+        goto err;
+
+    /* A reseed of the public DRBG alone leaves the master alone */
+    gen = master->reseed_gen_counter;
+    public->reseed_prop_counter++;
+    if (!TEST_int_eq(RAND_bytes(buf, sizeof(buf)), 1)
+        || !TEST_int_eq(public->reseed_prop_counter,
+                        master->reseed_prop_counter)
+        || !TEST_uint_eq(master->reseed_gen_counter, gen))
+        goto err;
+
+    /* After a reseed of the master, the shard pulls from it once */
+    master->reseed_prop_counter++;
+    if (!TEST_int_eq(RAND_bytes(buf, sizeof(buf)), 1)
+        || !TEST_int_eq(shard->reseed_prop_counter,
+                        master->reseed_prop_counter)
+        || !TEST_int_eq(public->reseed_prop_counter,
+                        master->reseed_prop_counter)
+        || !TEST_uint_eq(master->reseed_gen_counter, gen + 1))
+        goto err;
+
+    rv = 1;
+ err:
+    master->reseed_interval = interval;
+    master->reseed_time_interval = time_interval;
+    return rv;
+}
+
 #if defined(OPENSSL_THREADS)
 static int multi_thread_rand_bytes_succeeded = 1;
 static int multi_thread_rand_priv_bytes_succeeded = 1;
@@ -1104,6 +1160,95 @@ err:
     return ret;
 }
 
+static int test_rand_drbg_buffer(void)
+{
+    RAND_DRBG *m = NULL, *s = NULL;
+    unsigned char buf[100], next[16], zero[64];
+    const size_t size = sizeof(zero);
+    int ret = 0;
+
+    memset(zero, 0, sizeof(zero));
+    if (!TEST_ptr(m = RAND_DRBG_new(0, 0, NULL))
+        || !TEST_true(disable_crngt(m))
+        || !TEST_ptr(s = RAND_DRBG_new(0, 0, m)))
+        goto err;
+    /* Enable seed propagation, as for the global DRBGs */
+    m->reseed_prop_counter = 1;
+    s->reseed_prop_counter = 1;
+    if (!TEST_true(RAND_DRBG_instantiate(m, NULL, 0))
+        || !TEST_true(RAND_DRBG_instantiate(s, NULL, 0)))
+        goto err;
+
+    /* The buffer must be filled by a single generate request */
+    if (!TEST_false(RAND_DRBG_set_buffer_size(s, s->max_request + 1))
+        || !TEST_true(RAND_DRBG_set_buffer_size(s, size))
+        || !TEST_size_t_eq(RAND_DRBG_get_buffer_size(s), size))
+        goto err;
+
+    /* Small requests are served in order, and the used bytes are wiped */
+    if (!TEST_true(RAND_DRBG_bytes(s, buf, 10))
+        || !TEST_size_t_eq(s->buffer_avail, size - 10)
+        || !TEST_mem_eq(s->buffer, 10, zero, 10))
+        goto err;
+    memcpy(next, s->buffer + 10, sizeof(next));
+    if (!TEST_true(RAND_DRBG_bytes(s, buf, sizeof(next)))
+        || !TEST_mem_eq(buf, sizeof(next), next, sizeof(next))
+        || !TEST_mem_eq(s->buffer, 26, zero, 26)
+        || !TEST_size_t_eq(s->buffer_avail, size - 26))
+        goto err;
+
+    /* Larger requests bypass the buffer */
+    if (!TEST_true(RAND_DRBG_bytes(s, buf, sizeof(buf)))
+        || !TEST_size_t_eq(s->buffer_avail, size - 26))
+        goto err;
+
+    /* A request that runs the buffer dry refills it */
+    if (!TEST_true(RAND_DRBG_bytes(s, buf, size - 16))
+        || !TEST_size_t_eq(s->buffer_avail, size - 10))
+        goto err;
+
+    /* Buffered output is discarded by a reseed ... */
+    if (!TEST_true(RAND_DRBG_reseed(s, NULL, 0, 0))
+        || !TEST_size_t_eq(s->buffer_avail, 0)
+        || !TEST_mem_eq(s->buffer, size, zero, size))
+        goto err;
+
+    /* ... a reseed of the parent ... */
+    if (!TEST_true(RAND_DRBG_bytes(s, buf, 1)))
+        goto err;
+    memcpy(next, s->buffer + 1, sizeof(next));
+    ++m->reseed_prop_counter;
+    if (!TEST_true(RAND_DRBG_bytes(s, buf, sizeof(next)))
+        || !TEST_mem_ne(buf, sizeof(next), next, sizeof(next))
+        || !TEST_size_t_eq(s->buffer_avail, size - sizeof(next)))
+        goto err;
+
+    /* ... a fork ... */
+    memcpy(next, s->buffer + sizeof(next), sizeof(next));
+    rand_fork();
+    if (!TEST_true(RAND_DRBG_bytes(s, buf, sizeof(next)))
+        || !TEST_mem_ne(buf, sizeof(next), next, sizeof(next))
+        || !TEST_size_t_eq(s->buffer_avail, size - sizeof(next)))
+        goto err;
+
+    /* ... and a prediction resistant generate request */
+    if (!TEST_true(RAND_DRBG_generate(s, buf, sizeof(next), 1, NULL, 0))
+        || !TEST_size_t_eq(s->buffer_avail, 0)
+        || !TEST_mem_eq(s->buffer, size, zero, size))
+        goto err;
+
+    if (!TEST_true(RAND_DRBG_set_buffer_size(s, 0))
+        || !TEST_ptr_null(s->buffer)
+        || !TEST_true(RAND_DRBG_bytes(s, buf, 10)))
+        goto err;
+
+    ret = 1;
+err:
+    RAND_DRBG_free(s);
+    RAND_DRBG_free(m);
+    return ret;
+}
+
 static int test_multi_set(void)
 {
     int rv = 0;
@@ -1342,9 +1487,11 @@ int setup_tests(void)
     ADD_ALL_TESTS(test_kats, OSSL_NELEM(drbg_test));
     ADD_ALL_TESTS(test_error_checks, OSSL_NELEM(drbg_test));
     ADD_TEST(test_rand_drbg_reseed);
+    ADD_TEST(test_rand_drbg_seed_shards);
     ADD_TEST(test_rand_seed);
     ADD_TEST(test_rand_add);
     ADD_TEST(test_rand_drbg_prediction_resistance);
+    ADD_TEST(test_rand_drbg_buffer);
     ADD_TEST(test_multi_set);
     ADD_TEST(test_set_defaults);
 #if defined(OPENSSL_THREADS)
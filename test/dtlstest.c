@@ -16,6 +16,14 @@
 #include "ssltestlib.h"
 #include "testutil.h"
 
+#if defined(OPENSSL_SYS_LINUX) && !defined(OPENSSL_NO_SOCK)
+# include <unistd.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+# include <sys/socket.h>
+# define DTLS_UDP_TEST
+#endif
+
 static char *cert = NULL;
 static char *privkey = NULL;
 static unsigned int timer_cb_count;
@@ -328,6 +336,324 @@ static int test_dtls_duplicate_records(void)
     return testresult;
 }
 
+#ifdef DTLS_UDP_TEST
+# define BATCH_RECORDS  10
+
+/* Returns a non-blocking datagram BIO bound to a loopback UDP port */
+static BIO *create_udp_bio(struct sockaddr_in *sin)
+{
+    socklen_t len = sizeof(*sin);
+    int fd;
+    BIO *bio;
+
+    memset(sin, 0, sizeof(*sin));
+    sin->sin_family = AF_INET;
+    sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (!TEST_int_ge(fd = socket(AF_INET, SOCK_DGRAM, 0), 0))
+        return NULL;
+    if (!TEST_int_eq(bind(fd, (struct sockaddr *)sin, sizeof(*sin)), 0)
+            || !TEST_int_eq(getsockname(fd, (struct sockaddr *)sin, &len), 0)
+            || !TEST_true(BIO_socket_nbio(fd, 1))
+            || !TEST_ptr(bio = BIO_new_dgram(fd, BIO_CLOSE))) {
+        close(fd);
+        return NULL;
+    }
+    return bio;
+}
+
+static int connect_udp_bio(BIO *bio, const struct sockaddr_in *peer)
+{
+    BIO_ADDR *addr = BIO_ADDR_new();
+    int fd, ret = 0;
+
+    if (TEST_ptr(addr)
+            && TEST_true(BIO_ADDR_rawmake(addr, AF_INET, &peer->sin_addr,
+                                          sizeof(peer->sin_addr),
+                                          peer->sin_port))
+            && TEST_int_ge(BIO_get_fd(bio, &fd), 0)
+            && TEST_int_eq(connect(fd, (const struct sockaddr *)peer,
+                                   sizeof(*peer)), 0)) {
+        BIO_ctrl(bio, BIO_CTRL_DGRAM_SET_CONNECTED, 0, addr);
+        ret = 1;
+    }
+    BIO_ADDR_free(addr);
+    return ret;
+}
+
+/*
+ * Run a DTLS connection over loopback UDP sockets whose BIOs receive and send
+ * in batches, and check that a burst of records is read in one batch.
+ */
+static int test_dtls_batch(void)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    BIO *sbio = NULL, *cbio = NULL;
+    struct sockaddr_in saddr, caddr;
+    unsigned char msg[100], buf[sizeof(msg)];
+    size_t written, readbytes;
+    int testresult = 0, i;
+
+    if (!TEST_true(create_ssl_ctx_pair(DTLS_server_method(),
+                                       DTLS_client_method(),
+                                       DTLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey)))
+        return 0;
+
+    if (!TEST_ptr(sbio = create_udp_bio(&saddr))
+            || !TEST_ptr(cbio = create_udp_bio(&caddr))
+            || !TEST_true(connect_udp_bio(sbio, &caddr))
+            || !TEST_true(connect_udp_bio(cbio, &saddr)))
+        goto end;
+
+    if (!BIO_dgram_set_recv_batch(sbio, 16)) {
+        TEST_info("Datagram batching not supported, skipping");
+        testresult = 1;
+        goto end;
+    }
+    if (!TEST_true(BIO_dgram_set_recv_batch(cbio, 16))
+            || !TEST_true(BIO_dgram_set_send_batch(sbio, 16))
+            || !TEST_true(BIO_dgram_set_send_batch(cbio, 16)))
+        goto end;
+
+    if (!TEST_ptr(serverssl = SSL_new(sctx))
+            || !TEST_ptr(clientssl = SSL_new(cctx)))
+        goto end;
+    SSL_set_bio(serverssl, sbio, sbio);
+    sbio = NULL;
+    SSL_set_bio(clientssl, cbio, cbio);
+    cbio = NULL;
+    DTLS_set_timer_cb(clientssl, timer_cb);
+    DTLS_set_timer_cb(serverssl, timer_cb);
+
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE)))
+        goto end;
+
+    /* The records stay queued in the client's BIO until it is flushed */
+    for (i = 0; i < BATCH_RECORDS; i++) {
+        memset(msg, i, sizeof(msg));
+        if (!TEST_true(SSL_write_ex(clientssl, msg, sizeof(msg), &written))
+                || !TEST_size_t_eq(written, sizeof(msg)))
+            goto end;
+    }
+    if (!TEST_false(SSL_read_ex(serverssl, buf, sizeof(buf), &readbytes))
+            || !TEST_int_eq(SSL_get_error(serverssl, 0), SSL_ERROR_WANT_READ)
+            || !TEST_int_eq(BIO_flush(SSL_get_wbio(clientssl)), 1))
+        goto end;
+
+    /*
+     * All the records are received by the first read, and the rest are
+     * reported as pending until they have all been read.
+     */
+    for (i = 0; i < BATCH_RECORDS; i++) {
+        memset(msg, i, sizeof(msg));
+        if (!TEST_true(SSL_read_ex(serverssl, buf, sizeof(buf), &readbytes))
+                || !TEST_mem_eq(buf, readbytes, msg, sizeof(msg))
+                || !TEST_int_eq(SSL_has_pending(serverssl),
+                                i < BATCH_RECORDS - 1))
+            goto end;
+    }
+
+    testresult = 1;
+ end:
+    BIO_free(sbio);
+    BIO_free(cbio);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+# define DEMUX_CLIENTS  3
+# define DEMUX_PENDING  256
+
+/* Runs a step of a non-blocking handshake, which may wait for the peer */
+static int demux_handshake_step(SSL *s)
+{
+    int ret = SSL_do_handshake(s);
+
+    return ret == 1 || SSL_get_error(s, ret) == SSL_ERROR_WANT_READ;
+}
+
+/*
+ * Run several DTLS clients, each on its own UDP socket, against a server that
+ * serves them all through a single DTLS_DEMUX socket, with cookie exchange.
+ */
+static int test_dtls_demux(void)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *clientssl[DEMUX_CLIENTS] = { NULL };
+    SSL *serverssl[DEMUX_CLIENTS] = { NULL };
+    SSL *s;
+    DTLS_DEMUX *dm = NULL;
+    BIO *sbio = NULL, *cbio = NULL;
+    struct sockaddr_in saddr, caddr;
+    char msg[32], buf[32];
+    size_t readbytes, written;
+    int testresult = 0, i, j, done, naccepted = 0, nreadable = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(DTLS_server_method(),
+                                       DTLS_client_method(),
+                                       DTLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey)))
+        return 0;
+
+    SSL_CTX_set_options(sctx, SSL_OP_COOKIE_EXCHANGE);
+    SSL_CTX_set_cookie_generate_cb(sctx, generate_cookie_cb);
+    SSL_CTX_set_cookie_verify_cb(sctx, verify_cookie_cb);
+
+    if (!TEST_ptr(sbio = create_udp_bio(&saddr))
+            || !TEST_ptr(dm = DTLS_DEMUX_new(sctx, sbio)))
+        goto end;
+    sbio = NULL;
+
+    for (i = 0; i < DEMUX_CLIENTS; i++) {
+        if (!TEST_ptr(cbio = create_udp_bio(&caddr))
+                || !TEST_true(connect_udp_bio(cbio, &saddr))
+                || !TEST_ptr(clientssl[i] = SSL_new(cctx)))
+            goto end;
+        SSL_set_bio(clientssl[i], cbio, cbio);
+        cbio = NULL;
+        SSL_set_connect_state(clientssl[i]);
+    }
+
+    for (j = 0; j < 100; j++) {
+        done = naccepted == DEMUX_CLIENTS;
+        for (i = 0; i < DEMUX_CLIENTS; i++) {
+            if (!SSL_is_init_finished(clientssl[i])) {
+                done = 0;
+                if (!TEST_true(demux_handshake_step(clientssl[i])))
+                    goto end;
+            }
+        }
+        if (!TEST_int_ge(DTLS_DEMUX_recv(dm), 0))
+            goto end;
+        while ((s = DTLS_DEMUX_accept(dm)) != NULL) {
+            if (!TEST_int_lt(naccepted, DEMUX_CLIENTS))
+                goto end;
+            serverssl[naccepted++] = s;
+            if (!TEST_true(demux_handshake_step(s)))
+                goto end;
+        }
+        while ((s = DTLS_DEMUX_get_readable(dm)) != NULL) {
+            if (!TEST_true(demux_handshake_step(s)))
+                goto end;
+        }
+        for (i = 0; i < naccepted; i++) {
+            if (!SSL_is_init_finished(serverssl[i]))
+                done = 0;
+        }
+        if (done)
+            break;
+    }
+    if (!TEST_int_eq(naccepted, DEMUX_CLIENTS)
+            || !TEST_true(done))
+        goto end;
+
+    /* Each session echoes what it reads, so each client gets its own back */
+    for (i = 0; i < DEMUX_CLIENTS; i++) {
+        BIO_snprintf(msg, sizeof(msg), "hello from client %d", i);
+        if (!TEST_true(SSL_write_ex(clientssl[i], msg, strlen(msg), &written)))
+            goto end;
+    }
+    if (!TEST_int_ge(DTLS_DEMUX_recv(dm), DEMUX_CLIENTS))
+        goto end;
+    while ((s = DTLS_DEMUX_get_readable(dm)) != NULL) {
+        nreadable++;
+        if (!TEST_true(SSL_read_ex(s, buf, sizeof(buf), &readbytes))
+                || !TEST_false(SSL_has_pending(s))
+                || !TEST_true(SSL_write_ex(s, buf, readbytes, &written)))
+            goto end;
+    }
+    if (!TEST_int_eq(nreadable, DEMUX_CLIENTS)
+            || !TEST_int_eq(DTLS_DEMUX_flush(dm), 1))
+        goto end;
+    for (i = 0; i < DEMUX_CLIENTS; i++) {
+        BIO_snprintf(msg, sizeof(msg), "hello from client %d", i);
+        if (!TEST_true(SSL_read_ex(clientssl[i], buf, sizeof(buf), &readbytes))
+                || !TEST_mem_eq(buf, readbytes, msg, strlen(msg)))
+            goto end;
+    }
+
+    /* Sessions may outlive the demultiplexer */
+    SSL_free(serverssl[0]);
+    serverssl[0] = NULL;
+    DTLS_DEMUX_free(dm);
+    dm = NULL;
+    if (!TEST_false(SSL_read_ex(serverssl[1], buf, sizeof(buf), &readbytes)))
+        goto end;
+
+    testresult = 1;
+ end:
+    DTLS_DEMUX_free(dm);
+    BIO_free(sbio);
+    BIO_free(cbio);
+    for (i = 0; i < DEMUX_CLIENTS; i++) {
+        SSL_free(serverssl[i]);
+        SSL_free(clientssl[i]);
+    }
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+/*
+ * Without cookie exchange any datagram from a new address starts a session,
+ * but only DEMUX_PENDING of them wait to be accepted at a time.
+ */
+static int test_dtls_demux_pending(void)
+{
+    SSL_CTX *sctx = NULL;
+    DTLS_DEMUX *dm = NULL;
+    BIO *sbio = NULL, *cbio[DEMUX_PENDING + 1] = { NULL };
+    SSL *s;
+    struct sockaddr_in saddr, caddr;
+    int testresult = 0, i, naccepted = 0;
+
+    if (!TEST_ptr(sctx = SSL_CTX_new(DTLS_server_method()))
+            || !TEST_ptr(sbio = create_udp_bio(&saddr))
+            || !TEST_ptr(dm = DTLS_DEMUX_new(sctx, sbio)))
+        goto end;
+    sbio = NULL;
+
+    /* Read each one as it is sent, so that the socket buffer can't overflow */
+    for (i = 0; i <= DEMUX_PENDING; i++) {
+        if (!TEST_ptr(cbio[i] = create_udp_bio(&caddr))
+                || !TEST_true(connect_udp_bio(cbio[i], &saddr))
+                || !TEST_int_eq(BIO_write(cbio[i], "x", 1), 1)
+                || !TEST_int_eq(DTLS_DEMUX_recv(dm), 1))
+            goto end;
+    }
+    while ((s = DTLS_DEMUX_accept(dm)) != NULL) {
+        naccepted++;
+        SSL_free(s);
+    }
+    if (!TEST_int_eq(naccepted, DEMUX_PENDING))
+        goto end;
+
+    /* Once there is room again, the dropped address can start a session */
+    if (!TEST_int_eq(BIO_write(cbio[DEMUX_PENDING], "x", 1), 1)
+            || !TEST_int_eq(DTLS_DEMUX_recv(dm), 1)
+            || !TEST_ptr(s = DTLS_DEMUX_accept(dm)))
+        goto end;
+    SSL_free(s);
+
+    testresult = 1;
+ end:
+    DTLS_DEMUX_free(dm);
+    BIO_free(sbio);
+    for (i = 0; i <= DEMUX_PENDING; i++)
+        BIO_free(cbio[i]);
+    SSL_CTX_free(sctx);
+
+    return testresult;
+}
+#endif
+
 OPT_TEST_DECLARE_USAGE("certfile privkeyfile\n")
 
 int setup_tests(void)
@@ -340,6 +666,11 @@ int setup_tests(void)
     ADD_ALL_TESTS(test_dtls_drop_records, TOTAL_RECORDS);
     ADD_TEST(test_cookie);
     ADD_TEST(test_dtls_duplicate_records);
+#ifdef DTLS_UDP_TEST
+    ADD_TEST(test_dtls_batch);
+    ADD_TEST(test_dtls_demux);
+    ADD_TEST(test_dtls_demux_pending);
+#endif
 
     return 1;
 }
@@ -13,6 +13,7 @@
 
 #ifndef OPENSSL_NO_EC
 
+# include <string.h>
 # include <openssl/evp.h>
 # include <openssl/bn.h>
 # include <openssl/ec.h>
@@ -320,6 +321,164 @@ static int test_builtin(int n)
     OPENSSL_free(sig);
     return ret;
 }
+
+/*
+ * Verify a batch of signatures made with keys on two different curves, some
+ * of which are broken, and check that every result is what a single
+ * verification gives.
+ */
+# define BATCH_KEYS     6
+# define BATCH_SIGS     16
+
+static int test_verify_batch(void)
+{
+    static const int nids[BATCH_KEYS] = {
+        NID_X9_62_prime256v1, NID_secp384r1, NID_X9_62_prime256v1,
+        NID_X9_62_prime256v1, NID_secp384r1, NID_X9_62_prime256v1
+    };
+    EVP_PKEY *pkeys[BATCH_KEYS] = { NULL };
+    EVP_PKEY_CTX *ctx[BATCH_SIGS] = { NULL };
+    EC_KEY *eckeys[BATCH_SIGS];
+    unsigned char dgsts[BATCH_SIGS][32], sigbufs[BATCH_SIGS][128];
+    const unsigned char *dgst[BATCH_SIGS], *sig[BATCH_SIGS];
+    size_t dgstlen[BATCH_SIGS], siglen[BATCH_SIGS];
+    int results[BATCH_SIGS];
+    int i, ret = 0;
+
+    for (i = 0; i < BATCH_KEYS; i++) {
+        EC_KEY *eckey = EC_KEY_new_by_curve_name(nids[i]);
+
+        if (!TEST_ptr(eckey)
+            || !TEST_true(EC_KEY_generate_key(eckey))
+            || !TEST_ptr(pkeys[i] = EVP_PKEY_new())
+            || !TEST_true(EVP_PKEY_assign_EC_KEY(pkeys[i], eckey))) {
+            EC_KEY_free(eckey);
+            goto err;
+        }
+    }
+
+    for (i = 0; i < BATCH_SIGS; i++) {
+        EVP_PKEY *pkey = pkeys[i % BATCH_KEYS];
+
+        siglen[i] = sizeof(sigbufs[i]);
+        dgstlen[i] = sizeof(dgsts[i]);
+        dgst[i] = dgsts[i];
+        sig[i] = sigbufs[i];
+        eckeys[i] = EVP_PKEY_get0_EC_KEY(pkey);
+        if (!TEST_true(RAND_bytes(dgsts[i], sizeof(dgsts[i])))
+            || !TEST_ptr(ctx[i] = EVP_PKEY_CTX_new(pkey, NULL))
+            || !TEST_int_eq(EVP_PKEY_sign_init(ctx[i]), 1)
+            || !TEST_int_eq(EVP_PKEY_sign(ctx[i], sigbufs[i], &siglen[i],
+                                          dgsts[i], dgstlen[i]), 1)
+            || !TEST_int_eq(EVP_PKEY_verify_init(ctx[i]), 1))
+            goto err;
+    }
+
+    if (!TEST_int_eq(EVP_PKEY_verify_batch(BATCH_SIGS, ctx, sig, siglen, dgst,
+                                           dgstlen, results), 1)
+        || !TEST_int_eq(ECDSA_verify_batch(BATCH_SIGS, dgst, dgstlen, sig,
+                                           siglen, eckeys, results), 1))
+        goto err;
+
+    /* A changed digest, a signature by another key and a broken encoding */
+    dgsts[3][0] ^= 1;
+    eckeys[5] = EVP_PKEY_get0_EC_KEY(pkeys[0]);
+    EVP_PKEY_CTX_free(ctx[5]);
+    if (!TEST_ptr(ctx[5] = EVP_PKEY_CTX_new(pkeys[0], NULL))
+        || !TEST_int_eq(EVP_PKEY_verify_init(ctx[5]), 1))
+        goto err;
+    siglen[10]--;
+
+    if (!TEST_int_eq(EVP_PKEY_verify_batch(BATCH_SIGS, ctx, sig, siglen, dgst,
+                                           dgstlen, results), 0))
+        goto err;
+    for (i = 0; i < BATCH_SIGS; i++) {
+        if (!TEST_int_eq(results[i], EVP_PKEY_verify(ctx[i], sig[i], siglen[i],
+                                                     dgst[i], dgstlen[i])))
+            goto err;
+    }
+    if (!TEST_int_eq(results[3], 0)
+        || !TEST_int_eq(results[5], 0)
+        || !TEST_int_eq(results[10], -1))
+        goto err;
+
+    memset(results, 0, sizeof(results));
+    if (!TEST_int_eq(ECDSA_verify_batch(BATCH_SIGS, dgst, dgstlen, sig,
+                                        siglen, eckeys, results), 0))
+        goto err;
+    for (i = 0; i < BATCH_SIGS; i++) {
+        if (!TEST_int_eq(results[i], ECDSA_verify(0, dgst[i], (int)dgstlen[i],
+                                                  sig[i], (int)siglen[i],
+                                                  eckeys[i])))
+            goto err;
+    }
+
+    ret = 1;
+ err:
+    for (i = 0; i < BATCH_SIGS; i++)
+        EVP_PKEY_CTX_free(ctx[i]);
+    for (i = 0; i < BATCH_KEYS; i++)
+        EVP_PKEY_free(pkeys[i]);
+    return ret;
+}
+
+static const int precompute_nids[] = {
+    NID_X9_62_prime256v1, NID_secp384r1
+};
+
+static int test_precompute_pub(int n)
+{
+    EC_KEY *eckey = NULL, *other = NULL;
+    unsigned char dgst[32], sig[128], other_sig[128];
+    unsigned int siglen, other_siglen;
+    int i, ret = 0;
+
+    if (!TEST_ptr(eckey = EC_KEY_new_by_curve_name(precompute_nids[n]))
+        || !TEST_ptr(other = EC_KEY_new_by_curve_name(precompute_nids[n]))
+        || !TEST_true(EC_KEY_generate_key(eckey))
+        || !TEST_true(EC_KEY_generate_key(other))
+        || !TEST_false(EC_KEY_set_precompute_pub(eckey, -1))
+        || !TEST_int_eq(EC_KEY_get_precompute_pub(eckey), 0)
+        || !TEST_true(EC_KEY_set_precompute_pub(eckey, 3))
+        || !TEST_int_eq(EC_KEY_get_precompute_pub(eckey), 3))
+        goto err;
+
+    /* Verify before, when and after the table is built */
+    for (i = 0; i < 8; i++) {
+        siglen = sizeof(sig);
+        if (!TEST_true(RAND_bytes(dgst, sizeof(dgst)))
+            || !TEST_true(ECDSA_sign(0, dgst, sizeof(dgst), sig, &siglen,
+                                     eckey))
+            || !TEST_int_eq(ECDSA_verify(0, dgst, sizeof(dgst), sig, siglen,
+                                         eckey), 1))
+            goto err;
+        dgst[0] ^= 1;
+        if (!TEST_int_eq(ECDSA_verify(0, dgst, sizeof(dgst), sig, siglen,
+                                      eckey), 0))
+            goto err;
+    }
+
+    /* A new public key must not be verified against the old table */
+    other_siglen = sizeof(other_sig);
+    if (!TEST_true(ECDSA_sign(0, dgst, sizeof(dgst), other_sig, &other_siglen,
+                              other))
+        || !TEST_int_eq(ECDSA_verify(0, dgst, sizeof(dgst), other_sig,
+                                     other_siglen, eckey), 0)
+        || !TEST_true(EC_KEY_set_public_key(eckey,
+                                            EC_KEY_get0_public_key(other))))
+        goto err;
+    for (i = 0; i < 4; i++) {
+        if (!TEST_int_eq(ECDSA_verify(0, dgst, sizeof(dgst), other_sig,
+                                      other_siglen, eckey), 1))
+            goto err;
+    }
+
+    ret = 1;
+ err:
+    EC_KEY_free(eckey);
+    EC_KEY_free(other);
+    return ret;
+}
 #endif
 
 int setup_tests(void)
@@ -334,6 +493,8 @@ int setup_tests(void)
         return 0;
     ADD_ALL_TESTS(test_builtin, crv_len);
     ADD_ALL_TESTS(x9_62_tests, OSSL_NELEM(ecdsa_cavs_kats));
+    ADD_TEST(test_verify_batch);
+    ADD_ALL_TESTS(test_precompute_pub, OSSL_NELEM(precompute_nids));
 #endif
     return 1;
 }
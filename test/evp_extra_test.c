@@ -1229,6 +1229,183 @@ static int test_EVP_MD_fetch(int tst)
     return ret;
 }
 
+/*
+ * Test that repeated fetches are answered from the per-thread cache and that
+ * changing the default properties invalidates it.
+ */
+static int test_EVP_MD_fetch_cache(void)
+{
+    OPENSSL_CTX *ctx = NULL;
+    EVP_MD *md1 = NULL, *md2 = NULL;
+    int ret = 0;
+
+    if (!TEST_ptr(ctx = OPENSSL_CTX_new())
+            || !TEST_ptr(md1 = EVP_MD_fetch(ctx, "SHA256", ""))
+            || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "SHA256", ""))
+            || !TEST_ptr_eq(md1, md2))
+        goto err;
+    EVP_MD_free(md2);
+    md2 = NULL;
+
+    /*
+     * Nothing in the method store matches any more, so this has to construct
+     * a new method rather than hand back the one cached by this thread.
+     */
+    if (!TEST_true(EVP_set_default_properties(ctx, "default=no"))
+            || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "SHA256", ""))
+            || !TEST_ptr_ne(md1, md2)
+            || !TEST_int_eq(EVP_MD_nid(md2), NID_sha256)
+            || !TEST_true(EVP_set_default_properties(ctx, NULL)))
+        goto err;
+    ret = 1;
+
+ err:
+    EVP_MD_free(md1);
+    EVP_MD_free(md2);
+    OPENSSL_thread_stop_ex(ctx);
+    OPENSSL_CTX_free(ctx);
+    return ret;
+}
+
+/*
+ * Pipelined TLS records through AES-GCM must come out exactly as they do one
+ * record at a time.  The lengths cover partial blocks, empty records, records
+ * too long to batch and more short records than fit in one batch.
+ */
+static const size_t gcm_pipe_lens[] = {
+    0, 1, 15, 16, 17, 100, 1000, 1025, 2000, 64, 512, 500, 300
+};
+
+#define GCM_PIPE_N          OSSL_NELEM(gcm_pipe_lens)
+#define GCM_PIPE_OVERHEAD   (EVP_GCM_TLS_EXPLICIT_IV_LEN + EVP_GCM_TLS_TAG_LEN)
+
+static int gcm_pipe_aad(EVP_CIPHER_CTX *ctx, size_t i, size_t len)
+{
+    unsigned char aad[EVP_AEAD_TLS1_AAD_LEN] = { 0 };
+
+    aad[7] = (unsigned char)i;
+    aad[8] = 23;                        /* application_data */
+    aad[9] = 0x03;
+    aad[10] = 0x03;
+    aad[11] = (unsigned char)(len >> 8);
+    aad[12] = (unsigned char)len;
+    return EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD, sizeof(aad), aad)
+           == EVP_GCM_TLS_TAG_LEN;
+}
+
+static int gcm_pipe_set(EVP_CIPHER_CTX *ctx, unsigned char **recs,
+                        size_t *lens)
+{
+    return EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_SET_PIPELINE_OUTPUT_BUFS,
+                               GCM_PIPE_N, recs) > 0
+           && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_SET_PIPELINE_INPUT_BUFS,
+                                  GCM_PIPE_N, recs) > 0
+           && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_SET_PIPELINE_INPUT_LENS,
+                                  GCM_PIPE_N, lens) > 0;
+}
+
+static int test_EVP_CIPHER_gcm_pipeline(void)
+{
+    static const unsigned char key[16] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+    };
+    static unsigned char iv[12] = {
+        0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,
+        0xde, 0xca, 0xf8, 0x88
+    };
+    EVP_CIPHER *cipher = NULL;
+    EVP_CIPHER_CTX *pipe = NULL, *single = NULL;
+    unsigned char *recs[GCM_PIPE_N], *ref[GCM_PIPE_N];
+    size_t lens[GCM_PIPE_N];
+    size_t i, j;
+    int ret = 0;
+
+    memset(recs, 0, sizeof(recs));
+    memset(ref, 0, sizeof(ref));
+    if (!TEST_ptr(cipher = EVP_CIPHER_fetch(NULL, "id-aes128-GCM", ""))
+            || !TEST_true(EVP_CIPHER_flags(cipher) & EVP_CIPH_FLAG_PIPELINE)
+            || !TEST_ptr(pipe = EVP_CIPHER_CTX_new())
+            || !TEST_ptr(single = EVP_CIPHER_CTX_new())
+            || !TEST_true(EVP_EncryptInit_ex(pipe, cipher, NULL, key, NULL))
+            || !TEST_true(EVP_EncryptInit_ex(single, cipher, NULL, key, NULL))
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(pipe, EVP_CTRL_GCM_SET_IV_FIXED,
+                                                -1, iv), 0)
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(single,
+                                                EVP_CTRL_GCM_SET_IV_FIXED,
+                                                -1, iv), 0))
+        goto err;
+
+    for (i = 0; i < GCM_PIPE_N; i++) {
+        lens[i] = gcm_pipe_lens[i] + GCM_PIPE_OVERHEAD;
+        if (!TEST_ptr(recs[i] = OPENSSL_zalloc(lens[i]))
+                || !TEST_ptr(ref[i] = OPENSSL_zalloc(lens[i])))
+            goto err;
+        for (j = 0; j < gcm_pipe_lens[i]; j++)
+            recs[i][EVP_GCM_TLS_EXPLICIT_IV_LEN + j] = (unsigned char)(i + j);
+        memcpy(ref[i], recs[i], lens[i]);
+    }
+
+    /* Encrypt one record at a time, then the same records in one go */
+    for (i = 0; i < GCM_PIPE_N; i++)
+        if (!TEST_true(gcm_pipe_aad(single, i, lens[i] - EVP_GCM_TLS_TAG_LEN))
+                || !TEST_int_gt(EVP_Cipher(single, ref[i], ref[i],
+                                           (unsigned int)lens[i]), 0))
+            goto err;
+    for (i = 0; i < GCM_PIPE_N; i++)
+        if (!TEST_true(gcm_pipe_aad(pipe, i, lens[i] - EVP_GCM_TLS_TAG_LEN)))
+            goto err;
+    if (!TEST_true(gcm_pipe_set(pipe, recs, lens))
+            || !TEST_int_gt(EVP_Cipher(pipe, recs[0], recs[0],
+                                       (unsigned int)lens[0]), 0))
+        goto err;
+    for (i = 0; i < GCM_PIPE_N; i++)
+        if (!TEST_mem_eq(recs[i], lens[i], ref[i], lens[i]))
+            goto err;
+
+    /* Decrypt them all in one go */
+    if (!TEST_true(EVP_DecryptInit_ex(pipe, cipher, NULL, key, NULL))
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(pipe, EVP_CTRL_GCM_SET_IV_FIXED,
+                                                EVP_GCM_TLS_FIXED_IV_LEN, iv),
+                            0))
+        goto err;
+    for (i = 0; i < GCM_PIPE_N; i++)
+        if (!TEST_true(gcm_pipe_aad(pipe, i, lens[i])))
+            goto err;
+    if (!TEST_true(gcm_pipe_set(pipe, recs, lens))
+            || !TEST_int_gt(EVP_Cipher(pipe, recs[0], recs[0],
+                                       (unsigned int)lens[0]), 0))
+        goto err;
+    for (i = 0; i < GCM_PIPE_N; i++)
+        for (j = 0; j < gcm_pipe_lens[i]; j++)
+            if (!TEST_uchar_eq(recs[i][EVP_GCM_TLS_EXPLICIT_IV_LEN + j],
+                               (unsigned char)(i + j)))
+                goto err;
+
+    /* A single damaged record fails the lot */
+    for (i = 0; i < GCM_PIPE_N; i++) {
+        memcpy(recs[i], ref[i], lens[i]);
+        if (!TEST_true(gcm_pipe_aad(pipe, i, lens[i])))
+            goto err;
+    }
+    recs[GCM_PIPE_N / 2][lens[GCM_PIPE_N / 2] - 1] ^= 1;
+    if (!TEST_true(gcm_pipe_set(pipe, recs, lens))
+            || !TEST_int_le(EVP_Cipher(pipe, recs[0], recs[0],
+                                       (unsigned int)lens[0]), 0))
+        goto err;
+    ret = 1;
+
+ err:
+    for (i = 0; i < GCM_PIPE_N; i++) {
+        OPENSSL_free(recs[i]);
+        OPENSSL_free(ref[i]);
+    }
+    EVP_CIPHER_CTX_free(pipe);
+    EVP_CIPHER_CTX_free(single);
+    EVP_CIPHER_free(cipher);
+    return ret;
+}
+
 static int encrypt_decrypt(const EVP_CIPHER *cipher, const unsigned char *msg,
                            size_t len)
 {
@@ -1393,6 +1570,300 @@ static int test_EVP_CIPHER_fetch(int tst)
     return ret;
 }
 
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+/* Over two of the 32KB chunks that the cipher works on, and not a block */
+# define CHACHA_POLY_LEN    (64 * 1024 + 37)
+
+/*
+ * ChaCha20-Poly1305 as in RFC 7539, built from the separate ChaCha20 and
+ * Poly1305 implementations.
+ */
+static int chacha20_poly1305_ref(const unsigned char *key,
+                                 const unsigned char *nonce,
+                                 const unsigned char *aad, size_t aadlen,
+                                 const unsigned char *in, size_t len,
+                                 unsigned char *out, unsigned char *tag)
+{
+    static const unsigned char zeros[32];
+    unsigned char iv[16], polykey[32], lens[16];
+    EVP_CIPHER_CTX *ctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    EVP_MD_CTX *mctx = NULL;
+    size_t i, taglen = 16;
+    int outl, ret = 0;
+
+    /* The first key stream block gives the Poly1305 key */
+    memset(iv, 0, 4);
+    memcpy(iv + 4, nonce, 12);
+    if (!TEST_ptr(ctx = EVP_CIPHER_CTX_new())
+            || !TEST_true(EVP_EncryptInit_ex(ctx, EVP_chacha20(), NULL, key,
+                                             iv))
+            || !TEST_true(EVP_EncryptUpdate(ctx, polykey, &outl, zeros,
+                                            sizeof(zeros))))
+        goto err;
+    iv[0] = 1;
+    if (!TEST_true(EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv))
+            || !TEST_true(EVP_EncryptUpdate(ctx, out, &outl, in, (int)len)))
+        goto err;
+
+    for (i = 0; i < 8; i++) {
+        lens[i] = (unsigned char)(aadlen >> (8 * i));
+        lens[8 + i] = (unsigned char)(len >> (8 * i));
+    }
+    if (!TEST_ptr(pkey = EVP_PKEY_new_raw_private_key(EVP_PKEY_POLY1305, NULL,
+                                                      polykey,
+                                                      sizeof(polykey)))
+            || !TEST_ptr(mctx = EVP_MD_CTX_new())
+            || !TEST_true(EVP_DigestSignInit(mctx, NULL, NULL, NULL, pkey))
+            || !TEST_true(EVP_DigestSignUpdate(mctx, aad, aadlen))
+            || !TEST_true(EVP_DigestSignUpdate(mctx, zeros,
+                                               (16 - aadlen % 16) % 16))
+            || !TEST_true(EVP_DigestSignUpdate(mctx, out, len))
+            || !TEST_true(EVP_DigestSignUpdate(mctx, zeros,
+                                               (16 - len % 16) % 16))
+            || !TEST_true(EVP_DigestSignUpdate(mctx, lens, sizeof(lens)))
+            || !TEST_true(EVP_DigestSignFinal(mctx, tag, &taglen)))
+        goto err;
+    ret = 1;
+ err:
+    EVP_CIPHER_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+    EVP_MD_CTX_free(mctx);
+    return ret;
+}
+
+/*
+ * The updates that test_EVP_CIPHER_chacha20_poly1305_updates() splits the
+ * text into, the last one taking what is left.  They start in the middle of
+ * key stream blocks, and some of them span several chunks.
+ */
+static const size_t chacha_poly_splits[][5] = {
+    { CHACHA_POLY_LEN },
+    { 1, 62, 130, 32 * 1024 + 5, CHACHA_POLY_LEN },
+    { 7, CHACHA_POLY_LEN },
+    { 33, 32 * 1024, 17, 0, CHACHA_POLY_LEN },
+};
+
+static int test_EVP_CIPHER_chacha20_poly1305_updates(int idx)
+{
+    static const unsigned char key[32] = {
+        0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+        0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+        0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f
+    };
+    static const unsigned char nonce[12] = {
+        0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43,
+        0x44, 0x45, 0x46, 0x47
+    };
+    static const unsigned char aad[13] = "chunked text";
+    const size_t *splits = chacha_poly_splits[idx];
+    EVP_CIPHER *cipher = NULL;
+    EVP_CIPHER_CTX *ctx = NULL;
+    unsigned char *pt = NULL, *ct = NULL, *ref = NULL;
+    unsigned char tag[16], reftag[16];
+    size_t i, off, n;
+    int enc, outl, ret = 0;
+
+    if (!TEST_ptr(pt = OPENSSL_malloc(CHACHA_POLY_LEN))
+            || !TEST_ptr(ct = OPENSSL_malloc(CHACHA_POLY_LEN))
+            || !TEST_ptr(ref = OPENSSL_malloc(CHACHA_POLY_LEN)))
+        goto err;
+    for (i = 0; i < CHACHA_POLY_LEN; i++)
+        pt[i] = (unsigned char)(i * 13 + (i >> 8));
+    if (!TEST_true(chacha20_poly1305_ref(key, nonce, aad, sizeof(aad), pt,
+                                         CHACHA_POLY_LEN, ref, reftag))
+            || !TEST_ptr(cipher = EVP_CIPHER_fetch(NULL, "ChaCha20-Poly1305",
+                                                   ""))
+            || !TEST_ptr(ctx = EVP_CIPHER_CTX_new()))
+        goto err;
+
+    /* Encrypt into |ct|, then decrypt |ct| in place */
+    memcpy(ct, pt, CHACHA_POLY_LEN);
+    for (enc = 1; enc >= 0; enc--) {
+        if (!TEST_true(EVP_CipherInit_ex(ctx, cipher, NULL, key, nonce, enc))
+                || (!enc
+                    && !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx,
+                                                        EVP_CTRL_AEAD_SET_TAG,
+                                                        sizeof(reftag),
+                                                        reftag), 0))
+                || !TEST_true(EVP_CipherUpdate(ctx, NULL, &outl, aad,
+                                               sizeof(aad))))
+            goto err;
+        for (i = 0, off = 0; off < CHACHA_POLY_LEN; i++, off += n) {
+            n = splits[i];
+            if (n > CHACHA_POLY_LEN - off)
+                n = CHACHA_POLY_LEN - off;
+            if (!TEST_true(EVP_CipherUpdate(ctx, ct + off, &outl, ct + off,
+                                            (int)n))
+                    || !TEST_size_t_eq((size_t)outl, n))
+                goto err;
+        }
+        if (!TEST_true(EVP_CipherFinal_ex(ctx, ct + off, &outl))
+                || !TEST_int_eq(outl, 0))
+            goto err;
+        if (enc) {
+            if (!TEST_mem_eq(ct, CHACHA_POLY_LEN, ref, CHACHA_POLY_LEN)
+                    || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx,
+                                                        EVP_CTRL_AEAD_GET_TAG,
+                                                        sizeof(tag), tag), 0)
+                    || !TEST_mem_eq(tag, sizeof(tag), reftag, sizeof(reftag)))
+                goto err;
+        } else if (!TEST_mem_eq(ct, CHACHA_POLY_LEN, pt, CHACHA_POLY_LEN)) {
+            goto err;
+        }
+    }
+
+    ret = 1;
+ err:
+    OPENSSL_free(pt);
+    OPENSSL_free(ct);
+    OPENSSL_free(ref);
+    EVP_CIPHER_CTX_free(ctx);
+    EVP_CIPHER_free(cipher);
+    return ret;
+}
+#endif
+
+#ifndef OPENSSL_NO_EC
+# define ED25519_BATCH_KEYS     3
+# define ED25519_BATCH_SIGS     40
+
+static int test_EVP_PKEY_verify_batch_ed25519(void)
+{
+    EVP_PKEY *pkeys[ED25519_BATCH_KEYS] = { NULL };
+    EVP_PKEY_CTX *ctx[ED25519_BATCH_SIGS] = { NULL };
+    EVP_PKEY_CTX *kctx = NULL;
+    EVP_MD_CTX *mctx = NULL;
+    unsigned char msgs[ED25519_BATCH_SIGS][16], sigbufs[ED25519_BATCH_SIGS][64];
+    const unsigned char *msg[ED25519_BATCH_SIGS], *sig[ED25519_BATCH_SIGS];
+    size_t msglen[ED25519_BATCH_SIGS], siglen[ED25519_BATCH_SIGS];
+    int results[ED25519_BATCH_SIGS];
+    int i, ret = 0;
+
+    if (!TEST_ptr(kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, NULL))
+        || !TEST_int_gt(EVP_PKEY_keygen_init(kctx), 0))
+        goto err;
+    for (i = 0; i < ED25519_BATCH_KEYS; i++)
+        if (!TEST_int_gt(EVP_PKEY_keygen(kctx, &pkeys[i]), 0))
+            goto err;
+
+    for (i = 0; i < ED25519_BATCH_SIGS; i++) {
+        EVP_PKEY *pkey = pkeys[i % ED25519_BATCH_KEYS];
+
+        memset(msgs[i], i, sizeof(msgs[i]));
+        msg[i] = msgs[i];
+        msglen[i] = sizeof(msgs[i]) - i % 5;
+        sig[i] = sigbufs[i];
+        siglen[i] = sizeof(sigbufs[i]);
+        EVP_MD_CTX_free(mctx);
+        if (!TEST_ptr(mctx = EVP_MD_CTX_new())
+            || !TEST_true(EVP_DigestSignInit(mctx, NULL, NULL, NULL, pkey))
+            || !TEST_true(EVP_DigestSign(mctx, sigbufs[i], &siglen[i], msg[i],
+                                         msglen[i]))
+            || !TEST_ptr(ctx[i] = EVP_PKEY_CTX_new(pkey, NULL))
+            || !TEST_int_eq(EVP_PKEY_verify_init(ctx[i]), 1))
+            goto err;
+    }
+
+    if (!TEST_int_eq(EVP_PKEY_verify_batch(ED25519_BATCH_SIGS, ctx, sig,
+                                           siglen, msg, msglen, results), 1))
+        goto err;
+    for (i = 0; i < ED25519_BATCH_SIGS; i++)
+        if (!TEST_int_eq(results[i], 1))
+            goto err;
+
+    /* A changed message, another key, a short signature and S >= L */
+    msgs[7][0] ^= 1;
+    EVP_PKEY_CTX_free(ctx[20]);
+    if (!TEST_ptr(ctx[20] = EVP_PKEY_CTX_new(pkeys[0], NULL))
+        || !TEST_int_eq(EVP_PKEY_verify_init(ctx[20]), 1))
+        goto err;
+    siglen[33]--;
+    sigbufs[12][63] |= 0xf0;
+
+    if (!TEST_int_eq(EVP_PKEY_verify_batch(ED25519_BATCH_SIGS, ctx, sig,
+                                           siglen, msg, msglen, results), 0))
+        goto err;
+    for (i = 0; i < ED25519_BATCH_SIGS; i++) {
+        int expected = i != 7 && i != 12 && i != 20 && i != 33;
+
+        if (!TEST_int_eq(results[i], expected)
+            || !TEST_int_eq(EVP_PKEY_verify(ctx[i], sig[i], siglen[i], msg[i],
+                                            msglen[i]), expected))
+            goto err;
+    }
+
+    ret = 1;
+ err:
+    for (i = 0; i < ED25519_BATCH_SIGS; i++)
+        EVP_PKEY_CTX_free(ctx[i]);
+    for (i = 0; i < ED25519_BATCH_KEYS; i++)
+        EVP_PKEY_free(pkeys[i]);
+    EVP_PKEY_CTX_free(kctx);
+    EVP_MD_CTX_free(mctx);
+    return ret;
+}
+
+/*
+ * With the public key (0, -1) of order 2, the signature R = (0, 1), S = 0 is
+ * valid exactly when h = H(R || A || M) is even, while the cofactored batch
+ * equation holds for every message. The batch must agree with
+ * EVP_PKEY_verify() for each of them.
+ */
+static int test_EVP_PKEY_verify_batch_ed25519_small_order(void)
+{
+    static const unsigned char pub[32] = {
+        0xec, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f
+    };
+    static const unsigned char sigbuf[64] = { 0x01 };
+    EVP_PKEY *pkey = NULL;
+    EVP_PKEY_CTX *ctx[ED25519_BATCH_SIGS] = { NULL };
+    unsigned char msgs[ED25519_BATCH_SIGS];
+    const unsigned char *msg[ED25519_BATCH_SIGS], *sig[ED25519_BATCH_SIGS];
+    size_t msglen[ED25519_BATCH_SIGS], siglen[ED25519_BATCH_SIGS];
+    int results[ED25519_BATCH_SIGS];
+    int i, valid = 0, ret = 0;
+
+    if (!TEST_ptr(pkey = EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, NULL,
+                                                     pub, sizeof(pub))))
+        goto err;
+    for (i = 0; i < ED25519_BATCH_SIGS; i++) {
+        msgs[i] = (unsigned char)i;
+        msg[i] = &msgs[i];
+        msglen[i] = 1;
+        sig[i] = sigbuf;
+        siglen[i] = sizeof(sigbuf);
+        if (!TEST_ptr(ctx[i] = EVP_PKEY_CTX_new(pkey, NULL))
+            || !TEST_int_eq(EVP_PKEY_verify_init(ctx[i]), 1))
+            goto err;
+    }
+
+    EVP_PKEY_verify_batch(ED25519_BATCH_SIGS, ctx, sig, siglen, msg, msglen,
+                          results);
+    for (i = 0; i < ED25519_BATCH_SIGS; i++) {
+        if (!TEST_int_eq(results[i], EVP_PKEY_verify(ctx[i], sig[i], siglen[i],
+                                                     msg[i], msglen[i])))
+            goto err;
+        valid += results[i] == 1;
+    }
+    /* Both kinds of message are in the batch */
+    if (!TEST_int_gt(valid, 0)
+        || !TEST_int_lt(valid, ED25519_BATCH_SIGS))
+        goto err;
+
+    ret = 1;
+ err:
+    for (i = 0; i < ED25519_BATCH_SIGS; i++)
+        EVP_PKEY_CTX_free(ctx[i]);
+    EVP_PKEY_free(pkey);
+    return ret;
+}
+#endif
+
 int setup_tests(void)
 {
     ADD_TEST(test_EVP_DigestSignInit);
@@ -1421,6 +1892,16 @@ int setup_tests(void)
     ADD_TEST(test_X509_PUBKEY_inplace);
     ADD_ALL_TESTS(test_invalide_ec_char2_pub_range_decode,
                   OSSL_NELEM(ec_der_pub_keys));
+#endif
+    ADD_TEST(test_EVP_MD_fetch_cache);
+    ADD_TEST(test_EVP_CIPHER_gcm_pipeline);
+#ifndef OPENSSL_NO_EC
+    ADD_TEST(test_EVP_PKEY_verify_batch_ed25519);
+    ADD_TEST(test_EVP_PKEY_verify_batch_ed25519_small_order);
+#endif
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+    ADD_ALL_TESTS(test_EVP_CIPHER_chacha20_poly1305_updates,
+                  OSSL_NELEM(chacha_poly_splits));
 #endif
 #ifdef NO_FIPS_MODULE
     ADD_ALL_TESTS(test_EVP_MD_fetch, 3);
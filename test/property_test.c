@@ -332,6 +332,113 @@ err:
     return ret;
 }
 
+static int test_property_query(void)
+{
+    OSSL_METHOD_STORE *store;
+    const OSSL_PROPERTY_QUERY *q1, *q2;
+    void *result;
+    int ret = 0;
+
+    if (!TEST_ptr(store = ossl_method_store_new(NULL))
+        || !add_property_names("speed", "shape", NULL)
+        || !TEST_ptr(q1 = ossl_property_query_get(NULL, "?speed=fast"))
+        || !TEST_ptr(q2 = ossl_property_query_get(NULL, "?speed=fast"))
+        || !TEST_ptr_eq(q1, q2)
+        || !TEST_ptr(q2 = ossl_property_query_get(NULL, "shape=round"))
+        || !TEST_ptr_ne(q1, q2))
+        goto err;
+
+    /* The property value "fast" only comes into being here */
+    if (!TEST_true(ossl_method_store_add(store, NULL, 1, "speed=slow", "slow",
+                                         NULL, NULL))
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q1, &result))
+        || !TEST_str_eq((char *)result, "slow")
+        || !TEST_true(ossl_method_store_add(store, NULL, 1, "speed=fast",
+                                            "fast", NULL, NULL))
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q1, &result))
+        || !TEST_str_eq((char *)result, "fast")
+        || !TEST_true(ossl_method_store_fetch(store, 1, "?speed=fast",
+                                              &result))
+        || !TEST_str_eq((char *)result, "fast")
+        || !TEST_false(ossl_method_store_fetch_query(store, 1, q2, &result))
+        || !TEST_false(ossl_method_store_fetch_query(store, 2, q1, &result)))
+        goto err;
+
+    /* Global properties are merged into the query, which takes precedence */
+    if (!TEST_ptr(q2 = ossl_property_query_get(NULL, ""))
+        || !TEST_true(ossl_method_store_set_global_properties(store,
+                                                              "?speed=slow"))
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q2, &result))
+        || !TEST_str_eq((char *)result, "slow")
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q1, &result))
+        || !TEST_str_eq((char *)result, "fast")
+        || !TEST_true(ossl_method_store_set_global_properties(store,
+                                                              "?speed=fast"))
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q2, &result))
+        || !TEST_str_eq((char *)result, "fast")
+        || !TEST_true(ossl_method_store_set_global_properties(store, NULL))
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q1, &result))
+        || !TEST_str_eq((char *)result, "fast"))
+        goto err;
+
+    /* A query's own properties take precedence over the global ones */
+    if (!TEST_true(ossl_method_store_set_global_properties(store,
+                                                           "speed=slow"))
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q1, &result))
+        || !TEST_str_eq((char *)result, "fast")
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q2, &result))
+        || !TEST_str_eq((char *)result, "slow")
+        || !TEST_true(ossl_method_store_set_global_properties(store, NULL)))
+        goto err;
+
+    /* Removing the chosen implementation falls back to the other one */
+    if (!TEST_true(ossl_method_store_remove(store, 1, "fast"))
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q1, &result))
+        || !TEST_str_eq((char *)result, "slow"))
+        goto err;
+    ret = 1;
+err:
+    ossl_method_store_free(store);
+    return ret;
+}
+
+static int test_property_query_limit(void)
+{
+    OSSL_METHOD_STORE *store;
+    const OSSL_PROPERTY_QUERY *q;
+    char buf[50];
+    void *result;
+    int i, ret = 0;
+
+    if (!TEST_ptr(store = ossl_method_store_new(NULL))
+        || !add_property_names("n", NULL)
+        || !TEST_true(ossl_method_store_add(store, NULL, 1, "n=7", "seven",
+                                            NULL, NULL))
+        || !TEST_true(ossl_method_store_add(store, NULL, 1, "n=9", "nine",
+                                            NULL, NULL)))
+        goto err;
+
+    /* Queries beyond the interned ones are still resolved correctly */
+    for (i = 0; i < 2 * PROPERTY_QUERY_MAX + 100; i++) {
+        BIO_snprintf(buf, sizeof(buf), "?n=%d",
+                     i % 2 == 0 ? 9 : 2 * i + 10);
+        if (!TEST_true(ossl_method_store_fetch(store, 1, buf, &result))
+            || !TEST_str_eq((char *)result, i % 2 == 0 ? "nine" : "seven")) {
+            TEST_note("iteration %d", i);
+            goto err;
+        }
+    }
+    if (!TEST_ptr_null(ossl_property_query_get(NULL, "?n=100000"))
+        || !TEST_ptr(q = ossl_property_query_get(NULL, "?n=9"))
+        || !TEST_true(ossl_method_store_fetch_query(store, 1, q, &result))
+        || !TEST_str_eq((char *)result, "nine"))
+        goto err;
+    ret = 1;
+err:
+    ossl_method_store_free(store);
+    return ret;
+}
+
 static int test_query_cache_stochastic(void)
 {
     const int max = 10000, tail = 10;
@@ -381,6 +488,8 @@ int setup_tests(void)
     ADD_ALL_TESTS(test_definition_compares, OSSL_NELEM(definition_tests));
     ADD_TEST(test_register_deregister);
     ADD_TEST(test_property);
+    ADD_TEST(test_property_query);
+    ADD_TEST(test_property_query_limit);
     ADD_TEST(test_query_cache_stochastic);
     return 1;
 }
@@ -821,7 +821,8 @@ end:
 }
 
 static int execute_test_ktls(int cis_ktls_tx, int cis_ktls_rx,
-                             int sis_ktls_tx, int sis_ktls_rx)
+                             int sis_ktls_tx, int sis_ktls_rx,
+                             int tls_version, const char *cipher)
 {
     SSL_CTX *cctx = NULL, *sctx = NULL;
     SSL *clientssl = NULL, *serverssl = NULL;
@@ -838,12 +839,22 @@ static int execute_test_ktls(int cis_ktls_tx, int cis_ktls_rx,
     /* Create a session based on SHA-256 */
     if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
                                        TLS_client_method(),
-                                       TLS1_2_VERSION, TLS1_2_VERSION,
-                                       &sctx, &cctx, cert, privkey))
-            || !TEST_true(SSL_CTX_set_cipher_list(cctx,
-                                                  "AES128-GCM-SHA256"))
-            || !TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
-                                          &clientssl, sfd, cfd)))
+                                       tls_version, tls_version,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+
+    if (tls_version == TLS1_3_VERSION) {
+        if (!TEST_true(SSL_CTX_set_ciphersuites(cctx, cipher))
+            || !TEST_true(SSL_CTX_set_ciphersuites(sctx, cipher)))
+            goto end;
+    } else {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx, cipher))
+            || !TEST_true(SSL_CTX_set_cipher_list(sctx, cipher)))
+            goto end;
+    }
+
+    if (!TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
+                                       &clientssl, sfd, cfd)))
         goto end;
 
     if (!cis_ktls_tx) {
@@ -921,6 +932,124 @@ end:
     return testresult;
 }
 
+static struct ktls_test_cipher {
+    int tls_version;
+    const char *cipher;
+} ktls_test_ciphers[] = {
+    { TLS1_2_VERSION, "AES128-GCM-SHA256" },
+# ifdef OPENSSL_KTLS_AES_GCM_256
+    { TLS1_2_VERSION, "AES256-GCM-SHA384" },
+# endif
+# if defined(OPENSSL_KTLS_CHACHA20_POLY1305) && !defined(OPENSSL_NO_CHACHA) \
+     && !defined(OPENSSL_NO_POLY1305)
+    { TLS1_2_VERSION, "ECDHE-RSA-CHACHA20-POLY1305" },
+# endif
+# if defined(OPENSSL_KTLS_TLS13) && !defined(OPENSSL_NO_TLS1_3)
+    { TLS1_3_VERSION, "TLS_AES_128_GCM_SHA256" },
+    { TLS1_3_VERSION, "TLS_AES_256_GCM_SHA384" },
+#  if defined(OPENSSL_KTLS_CHACHA20_POLY1305) && !defined(OPENSSL_NO_CHACHA) \
+      && !defined(OPENSSL_NO_POLY1305)
+    { TLS1_3_VERSION, "TLS_CHACHA20_POLY1305_SHA256" },
+#  endif
+# endif
+};
+
+/*
+ * Run each supported protocol version and cipher with the kernel data-path
+ * enabled in both directions on both peers.
+ */
+static int test_ktls_cipher(int idx)
+{
+    return execute_test_ktls(1, 1, 1, 1, ktls_test_ciphers[idx].tls_version,
+                             ktls_test_ciphers[idx].cipher);
+}
+
+# if defined(OPENSSL_KTLS_TLS13) && !defined(OPENSSL_NO_TLS1_3)
+/*
+ * Exchange application data in both directions after a TLSv1.3 key update
+ * that both peers' kernels have to follow.
+ */
+static int test_ktls_key_update(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    static const char msg[] = "Hello after KeyUpdate";
+    char buf[sizeof(msg)];
+    int testresult = 0;
+    int cfd, sfd, err;
+
+    if (!TEST_true(create_test_sockets(&cfd, &sfd)))
+        goto end;
+
+    /* Skip this test if the platform does not support ktls */
+    if (!ktls_chk_platform(cfd)) {
+        testresult = 1;
+        goto end;
+    }
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_3_VERSION, TLS1_3_VERSION,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_ciphersuites(cctx,
+                                                   "TLS_AES_128_GCM_SHA256"))
+            || !TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
+                                              &clientssl, sfd, cfd))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    if (!BIO_get_ktls_send(serverssl->wbio)
+            || !BIO_get_ktls_recv(clientssl->rbio)) {
+        testresult = 1;
+        goto end;
+    }
+
+    if (!TEST_true(SSL_key_update(serverssl, SSL_KEY_UPDATE_REQUESTED)))
+        goto end;
+
+    while ((err = SSL_write(serverssl, msg, sizeof(msg))) != sizeof(msg)) {
+        if (SSL_get_error(serverssl, err) != SSL_ERROR_WANT_WRITE)
+            goto rekey_failed;
+    }
+    while ((err = SSL_read(clientssl, buf, sizeof(buf))) != sizeof(buf)) {
+        if (SSL_get_error(clientssl, err) != SSL_ERROR_WANT_READ)
+            goto rekey_failed;
+    }
+    if (!TEST_mem_eq(buf, sizeof(buf), msg, sizeof(msg)))
+        goto end;
+
+    /* The client now answers with its own KeyUpdate before the data */
+    while ((err = SSL_write(clientssl, msg, sizeof(msg))) != sizeof(msg)) {
+        if (SSL_get_error(clientssl, err) != SSL_ERROR_WANT_WRITE)
+            goto rekey_failed;
+    }
+    while ((err = SSL_read(serverssl, buf, sizeof(buf))) != sizeof(buf)) {
+        if (SSL_get_error(serverssl, err) != SSL_ERROR_WANT_READ)
+            goto rekey_failed;
+    }
+    if (!TEST_mem_eq(buf, sizeof(buf), msg, sizeof(msg)))
+        goto end;
+
+    testresult = 1;
+    goto end;
+
+ rekey_failed:
+    /* Older kernels cannot take a new key; that must fail cleanly */
+    if (TEST_int_eq(ERR_GET_REASON(ERR_peek_last_error()),
+                    SSL_R_KTLS_REKEY_FAILED)) {
+        TEST_info("Kernel does not support TLSv1.3 rekeying");
+        testresult = 1;
+    }
+end:
+    SSL_free(clientssl);
+    SSL_free(serverssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+# endif
+
 #define SENDFILE_SZ                     (16 * 4096)
 #define SENDFILE_CHUNK                  (4 * 4096)
 #define min(a,b)                        ((a) > (b) ? (b) : (a))
@@ -1028,82 +1157,98 @@ end:
 
 static int test_ktls_no_txrx_client_no_txrx_server(void)
 {
-    return execute_test_ktls(0, 0, 0, 0);
+    return execute_test_ktls(0, 0, 0, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_rx_client_no_txrx_server(void)
 {
-    return execute_test_ktls(1, 0, 0, 0);
+    return execute_test_ktls(1, 0, 0, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_tx_client_no_txrx_server(void)
 {
-    return execute_test_ktls(0, 1, 0, 0);
+    return execute_test_ktls(0, 1, 0, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_client_no_txrx_server(void)
 {
-    return execute_test_ktls(1, 1, 0, 0);
+    return execute_test_ktls(1, 1, 0, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_txrx_client_no_rx_server(void)
 {
-    return execute_test_ktls(0, 0, 1, 0);
+    return execute_test_ktls(0, 0, 1, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_rx_client_no_rx_server(void)
 {
-    return execute_test_ktls(1, 0, 1, 0);
+    return execute_test_ktls(1, 0, 1, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_tx_client_no_rx_server(void)
 {
-    return execute_test_ktls(0, 1, 1, 0);
+    return execute_test_ktls(0, 1, 1, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_client_no_rx_server(void)
 {
-    return execute_test_ktls(1, 1, 1, 0);
+    return execute_test_ktls(1, 1, 1, 0, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_txrx_client_no_tx_server(void)
 {
-    return execute_test_ktls(0, 0, 0, 1);
+    return execute_test_ktls(0, 0, 0, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_rx_client_no_tx_server(void)
 {
-    return execute_test_ktls(1, 0, 0, 1);
+    return execute_test_ktls(1, 0, 0, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_tx_client_no_tx_server(void)
 {
-    return execute_test_ktls(0, 1, 0, 1);
+    return execute_test_ktls(0, 1, 0, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_client_no_tx_server(void)
 {
-    return execute_test_ktls(1, 1, 0, 1);
+    return execute_test_ktls(1, 1, 0, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_txrx_client_server(void)
 {
-    return execute_test_ktls(0, 0, 1, 1);
+    return execute_test_ktls(0, 0, 1, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_rx_client_server(void)
 {
-    return execute_test_ktls(1, 0, 1, 1);
+    return execute_test_ktls(1, 0, 1, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_no_tx_client_server(void)
 {
-    return execute_test_ktls(0, 1, 1, 1);
+    return execute_test_ktls(0, 1, 1, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 
 static int test_ktls_client_server(void)
 {
-    return execute_test_ktls(1, 1, 1, 1);
+    return execute_test_ktls(1, 1, 1, 1, TLS1_2_VERSION,
+                             "AES128-GCM-SHA256");
 }
 #endif
 
@@ -1665,6 +1810,135 @@ static int test_session_with_both_cache(void)
 #endif
 }
 
+#ifndef OPENSSL_NO_TLS1_2
+/*
+ * Test a sharded internal session cache: sessions are spread over the shards,
+ * the size limit and incremental expiry apply per shard, and sessions can
+ * still be resumed.
+ */
+static int test_session_cache_shards(void)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    SSL_SESSION *sess = NULL;
+    unsigned char id[SSL3_SSL_SESSION_ID_LENGTH];
+    int testresult = 0, i;
+    long now = (long)time(NULL);
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_2_VERSION, TLS1_2_VERSION,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_long_eq(SSL_CTX_sess_get_cache_shards(sctx), 1)
+            || !TEST_ptr(SSL_CTX_sessions(sctx))
+            || !TEST_long_eq(SSL_CTX_sess_set_cache_shards(sctx, 0), 0)
+            || !TEST_long_eq(SSL_CTX_sess_set_cache_shards(sctx, 4), 1)
+            || !TEST_long_eq(SSL_CTX_sess_get_cache_shards(sctx), 4)
+            || !TEST_ptr_null(SSL_CTX_sessions(sctx)))
+        goto end;
+    SSL_CTX_sess_set_remove_cb(sctx, remove_session_cb);
+    SSL_CTX_sess_set_cache_size(sctx, 0);
+    remove_called = 0;
+
+    /* 8 sessions that have expired long ago, then 100 live ones */
+    memset(id, 0, sizeof(id));
+    for (i = 0; i < 108; i++) {
+        id[0] = (unsigned char)i;
+        id[5] = (unsigned char)(i * 37);
+        if (!TEST_ptr(sess = SSL_SESSION_new())
+                || !TEST_true(SSL_SESSION_set1_id(sess, id, sizeof(id)))
+                || !TEST_true(SSL_SESSION_set_protocol_version(sess,
+                                                              TLS1_2_VERSION)))
+            goto end;
+        if (i < 8
+                && (!TEST_true(SSL_SESSION_set_time(sess, now - 1000))
+                    || !TEST_true(SSL_SESSION_set_timeout(sess, 10))))
+            goto end;
+        if (!TEST_true(SSL_CTX_add_session(sctx, sess)))
+            goto end;
+        SSL_SESSION_free(sess);
+        sess = NULL;
+    }
+
+    /* The expired ones went as the shards they were in grew */
+    if (!TEST_int_eq(remove_called, 8)
+            || !TEST_long_eq(SSL_CTX_sess_number(sctx), 100))
+        goto end;
+
+    /*
+     * The size limit is spread over the shards: each shard that a session is
+     * added to drops its oldest sessions until it holds a quarter of the
+     * limit.  These 40 sessions land in every shard, so afterwards the cache
+     * is at the limit and the 100 sessions over it have been removed.
+     */
+    SSL_CTX_sess_set_cache_size(sctx, 40);
+    remove_called = 0;
+    for (i = 0; i < 40; i++) {
+        id[0] = (unsigned char)(i + 150);
+        id[5] = (unsigned char)(i * 53);
+        if (!TEST_ptr(sess = SSL_SESSION_new())
+                || !TEST_true(SSL_SESSION_set1_id(sess, id, sizeof(id)))
+                || !TEST_true(SSL_SESSION_set_protocol_version(sess,
+                                                              TLS1_2_VERSION))
+                || !TEST_true(SSL_CTX_add_session(sctx, sess)))
+            goto end;
+        SSL_SESSION_free(sess);
+        sess = NULL;
+    }
+    if (!TEST_long_eq(SSL_CTX_sess_number(sctx), 40)
+            || !TEST_int_eq(remove_called, 100))
+        goto end;
+
+    /* The last session added is still there */
+    if (!TEST_ptr(sess = SSL_SESSION_new())
+            || !TEST_true(SSL_SESSION_set1_id(sess, id, sizeof(id)))
+            || !TEST_true(SSL_SESSION_set_protocol_version(sess,
+                                                          TLS1_2_VERSION))
+            || !TEST_true(SSL_CTX_remove_session(sctx, sess))
+            || !TEST_false(SSL_CTX_remove_session(sctx, sess))
+            || !TEST_long_eq(SSL_CTX_sess_number(sctx), 39))
+        goto end;
+    SSL_SESSION_free(sess);
+    sess = NULL;
+
+    SSL_CTX_flush_sessions(sctx, 0);
+    if (!TEST_long_eq(SSL_CTX_sess_number(sctx), 0))
+        goto end;
+
+    /* Resumption by session ID through a sharded cache */
+    SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
+    SSL_CTX_sess_set_cache_size(sctx, 0);
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_ptr(sess = SSL_get1_session(clientssl))
+            || !TEST_long_eq(SSL_CTX_sess_number(sctx), 1))
+        goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(SSL_set_session(clientssl, sess))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_session_reused(clientssl)))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_SESSION_free(sess);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+#endif
+
 #ifndef OPENSSL_NO_TLS1_3
 static SSL_SESSION *sesscache[6];
 static int do_cache;
@@ -5906,6 +6180,285 @@ static int test_ssl_pending(int tst)
     return testresult;
 }
 
+#ifndef OPENSSL_NO_TLS1_2
+/*
+ * Test that data written and read with pipelining switched on comes through
+ * intact with AES-GCM ciphersuites, which encrypt and decrypt the records of
+ * a pipeline in one batch.
+ */
+static int test_pipelining(int idx)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int testresult = 0;
+    static const char *ciphers[] = {
+        "AES128-GCM-SHA256", "ECDHE-RSA-AES256-GCM-SHA384"
+    };
+    unsigned char msg[5000], buf[sizeof(msg)];
+    size_t i, written, readbytes, total = 0;
+
+    for (i = 0; i < sizeof(msg); i++)
+        msg[i] = (unsigned char)i;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_2_VERSION, TLS1_2_VERSION,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_cipher_list(cctx, ciphers[idx]))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_set_max_pipelines(clientssl, 4))
+            || !TEST_true(SSL_set_split_send_fragment(clientssl, 512))
+            || !TEST_true(SSL_set_max_pipelines(serverssl, 4)))
+        goto end;
+
+    if (!TEST_true(SSL_write_ex(clientssl, msg, sizeof(msg), &written))
+            || !TEST_size_t_eq(written, sizeof(msg)))
+        goto end;
+    while (total < sizeof(msg)) {
+        if (!TEST_true(SSL_read_ex(serverssl, buf + total,
+                                   sizeof(buf) - total, &readbytes)))
+            goto end;
+        total += readbytes;
+    }
+    if (!TEST_mem_eq(buf, total, msg, sizeof(msg)))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+#endif
+
+#ifndef OPENSSL_NO_TLS1_2
+/*
+ * Test SSL_write_iov(): records sealed in place over caller buffers
+ * Test 0: TLSv1.2 AES-GCM with pipelining
+ * Test 1: TLSv1.2 AES-CBC with encrypt-then-MAC
+ * Test 2: TLSv1.2 AES-CBC with MAC-then-encrypt
+ * Test 3: TLSv1.3 with block padding
+ */
+static int test_write_iov(int idx)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int testresult = 0;
+    static const size_t lens[] = {
+        1, 100, 1000, SSL3_RT_MAX_PLAIN_LENGTH, 0, 37, 5000
+    };
+    SSL_IOVEC iov[OSSL_NELEM(lens)], big;
+    unsigned char *mem = NULL, *msg = NULL, *buf = NULL, *p;
+    size_t i, j, memlen = 0, total = 0, written, readbytes;
+    int maxver = idx == 3 ? TLS1_3_VERSION : TLS1_2_VERSION;
+
+#ifdef OPENSSL_NO_TLS1_3
+    if (idx == 3)
+        return 1;
+#endif
+    if (idx == 4 && !ASYNC_is_capable())
+        return TEST_skip("async jobs are not supported");
+
+    for (i = 0; i < OSSL_NELEM(lens); i++) {
+        memlen += SSL_WRITE_IOV_HEADROOM + lens[i] + SSL_WRITE_IOV_TAILROOM;
+        total += lens[i];
+    }
+    if (!TEST_ptr(mem = OPENSSL_zalloc(memlen))
+            || !TEST_ptr(msg = OPENSSL_malloc(total))
+            || !TEST_ptr(buf = OPENSSL_malloc(total)))
+        goto end;
+    for (i = 0; i < total; i++)
+        msg[i] = (unsigned char)(i * 7);
+    for (i = 0, j = 0, p = mem; i < OSSL_NELEM(lens); i++) {
+        iov[i].data = p + SSL_WRITE_IOV_HEADROOM;
+        iov[i].len = lens[i];
+        memcpy(iov[i].data, msg + j, lens[i]);
+        j += lens[i];
+        p += SSL_WRITE_IOV_HEADROOM + lens[i] + SSL_WRITE_IOV_TAILROOM;
+    }
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_2_VERSION, maxver,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+    if (idx == 0) {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx, "AES128-GCM-SHA256"))
+                || !TEST_true(SSL_CTX_set_max_pipelines(cctx, 4)))
+            goto end;
+    } else if (idx < 3) {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx, "AES128-SHA256")))
+            goto end;
+        if (idx == 2)
+            SSL_CTX_set_options(cctx, SSL_OP_NO_ENCRYPT_THEN_MAC);
+    } else if (idx == 3) {
+        if (!TEST_true(SSL_CTX_set_block_padding(cctx, 512)))
+            goto end;
+    } else {
+        /* The write runs as an async job */
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx, "AES128-GCM-SHA256")))
+            goto end;
+        SSL_CTX_set_mode(cctx, SSL_MODE_ASYNC);
+    }
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    /* An element that does not fit in one record is refused */
+    big = iov[3];
+    big.len++;
+    if (!TEST_false(SSL_write_iov(clientssl, &big, 1, &written)))
+        goto end;
+
+    if (!TEST_true(SSL_write_iov(clientssl, iov, OSSL_NELEM(iov), &written))
+            || !TEST_size_t_eq(written, total))
+        goto end;
+
+    /* The plaintext has been replaced by the sealed records */
+    if (!TEST_mem_ne(iov[2].data, iov[2].len, msg + 101, iov[2].len))
+        goto end;
+
+    for (i = 0; i < total; i += readbytes) {
+        if (!TEST_true(SSL_read_ex(serverssl, buf + i, total - i,
+                                   &readbytes)))
+            goto end;
+    }
+    if (!TEST_mem_eq(buf, total, msg, total))
+        goto end;
+
+    /* The ordinary write path still works afterwards */
+    if (!TEST_true(SSL_write_ex(clientssl, msg, 1000, &written))
+            || !TEST_size_t_eq(written, 1000))
+        goto end;
+    for (i = 0; i < 1000; i += readbytes) {
+        if (!TEST_true(SSL_read_ex(serverssl, buf + i, 1000 - i,
+                                   &readbytes)))
+            goto end;
+    }
+    if (!TEST_mem_eq(buf, 1000, msg, 1000))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    OPENSSL_free(mem);
+    OPENSSL_free(msg);
+    OPENSSL_free(buf);
+
+    return testresult;
+}
+#endif
+
+/*
+ * Test the SSL_CTX record buffer pool: connections that release their buffers
+ * when idle borrow them from the pool, and keep working when the pool goes
+ * away underneath them.
+ */
+static int test_buffer_pool(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int testresult = 0, conn, round;
+    unsigned char msg[3000], buf[sizeof(msg)], *rbuf, *pooled = NULL;
+    size_t i, written, readbytes, rbuflen = 0;
+
+    for (i = 0; i < sizeof(msg); i++)
+        msg[i] = (unsigned char)(i * 3);
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_size_t_eq(SSL_CTX_get_buffer_pool_size(sctx), 0)
+            || !TEST_true(SSL_CTX_set_buffer_pool_size(sctx, 16))
+            || !TEST_true(SSL_CTX_set_buffer_pool_size(cctx, 4))
+            || !TEST_size_t_eq(SSL_CTX_get_buffer_pool_size(sctx), 16))
+        goto end;
+    SSL_CTX_set_mode(sctx, SSL_MODE_RELEASE_BUFFERS);
+    SSL_CTX_set_mode(cctx, SSL_MODE_RELEASE_BUFFERS);
+
+    for (conn = 0; conn < 3; conn++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE)))
+            goto end;
+
+        for (round = 0; round < 4; round++) {
+            SSL *from = (round & 1) ? serverssl : clientssl;
+            SSL *to = (round & 1) ? clientssl : serverssl;
+
+            /* Drop the client's pool while the last connection is live */
+            if (conn == 2 && round == 2
+                    && (!TEST_true(SSL_CTX_set_buffer_pool_size(cctx, 0))
+                        || !TEST_size_t_eq(SSL_CTX_get_buffer_pool_size(cctx),
+                                           0)))
+                goto end;
+
+            if (!TEST_true(SSL_write_ex(from, msg, sizeof(msg), &written))
+                    || !TEST_size_t_eq(written, sizeof(msg)))
+                goto end;
+            /* Read one byte first, so that the server's buffer is held */
+            for (i = 0; i < sizeof(msg); i += readbytes) {
+                if (!TEST_true(SSL_read_ex(to, buf + i,
+                                           i == 0 ? 1 : sizeof(buf) - i,
+                                           &readbytes)))
+                    goto end;
+                if (i == 0 && to == serverssl) {
+                    rbuf = serverssl->rlayer.rbuf.buf;
+                    if (!TEST_ptr(rbuf))
+                        goto end;
+                    /* The server reads into the same pooled buffer each time */
+                    if (pooled == NULL) {
+                        pooled = rbuf;
+                        rbuflen = serverssl->rlayer.rbuf.len;
+                    } else if (!TEST_ptr_eq(rbuf, pooled)) {
+                        goto end;
+                    }
+                }
+            }
+            if (!TEST_mem_eq(buf, sizeof(buf), msg, sizeof(msg)))
+                goto end;
+
+            /* A buffer is wiped before it goes back into the pool */
+            if (to == serverssl) {
+                if (!TEST_ptr_null(serverssl->rlayer.rbuf.buf))
+                    goto end;
+                for (i = 0; i < rbuflen; i++)
+                    if (!TEST_uchar_eq(pooled[i], 0))
+                        goto end;
+            }
+        }
+        pooled = NULL;
+
+        shutdown_ssl_connection(serverssl, clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
 static struct {
     unsigned int maxprot;
     const char *clntciphers;
@@ -6822,6 +7375,112 @@ static int test_ca_names(int tst)
     return testresult;
 }
 
+static X509 *load_cert(const char *name)
+{
+    char *file = test_mk_file_path(certsdir, name);
+    BIO *in = NULL;
+    X509 *x = NULL;
+
+    if (TEST_ptr(file)
+            && TEST_ptr(in = BIO_new_file(file, "r")))
+        x = PEM_read_bio_X509(in, NULL, NULL, NULL);
+    BIO_free(in);
+    OPENSSL_free(file);
+    return x;
+}
+
+/*
+ * Connect once and check that the server sent a chain of |num| certificates,
+ * the second of which is |second| if |num| is 2.
+ */
+static int check_sent_chain(SSL_CTX *sctx, SSL_CTX *cctx, int num,
+                            X509 *second)
+{
+    SSL *serverssl = NULL, *clientssl = NULL;
+    STACK_OF(X509) *chain;
+    int testresult = 0;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    /* On the client the peer chain includes the server certificate */
+    chain = SSL_get_peer_cert_chain(clientssl);
+    if (!TEST_ptr(chain)
+            || !TEST_int_eq(sk_X509_num(chain), num)
+            || (num == 2
+                && !TEST_int_eq(X509_cmp(sk_X509_value(chain, 1), second), 0)))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    return testresult;
+}
+
+/*
+ * Test that the encoded certificate chain the server caches follows changes
+ * to the chain and to the store it is built from.
+ * Test 0: TLSv1.2
+ * Test 1: TLSv1.3
+ */
+static int test_cert_chain_cache(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    X509 *root = NULL, *ca = NULL;
+    int prot = tst == 0 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    int testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 0)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (tst == 1)
+        return 1;
+#endif
+
+    if (!TEST_ptr(root = load_cert("rootcert.pem"))
+            || !TEST_ptr(ca = load_cert("ca-cert.pem"))
+            || !TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                              TLS_client_method(), prot, prot,
+                                              &sctx, &cctx, cert, privkey)))
+        goto end;
+
+    /* Nothing to build a chain from: only the server certificate is sent */
+    if (!check_sent_chain(sctx, cctx, 1, NULL)
+            || !check_sent_chain(sctx, cctx, 1, NULL))
+        goto end;
+
+    /* The chain is built again once the store has changed */
+    if (!TEST_true(X509_STORE_add_cert(SSL_CTX_get_cert_store(sctx), root))
+            || !check_sent_chain(sctx, cctx, 2, root)
+            || !check_sent_chain(sctx, cctx, 2, root))
+        goto end;
+
+    /* A configured chain replaces the built one... */
+    if (!TEST_true(SSL_CTX_add1_chain_cert(sctx, ca))
+            || !check_sent_chain(sctx, cctx, 2, ca))
+        goto end;
+
+    /* ...until it is cleared again */
+    if (!TEST_true(SSL_CTX_clear_chain_certs(sctx))
+            || !check_sent_chain(sctx, cctx, 2, root))
+        goto end;
+
+    testresult = 1;
+ end:
+    X509_free(root);
+    X509_free(ca);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
 
 OPT_TEST_DECLARE_USAGE("certfile privkeyfile srpvfile tmpfile\n")
 
@@ -6876,6 +7535,10 @@ int setup_tests(void)
     ADD_TEST(test_ktls_no_rx_client_server);
     ADD_TEST(test_ktls_no_tx_client_server);
     ADD_TEST(test_ktls_client_server);
+    ADD_ALL_TESTS(test_ktls_cipher, OSSL_NELEM(ktls_test_ciphers));
+# if defined(OPENSSL_KTLS_TLS13) && !defined(OPENSSL_NO_TLS1_3)
+    ADD_TEST(test_ktls_key_update);
+# endif
     ADD_TEST(test_ktls_sendfile);
 #endif
     ADD_TEST(test_large_message_tls);
@@ -6889,6 +7552,9 @@ int setup_tests(void)
     ADD_TEST(test_session_with_only_int_cache);
     ADD_TEST(test_session_with_only_ext_cache);
     ADD_TEST(test_session_with_both_cache);
+#ifndef OPENSSL_NO_TLS1_2
+    ADD_TEST(test_session_cache_shards);
+#endif
 #ifndef OPENSSL_NO_TLS1_3
     ADD_ALL_TESTS(test_stateful_tickets, 3);
     ADD_ALL_TESTS(test_stateless_tickets, 3);
@@ -6964,12 +7630,20 @@ int setup_tests(void)
 #endif
     ADD_ALL_TESTS(test_info_callback, 6);
     ADD_ALL_TESTS(test_ssl_pending, 2);
+#ifndef OPENSSL_NO_TLS1_2
+    ADD_ALL_TESTS(test_pipelining, 2);
+#endif
+#ifndef OPENSSL_NO_TLS1_2
+    ADD_ALL_TESTS(test_write_iov, 5);
+#endif
+    ADD_TEST(test_buffer_pool);
     ADD_ALL_TESTS(test_ssl_get_shared_ciphers, OSSL_NELEM(shared_ciphers_data));
     ADD_ALL_TESTS(test_ticket_callbacks, 12);
     ADD_ALL_TESTS(test_shutdown, 7);
     ADD_ALL_TESTS(test_cert_cb, 6);
     ADD_ALL_TESTS(test_client_cert_cb, 2);
     ADD_ALL_TESTS(test_ca_names, 3);
+    ADD_ALL_TESTS(test_cert_chain_cache, 2);
     return 1;
 }
 
@@ -12,6 +12,13 @@
 #endif
 
 #include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <openssl/rsa.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <openssl/provider.h>
 #include "testutil.h"
 
 #if !defined(OPENSSL_THREADS) || defined(CRYPTO_TDEBUG)
@@ -184,10 +191,326 @@ static int test_thread_local(void)
     return 1;
 }
 
+/*
+ * Run |thread_cb| on MULTI_THREADS new threads while |main_cb| runs on this
+ * one, then wait for them all.  The callbacks report failure by setting
+ * |multi_failed|.
+ */
+#define MULTI_THREADS       4
+
+static int multi_failed = 0;
+
+static int run_multi_thread(void (*thread_cb)(void), void (*main_cb)(void))
+{
+    thread_t threads[MULTI_THREADS];
+    int started = 0, ret = 1;
+
+    multi_failed = 0;
+    for (; started < MULTI_THREADS; started++)
+        if (!TEST_true(run_thread(&threads[started], thread_cb))) {
+            ret = 0;
+            break;
+        }
+    main_cb();
+    while (started-- > 0)
+        if (!TEST_true(wait_for_thread(threads[started])))
+            ret = 0;
+    return ret && TEST_int_eq(multi_failed, 0);
+}
+
+/*
+ * Hammer the method store query cache from several threads while its entries
+ * are being flushed underneath them.
+ */
+#define FETCH_ITERATIONS    2000
+
+static void fetch_thread_cb(void)
+{
+    EVP_MD *md;
+    int i;
+
+    for (i = 0; i < FETCH_ITERATIONS; i++) {
+        if ((md = EVP_MD_fetch(NULL, "SHA256", NULL)) == NULL
+            || EVP_MD_size(md) != 32)
+            multi_failed = 1;
+        EVP_MD_free(md);
+    }
+}
+
+/* Changing the default properties flushes the whole query cache */
+static void fetch_main_cb(void)
+{
+    int i;
+
+    for (i = 0; i < FETCH_ITERATIONS / 10; i++)
+        if (!TEST_true(EVP_set_default_properties(NULL, i % 2 == 0
+                                                        ? "default=yes"
+                                                        : NULL)))
+            multi_failed = 1;
+}
+
+static int test_fetch_cache(void)
+{
+    int ret = run_multi_thread(fetch_thread_cb, fetch_main_cb);
+
+    return TEST_true(EVP_set_default_properties(NULL, NULL)) && ret;
+}
+
+/*
+ * Unloading a provider empties every thread's fetch cache, including the
+ * caches of threads that are busy fetching at the time.
+ */
+static OPENSSL_CTX *unload_ctx = NULL;
+
+static void unload_thread_cb(void)
+{
+    EVP_MD *md;
+    int i;
+
+    for (i = 0; i < FETCH_ITERATIONS; i++) {
+        if ((md = EVP_MD_fetch(unload_ctx, "SHA256", NULL)) == NULL
+            || EVP_MD_size(md) != 32)
+            multi_failed = 1;
+        EVP_MD_free(md);
+    }
+}
+
+static void unload_main_cb(void)
+{
+    OSSL_PROVIDER *prov;
+    int i;
+
+    for (i = 0; i < FETCH_ITERATIONS / 10; i++) {
+        if (!TEST_ptr(prov = OSSL_PROVIDER_load(unload_ctx, "default")))
+            multi_failed = 1;
+        OSSL_PROVIDER_unload(prov);
+    }
+}
+
+static int test_fetch_cache_unload(void)
+{
+    OSSL_PROVIDER *prov = NULL;
+    int ret = 0;
+
+    if (!TEST_ptr(unload_ctx = OPENSSL_CTX_new())
+        || !TEST_ptr(prov = OSSL_PROVIDER_load(unload_ctx, "default")))
+        goto err;
+    ret = run_multi_thread(unload_thread_cb, unload_main_cb);
+
+ err:
+    OSSL_PROVIDER_unload(prov);
+    OPENSSL_CTX_free(unload_ctx);
+    unload_ctx = NULL;
+    return ret;
+}
+
+/*
+ * Look up certificates in a shared X509_STORE from several threads while
+ * more certificates are being added to it.
+ */
+#define STORE_CERTS         64
+
+static X509_STORE *store = NULL;
+static X509_NAME *store_names[STORE_CERTS];
+
+static void store_thread_cb(void)
+{
+    X509_STORE_CTX *ctx = X509_STORE_CTX_new();
+    X509_OBJECT *obj = X509_OBJECT_new();
+    int i;
+
+    if (ctx == NULL || obj == NULL
+        || !X509_STORE_CTX_init(ctx, store, NULL, NULL)) {
+        multi_failed = 1;
+        goto end;
+    }
+    for (i = 0; i < FETCH_ITERATIONS; i++) {
+        X509_NAME *nm = store_names[i % (STORE_CERTS / 2)];
+
+        /* The first half of the certificates is always there */
+        if (X509_STORE_CTX_get_by_subject(ctx, X509_LU_X509, nm, obj) != 1
+            || X509_NAME_cmp(X509_get_subject_name(X509_OBJECT_get0_X509(obj)),
+                             nm) != 0)
+            multi_failed = 1;
+        X509_OBJECT_free(obj);
+        if ((obj = X509_OBJECT_new()) == NULL) {
+            multi_failed = 1;
+            break;
+        }
+    }
+ end:
+    X509_OBJECT_free(obj);
+    X509_STORE_CTX_free(ctx);
+}
+
+static int store_add_cert(int i)
+{
+    X509 *x = X509_new();
+    int ret;
+
+    ret = TEST_ptr(x)
+          && TEST_true(X509_set_subject_name(x, store_names[i]))
+          && TEST_true(X509_set_issuer_name(x, store_names[i]))
+          && TEST_true(X509_STORE_add_cert(store, x));
+    X509_free(x);
+    return ret;
+}
+
+/* Add the second half of the certificates while the threads look them up */
+static void store_main_cb(void)
+{
+    int i;
+
+    for (i = STORE_CERTS; i-- > STORE_CERTS / 2; )
+        if (!store_add_cert(i))
+            multi_failed = 1;
+}
+
+static int test_store_lookup(void)
+{
+    X509_STORE_CTX *ctx = NULL;
+    STACK_OF(X509) *certs = NULL;
+    char cn[16];
+    int i, ret = 0;
+
+    if (!TEST_ptr(store = X509_STORE_new()))
+        return 0;
+    for (i = 0; i < STORE_CERTS; i++) {
+        BIO_snprintf(cn, sizeof(cn), "cert %d", i);
+        if (!TEST_ptr(store_names[i] = X509_NAME_new())
+            || !TEST_true(X509_NAME_add_entry_by_txt(store_names[i], "CN",
+                                                     MBSTRING_ASC,
+                                                     (unsigned char *)cn,
+                                                     -1, -1, 0)))
+            goto err;
+    }
+    /* Add in reverse order so that every addition unsorts the store */
+    for (i = STORE_CERTS / 2; i-- > 0; )
+        if (!store_add_cert(i))
+            goto err;
+
+    if (!run_multi_thread(store_thread_cb, store_main_cb))
+        goto err;
+
+    /* Everything added while the threads were running is found as well */
+    if (!TEST_ptr(ctx = X509_STORE_CTX_new())
+        || !TEST_true(X509_STORE_CTX_init(ctx, store, NULL, NULL)))
+        goto err;
+    for (i = 0; i < STORE_CERTS; i++) {
+        if (!TEST_ptr(certs = X509_STORE_CTX_get1_certs(ctx, store_names[i]))
+            || !TEST_int_eq(sk_X509_num(certs), 1))
+            goto err;
+        sk_X509_pop_free(certs, X509_free);
+        certs = NULL;
+    }
+    ret = TEST_int_eq(sk_X509_OBJECT_num(X509_STORE_get0_objects(store)),
+                      STORE_CERTS);
+ err:
+    sk_X509_pop_free(certs, X509_free);
+    X509_STORE_CTX_free(ctx);
+    for (i = 0; i < STORE_CERTS; i++)
+        X509_NAME_free(store_names[i]);
+    X509_STORE_free(store);
+    return ret;
+}
+
+/*
+ * Sign with one RSA key from several threads at once, each with its own
+ * blinding.
+ */
+#define RSA_ITERATIONS      50
+
+static RSA *rsa_key = NULL;
+
+static void rsa_sign_verify(void)
+{
+    static const unsigned char msg[20] = { 1, 2, 3 };
+    unsigned char sig[128];
+    unsigned int siglen;
+    int i;
+
+    for (i = 0; i < RSA_ITERATIONS; i++) {
+        if (!RSA_sign(NID_sha1, msg, sizeof(msg), sig, &siglen, rsa_key)
+            || !RSA_verify(NID_sha1, msg, sizeof(msg), sig, siglen, rsa_key))
+            multi_failed = 1;
+    }
+}
+
+static int test_rsa_blinding(void)
+{
+    BIGNUM *e = NULL;
+    int ret = 0;
+
+    if (!TEST_ptr(e = BN_new())
+        || !TEST_true(BN_set_word(e, RSA_F4))
+        || !TEST_ptr(rsa_key = RSA_new())
+        || !TEST_true(RSA_generate_key_ex(rsa_key, 1024, e, NULL))
+        || !run_multi_thread(rsa_sign_verify, rsa_sign_verify))
+        goto err;
+
+    /* The blindings can be switched off and on again */
+    RSA_blinding_off(rsa_key);
+    if (!run_multi_thread(rsa_sign_verify, rsa_sign_verify)
+        || !TEST_true(RSA_blinding_on(rsa_key, NULL)))
+        goto err;
+    ret = run_multi_thread(rsa_sign_verify, rsa_sign_verify);
+ err:
+    RSA_free(rsa_key);
+    BN_free(e);
+    return ret;
+}
+
+#ifndef OPENSSL_NO_EC
+/*
+ * Verify with one EC key from several threads at once, while one of them
+ * builds the table for the public key.
+ */
+# define EC_ITERATIONS      50
+
+static EC_KEY *ec_key = NULL;
+static unsigned char ec_sig[128];
+static unsigned int ec_siglen;
+
+static void ec_thread_cb(void)
+{
+    static const unsigned char dgst[32] = { 1, 2, 3 };
+    int i;
+
+    for (i = 0; i < EC_ITERATIONS; i++) {
+        if (ECDSA_verify(0, dgst, sizeof(dgst), ec_sig, ec_siglen,
+                         ec_key) != 1)
+            multi_failed = 1;
+    }
+}
+
+static int test_ec_precompute_pub(void)
+{
+    static const unsigned char dgst[32] = { 1, 2, 3 };
+    int ret = 0;
+
+    ec_siglen = sizeof(ec_sig);
+    if (TEST_ptr(ec_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1))
+        && TEST_true(EC_KEY_generate_key(ec_key))
+        && TEST_true(EC_KEY_set_precompute_pub(ec_key, MULTI_THREADS))
+        && TEST_true(ECDSA_sign(0, dgst, sizeof(dgst), ec_sig, &ec_siglen,
+                                ec_key)))
+        ret = run_multi_thread(ec_thread_cb, ec_thread_cb);
+    EC_KEY_free(ec_key);
+    return ret;
+}
+#endif
+
 int setup_tests(void)
 {
     ADD_TEST(test_lock);
     ADD_TEST(test_once);
     ADD_TEST(test_thread_local);
+    ADD_TEST(test_fetch_cache);
+    ADD_TEST(test_fetch_cache_unload);
+    ADD_TEST(test_store_lookup);
+    ADD_TEST(test_rsa_blinding);
+#ifndef OPENSSL_NO_EC
+    ADD_TEST(test_ec_precompute_pub);
+#endif
     return 1;
 }
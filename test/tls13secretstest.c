@@ -206,6 +206,34 @@ int ossl_statem_export_early_allowed(SSL *s)
     return 1;
 }
 
+#ifndef OPENSSL_NO_KTLS
+unsigned int ssl_get_max_send_fragment(const SSL *ssl)
+{
+    return SSL3_RT_MAX_PLAIN_LENGTH;
+}
+
+/* Normally declared in ssl/record/record_locl.h */
+int ssl3_release_write_buffer(SSL *s);
+
+int ssl3_release_write_buffer(SSL *s)
+{
+    return 1;
+}
+
+int ktls_check_supported_cipher(const SSL *s, const EVP_CIPHER *c)
+{
+    return 0;
+}
+
+int ktls_configure_crypto(SSL *s, const EVP_CIPHER *c, EVP_CIPHER_CTX *dd,
+                          void *rl_sequence,
+                          struct tls_crypto_info_all *crypto_info,
+                          int is_tx, unsigned char *iv, unsigned char *key)
+{
+    return 0;
+}
+#endif
+
 /* End of mocked out code */
 
 static int test_secret(SSL *s, unsigned char *prk,
@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2018 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2015-2019 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -177,6 +177,73 @@ static int test_store_ctx(void)
     return testresult;
 }
 
+/*
+ * The generation of a store changes with its contents and parameters, and
+ * with nothing else.
+ */
+static int test_store_generation(void)
+{
+    X509_STORE *store = NULL;
+    STACK_OF(X509) *certs = NULL;
+    X509_OBJECT *obj;
+    uint64_t gen;
+    int testresult = 0;
+
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(certs = load_certs_from_file(untrusted_f))
+            || !TEST_int_ge(sk_X509_num(certs), 2))
+        goto err;
+
+    gen = X509_STORE_get_generation(store);
+    if (!TEST_ptr(X509_STORE_get0_param(store))
+            || !TEST_true(X509_STORE_get_generation(store) == gen)
+            || !TEST_true(X509_STORE_add_cert(store, sk_X509_value(certs, 0)))
+            || !TEST_true(X509_STORE_get_generation(store) != gen))
+        goto err;
+
+    /* Adding the same certificate again changes nothing */
+    gen = X509_STORE_get_generation(store);
+    if (!TEST_true(X509_STORE_add_cert(store, sk_X509_value(certs, 0)))
+            || !TEST_true(X509_STORE_get_generation(store) == gen)
+            || !TEST_true(X509_STORE_lock(store))
+            || !TEST_true(X509_STORE_unlock(store))
+            || !TEST_true(X509_STORE_get_generation(store) == gen))
+        goto err;
+
+    /* Nor does looking up a certificate under the lock */
+    if (!TEST_true(X509_STORE_add_cert(store, sk_X509_value(certs, 1))))
+        goto err;
+    gen = X509_STORE_get_generation(store);
+    if (!TEST_true(X509_STORE_lock(store)))
+        goto err;
+    obj = sk_X509_OBJECT_value(X509_STORE_get0_objects(store), 0);
+    if (!TEST_ptr(obj)
+            || !TEST_ptr(X509_OBJECT_get0_X509(obj))
+            || !TEST_true(X509_STORE_unlock(store))
+            || !TEST_true(X509_STORE_get_generation(store) == gen))
+        goto err;
+
+    /* Removing it under the lock does */
+    if (!TEST_true(X509_STORE_lock(store)))
+        goto err;
+    obj = sk_X509_OBJECT_delete(X509_STORE_get0_objects(store), 0);
+    X509_OBJECT_free(obj);
+    if (!TEST_true(X509_STORE_unlock(store))
+            || !TEST_true(X509_STORE_get_generation(store) != gen))
+        goto err;
+
+    gen = X509_STORE_get_generation(store);
+    if (!TEST_true(X509_STORE_set_depth(store, 3))
+            || !TEST_true(X509_STORE_get_generation(store) != gen))
+        goto err;
+
+    testresult = 1;
+ err:
+    sk_X509_pop_free(certs, X509_free);
+    X509_STORE_free(store);
+    return testresult;
+}
+
 OPT_TEST_DECLARE_USAGE("roots.pem untrusted.pem bad.pem\n")
 
 #ifndef OPENSSL_NO_SM2
@@ -271,6 +338,7 @@ int setup_tests(void)
 
     ADD_TEST(test_alt_chains_cert_forgery);
     ADD_TEST(test_store_ctx);
+    ADD_TEST(test_store_generation);
 #ifndef OPENSSL_NO_SM2
     ADD_TEST(test_sm2_id);
     ADD_TEST(test_req_sm2_id);